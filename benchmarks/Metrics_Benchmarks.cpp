@@ -0,0 +1,274 @@
+#include "metrics/LatencyHistogram.hpp"
+#include "metrics/Performance.hpp"
+#include "metrics/ProcSampler.hpp"
+#include "metrics/ScrapeRegistry.hpp"
+#include "utils/BaseServerStats.hpp"
+#include "utils/FileHelpers.hpp"
+#include "utils/TscClock.hpp"
+
+#include <benchmark/benchmark.h>
+#include <prometheus/counter.h>
+#include <prometheus/gauge.h>
+#include <prometheus/histogram.h>
+#include <prometheus/summary.h>
+
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/times.h>
+
+namespace
+{
+	// Quantiles of the summaries replaced by the latency histograms
+	const prometheus::Summary::Quantiles SUMMARY_QUANTILES = {{0.5, 0.1}, {0.9, 0.1}, {0.99, 0.1}};
+
+	// Exposes the base statistics of the servers
+	class BenchmarkServerStats : private BaseServerStats {
+	  public:
+		explicit BenchmarkServerStats(const std::shared_ptr<prometheus::Registry> &reg)
+		{
+			initBaseStats(reg, "benchmark_");
+		}
+
+		void consume(uint64_t succeeded, uint64_t failed, double processingTime)
+		{
+			consumeBaseStats(succeeded, failed, processingTime);
+		}
+	};
+
+	// Counts the entries of a directory, as the process metrics did before sampling with kept-open descriptors
+	uint64_t countDirectoryEntries(const char *path)
+	{
+		uint64_t count = 0;
+		if (DIR *dir = opendir(path); dir != nullptr)
+		{
+			while (readdir(dir) != nullptr) // NOLINT(concurrency-mt-unsafe)
+			{
+				++count;
+			}
+			closedir(dir);
+		}
+		return count;
+	}
+
+	// Samples the process values as the process metrics did before sampling with kept-open descriptors
+	void sampleLegacy(ProcSample &sample)
+	{
+		// Memory usage and page faults were read by separate calls
+		struct rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+		const long peakResident = usage.ru_maxrss; // NOLINT(cppcoreguidelines-pro-type-union-access)
+		getrusage(RUSAGE_SELF, &usage);
+		const long majorFaults = usage.ru_majflt; // NOLINT(cppcoreguidelines-pro-type-union-access)
+		sample.peakResidentKb = static_cast<uint64_t>(peakResident);
+		sample.majorFaults = static_cast<uint64_t>(majorFaults);
+
+		struct tms cpuTimes{};
+		times(&cpuTimes);
+		sample.userTicks = static_cast<uint64_t>(cpuTimes.tms_utime);
+
+		std::string buffer;
+		findFromFile("/proc/self/io", "read_bytes", buffer);
+		sample.readBytes = buffer.empty() ? 0 : std::stoull(buffer);
+		buffer.clear();
+		findFromFile("/proc/self/io", "write_bytes", buffer);
+		sample.writeBytes = buffer.empty() ? 0 : std::stoull(buffer);
+
+		sample.threadCount = countDirectoryEntries("/proc/self/task");
+		sample.fileDescriptorCount = countDirectoryEntries("/proc/self/fd");
+	}
+
+	// Updates the prometheus metrics on every command, as the statistics did before they were sharded
+	class BenchmarkDirectStats {
+	  private:
+		prometheus::Summary *_processingTime;
+		prometheus::Gauge *_maxProcessingTime;
+		prometheus::Gauge *_minProcessingTime;
+		prometheus::Counter *_succeededCommand;
+		prometheus::Counter *_failedCommand;
+		prometheus::Counter *_totalCommand;
+
+	  public:
+		explicit BenchmarkDirectStats(prometheus::Registry &reg)
+			: _processingTime(&prometheus::BuildSummary().Name("direct_time").Register(reg).Add({}, SUMMARY_QUANTILES)),
+			  _maxProcessingTime(&prometheus::BuildGauge().Name("direct_max_time").Register(reg).Add({})),
+			  _minProcessingTime(&prometheus::BuildGauge().Name("direct_min_time").Register(reg).Add({})),
+			  _succeededCommand(&prometheus::BuildCounter().Name("direct_succeeded").Register(reg).Add({})),
+			  _failedCommand(&prometheus::BuildCounter().Name("direct_failed").Register(reg).Add({})),
+			  _totalCommand(&prometheus::BuildCounter().Name("direct_total").Register(reg).Add({}))
+		{
+			_minProcessingTime->Set(std::numeric_limits<int>::max());
+		}
+
+		void consume(uint64_t succeeded, uint64_t failed, double processingTime)
+		{
+			_succeededCommand->Increment(static_cast<double>(succeeded));
+			_failedCommand->Increment(static_cast<double>(failed));
+			_totalCommand->Increment(static_cast<double>(succeeded + failed));
+			_processingTime->Observe(processingTime);
+			_maxProcessingTime->Set(std::max(_maxProcessingTime->Value(), processingTime));
+			_minProcessingTime->Set(std::min(_minProcessingTime->Value(), processingTime));
+		}
+	};
+} // namespace
+
+static void Metrics_ServerStatsBenchmark(benchmark::State &state)
+{
+	static const auto reg = std::make_shared<ScrapeRegistry>();
+	static BenchmarkServerStats shardedStats(reg);
+	static BenchmarkDirectStats directStats(*reg);
+
+	const bool isSharded = state.range(0) != 0;
+	auto processingTime = static_cast<double>(1000 + state.thread_index());
+	for (auto _ : state)
+	{
+		if (isSharded)
+		{
+			shardedStats.consume(1, 0, processingTime);
+		}
+		else
+		{
+			directStats.consume(1, 0, processingTime);
+		}
+		processingTime += 1;
+	}
+
+	// Aggregation is paid once per scrape instead of once per command
+	if (state.thread_index() == 0)
+	{
+		benchmark::DoNotOptimize(reg->Collect());
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Metrics_ServerStatsBenchmark)->ArgName("sharded")->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
+
+static void Metrics_LatencyRecordBenchmark(benchmark::State &state)
+{
+	static const auto reg = std::make_shared<ScrapeRegistry>();
+	static auto &summary = prometheus::BuildSummary().Name("record_summary").Register(*reg).Add({}, SUMMARY_QUANTILES);
+	static auto &histogram = prometheus::BuildHistogram().Name("record_histogram").Register(*reg);
+	static LatencyHistogram latencyHistogram(reg, histogram);
+
+	const auto backend = state.range(0);
+	uint64_t value = 1000 + static_cast<uint64_t>(state.thread_index());
+	for (auto _ : state)
+	{
+		if (backend == 0)
+		{
+			summary.Observe(static_cast<double>(value));
+		}
+		else
+		{
+			latencyHistogram.record(value);
+		}
+		value = (value * 7) % 1000003;
+	}
+
+	if (state.thread_index() == 0)
+	{
+		benchmark::DoNotOptimize(reg->Collect());
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Metrics_LatencyRecordBenchmark)
+	->ArgName("histogram")
+	->Arg(0)
+	->Arg(1)
+	->ThreadRange(1, 8)
+	->UseRealTime();
+
+static void Metrics_ClockBenchmark(benchmark::State &state)
+{
+	const auto clock = state.range(0);
+	for (auto _ : state)
+	{
+		if (clock == 0)
+		{
+			benchmark::DoNotOptimize(std::chrono::steady_clock::now());
+		}
+		else if (clock == 1)
+		{
+			benchmark::DoNotOptimize(std::chrono::high_resolution_clock::now());
+		}
+		else
+		{
+			benchmark::DoNotOptimize(TscClock::now());
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Metrics_ClockBenchmark)->ArgName("clock")->Arg(0)->Arg(1)->Arg(2);
+
+static void Metrics_PerformanceSpanBenchmark(benchmark::State &state)
+{
+	static const auto reg = std::make_shared<ScrapeRegistry>();
+	static PerformanceTracker requestTracker(reg, "benchmark_request");
+	static PerformanceTracker commandTracker(reg, "benchmark_command");
+
+	// All threads share the trackers, every request has a nested command
+	for (auto _ : state)
+	{
+		const auto request = requestTracker.scope();
+		const auto command = commandTracker.scope();
+		benchmark::ClobberMemory();
+	}
+
+	if (state.thread_index() == 0)
+	{
+		benchmark::DoNotOptimize(reg->Collect());
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Metrics_PerformanceSpanBenchmark)->ThreadRange(1, 8)->UseRealTime();
+
+static void Metrics_ProcSampleBenchmark(benchmark::State &state)
+{
+	const bool isKeptOpen = state.range(0) != 0;
+	ProcSampler sampler;
+	ProcSample sample;
+
+	// Cost of a process metrics update, which bounds the usable update interval
+	for (auto _ : state)
+	{
+		if (isKeptOpen)
+		{
+			sampler.sample(sample);
+		}
+		else
+		{
+			sampleLegacy(sample);
+		}
+		benchmark::DoNotOptimize(sample);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Metrics_ProcSampleBenchmark)->ArgName("kept_open")->Arg(0)->Arg(1);
+
+static void Metrics_ProcThreadSampleBenchmark(benchmark::State &state)
+{
+	ProcSampler sampler;
+	std::vector<ThreadSample> threads;
+
+	// Cost of the per-thread metrics of an update, which grows with the number of threads
+	std::vector<std::jthread> workers;
+	for (int64_t idx = 0; idx < state.range(0); ++idx)
+	{
+		workers.emplace_back([](const std::stop_token &stopToken) {
+			while (!stopToken.stop_requested())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+	for (auto _ : state)
+	{
+		sampler.sampleThreads(threads);
+		benchmark::DoNotOptimize(threads.data());
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Metrics_ProcThreadSampleBenchmark)->ArgName("threads")->Arg(0)->Arg(8)->Arg(32);
@@ -1,18 +1,26 @@
 #include "TelnetClient.hpp"
+#include "telnet/TelnetInputParser.hpp"
 #include "telnet/TelnetServer.hpp"
 
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <ctime>
+
 #define TELNET_SERVER_PORT 10001
+#define TELNET_LOAD_SERVER_PORT 10002
 
 class TelnetWrapper {
   private:
 	std::shared_ptr<TelnetServer> server;
 
   public:
-	explicit TelnetWrapper(uint16_t port)
+	explicit TelnetWrapper(uint16_t port, const TelnetLimits &limits = {})
 	{
 		server = std::make_shared<TelnetServer>();
+		server->limits(limits);
 		if (!server || !(server->initialise(port, nullptr)))
 		{
 			throw std::runtime_error("Can't init telnet");
@@ -40,3 +48,202 @@ static void Telnet_Benchmark(benchmark::State &state)
 	}
 }
 BENCHMARK(Telnet_Benchmark);
+
+static void TelnetInputParser_Benchmark(benchmark::State &state)
+{
+	// Simulate a large paste of commands mixed with negotiation, escape sequences and backspaces
+	const std::string chunk = "enable log vv\r\n\xff\xfb\x01status\x1b[A\x1b[Bhelpp\x7f\r\n";
+
+	std::string paste;
+	while (paste.size() < static_cast<size_t>(state.range(0)))
+	{
+		paste += chunk;
+	}
+
+	TelnetInputParser parser;
+	for (auto _ : state)
+	{
+		for (const char chr : paste)
+		{
+			if (parser.consume(chr) == TelnetInputEvent::Line)
+			{
+				benchmark::DoNotOptimize(parser.takeBuffer());
+			}
+		}
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(paste.size()));
+}
+BENCHMARK(TelnetInputParser_Benchmark)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+static int64_t CpuTimeNs(clockid_t clockId)
+{
+	timespec spec{};
+	clock_gettime(clockId, &spec);
+	return static_cast<int64_t>(spec.tv_sec) * 1000000000 + spec.tv_nsec;
+}
+
+static double Percentile(const std::vector<double> &sorted, double ratio)
+{
+	if (sorted.empty())
+	{
+		return 0;
+	}
+	return sorted[std::min(sorted.size() - 1, static_cast<size_t>(ratio * static_cast<double>(sorted.size())))];
+}
+
+/**
+ * Concurrent Telnet clients driven in rounds. In every round all clients send a paste of ping commands at the same time
+ * and wait for all responses, so the server sees the load of every session at once.
+ */
+class TelnetLoadClients {
+  private:
+	std::vector<std::unique_ptr<TelnetClient>> _clients;
+	std::vector<std::vector<double>> _latencies; // Round-trip latencies of the clients in microseconds
+	std::vector<int64_t> _cpuStart;				 // Thread CPU times of the clients before the first round
+	std::vector<int64_t> _cpuEnd;				 // Thread CPU times of the clients after the last round
+	std::string _paste;
+	size_t _pasteLines;
+	std::atomic_bool _stop{false};
+	std::atomic_bool _failed{false};
+	std::barrier<> _startBarrier;
+	std::barrier<> _endBarrier;
+	std::vector<std::jthread> _workers;
+
+	void workerFunc(size_t idx)
+	{
+		_cpuStart[idx] = CpuTimeNs(CLOCK_THREAD_CPUTIME_ID);
+		while (true)
+		{
+			_startBarrier.arrive_and_wait();
+			if (_stop)
+			{
+				return;
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			if (!_clients[idx]->sendAndWait(_paste, "pong", _pasteLines))
+			{
+				_failed = true;
+			}
+			_latencies[idx].push_back(
+				std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+			_cpuEnd[idx] = CpuTimeNs(CLOCK_THREAD_CPUTIME_ID);
+
+			_endBarrier.arrive_and_wait();
+		}
+	}
+
+  public:
+	TelnetLoadClients(uint16_t port, size_t clientCount, size_t pasteLines)
+		: _latencies(clientCount), _cpuStart(clientCount), _cpuEnd(clientCount), _pasteLines(pasteLines),
+		  _startBarrier(static_cast<ptrdiff_t>(clientCount + 1)), _endBarrier(static_cast<ptrdiff_t>(clientCount + 1))
+	{
+		for (size_t idx = 0; idx < pasteLines; ++idx)
+		{
+			_paste += "ping\r\n";
+		}
+		for (size_t idx = 0; idx < clientCount; ++idx)
+		{
+			_clients.push_back(std::make_unique<TelnetClient>("127.0.0.1", port));
+		}
+		for (size_t idx = 0; idx < clientCount; ++idx)
+		{
+			_workers.emplace_back([this, idx] { workerFunc(idx); });
+		}
+	}
+
+	TelnetLoadClients(const TelnetLoadClients &) = delete;
+	TelnetLoadClients &operator=(const TelnetLoadClients &) = delete;
+
+	~TelnetLoadClients()
+	{
+		_stop = true;
+		_startBarrier.arrive_and_wait();
+		_workers.clear();
+	}
+
+	/// Runs a round, returns false if any client missed a response
+	bool runRound()
+	{
+		_startBarrier.arrive_and_wait();
+		_endBarrier.arrive_and_wait();
+		return !_failed;
+	}
+
+	/// Sorted round-trip latencies of all clients
+	std::vector<double> latencies() const
+	{
+		std::vector<double> merged;
+		for (const auto &latencies : _latencies)
+		{
+			merged.insert(merged.end(), latencies.begin(), latencies.end());
+		}
+		std::ranges::sort(merged);
+		return merged;
+	}
+
+	/// CPU time spent by the client threads during the rounds
+	int64_t cpuTime() const
+	{
+		int64_t total = 0;
+		for (size_t idx = 0; idx < _cpuStart.size(); ++idx)
+		{
+			total += std::max(_cpuEnd[idx], _cpuStart[idx]) - _cpuStart[idx];
+		}
+		return total;
+	}
+};
+
+// Limits are relaxed to measure the server loop itself
+static TelnetLimits LoadLimits()
+{
+	TelnetLimits limits;
+	limits.maxSessions = 512;
+	limits.listenBacklog = 512;
+	limits.acceptBatch = 64;
+	limits.connectionRate = limits.connectionBurst = 1e6;
+	limits.byteRate = limits.byteBurst = 1e9;
+	limits.commandRate = limits.commandBurst = 1e6;
+	return limits;
+}
+
+static void Telnet_LoadBenchmark(benchmark::State &state)
+{
+	static TelnetWrapper server(TELNET_LOAD_SERVER_PORT, LoadLimits());
+
+	const auto sessionCount = static_cast<size_t>(state.range(0));
+	const auto pasteLines = static_cast<size_t>(state.range(1));
+	TelnetLoadClients clients(TELNET_LOAD_SERVER_PORT, sessionCount, pasteLines);
+
+	const auto processCpuStart = CpuTimeNs(CLOCK_PROCESS_CPUTIME_ID);
+	const auto mainCpuStart = CpuTimeNs(CLOCK_THREAD_CPUTIME_ID);
+	for (auto _ : state)
+	{
+		if (!clients.runRound())
+		{
+			state.SkipWithError("Telnet server didn't respond to all commands");
+			return;
+		}
+	}
+	const auto mainCpu = CpuTimeNs(CLOCK_THREAD_CPUTIME_ID) - mainCpuStart;
+	const auto processCpu = CpuTimeNs(CLOCK_PROCESS_CPUTIME_ID) - processCpuStart;
+
+	const auto commands = static_cast<int64_t>(state.iterations() * sessionCount * pasteLines);
+	state.SetItemsProcessed(commands);
+
+	// Latency of a round trip of a paste
+	const auto latencies = clients.latencies();
+	state.counters["p50_us"] = Percentile(latencies, 0.5);
+	state.counters["p99_us"] = Percentile(latencies, 0.99);
+	state.counters["p999_us"] = Percentile(latencies, 0.999);
+
+	// CPU of the process excluding the client threads and the benchmark thread, which is the server thread
+	const auto serverCpu = processCpu - clients.cpuTime() - mainCpu;
+	state.counters["server_cpu_ns_per_cmd"] =
+		static_cast<double>(serverCpu) / static_cast<double>(std::max<int64_t>(commands, 1));
+}
+BENCHMARK(Telnet_LoadBenchmark)
+	->ArgsProduct({{10, 50, 100, 200}, {1, 16, 64}})
+	->ArgNames({"sessions", "paste"})
+	->UseRealTime()
+	->Unit(benchmark::kMillisecond);
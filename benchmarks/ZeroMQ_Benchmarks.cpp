@@ -0,0 +1,531 @@
+#include "ZeroMQEchoServer.hpp"
+#include "ZeroMQTestClient.hpp"
+#include "metrics/ScrapeRegistry.hpp"
+#include "zeromq/ZeroMQContext.hpp"
+#include "zeromq/ZeroMQServer.hpp"
+
+#include <benchmark/benchmark.h>
+#include <zmq_addon.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <format>
+#include <map>
+#include <new>
+#include <mutex>
+
+#define ZEROMQ_SERVER_PORT 10003
+#define ZEROMQ_ECHO_FIXTURE_PORT 10004
+#define ZEROMQ_REP_SERVER_PORT 10005
+#define ZEROMQ_WORKER_SERVER_PORT 10006
+#define ZEROMQ_STATS_SERVER_PORT 10007
+
+// Number of workers of the multi-worker server benchmarks
+constexpr size_t ZEROMQ_BENCHMARK_WORKERS = 4;
+
+namespace
+{
+	// Number of operator new calls in the measured loops, libzmq allocates its objects through it as well
+	std::atomic_uint64_t allocationCount{0};
+	// Allocations are counted only while a benchmark loop runs, not by the other benchmarks of the executable
+	std::atomic_bool isCountingAllocations{false};
+
+	// Counts the allocations of the process during its lifetime
+	class AllocationCounter {
+	  private:
+		uint64_t _startCount;
+
+	  public:
+		AllocationCounter() : _startCount(allocationCount.load()) { isCountingAllocations = true; }
+
+		[[nodiscard]] benchmark::Counter perIteration() const
+		{
+			return {static_cast<double>(allocationCount.load() - _startCount), benchmark::Counter::kAvgIterations};
+		}
+
+		~AllocationCounter() { isCountingAllocations = false; }
+
+		AllocationCounter(const AllocationCounter & /*unused*/) = delete;
+		AllocationCounter(AllocationCounter && /*unused*/) = delete;
+		AllocationCounter &operator=(const AllocationCounter & /*unused*/) = delete;
+		AllocationCounter &operator=(AllocationCounter && /*unused*/) = delete;
+	};
+
+	// Allocates like the default operator new and counts it if enabled
+	void *countedAllocation(size_t size, size_t alignment)
+	{
+		if (isCountingAllocations.load(std::memory_order_relaxed))
+		{
+			allocationCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		size = std::max<size_t>(size, 1);
+		void *ptr = alignment <= alignof(std::max_align_t)
+						? std::malloc(size) // NOLINT(cppcoreguidelines-no-malloc)
+						: std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+		if (ptr == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		return ptr;
+	}
+
+	// "ping" hash
+	constexpr uint32_t PING_ID = 1196312912;
+	// "status" hash
+	constexpr uint32_t STATUS_ID = 1263027027;
+	// "RPLY" command which returns a generated reply of the requested size
+	constexpr uint32_t REPLY_ID = (static_cast<uint32_t>('R') | (static_cast<uint32_t>('P') << 8) |
+								   (static_cast<uint32_t>('L') << 16) | (static_cast<uint32_t>('Y') << 24));
+} // namespace
+
+// Replaceable allocation functions count the C++ allocations, array and nothrow forms forward to them
+void *operator new(size_t size) { return countedAllocation(size, alignof(std::max_align_t)); }
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	return countedAllocation(size, static_cast<size_t>(alignment));
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); } // NOLINT(cppcoreguidelines-no-malloc)
+void operator delete(void *ptr, size_t /*unused*/) noexcept { std::free(ptr); } // NOLINT(cppcoreguidelines-no-malloc)
+void operator delete(void *ptr, std::align_val_t /*unused*/) noexcept
+{
+	std::free(ptr); // NOLINT(cppcoreguidelines-no-malloc)
+}
+void operator delete(void *ptr, size_t /*unused*/, std::align_val_t /*unused*/) noexcept
+{
+	std::free(ptr); // NOLINT(cppcoreguidelines-no-malloc)
+}
+
+class ZeroMQWrapper {
+  private:
+	std::unique_ptr<ZeroMQServer> server;
+
+	// Serves the reply benchmark, other commands are forwarded to the default callback
+	static bool callback(const std::vector<zmq::message_t> &recvMsgs, std::vector<zmq::message_t> &replyMsgs)
+	{
+		if (*recvMsgs[0].data<uint32_t>() != REPLY_ID || recvMsgs.size() != 3)
+		{
+			return ZeroMQServerMessageCallback(recvMsgs, replyMsgs);
+		}
+
+		replyMsgs.clear();
+		std::string replyBody(*recvMsgs[1].data<uint32_t>(), 'x');
+		if (*recvMsgs[2].data<uint8_t>() != 0)
+		{
+			replyMsgs.push_back(makeMessage(std::move(replyBody)));
+		}
+		else
+		{
+			replyMsgs.emplace_back(replyBody.data(), replyBody.size());
+		}
+		return true;
+	}
+
+  public:
+	explicit ZeroMQWrapper(uint16_t port)
+	{
+		server = std::make_unique<ZeroMQServer>("tcp://127.0.0.1:" + std::to_string(port), nullptr);
+		server->messageCallback(callback);
+		if (!server->initialise())
+		{
+			throw std::runtime_error("Can't init ZeroMQ server");
+		}
+	}
+};
+
+class ZeroMQBenchmarkClient {
+  private:
+	zmq::context_t context{1};
+	zmq::socket_t socket{context, zmq::socket_type::req};
+	std::vector<zmq::message_t> recvMsgs;
+
+  public:
+	explicit ZeroMQBenchmarkClient(uint16_t port)
+	{
+		socket.set(zmq::sockopt::linger, 0);
+		socket.set(zmq::sockopt::rcvtimeo, 1000);
+		socket.connect("tcp://127.0.0.1:" + std::to_string(port));
+	}
+
+	// Sends a request and waits the reply, messages are recycled so only the request path allocates
+	bool request(std::vector<zmq::message_t> &sendMsgs)
+	{
+		recvMsgs.clear();
+		return zmq::send_multipart(socket, sendMsgs) && zmq::recv_multipart(socket, std::back_inserter(recvMsgs));
+	}
+
+	[[nodiscard]] const std::vector<zmq::message_t> &replies() const { return recvMsgs; }
+};
+
+// Server and client are shared by the benchmarks, since they bind the same port
+static ZeroMQBenchmarkClient &BenchmarkClient()
+{
+	static ZeroMQWrapper server(ZEROMQ_SERVER_PORT);
+	static ZeroMQBenchmarkClient client(ZEROMQ_SERVER_PORT);
+	return client;
+}
+
+static void ZeroMQ_CommandBenchmark(benchmark::State &state)
+{
+	auto &client = BenchmarkClient();
+
+	const uint32_t command = state.range(0) == 0 ? PING_ID : STATUS_ID;
+	std::vector<zmq::message_t> sendMsgs;
+
+	const AllocationCounter allocations;
+	for (auto _ : state)
+	{
+		sendMsgs.clear();
+		sendMsgs.emplace_back(&command, sizeof(command));
+		if (!client.request(sendMsgs))
+		{
+			state.SkipWithError("Can't receive ZeroMQ reply");
+			return;
+		}
+	}
+	state.counters["allocs_per_request"] = allocations.perIteration();
+}
+BENCHMARK(ZeroMQ_CommandBenchmark)->ArgName("status")->Arg(0)->Arg(1);
+
+static void ZeroMQ_ReplyBenchmark(benchmark::State &state)
+{
+	auto &client = BenchmarkClient();
+
+	const auto replySize = static_cast<uint32_t>(state.range(0));
+	const auto zeroCopy = static_cast<uint8_t>(state.range(1));
+	std::vector<zmq::message_t> sendMsgs;
+
+	const AllocationCounter allocations;
+	for (auto _ : state)
+	{
+		sendMsgs.clear();
+		sendMsgs.emplace_back(&REPLY_ID, sizeof(REPLY_ID));
+		sendMsgs.emplace_back(&replySize, sizeof(replySize));
+		sendMsgs.emplace_back(&zeroCopy, sizeof(zeroCopy));
+		if (!client.request(sendMsgs) || client.replies().front().size() != replySize)
+		{
+			state.SkipWithError("Can't receive ZeroMQ reply");
+			return;
+		}
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * replySize);
+	state.counters["allocs_per_request"] = allocations.perIteration();
+}
+BENCHMARK(ZeroMQ_ReplyBenchmark)
+	->ArgsProduct({{64, 4 * 1024, 64 * 1024, 1024 * 1024}, {0, 1}})
+	->ArgNames({"size", "zero_copy"});
+
+namespace
+{
+	// Transports of the transport benchmarks
+	enum class BenchmarkTransport : uint8_t { Inproc, Ipc, Tcp };
+
+	// Servers of the transport benchmarks
+	enum class BenchmarkServer : uint8_t {
+		EchoFixture,  ///< Plain reply loop of the test fixture, the baseline without the server overhead
+		ReplyServer,  ///< ZeroMQServer processing the messages in the server thread
+		WorkerServer, ///< ZeroMQServer processing the messages in the worker threads
+		StatsServer,  ///< ZeroMQServer processing the messages in the worker threads and updating the statistics
+	};
+
+	// Address of a benchmark server, ports also separate the inproc and ipc endpoints
+	std::string benchmarkAddress(BenchmarkTransport transport, int port)
+	{
+		switch (transport)
+		{
+		case BenchmarkTransport::Inproc:
+			return std::format("inproc://zeromq-benchmark-{}", port);
+		case BenchmarkTransport::Ipc:
+			return std::format("ipc:///tmp/zeromq-benchmark-{}.ipc", port);
+		default:
+			return std::format("tcp://127.0.0.1:{}", port);
+		}
+	}
+
+	// Echoes the received messages back
+	bool echoCallback(const std::vector<zmq::message_t> &recvMsgs, std::vector<zmq::message_t> &replyMsgs)
+	{
+		for (const auto &msg : recvMsgs)
+		{
+			replyMsgs.emplace_back(msg.data(), msg.size());
+		}
+		return true;
+	}
+
+	/// Echo server of a transport benchmark and the context its inproc clients should use
+	class TransportFixture {
+	  private:
+		std::unique_ptr<ZeroMQEchoServer> echoServer;
+		std::unique_ptr<ZeroMQServer> server;
+		std::shared_ptr<zmq::context_t> context;
+
+	  public:
+		TransportFixture(BenchmarkTransport transport, BenchmarkServer serverType)
+		{
+			switch (serverType)
+			{
+			case BenchmarkServer::EchoFixture:
+				context = std::make_shared<zmq::context_t>(1);
+				echoServer = std::make_unique<ZeroMQEchoServer>(
+					benchmarkAddress(transport, ZEROMQ_ECHO_FIXTURE_PORT), INT_MAX, context);
+				break;
+			case BenchmarkServer::ReplyServer:
+			case BenchmarkServer::WorkerServer:
+				server = std::make_unique<ZeroMQServer>(
+					benchmarkAddress(transport, serverType == BenchmarkServer::ReplyServer ? ZEROMQ_REP_SERVER_PORT
+																						   : ZEROMQ_WORKER_SERVER_PORT),
+					nullptr, nullptr, "", serverType == BenchmarkServer::ReplyServer ? 0 : ZEROMQ_BENCHMARK_WORKERS);
+				server->messageCallback(echoCallback);
+				if (!server->initialise())
+				{
+					throw std::runtime_error("Can't init ZeroMQ server");
+				}
+				context = server->context();
+				break;
+			case BenchmarkServer::StatsServer:
+				server = std::make_unique<ZeroMQServer>(benchmarkAddress(transport, ZEROMQ_STATS_SERVER_PORT), nullptr,
+														std::make_shared<ScrapeRegistry>(), "benchmark",
+														ZEROMQ_BENCHMARK_WORKERS);
+				server->messageCallback(echoCallback);
+				if (!server->initialise())
+				{
+					throw std::runtime_error("Can't init ZeroMQ server");
+				}
+				context = server->context();
+				break;
+			}
+		}
+
+		// Inproc clients should share the context of the server, others use their own like remote clients
+		[[nodiscard]] std::shared_ptr<zmq::context_t> clientContext(BenchmarkTransport transport) const
+		{
+			return transport == BenchmarkTransport::Inproc ? context : nullptr;
+		}
+	};
+
+	// Servers are started once and shared by the benchmarks, since they bind the same addresses
+	TransportFixture &benchmarkFixture(BenchmarkTransport transport, BenchmarkServer serverType)
+	{
+		static std::mutex guard;
+		static std::map<std::pair<BenchmarkTransport, BenchmarkServer>, std::unique_ptr<TransportFixture>> fixtures;
+
+		const std::scoped_lock lock(guard);
+		auto &fixture = fixtures[{transport, serverType}];
+		if (!fixture)
+		{
+			fixture = std::make_unique<TransportFixture>(transport, serverType);
+		}
+		return *fixture;
+	}
+
+	// Payload of the requests, split to the requested number of parts
+	void makeRequest(std::vector<zmq::message_t> &sendMsgs, size_t payloadSize, size_t nParts)
+	{
+		static const std::string payload(1024 * 1024, 'x');
+
+		sendMsgs.clear();
+		sendMsgs.emplace_back(&PING_ID, sizeof(PING_ID));
+		for (size_t idx = 0; idx < nParts; ++idx)
+		{
+			sendMsgs.emplace_back(payload.data(), payloadSize / nParts);
+		}
+	}
+
+	// Reports the latency percentiles of the iterations in microseconds, averaged over the benchmark threads
+	void reportLatencies(benchmark::State &state, std::vector<int64_t> &latencies)
+	{
+		if (latencies.empty())
+		{
+			return;
+		}
+
+		for (const auto &[name, percentile] : {std::pair{"p50_us", 0.5}, {"p99_us", 0.99}, {"p999_us", 0.999}})
+		{
+			const auto nth = latencies.begin() + static_cast<std::ptrdiff_t>(
+													 percentile * static_cast<double>(latencies.size() - 1));
+			std::nth_element(latencies.begin(), nth, latencies.end());
+			state.counters[name] =
+				benchmark::Counter(static_cast<double>(*nth) / 1000.0, benchmark::Counter::kAvgThreads);
+		}
+	}
+} // namespace
+
+static void ZeroMQ_TransportBenchmark(benchmark::State &state)
+{
+	const auto transport = static_cast<BenchmarkTransport>(state.range(0));
+	const auto serverType = static_cast<BenchmarkServer>(state.range(1));
+	const auto payloadSize = static_cast<size_t>(state.range(2));
+	const auto nParts = static_cast<size_t>(state.range(3));
+
+	auto &fixture = benchmarkFixture(transport, serverType);
+	const int port = serverType == BenchmarkServer::EchoFixture	  ? ZEROMQ_ECHO_FIXTURE_PORT
+					 : serverType == BenchmarkServer::ReplyServer ? ZEROMQ_REP_SERVER_PORT
+																  : ZEROMQ_WORKER_SERVER_PORT;
+	ZeroMQTestClient client(benchmarkAddress(transport, port), fixture.clientContext(transport));
+
+	std::vector<zmq::message_t> sendMsgs;
+	std::vector<zmq::message_t> recvMsgs;
+	std::vector<int64_t> latencies;
+	latencies.reserve(static_cast<size_t>(state.max_iterations));
+	for (auto _ : state)
+	{
+		makeRequest(sendMsgs, payloadSize, nParts);
+
+		const auto requestStart = std::chrono::steady_clock::now();
+		if (!client.request(sendMsgs, recvMsgs) || recvMsgs.size() != nParts + 1)
+		{
+			state.SkipWithError("Can't receive ZeroMQ reply");
+			return;
+		}
+		const auto latency = std::chrono::steady_clock::now() - requestStart;
+		latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+	}
+
+	state.SetItemsProcessed(state.iterations());
+	state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(payloadSize / nParts * nParts));
+	reportLatencies(state, latencies);
+}
+BENCHMARK(ZeroMQ_TransportBenchmark)
+	->ArgsProduct({{0, 1, 2}, // inproc, ipc, tcp
+				   {0, 1, 2}, // echo fixture, reply server, worker server
+				   {64, 4 * 1024, 64 * 1024},
+				   {1, 8}})
+	->ArgNames({"transport", "server", "size", "parts"})
+	->UseRealTime();
+
+static void ZeroMQ_ConcurrentClientBenchmark(benchmark::State &state)
+{
+	const auto serverType = static_cast<BenchmarkServer>(state.range(0));
+	const int port = serverType == BenchmarkServer::ReplyServer ? ZEROMQ_REP_SERVER_PORT : ZEROMQ_WORKER_SERVER_PORT;
+
+	// Every benchmark thread is a separate client
+	benchmarkFixture(BenchmarkTransport::Tcp, serverType);
+	ZeroMQTestClient client(benchmarkAddress(BenchmarkTransport::Tcp, port));
+
+	std::vector<zmq::message_t> sendMsgs;
+	std::vector<zmq::message_t> recvMsgs;
+	std::vector<int64_t> latencies;
+	latencies.reserve(static_cast<size_t>(state.max_iterations));
+	for (auto _ : state)
+	{
+		makeRequest(sendMsgs, 64, 1);
+
+		const auto requestStart = std::chrono::steady_clock::now();
+		if (!client.request(sendMsgs, recvMsgs))
+		{
+			state.SkipWithError("Can't receive ZeroMQ reply");
+			return;
+		}
+		const auto latency = std::chrono::steady_clock::now() - requestStart;
+		latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+	}
+
+	state.SetItemsProcessed(state.iterations());
+	reportLatencies(state, latencies);
+}
+BENCHMARK(ZeroMQ_ConcurrentClientBenchmark)
+	->Arg(static_cast<int64_t>(BenchmarkServer::ReplyServer))
+	->Arg(static_cast<int64_t>(BenchmarkServer::WorkerServer))
+	->ArgName("server")
+	->ThreadRange(1, 8)
+	->UseRealTime();
+
+static void ZeroMQ_SharedContextBenchmark(benchmark::State &state)
+{
+	// Sockets of the shared context share its I/O threads, otherwise every socket starts its own
+	const bool isShared = state.range(0) != 0;
+	const auto nSockets = static_cast<size_t>(state.range(1));
+
+	benchmarkFixture(BenchmarkTransport::Tcp, BenchmarkServer::WorkerServer);
+	std::vector<std::unique_ptr<ZeroMQ>> clients;
+	for (size_t idx = 0; idx < nSockets; ++idx)
+	{
+		auto ctx = isShared ? ZeroMQSharedContext() : std::make_shared<zmq::context_t>(1);
+		clients.push_back(std::make_unique<ZeroMQ>(
+			ctx, zmq::socket_type::req, benchmarkAddress(BenchmarkTransport::Tcp, ZEROMQ_WORKER_SERVER_PORT), false));
+		clients.back()->start();
+	}
+
+	// Every socket has a request in flight at the same time
+	std::vector<zmq::message_t> sendMsgs;
+	std::vector<zmq::message_t> recvMsgs;
+	for (auto _ : state)
+	{
+		for (auto &client : clients)
+		{
+			makeRequest(sendMsgs, 64, 1);
+			client->sendMessages(sendMsgs);
+		}
+		for (auto &client : clients)
+		{
+			if (client->recvMessages(recvMsgs) == 0)
+			{
+				state.SkipWithError("Can't receive ZeroMQ reply");
+				return;
+			}
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(nSockets));
+}
+BENCHMARK(ZeroMQ_SharedContextBenchmark)
+	->ArgsProduct({{0, 1}, {1, 8, 32}})
+	->ArgNames({"shared", "sockets"})
+	->UseRealTime();
+
+static void ZeroMQ_ShortLivedClientBenchmark(benchmark::State &state)
+{
+	// Private contexts start and join their threads for every client
+	const bool isShared = state.range(0) != 0;
+
+	benchmarkFixture(BenchmarkTransport::Tcp, BenchmarkServer::WorkerServer);
+	std::vector<zmq::message_t> sendMsgs;
+	std::vector<zmq::message_t> recvMsgs;
+	for (auto _ : state)
+	{
+		ZeroMQ client(isShared ? ZeroMQSharedContext() : std::make_shared<zmq::context_t>(1), zmq::socket_type::req,
+					  benchmarkAddress(BenchmarkTransport::Tcp, ZEROMQ_WORKER_SERVER_PORT), false);
+		client.start();
+
+		makeRequest(sendMsgs, 64, 1);
+		client.sendMessages(sendMsgs);
+		if (client.recvMessages(recvMsgs) == 0)
+		{
+			state.SkipWithError("Can't receive ZeroMQ reply");
+			return;
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(ZeroMQ_ShortLivedClientBenchmark)->Arg(0)->Arg(1)->ArgName("shared")->UseRealTime();
+
+static void ZeroMQ_WorkerStatsBenchmark(benchmark::State &state)
+{
+	// Workers of the statistics server update the shared server and command metrics on every request
+	const bool hasStats = state.range(0) != 0;
+	const auto serverType = hasStats ? BenchmarkServer::StatsServer : BenchmarkServer::WorkerServer;
+	const int port = hasStats ? ZEROMQ_STATS_SERVER_PORT : ZEROMQ_WORKER_SERVER_PORT;
+
+	// Every benchmark thread is a separate client, so the workers consume the statistics concurrently
+	benchmarkFixture(BenchmarkTransport::Tcp, serverType);
+	ZeroMQTestClient client(benchmarkAddress(BenchmarkTransport::Tcp, port));
+
+	std::vector<zmq::message_t> sendMsgs;
+	std::vector<zmq::message_t> recvMsgs;
+	for (auto _ : state)
+	{
+		makeRequest(sendMsgs, 64, 1);
+		if (!client.request(sendMsgs, recvMsgs))
+		{
+			state.SkipWithError("Can't receive ZeroMQ reply");
+			return;
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(ZeroMQ_WorkerStatsBenchmark)->ArgName("stats")->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <spdlog/sinks/dist_sink.h>
 #include <spdlog/spdlog.h>
 
 /**
@@ -8,6 +9,7 @@
 class MainLogger {
   private:
 	std::shared_ptr<spdlog::logger> _mainLogger;
+	std::shared_ptr<spdlog::sinks::dist_sink_mt> _mainSink;
 
   public:
 	/**
@@ -35,6 +37,12 @@ class MainLogger {
 	 */
 	[[nodiscard]] std::shared_ptr<spdlog::logger> getLogger() const { return _mainLogger; }
 
+	/**
+	 * Adds a sink to the main logger. Log lines are passed through the duplicate filter like the other sinks
+	 * @param[in] sink Sink to add
+	 */
+	void addSink(const std::shared_ptr<spdlog::sinks::sink> &sink) const { _mainSink->add_sink(sink); }
+
 	/**
 	 * Deconstructs the main logger
 	 */
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "metrics/ScrapeRegistry.hpp"
+
+#include <prometheus/histogram.h>
+#include <prometheus/registry.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// Bits of the linear sub-buckets of every power of two, values are recorded with 1/16 relative precision
+constexpr size_t LATENCY_HISTOGRAM_SUB_BUCKET_BITS = 4;
+/// Values from 2^LATENCY_HISTOGRAM_MAX_EXPONENT are recorded to the overflow bucket, ~13 days in nanoseconds
+constexpr size_t LATENCY_HISTOGRAM_MAX_EXPONENT = 50;
+/// Number of buckets, including the overflow bucket
+constexpr size_t LATENCY_HISTOGRAM_BUCKETS =
+	((LATENCY_HISTOGRAM_MAX_EXPONENT - LATENCY_HISTOGRAM_SUB_BUCKET_BITS + 1) << LATENCY_HISTOGRAM_SUB_BUCKET_BITS) + 1;
+/// Number of shards of a histogram, threads are spread over them
+constexpr size_t LATENCY_HISTOGRAM_SHARDS = 8;
+/// Default lowest exported bucket boundary, ~1 microsecond in nanoseconds
+constexpr uint64_t LATENCY_HISTOGRAM_LOWEST_BOUNDARY = uint64_t{1} << 10;
+/// Default highest exported bucket boundary, ~34 seconds in nanoseconds
+constexpr uint64_t LATENCY_HISTOGRAM_HIGHEST_BOUNDARY = uint64_t{1} << 35;
+
+/**
+ * Gets the shard index of the calling thread. Threads get consecutive indexes on first use, so threads up to the
+ * number of shards never share one
+ * @return size_t Index of the thread, should be reduced to the number of shards
+ */
+size_t threadShardIndex();
+
+/**
+ * @class LatencyHistogram
+ * Lock-free log-linear histogram of integer values, such as latencies in nanoseconds.
+ *
+ * Every power of two is split to 2^LATENCY_HISTOGRAM_SUB_BUCKET_BITS linear buckets as in HDR histograms, so a value
+ * is recorded with a single relaxed increment on the bucket of its thread's shard. Shards are merged when quantiles
+ * are read or when the histogram is exported.
+ *
+ * If constructed with a metric family, the histogram is exported as a native prometheus histogram with two buckets for
+ * every power of two between the lowest and the highest boundary. Shards are exported when the registry is scraped,
+ * or recorded values are observed directly if the registry is not a ScrapeRegistry.
+ */
+class LatencyHistogram {
+  private:
+	/// Values recorded by the threads of a shard
+	struct alignas(64) Shard {
+		/// Number of values by bucket, the last bucket is the overflow bucket
+		std::array<std::atomic_uint64_t, LATENCY_HISTOGRAM_BUCKETS> buckets{};
+		/// Sum of the values
+		std::atomic_uint64_t sum{0};
+	};
+
+	std::unique_ptr<Shard[]> _shards;					 ///< Per-thread values
+	prometheus::Histogram *_metric{nullptr};			 ///< Exported prometheus histogram
+	prometheus::Histogram::BucketBoundaries _boundaries; ///< Bucket boundaries of the metric
+	std::mutex _exportLock;								 ///< Serialises the exports
+	std::vector<uint64_t> _exportedCounts;				 ///< Bucket counts already exported
+	uint64_t _exportedSum{0};							 ///< Sum of the values already exported
+	bool _observeOnRecord{false};						 ///< Observes the metric without scrapes
+	std::unique_ptr<ScrapeCallback> _scrapeCallback;	 ///< Exports the shards, removed first on destruction
+
+	// Sums a bucket over the shards
+	[[nodiscard]] uint64_t bucketCount(size_t idx) const;
+
+  public:
+	/// Constructs a histogram which is not exported
+	LatencyHistogram();
+
+	/**
+	 * Constructs a histogram exported as a prometheus histogram
+	 * @param[in] reg Prometheus registry of the family
+	 * @param[in] family Histogram family to add the metric to
+	 * @param[in] labels Labels of the metric
+	 * @param[in] lowestBoundary Lowest bucket boundary of the metric, rounded up to a power of two
+	 * @param[in] highestBoundary Highest bucket boundary of the metric, rounded up to a power of two
+	 */
+	LatencyHistogram(const std::shared_ptr<prometheus::Registry> &reg,
+					 prometheus::Family<prometheus::Histogram> &family, const prometheus::Labels &labels = {},
+					 uint64_t lowestBoundary = LATENCY_HISTOGRAM_LOWEST_BOUNDARY,
+					 uint64_t highestBoundary = LATENCY_HISTOGRAM_HIGHEST_BOUNDARY);
+
+	/// Copy constructor
+	LatencyHistogram(const LatencyHistogram & /*unused*/) = delete;
+
+	/// Move constructor
+	LatencyHistogram(LatencyHistogram && /*unused*/) = delete;
+
+	/// Copy assignment operator
+	LatencyHistogram &operator=(LatencyHistogram /*unused*/) = delete;
+
+	/// Move assignment operator
+	LatencyHistogram &operator=(LatencyHistogram && /*unused*/) = delete;
+
+	/// Destructor
+	~LatencyHistogram() = default;
+
+	/**
+	 * Records a value
+	 * @param[in] value Value to record
+	 */
+	void record(uint64_t value);
+
+	/**
+	 * Adds the values of another histogram
+	 * @param[in] other Histogram to merge
+	 */
+	void merge(const LatencyHistogram &other);
+
+	/**
+	 * Exports the values recorded since the last export to the prometheus histogram. Called on scrapes
+	 */
+	void exportMetric();
+
+	/**
+	 * Gets the number of recorded values
+	 * @return uint64_t Number of values
+	 */
+	[[nodiscard]] uint64_t count() const;
+
+	/**
+	 * Gets the sum of recorded values
+	 * @return uint64_t Sum of values
+	 */
+	[[nodiscard]] uint64_t sum() const;
+
+	/**
+	 * Gets a quantile of the recorded values
+	 * @param[in] quantile Quantile in [0, 1]
+	 * @return uint64_t Upper bound of the bucket of the quantile, zero if there is no value
+	 */
+	[[nodiscard]] uint64_t quantile(double quantile) const;
+
+	/**
+	 * Gets the bucket of a value
+	 * @param[in] value Value
+	 * @return size_t Index of the bucket
+	 */
+	static size_t bucketIndex(uint64_t value);
+
+	/**
+	 * Gets the upper bound of a bucket, the bucket contains the values up to and including it
+	 * @param[in] idx Index of the bucket
+	 * @return uint64_t Upper bound, lower bound of the overflow bucket for the overflow bucket
+	 */
+	static uint64_t bucketUpperBound(size_t idx);
+
+	/**
+	 * Gets the bucket boundaries of the exported metric
+	 * @param[in] lowestBoundary Lowest boundary, rounded up to a power of two
+	 * @param[in] highestBoundary Highest boundary, rounded up to a power of two
+	 * @return prometheus::Histogram::BucketBoundaries Powers of two and their midpoints between the boundaries
+	 */
+	static prometheus::Histogram::BucketBoundaries bucketBoundaries(uint64_t lowestBoundary, uint64_t highestBoundary);
+};
@@ -1,31 +1,162 @@
 #pragma once
 
+#include "metrics/LatencyHistogram.hpp"
+#include "metrics/ScrapeRegistry.hpp"
+#include "utils/TscClock.hpp"
+
 #include <prometheus/registry.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @class PerformanceSpan
+ * Links the alive spans of a thread, so nested spans attribute their time to the enclosing span.
+ *
+ * Spans should be destructed on the thread which created them, in reverse order of creation, as scoped objects
+ * are. The class is non-copyable and non-movable.
+ */
+class PerformanceSpan {
+  private:
+	static thread_local PerformanceSpan *_currentSpan; ///< Innermost alive span of the thread
+
+	PerformanceSpan *_parent;			   ///< Enclosing span of the thread, null for the outermost span
+	std::chrono::nanoseconds _childTime{}; ///< Time spent in the finished children
+
+  protected:
+	/// Constructs a new span and makes it the innermost span of the thread
+	PerformanceSpan();
+
+	/**
+	 * Attributes the time of the span to its parent and makes the parent the innermost span of the thread
+	 * @param[in] totalTime Time of the span
+	 */
+	void finish(std::chrono::nanoseconds totalTime);
+
+	/// Destructor
+	~PerformanceSpan() = default;
+
+  public:
+	/**
+	 * Gets the enclosing span
+	 * @return const PerformanceSpan* Parent span, null if this is the outermost span of the thread
+	 */
+	[[nodiscard]] const PerformanceSpan *parent() const { return _parent; }
+
+	/**
+	 * Gets the time spent in the finished child spans
+	 * @return std::chrono::nanoseconds Time of the children
+	 */
+	[[nodiscard]] std::chrono::nanoseconds childTime() const { return _childTime; }
+
+	// Non-copyable and non-movable
+	PerformanceSpan(const PerformanceSpan & /*unused*/) = delete;
+	PerformanceSpan(PerformanceSpan && /*unused*/) = delete;
+	PerformanceSpan &operator=(const PerformanceSpan & /*unused*/) = delete;
+	PerformanceSpan &operator=(PerformanceSpan && /*unused*/) = delete;
+};
+
 /**
- * @class PerformanceTracker
+ * @class BasicPerformanceTracker
  * Measures and calculates performance metrics.
  *
- * The PerformanceTracker class is responsible for measuring and calculating performance metrics.
+ * The BasicPerformanceTracker class is responsible for measuring and calculating performance metrics.
  * It provides functionality to start and stop a timer, and calculates the elapsed time between the start and stop
- * events. The class uses the prometheus library to store and manage the performance metrics.
+ * events. Timings are recorded to a LatencyHistogram which is exported as a prometheus histogram.
+ *
+ * Overlapping operations are timed with spans created by scope(), which keep their own start time, so one tracker can
+ * be shared by any number of threads. Spans opened while another span is alive on the same thread are its children,
+ * the time of the children is subtracted from the self time of the parent, also across trackers.
+ * startTimer and endTimer share a single start time and are not thread-safe.
+ * @tparam Clock Clock of the timer. Instantiated for TscClock and std::chrono::steady_clock
  */
-class PerformanceTracker {
+template <typename Clock> class BasicPerformanceTracker {
+  public:
+	/**
+	 * @class Span
+	 * Times the scope it lives in and records it to the tracker when destructed.
+	 */
+	class Span : public PerformanceSpan {
+	  private:
+		BasicPerformanceTracker &_tracker;	   ///< Tracker to record to
+		typename Clock::time_point _startTime; ///< Start time of the span
+
+		friend class BasicPerformanceTracker;
+
+		/**
+		 * Constructs a new span
+		 * @param[in] tracker Tracker to record to
+		 */
+		explicit Span(BasicPerformanceTracker &tracker) : _tracker(tracker), _startTime(Clock::now()) {}
+
+	  public:
+		/**
+		 * Gets the time elapsed since the span is created
+		 * @return std::chrono::nanoseconds Elapsed time
+		 */
+		[[nodiscard]] std::chrono::nanoseconds elapsed() const
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _startTime);
+		}
+
+		/// Records the span and attributes its time to the parent
+		~Span()
+		{
+			const auto totalTime = elapsed();
+			_tracker.record(totalTime, totalTime - childTime());
+			finish(totalTime);
+		}
+
+		// Non-copyable and non-movable
+		Span(const Span & /*unused*/) = delete;
+		Span(Span && /*unused*/) = delete;
+		Span &operator=(const Span & /*unused*/) = delete;
+		Span &operator=(Span && /*unused*/) = delete;
+	};
+
   private:
-	std::chrono::high_resolution_clock::time_point _startTime; ///< Set after startTimer to measure counter difference
-	prometheus::Summary *_perfTiming;						   ///< Overall performance
-	prometheus::Gauge *_maxTiming;							   ///< Maximum observed value
-	prometheus::Gauge *_minTiming;							   ///< Minimum observed value
+	typename Clock::time_point _startTime;			 ///< Set after startTimer to measure counter difference
+	std::unique_ptr<LatencyHistogram> _perfTiming;	 ///< Overall performance
+	std::unique_ptr<LatencyHistogram> _selfTiming;	 ///< Performance without the child spans
+	std::atomic_uint64_t _maxValue{0};				 ///< Maximum observed value in nanoseconds
+	std::atomic_uint64_t _minValue{UINT64_MAX};		 ///< Minimum observed value in nanoseconds
+	prometheus::Gauge *_maxTiming;					 ///< Maximum observed value
+	prometheus::Gauge *_minTiming;					 ///< Minimum observed value
+	bool _exportOnRecord{true};						 ///< Sets the gauges on every record without scrapes
+	std::unique_ptr<ScrapeCallback> _scrapeCallback; ///< Sets the gauges, removed first on destruction
+
+	// Records a timing, thread-safe
+	void record(std::chrono::nanoseconds totalTime, std::chrono::nanoseconds selfTime);
+
+	// Sets the gauges from the observed extremes
+	void exportExtremes();
 
   public:
 	/**
-	 * Construct a new PerformanceTracker object.
+	 * Construct a new BasicPerformanceTracker object.
 	 * @param[in] reg The registry to register the performance metrics.
 	 * @param[in] name The name of the metric.
 	 * @param[in] metricID The ID to append to metric names.
 	 */
-	PerformanceTracker(const std::shared_ptr<prometheus::Registry> &reg, const std::string &name,
-					   uint64_t metricID = 0);
+	BasicPerformanceTracker(const std::shared_ptr<prometheus::Registry> &reg, const std::string &name,
+							uint64_t metricID = 0);
+
+	/// Copy constructor
+	BasicPerformanceTracker(const BasicPerformanceTracker & /*unused*/) = delete;
+
+	/// Move constructor
+	BasicPerformanceTracker(BasicPerformanceTracker && /*unused*/) = delete;
+
+	/// Copy assignment operator
+	BasicPerformanceTracker &operator=(BasicPerformanceTracker /*unused*/) = delete;
+
+	/// Move assignment operator
+	BasicPerformanceTracker &operator=(BasicPerformanceTracker && /*unused*/) = delete;
+
+	/// Destructor
+	~BasicPerformanceTracker() = default;
 
 	/**
 	 * Starts the timer.
@@ -37,32 +168,56 @@ class PerformanceTracker {
 	 * @return The result of the timer in nanoseconds.
 	 */
 	double endTimer();
+
+	/**
+	 * Starts a span which is recorded when it goes out of scope. Thread-safe
+	 * @return Span Timer of the calling scope
+	 */
+	[[nodiscard]] Span scope() { return Span(*this); }
+
+	/**
+	 * Gets the recorded timings
+	 * @return const LatencyHistogram& Overall performance in nanoseconds
+	 */
+	[[nodiscard]] const LatencyHistogram &timings() const { return *_perfTiming; }
+
+	/**
+	 * Gets the recorded timings without the time of the child spans
+	 * @return const LatencyHistogram& Self performance in nanoseconds
+	 */
+	[[nodiscard]] const LatencyHistogram &selfTimings() const { return *_selfTiming; }
 };
 
+extern template class BasicPerformanceTracker<TscClock>;
+extern template class BasicPerformanceTracker<std::chrono::steady_clock>;
+
+/// Performance tracker timed with the time stamp counter
+using PerformanceTracker = BasicPerformanceTracker<TscClock>;
+
 /**
  * @class TrackPerformance
  * RAII style wrapper for PerformanceTracker.
  *
  * The TrackPerformance class is a RAII (Resource Acquisition Is Initialization) style wrapper for the
- * PerformanceTracker class. It automatically starts the timer when constructed and stops the timer when destructed.
- * This ensures that the timer is always stopped, even in case of exceptions or early returns.
+ * BasicPerformanceTracker class. It holds a span of the tracker, so the timing is always recorded, even in case of
+ * exceptions or early returns, and several threads can track the same tracker.
  * The class is non-copyable and non-movable to prevent unintended behavior.
  */
-class TrackPerformance {
+template <typename Clock> class TrackPerformance {
   private:
-	PerformanceTracker &_tracker; ///< Reference to the PerformanceTracker object.
+	typename BasicPerformanceTracker<Clock>::Span _span; ///< Span of the tracked scope
 
   public:
 	/**
 	 * Constructs a new TrackPerformance object.
-	 * @param[in] tracker The PerformanceTracker object to track.
+	 * @param[in] tracker The BasicPerformanceTracker object to track.
 	 */
-	explicit TrackPerformance(PerformanceTracker &tracker) : _tracker(tracker) { _tracker.startTimer(); }
+	explicit TrackPerformance(BasicPerformanceTracker<Clock> &tracker) : _span(tracker.scope()) {}
 
 	/**
-	 * Destructs the TrackPerformance object and stops the timer.
+	 * Destructs the TrackPerformance object and records the span.
 	 */
-	~TrackPerformance() { _tracker.endTimer(); }
+	~TrackPerformance() = default;
 
 	// Non-copyable and non-movable
 	TrackPerformance(const TrackPerformance & /*unused*/) = delete;
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/types.h>
+
+/// Size of the read buffer, large enough for /proc/self/status
+constexpr size_t PROC_SAMPLER_BUFFER_SIZE = 4096;
+
+/**
+ * @struct ProcSample
+ * Values of the current process sampled from /proc/self
+ */
+struct ProcSample {
+	uint64_t userTicks{0};			 ///< CPU time in user mode in clock ticks
+	uint64_t systemTicks{0};		 ///< CPU time in kernel mode in clock ticks
+	uint64_t minorFaults{0};		 ///< Page faults without loading a page from disk
+	uint64_t majorFaults{0};		 ///< Page faults loading a page from disk
+	uint64_t threadCount{0};		 ///< Number of threads
+	uint64_t peakResidentKb{0};		 ///< Peak resident set size in kilobytes
+	uint64_t residentKb{0};			 ///< Resident set size in kilobytes
+	uint64_t readBytes{0};			 ///< Bytes read from the storage
+	uint64_t writeBytes{0};			 ///< Bytes written to the storage
+	uint64_t fileDescriptorCount{0}; ///< Number of open file descriptors, without the ones of the sampler
+};
+
+/**
+ * @struct ThreadSample
+ * Values of a thread of the current process sampled from /proc/self/task
+ */
+struct ThreadSample {
+	pid_t threadId{0};				 ///< Kernel thread ID
+	std::string name;				 ///< Name of the thread, see pthread_setname_np
+	uint64_t userTicks{0};			 ///< CPU time in user mode in clock ticks
+	uint64_t systemTicks{0};		 ///< CPU time in kernel mode in clock ticks
+	uint64_t runQueueWaitNs{0};		 ///< Time spent runnable but waiting on a run queue in nanoseconds
+	uint64_t voluntarySwitches{0};	 ///< Context switches because the thread blocked
+	uint64_t involuntarySwitches{0}; ///< Context switches because the thread was preempted
+};
+
+/**
+ * @class ProcSampler
+ * Samples /proc/self without allocating or reopening files.
+ *
+ * /proc/self/stat, io and status and the /proc/self/fd directory are opened once. Each sample rereads them from the
+ * beginning with pread and getdents64 into a fixed buffer, and the values are picked by scanning the text in place,
+ * so sampling costs a few system calls and no allocations. Files which can't be opened, e.g. io without task I/O
+ * accounting, leave their values zero.
+ *
+ * Threads are sampled from the stat, status and schedstat files of /proc/self/task, which are opened when a thread is
+ * first seen and closed once it exits.
+ */
+class ProcSampler {
+  private:
+	int _statFd{-1};	///< Descriptor of /proc/self/stat
+	int _ioFd{-1};		///< Descriptor of /proc/self/io
+	int _statusFd{-1};	///< Descriptor of /proc/self/status
+	int _fdDirFd{-1};	///< Descriptor of the /proc/self/fd directory
+	int _taskDirFd{-1}; ///< Descriptor of the /proc/self/task directory
+	/// Read buffer shared by the files, aligned for the directory entries read by getdents64
+	alignas(dirent64) std::array<char, PROC_SAMPLER_BUFFER_SIZE> _buffer{};
+
+	/// Descriptors of the files of a thread
+	struct ThreadFiles {
+		int statFd{-1};		 ///< Descriptor of stat
+		int statusFd{-1};	 ///< Descriptor of status
+		int schedstatFd{-1}; ///< Descriptor of schedstat
+	};
+
+	std::unordered_map<pid_t, ThreadFiles> _threadFiles; ///< Files of the sampled threads
+	std::vector<pid_t> _threadIds;						 ///< Threads listed by the last sample
+
+	// Reads a file from the beginning, returns an empty view on failure
+	std::string_view readFile(int fd);
+
+	// Counts the entries of the descriptor directory
+	uint64_t countFileDescriptors();
+
+	// Lists the threads of the process to _threadIds
+	void listThreads();
+
+	// Closes the files of a thread
+	static void closeThreadFiles(const ThreadFiles &files);
+
+  public:
+	/// Opens the files of the current process
+	ProcSampler();
+
+	/// Copy constructor
+	ProcSampler(const ProcSampler & /*unused*/) = delete;
+
+	/// Move constructor
+	ProcSampler(ProcSampler && /*unused*/) = delete;
+
+	/// Copy assignment operator
+	ProcSampler &operator=(ProcSampler /*unused*/) = delete;
+
+	/// Move assignment operator
+	ProcSampler &operator=(ProcSampler && /*unused*/) = delete;
+
+	/**
+	 * Samples the current values. Not thread-safe
+	 * @param[out] values Sampled values
+	 * @return true If /proc/self/stat is sampled
+	 * @return false otherwise
+	 */
+	bool sample(ProcSample &values);
+
+	/**
+	 * Samples the current values of every thread. Not thread-safe
+	 * @param[out] values Sampled threads, the previous content is replaced
+	 * @return true If the threads are listed
+	 * @return false otherwise
+	 */
+	bool sampleThreads(std::vector<ThreadSample> &values);
+
+	/**
+	 * Parses the content of /proc/[pid]/stat
+	 * @param[in] content Content of the file
+	 * @param[out] sample Values to set, others are not changed
+	 * @return true If all fields are parsed
+	 * @return false otherwise
+	 */
+	static bool parseStat(std::string_view content, ProcSample &sample);
+
+	/**
+	 * Parses the content of /proc/[pid]/io
+	 * @param[in] content Content of the file
+	 * @param[out] sample Values to set, others are not changed
+	 * @return true If all fields are parsed
+	 * @return false otherwise
+	 */
+	static bool parseIo(std::string_view content, ProcSample &sample);
+
+	/**
+	 * Parses the content of /proc/[pid]/status
+	 * @param[in] content Content of the file
+	 * @param[out] sample Values to set, others are not changed
+	 * @return true If all fields are parsed
+	 * @return false otherwise
+	 */
+	static bool parseStatus(std::string_view content, ProcSample &sample);
+
+	/**
+	 * Parses the content of /proc/[pid]/task/[tid]/stat
+	 * @param[in] content Content of the file
+	 * @param[out] sample Values to set, others are not changed
+	 * @return true If all fields are parsed
+	 * @return false otherwise
+	 */
+	static bool parseThreadStat(std::string_view content, ThreadSample &sample);
+
+	/**
+	 * Parses the content of /proc/[pid]/task/[tid]/status
+	 * @param[in] content Content of the file
+	 * @param[out] sample Values to set, others are not changed
+	 * @return true If all fields are parsed
+	 * @return false otherwise
+	 */
+	static bool parseThreadStatus(std::string_view content, ThreadSample &sample);
+
+	/**
+	 * Parses the content of /proc/[pid]/task/[tid]/schedstat
+	 * @param[in] content Content of the file
+	 * @param[out] sample Values to set, others are not changed
+	 * @return true If all fields are parsed
+	 * @return false otherwise
+	 */
+	static bool parseSchedstat(std::string_view content, ThreadSample &sample);
+
+	/// Closes the files
+	~ProcSampler();
+};
@@ -1,19 +1,59 @@
 #pragma once
 
+#include "metrics/ProcSampler.hpp"
+
 #include <prometheus/gauge.h>
 #include <prometheus/registry.h>
 
-#include <filesystem>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// Hardware and software events counted with perf_event_open
+enum class PerfCounterType : uint8_t { Cycles, Instructions, CacheMisses, BranchMisses, ContextSwitches };
+
+/// Number of the perf_event_open counters
+constexpr size_t PERF_COUNTER_COUNT = 5;
 
-#include <sys/times.h>
+/// Default interval between the updates of the metrics
+constexpr std::chrono::milliseconds PROCESS_METRICS_DEFAULT_INTERVAL{1000};
 
 /**
  * @class ProcessMetrics
  * Class that provides metrics related to the current process.
+ *
+ * Optionally, hardware and software events of the process are counted with perf_event_open and exported as rates per
+ * second. Events are counted for every thread alive at construction and inherited by the threads they start, so the
+ * whole process is covered. Counters which can't be opened, e.g. because of perf_event_paranoid or missing PMU access
+ * in virtual machines, are not exported.
+ *
+ * The values are sampled from /proc/self with descriptors kept open between the updates, so short update intervals
+ * are cheap. CPU usage, run queue wait and context switches are also exported for every thread, labelled by the thread
+ * name and ID.
  */
 class ProcessMetrics {
   private:
+	/// Event counter of the process
+	struct PerfCounter {
+		std::vector<int> fds;			  ///< Counter of every thread, new threads are inherited
+		prometheus::Gauge *rate{nullptr}; ///< Events per second
+		double oldValue{0};				  ///< Variable to store the old number of events
+		std::atomic<double> lastRate{0};  ///< Rate of the last update, read by other threads
+	};
+
+	/// Metrics of a thread
+	struct ThreadMetrics {
+		prometheus::Gauge *userCpu{nullptr};			 ///< User mode CPU usage
+		prometheus::Gauge *systemCpu{nullptr};			 ///< Kernel mode CPU usage
+		prometheus::Gauge *runQueueWait{nullptr};		 ///< Share of time waiting on a run queue
+		prometheus::Gauge *voluntarySwitches{nullptr};	 ///< Voluntary context switches per second
+		prometheus::Gauge *involuntarySwitches{nullptr}; ///< Involuntary context switches per second
+		ThreadSample oldSample;							 ///< Values of the previous update
+	};
+
 	std::shared_ptr<std::atomic_flag> _checkFlag; ///< Runtime check flag
 
 	prometheus::Gauge *_pInitTime;			  ///< Pointer to initialization time gauge
@@ -21,63 +61,60 @@ class ProcessMetrics {
 	prometheus::Gauge *_pMemory;			  ///< Pointer to the memory usage gauge
 	prometheus::Gauge *_pPageFaults;		  ///< Pointer to the page faults gauge
 	prometheus::Gauge *_pCpuUsage;			  ///< Pointer to the CPU usage gauge
-	prometheus::Gauge *_pDiskRead;			  ///< Pointer to the disk read gauge
-	prometheus::Gauge *_pDiskWrite;			  ///< Pointer to the disk write gauge
+	prometheus::Gauge *_pDiskRead;			  ///< Pointer to the disk read rate gauge
+	prometheus::Gauge *_pDiskWrite;			  ///< Pointer to the disk write rate gauge
 	prometheus::Gauge *_pThreadCount;		  ///< Pointer to the thread count gauge
 	prometheus::Gauge *_pFileDescriptorCount; ///< Pointer to the file descriptor count gauge
 
-	size_t _oldReadBytes{0};  ///< Variable to store the old read bytes
-	size_t _oldWriteBytes{0}; ///< Variable to store the old write bytes
+	ProcSampler _sampler;								  ///< Reader of /proc/self
+	ProcSample _oldSample;								  ///< Values of the previous update
+	std::chrono::steady_clock::time_point _oldSampleTime; ///< Time of the previous update
+	std::chrono::milliseconds _updateInterval;			  ///< Interval between the updates
 
-	clock_t _oldCpuTime{0}; ///< Variable to store the old CPU time
-	struct tms _oldCpu{
-		.tms_utime = 0, .tms_stime = 0, .tms_cutime = 0, .tms_cstime = 0}; ///< Structure to store the old CPU times
+	prometheus::Family<prometheus::Gauge> *_threadUserCpuFamily;		   ///< User mode CPU usage by thread
+	prometheus::Family<prometheus::Gauge> *_threadSystemCpuFamily;		   ///< Kernel mode CPU usage by thread
+	prometheus::Family<prometheus::Gauge> *_threadRunQueueWaitFamily;	   ///< Run queue wait by thread
+	prometheus::Family<prometheus::Gauge> *_threadVoluntarySwitchFamily;   ///< Voluntary context switches by thread
+	prometheus::Family<prometheus::Gauge> *_threadInvoluntarySwitchFamily; ///< Involuntary context switches by thread
+	std::unordered_map<pid_t, ThreadMetrics> _threadMetrics; ///< Metrics of the threads by thread ID
+	std::vector<ThreadSample> _threadSamples;				 ///< Threads sampled by the last update
 
-	std::unique_ptr<std::jthread> _thread; ///< Thread handler
+	std::array<PerfCounter, PERF_COUNTER_COUNT> _perfCounters; ///< Counters of the perf events, empty if disabled
+	prometheus::Gauge *_pInstructionsPerCycle{nullptr};		   ///< Pointer to the instructions per cycle gauge
+	std::chrono::steady_clock::time_point _oldPerfTime;		   ///< Variable to store the old perf counter time
 
-	/**
-	 * Counts the number of entries in a directory.
-	 * @param[in] path The path of the directory.
-	 * @return The number of entries in the directory.
-	 */
-	static size_t countDirectoryEntries(const std::filesystem::path &path);
+	std::unique_ptr<std::jthread> _thread; ///< Thread handler
 
   protected:
 	/**
-	 * Gets the memory usage of the process.
-	 * @return The memory usage in bytes.
-	 */
-	static long int getMemoryUsage();
-
-	/**
-	 * Gets the number of page faults of the process.
-	 * @return The number of page faults.
+	 * Opens the perf event counters for every thread of the process and registers the metrics of the opened ones.
+	 * @param[in] reg The Prometheus registry.
 	 */
-	static long int getPageFaults();
+	void initPerfCounters(const std::shared_ptr<prometheus::Registry> &reg);
 
 	/**
-	 * Gets the CPU usage of the process.
-	 * @return The CPU usage as a percentage.
+	 * Reads the perf event counters and updates their rates.
 	 */
-	double getCpuUsage();
+	void updatePerfCounters();
 
 	/**
-	 * Gets the disk read and write bytes of the process.
-	 * @return A pair of the disk read and write bytes.
+	 * Reads the number of events counted by a perf event counter, scaled if the counter is multiplexed.
+	 * @param[in] counter The counter to read.
+	 * @return The number of events of all threads.
 	 */
-	std::pair<size_t, size_t> getDiskIO();
+	static double readPerfCounter(const PerfCounter &counter);
 
 	/**
-	 * Gets the number of threads in the process.
-	 * @return The number of threads.
+	 * Updates the metrics of the threads, threads seen the first time start from zero.
+	 * @param[in] elapsed Seconds since the previous update.
 	 */
-	static size_t getThreadCount();
+	void updateThreads(double elapsed);
 
 	/**
-	 * Gets the number of file descriptors in the process.
-	 * @return The number of file descriptors.
+	 * Removes the metrics of a thread.
+	 * @param[in] metrics The metrics to remove.
 	 */
-	static size_t getFileDescriptorCount();
+	void removeThreadMetrics(const ThreadMetrics &metrics);
 
 	/**
 	 * Updates the metrics values.
@@ -95,8 +132,12 @@ class ProcessMetrics {
 	 * Constructs a ProcessMetrics object.
 	 * @param[in] reg The Prometheus registry.
 	 * @param[in] checkFlag Runtime check flag
+	 * @param[in] enablePerfCounters Count the hardware and software events of the process with perf_event_open
+	 * @param[in] updateInterval Interval between the updates of the metrics
 	 */
-	ProcessMetrics(std::shared_ptr<std::atomic_flag> checkFlag, const std::shared_ptr<prometheus::Registry> &reg);
+	ProcessMetrics(std::shared_ptr<std::atomic_flag> checkFlag, const std::shared_ptr<prometheus::Registry> &reg,
+				   bool enablePerfCounters = false,
+				   std::chrono::milliseconds updateInterval = PROCESS_METRICS_DEFAULT_INTERVAL);
 
 	/// Copy constructor
 	ProcessMetrics(const ProcessMetrics & /*unused*/) = delete;
@@ -110,6 +151,27 @@ class ProcessMetrics {
 	/// Move assignment operator
 	ProcessMetrics &operator=(ProcessMetrics && /*unused*/) = delete;
 
+	/**
+	 * Gets the rate of a perf event counter computed by the last update
+	 * @param[in] type The event type.
+	 * @return The number of events per second, zero if the counter is not opened.
+	 */
+	[[nodiscard]] double perfCounterRate(PerfCounterType type) const
+	{
+		return _perfCounters[static_cast<size_t>(type)].lastRate;
+	}
+
+	/**
+	 * Checks whether a perf event counter is opened
+	 * @param[in] type The event type.
+	 * @return true If the events are counted
+	 * @return false otherwise
+	 */
+	[[nodiscard]] bool hasPerfCounter(PerfCounterType type) const
+	{
+		return !_perfCounters[static_cast<size_t>(type)].fds.empty();
+	}
+
 	/**
 	 * Deconstructs a ProcessMetrics object.
 	 */
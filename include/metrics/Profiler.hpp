@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// Default sampling frequency in Hz, off the common timer frequencies to avoid lockstep sampling
+constexpr uint32_t PROFILER_DEFAULT_FREQUENCY = 99;
+/// Maximum sampling frequency in Hz
+constexpr uint32_t PROFILER_MAX_FREQUENCY = 1000;
+/// Maximum number of frames captured for a sample
+constexpr size_t PROFILER_MAX_DEPTH = 64;
+/// Number of samples buffered between the signal handler and the aggregation
+constexpr size_t PROFILER_BUFFER_SIZE = 1024;
+/// Maximum number of distinct stacks kept in memory, samples of further stacks are dropped
+constexpr size_t PROFILER_MAX_STACKS = 16384;
+/// Interval of moving the buffered samples to the aggregated stacks
+constexpr std::chrono::milliseconds PROFILER_DRAIN_INTERVAL{50};
+
+/**
+ * @class SamplingProfiler
+ * In-process sampling profiler driven by SIGPROF.
+ *
+ * ITIMER_PROF delivers SIGPROF to the thread consuming CPU at the configured frequency, and the handler captures the
+ * return addresses of the interrupted thread to a fixed ring of slots without locking or allocating. The addresses are
+ * collected by walking the frame pointers, where every frame record is bounds-checked against the interrupted stack and
+ * read with process_vm_readv, so a corrupt chain ends the walk instead of faulting. Code built without frame pointers
+ * is only represented by its innermost frames. A background thread moves the samples to an aggregation of distinct
+ * stacks, which are symbolised only when dumped as folded stacks, one "outer;...;inner count" line per stack, as
+ * flamegraph.pl and compatible viewers read them. Memory is bounded by the slot ring and the maximum number of distinct
+ * stacks, samples not fitting to them are counted as dropped.
+ *
+ * SIGPROF and ITIMER_PROF are process-wide, so only one profiler can run at a time, see Profiler(). The signal handler
+ * replaces any previous SIGPROF handler on the first start and stays installed.
+ */
+class SamplingProfiler {
+  private:
+	/// Slot of a captured sample
+	struct Sample {
+		std::atomic_uint32_t state{0};			   ///< Free, being written or ready to aggregate
+		uint32_t depth{0};						   ///< Number of captured frames
+		void *frames[PROFILER_MAX_DEPTH]{nullptr}; ///< Return addresses, innermost first
+	};
+
+	/// Hash of the captured return addresses
+	struct StackHash {
+		size_t operator()(const std::vector<uintptr_t> &stack) const;
+	};
+
+	std::unique_ptr<Sample[]> _samples;				  ///< Slots written by the signal handler
+	std::atomic_uint64_t _nextSample{0};			  ///< Index of the next slot to write
+	std::atomic_uint64_t _nSamples{0};				  ///< Number of aggregated samples
+	std::atomic_uint64_t _nDropped{0};				  ///< Number of dropped samples
+	std::atomic_bool _isRunning{false};				  ///< Whether the signal handler should capture samples
+	uint32_t _frequency{0};							  ///< Sampling frequency of the current run in Hz
+	std::chrono::steady_clock::time_point _startTime; ///< Start time of the current run
+
+	mutable std::mutex _guard;												 ///< Serialises start, stop and dumps
+	mutable std::mutex _stacksGuard;										 ///< Guards the aggregated stacks
+	std::unordered_map<std::vector<uintptr_t>, uint64_t, StackHash> _stacks; ///< Sample counts by distinct stacks
+
+	std::unique_ptr<std::jthread> _thread; ///< Aggregation thread
+
+	// Captures a sample of the interrupted thread from the signal context, async-signal-safe
+	void capture(void *context);
+
+	// Moves the ready samples to the aggregated stacks
+	void drain();
+
+	/// Main thread function
+	void threadFunc(const std::stop_token &stopToken);
+
+	// SIGPROF handler forwarding to the running profiler
+	static void signalHandler(int signal, siginfo_t *info, void *context);
+
+  public:
+	/// Constructs a new idle profiler
+	SamplingProfiler();
+
+	/// Copy constructor
+	SamplingProfiler(const SamplingProfiler & /*unused*/) = delete;
+
+	/// Move constructor
+	SamplingProfiler(SamplingProfiler && /*unused*/) = delete;
+
+	/// Copy assignment operator
+	SamplingProfiler &operator=(SamplingProfiler /*unused*/) = delete;
+
+	/// Move assignment operator
+	SamplingProfiler &operator=(SamplingProfiler && /*unused*/) = delete;
+
+	/**
+	 * Clears the previous samples and starts sampling
+	 * @param[in] frequency Sampling frequency in Hz, limited to PROFILER_MAX_FREQUENCY
+	 * @return true If started
+	 * @return false If a profiler is already running or the timer can't be set
+	 */
+	bool start(uint32_t frequency = PROFILER_DEFAULT_FREQUENCY);
+
+	/**
+	 * Stops sampling. The samples are kept until the next start
+	 * @return true If stopped
+	 * @return false If the profiler is not running
+	 */
+	bool stop();
+
+	/**
+	 * Checks whether the profiler is sampling
+	 * @return true If running
+	 * @return false otherwise
+	 */
+	[[nodiscard]] bool isRunning() const { return _isRunning; }
+
+	/**
+	 * Gets the number of aggregated samples
+	 * @return uint64_t Number of samples
+	 */
+	[[nodiscard]] uint64_t sampleCount() const { return _nSamples; }
+
+	/**
+	 * Gets the number of samples dropped because the buffer or the stack limit is full
+	 * @return uint64_t Number of samples
+	 */
+	[[nodiscard]] uint64_t droppedCount() const { return _nDropped; }
+
+	/**
+	 * Gets a one line summary of the profiler state
+	 * @return std::string Summary
+	 */
+	[[nodiscard]] std::string summary() const;
+
+	/**
+	 * Symbolises the aggregated stacks, also while running
+	 * @return std::vector<std::string> Folded stacks, most sampled first
+	 */
+	[[nodiscard]] std::vector<std::string> foldedStacks() const;
+
+	/// Destructor, stops sampling
+	~SamplingProfiler();
+};
+
+/**
+ * Process-wide profiler used by the Telnet and ZeroMQ commands
+ * @return SamplingProfiler& Profiler
+ */
+SamplingProfiler &Profiler();
@@ -34,7 +34,7 @@ class PrometheusServer {
 	std::shared_ptr<prometheus::Registry> getRegistry(uint64_t regId);
 
 	/**
-	 * Create a registry for prometheus
+	 * Create a registry for prometheus. Registries are ScrapeRegistry instances
 	 * @return std::shared_ptr<prometheus::Registry> Registry pointer
 	 */
 	std::shared_ptr<prometheus::Registry> createNewRegistry();
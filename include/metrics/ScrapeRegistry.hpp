@@ -0,0 +1,89 @@
+#pragma once
+
+#include <prometheus/registry.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @class ScrapeRegistry
+ * Prometheus registry which runs its scrape callbacks before the metrics are collected.
+ *
+ * Metrics accumulated outside of the registry, such as per-thread counters, are written to the registry metrics only
+ * when they are scraped. Registries created by PrometheusServer are scrape registries.
+ */
+class ScrapeRegistry : public prometheus::Registry {
+  private:
+	/// Guards the callbacks, held while they run so a removed callback is never invoked
+	mutable std::mutex _guardLock;
+	/// Identifier of the next callback
+	uint64_t _nextCallbackId{0};
+	/// Callbacks with their identifiers
+	std::vector<std::pair<uint64_t, std::function<void()>>> _vCallbacks;
+
+  public:
+	/**
+	 * Adds a callback invoked before every collection
+	 * @param[in] func Callback function
+	 * @return uint64_t Identifier of the callback
+	 */
+	uint64_t addScrapeCallback(std::function<void()> func);
+
+	/**
+	 * Removes a callback. Waits if the callback is running
+	 * @param[in] callbackId Identifier of the callback
+	 */
+	void removeScrapeCallback(uint64_t callbackId);
+
+	/**
+	 * Runs the scrape callbacks and collects the metrics
+	 * @return std::vector<prometheus::MetricFamily> Collected metrics
+	 */
+	std::vector<prometheus::MetricFamily> Collect() const override;
+};
+
+/**
+ * @class ScrapeCallback
+ * Adds a scrape callback to a registry for its lifetime.
+ *
+ * The callback is only added if the registry is a ScrapeRegistry, otherwise the owner should update its metrics
+ * itself. The callback is removed before the owner's members it uses are released if it is declared after them.
+ */
+class ScrapeCallback {
+  private:
+	std::weak_ptr<ScrapeRegistry> _registry; ///< Registry of the callback
+	uint64_t _callbackId{0};				 ///< Identifier of the callback
+	bool _isRegistered{false};				 ///< Whether the registry is a ScrapeRegistry
+
+  public:
+	/**
+	 * Adds the callback if the registry is a ScrapeRegistry
+	 * @param[in] reg Prometheus registry
+	 * @param[in] func Callback function
+	 */
+	ScrapeCallback(const std::shared_ptr<prometheus::Registry> &reg, std::function<void()> func);
+
+	/// Copy constructor
+	ScrapeCallback(const ScrapeCallback & /*unused*/) = delete;
+
+	/// Move constructor
+	ScrapeCallback(ScrapeCallback && /*unused*/) = delete;
+
+	/// Copy assignment operator
+	ScrapeCallback &operator=(ScrapeCallback /*unused*/) = delete;
+
+	/// Move assignment operator
+	ScrapeCallback &operator=(ScrapeCallback && /*unused*/) = delete;
+
+	/**
+	 * Checks whether the callback is invoked on scrapes
+	 * @return true If the registry is a ScrapeRegistry
+	 * @return false otherwise
+	 */
+	[[nodiscard]] bool isRegistered() const { return _isRegistered; }
+
+	/// Removes the callback, waits if it is running
+	~ScrapeCallback();
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class TelnetSession;
+
+/// Telnet command handler. Receives the session and the arguments following the command name
+using FPTR_TelnetCommand = std::function<bool(const std::shared_ptr<TelnetSession> &, std::string_view)>;
+
+/**
+ * @struct TelnetCommand
+ * Represents a registered Telnet command
+ */
+struct TelnetCommand {
+	std::string name;			///< Full name of the command
+	std::string info;			///< Description printed by help. Commands without description are hidden
+	FPTR_TelnetCommand handler; ///< Function invoked when the command is received
+	bool hasArguments{false};	///< True if the command accepts arguments after its name
+};
+
+/**
+ * @class TelnetCommandRegistry
+ * Thread-safe registry of Telnet commands backed by a prefix trie.
+ *
+ * Lookups walk the trie once along the received line, so dispatching a command and finding the completion candidates
+ * of a partial command are proportional to the length of the input rather than the number of commands. Commands can
+ * be registered or removed at any time, also while a Telnet server is running.
+ */
+class TelnetCommandRegistry {
+  private:
+	/// Trie node
+	struct Node {
+		std::map<char, std::unique_ptr<Node>> children; ///< Child nodes ordered by character
+		std::unique_ptr<TelnetCommand> command;			///< Command terminating at this node
+		size_t visibleCount{0};							///< Number of visible commands in the subtree
+	};
+
+	/// Guards the trie
+	mutable std::shared_mutex m_guard;
+	/// Root of the trie
+	Node m_root;
+
+	// Walks the trie along the prefix, returns nullptr if there is no such path
+	const Node *findNode(std::string_view prefix) const;
+	// Collects visible commands of the subtree in lexicographic order
+	static void collect(const Node &node, std::vector<const TelnetCommand *> &commands);
+
+  public:
+	/**
+	 * Registers a new command
+	 * @param[in] name Full name of the command
+	 * @param[in] info Description of the command. Empty description hides the command from help and completion
+	 * @param[in] handler Function to invoke when the command is received
+	 * @param[in] hasArguments True if the command accepts arguments separated with a space after its name
+	 * @return true If registered
+	 * @return false If the name is empty or a command with the same name already exists
+	 */
+	bool registerCommand(const std::string &name, std::string info, FPTR_TelnetCommand handler,
+						 bool hasArguments = false);
+
+	/**
+	 * Removes a registered command
+	 * @param[in] name Full name of the command
+	 * @return true If removed
+	 * @return false If there is no such command
+	 */
+	bool unregisterCommand(std::string_view name);
+
+	/**
+	 * Finds the handler for a received line. The line should either match a command exactly or start with a command
+	 * accepting arguments followed by a space. The longest matching command is selected.
+	 * @param[in] line Received line
+	 * @param[out] args Arguments following the command name
+	 * @return FPTR_TelnetCommand Handler of the command, empty if not found
+	 */
+	FPTR_TelnetCommand find(std::string_view line, std::string_view &args) const;
+
+	/**
+	 * Finds the completion of a partial command
+	 * @param[in] prefix Partial command
+	 * @param[out] candidates Visible commands starting with the prefix in lexicographic order
+	 * @return std::string Longest common prefix of the candidates, empty if there is no candidate
+	 */
+	std::string complete(std::string_view prefix, std::vector<std::string> &candidates) const;
+
+	/**
+	 * Gets the visible commands
+	 * @return std::vector<std::pair<std::string, std::string>> Names and descriptions in lexicographic order
+	 */
+	std::vector<std::pair<std::string, std::string>> commands() const;
+};
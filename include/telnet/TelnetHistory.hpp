@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// History limit for Telnet session
+constexpr size_t TELNET_HISTORY_LIMIT = 50;
+// Number of characters stored without a heap allocation in a history entry
+constexpr size_t TELNET_HISTORY_INLINE_SIZE = 64;
+// Default number of peers kept in the history arena
+constexpr size_t TELNET_HISTORY_ARENA_SIZE = 32;
+
+/**
+ * @class TelnetHistoryEntry
+ * Small-string-optimised storage for a single command. Commands up to TELNET_HISTORY_INLINE_SIZE characters are stored
+ * inline, longer ones reuse the capacity of the overflow string so recycled entries don't allocate again.
+ */
+class TelnetHistoryEntry {
+  private:
+	/// Inline storage
+	std::array<char, TELNET_HISTORY_INLINE_SIZE> m_inline{};
+	/// Storage for long commands
+	std::string m_overflow;
+	/// Length of the command
+	size_t m_size{0};
+
+  public:
+	/**
+	 * Replaces the stored command
+	 * @param[in] value New command
+	 */
+	void assign(std::string_view value);
+
+	/**
+	 * Gets the stored command
+	 * @return std::string_view Stored command, valid until the entry is modified
+	 */
+	[[nodiscard]] std::string_view view() const
+	{
+		return m_size <= TELNET_HISTORY_INLINE_SIZE ? std::string_view(m_inline.data(), m_size)
+													: std::string_view(m_overflow);
+	}
+};
+
+/**
+ * @class TelnetHistory
+ * Fixed-capacity ring of completed commands. Once the ring is full the oldest command is overwritten.
+ */
+class TelnetHistory {
+  private:
+	/// Entries of the ring
+	std::array<TelnetHistoryEntry, TELNET_HISTORY_LIMIT> m_entries;
+	/// Index of the oldest entry
+	size_t m_head{0};
+	/// Number of stored entries
+	size_t m_size{0};
+
+  public:
+	/**
+	 * Appends a command. Empty commands and repeats of the latest command are skipped.
+	 * @param[in] line Completed command
+	 * @return true If appended
+	 * @return false otherwise
+	 */
+	bool push(std::string_view line);
+
+	/**
+	 * Gets a stored command
+	 * @param[in] idx Index of the command, 0 is the oldest one
+	 * @return std::string_view Stored command
+	 */
+	[[nodiscard]] std::string_view operator[](size_t idx) const
+	{
+		return m_entries[(m_head + idx) % TELNET_HISTORY_LIMIT].view();
+	}
+
+	/**
+	 * Searches backwards for a command containing the pattern
+	 * @param[in] pattern Pattern to search
+	 * @param[in] before Search starts from the command just before this index
+	 * @return size_t Index of the newest matching command, std::string::npos if not found or the pattern is empty
+	 */
+	[[nodiscard]] size_t rfind(std::string_view pattern, size_t before) const;
+
+	/**
+	 * Number of stored commands
+	 * @return size_t Number of commands
+	 */
+	[[nodiscard]] size_t size() const { return m_size; }
+
+	/// Removes all commands
+	void clear();
+};
+
+/**
+ * @class TelnetHistoryArena
+ * Preallocated pool of command histories keyed by peer identity. Histories of disconnected peers are kept, so
+ * reconnecting clients continue with their previous commands. When the arena is full the least recently used history
+ * which has no active session is recycled. Not thread-safe, should be used from the server thread.
+ */
+class TelnetHistoryArena {
+  private:
+	/// History of a peer
+	struct Slot {
+		std::string peer;	   ///< Peer identity, empty for unused slots
+		TelnetHistory history; ///< Command history
+		size_t users{0};	   ///< Number of active sessions
+		uint64_t lastUsed{0};  ///< Logical time of the last acquire or release
+	};
+
+	/// Slots of the arena
+	std::vector<Slot> m_slots;
+	/// Logical clock for least recently used selection
+	uint64_t m_clock{0};
+
+  public:
+	/**
+	 * Constructs a new arena
+	 * @param[in] capacity Maximum number of peers
+	 */
+	explicit TelnetHistoryArena(size_t capacity = TELNET_HISTORY_ARENA_SIZE) : m_slots(capacity) {}
+
+	/**
+	 * Acquires the history of a peer
+	 * @param[in] peer Peer identity
+	 * @return TelnetHistory* History of the peer, nullptr if all slots are in use
+	 */
+	TelnetHistory *acquire(std::string_view peer);
+
+	/**
+	 * Releases a history acquired from the arena
+	 * @param[in] history History to release
+	 */
+	void release(const TelnetHistory *history);
+};
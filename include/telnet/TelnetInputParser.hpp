@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Events produced by the Telnet input parser
+ */
+enum class TelnetInputEvent : uint8_t {
+	None,		   ///< Byte consumed without any action required
+	Line,		   ///< A complete line is available in the buffer
+	Tab,		   ///< TAB received, completion is requested for the buffer
+	Erase,		   ///< Backspace received, last character removed from the buffer
+	ArrowUp,	   ///< Up arrow received
+	ArrowDown,	   ///< Down arrow received
+	ArrowRight,	   ///< Right arrow received
+	ArrowLeft,	   ///< Left arrow received
+	ReverseSearch, ///< Ctrl-R received, reverse history search is requested
+	Cancel		   ///< Ctrl-G received, current operation should be aborted
+};
+
+/**
+ * @class TelnetInputParser
+ * Incremental parser for the data received from a Telnet client.
+ *
+ * Input is consumed byte by byte. Telnet negotiation sequences (IAC commands, options and sub-negotiations) and ANSI
+ * escape sequences are removed while printable characters are collected to the line buffer, so a received block is
+ * processed in a single pass regardless of its size. Line editing keys (backspace, TAB, arrows, Ctrl-R and Ctrl-G) are
+ * only interpreted if line editing is enabled, otherwise they are kept in the buffer as is.
+ */
+class TelnetInputParser {
+  private:
+	/// Parser states
+	enum class State : uint8_t {
+		Data,			   ///< Regular data
+		CarriageReturn,	   ///< CR received, waiting for LF or NUL
+		Iac,			   ///< IAC received, waiting for the command
+		IacOption,		   ///< Option negotiation command received, waiting for the option code
+		SubNegotiation,	   ///< Inside of a sub-negotiation block
+		SubNegotiationIac, ///< IAC received inside of a sub-negotiation block
+		Escape,			   ///< ESC received
+		ControlSequence	   ///< Inside of an ANSI control sequence
+	};
+
+	/// Current state
+	State m_state{State::Data};
+	/// Interpret line editing keys
+	bool m_lineEditing;
+	/// Buffer of input data (mid line)
+	std::string m_buffer;
+
+  public:
+	/**
+	 * Constructs a new parser
+	 * @param[in] lineEditing Interpret line editing keys (backspace, TAB, arrows, Ctrl-R, Ctrl-G)
+	 */
+	explicit TelnetInputParser(bool lineEditing = true) : m_lineEditing(lineEditing) {}
+
+	/**
+	 * Consumes a single byte of input
+	 * @param[in] chr Received byte
+	 * @return TelnetInputEvent Event produced by the byte
+	 */
+	TelnetInputEvent consume(char chr);
+
+	/**
+	 * Enables or disables line editing
+	 * @param[in] enable True to interpret line editing keys
+	 */
+	void lineEditing(bool enable) { m_lineEditing = enable; }
+
+	/**
+	 * Gets the buffer of current line
+	 * @return std::string& Line buffer
+	 */
+	[[nodiscard]] std::string &buffer() { return m_buffer; }
+
+	/**
+	 * Gets the buffer of current line
+	 * @return const std::string& Line buffer
+	 */
+	[[nodiscard]] const std::string &buffer() const { return m_buffer; }
+
+	/**
+	 * Moves the current line out of the parser and clears the buffer
+	 * @return std::string Current line
+	 */
+	std::string takeBuffer();
+
+	/**
+	 * Resets parser state and clears the buffer
+	 */
+	void reset();
+};
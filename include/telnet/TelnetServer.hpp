@@ -29,18 +29,27 @@ either expressed or implied, of the FreeBSD Project.
 
 #pragma once
 
+#include "telnet/TelnetCommands.hpp"
+#include "telnet/TelnetHistory.hpp"
+#include "telnet/TelnetInputParser.hpp"
 #include "telnet/TelnetStats.hpp"
+#include "utils/TokenBucket.hpp"
 
 #include <array>
+#include <deque>
 #include <functional>
-#include <list>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <openssl/ssl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -50,20 +59,60 @@ class TelnetSession;
 
 using Socket = int;
 
+/**
+ * Admission control and rate limits of the Telnet server
+ */
+struct TelnetLimits {
+	size_t maxSessions{5};		 ///< Maximum number of concurrent sessions
+	int listenBacklog{16};		 ///< Backlog of the listening socket
+	size_t acceptBatch{8};		 ///< Maximum number of connections accepted per loop
+	double connectionRate{5};	 ///< Connections per second allowed for a peer address
+	double connectionBurst{10};	 ///< Maximum burst of connections for a peer address
+	double byteRate{64 * 1024};	 ///< Received bytes per second allowed for a session
+	double byteBurst{64 * 1024}; ///< Maximum burst of received bytes for a session
+	double commandRate{20};		 ///< Commands per second allowed for a session
+	double commandBurst{50};	 ///< Maximum burst of commands for a session
+};
+
+/// Deleter for OpenSSL handles
+struct TelnetSSLDeleter {
+	void operator()(SSL *ssl) const { SSL_free(ssl); }
+	void operator()(SSL_CTX *ctx) const { SSL_CTX_free(ctx); }
+};
+
+/// Produces the next line of a streamed output. Returns false when there is no more line
+using FPTR_LineProducer = std::function<bool(std::string &)>;
+
 /**
  * Session class for manage connections
  */
 class TelnetSession : public std::enable_shared_from_this<TelnetSession> {
   public:
 	/// Constructor for session
-	TelnetSession(Socket ClientSocket, std::shared_ptr<TelnetServer> tServer)
-		: m_socket(ClientSocket), m_telnetServer(std::move(tServer))
-	{
-		m_historyCursor = m_history.end();
-	};
+	TelnetSession(Socket ClientSocket, std::shared_ptr<TelnetServer> tServer);
 
 	/// Send a line of data to the Telnet Server
 	void sendLine(std::string data);
+	/**
+	 * Queues a streamed output. Lines are pulled from the producer only when the client is able to receive them, so
+	 * large outputs are neither built in memory at once nor block the server loop.
+	 * @param[in] producer Function producing the lines
+	 * @param[in] paged Wait for a key press of the user after every page
+	 */
+	void sendStream(FPTR_LineProducer producer, bool paged = false);
+	/// Checks if the session waits for the socket to become writable
+	bool hasPendingOutput() const
+	{
+		if (!m_established)
+		{
+			return m_tlsWantWrite;
+		}
+		return !m_outputBuffer.empty() || (!m_outputStreams.empty() && !m_pagerWaiting);
+	}
+	/// Checks if reading is paused by the byte rate limit
+	bool isThrottled() { return m_established && m_byteBucket.available() < 1.0; }
+	/// Checks if there is decrypted input which is not read yet
+	bool hasBufferedInput() const { return m_ssl && SSL_pending(m_ssl.get()) > 0; }
 	/// Finish the session
 	void closeClient();
 	/// Checks the connection timeout
@@ -78,29 +127,43 @@ class TelnetSession : public std::enable_shared_from_this<TelnetSession> {
 	void update();
 
   private:
+	/// Queued streamed output
+	struct OutputStream {
+		FPTR_LineProducer producer; ///< Line producer
+		bool paged;					///< Pause after every page
+		size_t pageLines;			///< Number of lines written on the current page
+	};
+
 	// Returns ip of the peer
 	std::string getPeerIP() const;
+	// Reads from the socket or the TLS connection, returns -1 with EAGAIN if no data is available
+	ssize_t readSocket(char *buffer, size_t length);
+	// Writes to the socket or the TLS connection, returns -1 with EAGAIN if the socket is not writable
+	ssize_t writeSocket(const char *buffer, size_t length);
+	// Advances the TLS handshake without blocking
+	void continueHandshake();
+	// Starts the Telnet negotiation once the connection is ready
+	void establish();
+	// Sends the data or appends it to the output buffer if the socket is not writable
+	void writeData(std::string_view data);
+	// Pulls lines from the output streams and sends the pending output
+	void flushOutput();
+	// Handles the keys received while the pager is waiting
+	void processPagerInput(std::span<const char> data);
 	// Write the prompt and any data sat in the input buffer
 	void sendPromptAndBuffer();
 	// Erase all characters on the current line and move prompt back to beginning of line
 	void eraseLine();
 	// Echo back message
 	void echoBack(const char *buffer, unsigned long length);
-	//
-	static void stripNVT(std::string &buffer);
-	// Remove all escape characters from the line
-	static void stripEscapeCharacters(std::string &buffer);
-	// Takes backspace commands and removes them and the preceding character from the m_buffer. Handles arrow key
-	// actions for history management. Returns true if the input buffer was changed.
-	static bool processBackspace(std::string &buffer);
-	// Takes tab commands and completes or suggests commands
-	bool processTab(std::string &buffer);
+	// Completes or suggests commands for the input buffer
+	void processTab();
 	// Add a command into the command history
 	void addToHistory(const std::string &line);
 	// Handles arrow key actions for history management. Returns true if the input buffer was changed.
-	bool processCommandHistory(std::string &buffer);
-	//
-	static std::vector<std::string> getCompleteLines(std::string &buffer);
+	bool processCommandHistory(TelnetInputEvent event);
+	// Handles the keys of reverse incremental history search. Returns true if the event is consumed.
+	bool processReverseSearch(TelnetInputEvent event);
 
 	/// Statistics variables
 	TelnetSessionStats stats;
@@ -110,12 +173,36 @@ class TelnetSession : public std::enable_shared_from_this<TelnetSession> {
 	Socket m_socket;
 	// Parent TelnetServer class
 	std::shared_ptr<TelnetServer> m_telnetServer;
-	// Buffer of input data (mid line)
-	std::string m_buffer;
-	// A history of all completed commands
-	std::list<std::string> m_history;
-	// Iterator to completed commands
-	std::list<std::string>::iterator m_historyCursor;
+	// Parser for input data, holds the buffer of current line
+	TelnetInputParser m_inputParser;
+	// History of completed commands, shared with the other sessions of the peer and owned by the server
+	TelnetHistory *m_history{nullptr};
+	// Index of the history entry on the input buffer
+	size_t m_historyCursor{std::string::npos};
+	// Reverse incremental search is active, input buffer holds the search pattern
+	bool m_searching{false};
+	// Index of the history entry matching the search pattern
+	size_t m_searchMatch{std::string::npos};
+	// Input buffer before the search started
+	std::string m_searchSavedLine;
+	// Output waiting for the socket to become writable
+	std::string m_outputBuffer;
+	// Streamed outputs in order
+	std::deque<OutputStream> m_outputStreams;
+	// Waiting for a key press to continue the paged output
+	bool m_pagerWaiting{false};
+	// TLS connection, null for plaintext sessions
+	std::unique_ptr<SSL, TelnetSSLDeleter> m_ssl;
+	// True after the TLS handshake (if any) completed and Telnet negotiation started
+	bool m_established{false};
+	// TLS handshake waits for the socket to become writable
+	bool m_tlsWantWrite{false};
+	// Start time of the TLS handshake
+	std::chrono::high_resolution_clock::time_point m_handshakeStart;
+	// Limits the received bytes
+	TokenBucket m_byteBucket;
+	// Limits the received commands
+	TokenBucket m_commandBucket;
 
 	friend TelnetServer;
 };
@@ -126,6 +213,7 @@ using VEC_SP_TelnetSession = std::vector<SP_TelnetSession>;
 using FPTR_ConnectedCallback = std::function<void(SP_TelnetSession)>;
 using FPTR_NewLineCallback = std::function<bool(SP_TelnetSession, std::string)>;
 using FPTR_TabCallback = std::function<std::string(SP_TelnetSession, std::string)>;
+using FPTR_AuditCallback = std::function<void(const std::string &, const std::string &, bool)>;
 
 class TelnetServer : public std::enable_shared_from_this<TelnetServer> {
   public:
@@ -160,6 +248,16 @@ class TelnetServer : public std::enable_shared_from_this<TelnetServer> {
 					std::string promptString = "", const std::shared_ptr<prometheus::Registry> &reg = nullptr,
 					const std::string &prependName = "");
 
+	/**
+	 * Enables TLS for the connections. Should be called before initialise. Sessions are resumed with tickets, so
+	 * reconnects of the clients are completed without a full handshake.
+	 * @param[in] certPath Path to the PEM certificate chain
+	 * @param[in] keyPath Path to the PEM private key
+	 * @return true If the certificate and the key are loaded
+	 * @return false otherwise
+	 */
+	bool initialiseTLS(const std::string &certPath, const std::string &keyPath);
+
 	/// Closes the Telnet Server
 	void shutdown();
 
@@ -172,8 +270,19 @@ class TelnetServer : public std::enable_shared_from_this<TelnetServer> {
 	void tabCallback(FPTR_TabCallback func) { m_tabCallback = std::move(func); }
 	FPTR_TabCallback tabCallback() const { return m_tabCallback; }
 
+	void auditCallback(FPTR_AuditCallback func) { m_auditCallback = std::move(func); }
+	FPTR_AuditCallback auditCallback() const { return m_auditCallback; }
+
 	const VEC_SP_TelnetSession &sessions() const { return m_sessions; }
 
+	TelnetHistoryArena &historyArena() { return m_historyArena; }
+
+	bool isTLS() const { return m_sslContext != nullptr; }
+
+	/// Limits should be set before initialise
+	void limits(const TelnetLimits &limits) { m_limits = limits; }
+	const TelnetLimits &limits() const { return m_limits; }
+
 	bool interactivePrompt() const { return !m_promptString.empty(); }
 	void promptString(const std::string_view &prompt) { m_promptString = prompt; }
 	const std::string &promptString() const { return m_promptString; }
@@ -185,8 +294,11 @@ class TelnetServer : public std::enable_shared_from_this<TelnetServer> {
 	FPTR_NewLineCallback m_newlineCallback;
 	// Called after TAB detected. function(SP_TelnetSession, std::string, PredictSignalType) {}
 	FPTR_TabCallback m_tabCallback;
+	// Called after every processed command. function(std::string peerIP, std::string line, bool isSucceeded) {}
+	FPTR_AuditCallback m_auditCallback;
 
-	bool acceptConnection();
+	bool admitPeer(in_addr_t peerAddr);
+	void acceptConnections(TelnetServerStats &serverStats);
 	void threadFunc(const std::stop_token &stopToken) noexcept;
 
 	/// Process new connections and messages
@@ -195,9 +307,19 @@ class TelnetServer : public std::enable_shared_from_this<TelnetServer> {
 	unsigned long m_listenPort{};
 	Socket m_listenSocket{-1};
 	VEC_SP_TelnetSession m_sessions;
+	// Polled descriptors of the listening socket and the sessions, reused between the updates
+	std::vector<pollfd> m_pollFds;
 	bool m_initialised{false};
 	// A string that denotes the current prompt
 	std::string m_promptString;
+	// TLS context, null if TLS is not enabled
+	std::unique_ptr<SSL_CTX, TelnetSSLDeleter> m_sslContext;
+	// Command histories of the peers, kept across reconnects
+	TelnetHistoryArena m_historyArena;
+	// Admission control and rate limits
+	TelnetLimits m_limits;
+	// Connection rate limiters of the peer addresses
+	std::unordered_map<in_addr_t, TokenBucket> m_peerBuckets;
 
 	// Statistics
 	std::unique_ptr<TelnetStats> m_stats;
@@ -206,6 +328,13 @@ class TelnetServer : public std::enable_shared_from_this<TelnetServer> {
 	std::unique_ptr<std::jthread> m_serverThread;  /**< Thread handler */
 };
 
+/**
+ * Registry of the commands used by the default Telnet callbacks. Built-in commands are registered on first access and
+ * modules can register their own commands at runtime.
+ * @return TelnetCommandRegistry& Command registry
+ */
+TelnetCommandRegistry &TelnetCommands();
+
 /**
  * Print available commands to the session
  * @param[in] session Handle to session
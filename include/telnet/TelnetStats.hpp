@@ -1,6 +1,8 @@
 #pragma once
 
+#include "metrics/LatencyHistogram.hpp"
 #include "utils/BaseServerStats.hpp"
+#include "utils/TscClock.hpp"
 
 #include <prometheus/registry.h>
 
@@ -14,17 +16,24 @@ struct TelnetSessionStats {
 	size_t downloadBytes{};										   ///< Downloaded bytes
 	uint64_t successCmdCtr{};									   ///< Successful commands
 	uint64_t failCmdCtr{};										   ///< Failed commands
+	uint64_t tlsHandshakeCtr{};									   ///< Completed TLS handshakes
+	uint64_t tlsResumedHandshakeCtr{};							   ///< Completed TLS handshakes with resumption
+	uint64_t tlsFailedHandshakeCtr{};							   ///< Failed TLS handshakes
+	std::chrono::nanoseconds tlsHandshakeDuration{};			   ///< Duration of the completed TLS handshake
+	uint64_t rateLimitedCmdCtr{};								   ///< Commands rejected by the rate limit
+	uint64_t throttledReadCtr{};								   ///< Reads paused by the byte rate limit
 };
 
 /**
  * Telnet server statistics
  */
 struct TelnetServerStats {
-	std::chrono::high_resolution_clock::time_point processingTimeStart; ///< Processing time start
-	std::chrono::high_resolution_clock::time_point processingTimeEnd;	///< Processing time end
-	uint64_t activeConnectionCtr{};										///< Number of active connections
-	uint64_t acceptedConnectionCtr{};									///< Number of accepted connections
-	uint64_t refusedConnectionCtr{};									///< Number of refused connections
+	TscClock::time_point processingTimeStart; ///< Processing time start
+	TscClock::time_point processingTimeEnd;	  ///< Processing time end
+	uint64_t activeConnectionCtr{};			  ///< Number of active connections
+	uint64_t acceptedConnectionCtr{};		  ///< Number of accepted connections
+	uint64_t refusedConnectionCtr{};		  ///< Number of refused connections
+	uint64_t rateLimitedConnectionCtr{};	  ///< Number of rate limited connections
 };
 
 /**
@@ -32,15 +41,22 @@ struct TelnetServerStats {
  */
 class TelnetStats : private BaseServerStats {
   private:
-	prometheus::Family<prometheus::Info> *_infoFamily; ///< Information metric family
-	prometheus::Gauge *_activeConnection;			   ///< Number of active connections
-	prometheus::Counter *_refusedConnection;		   ///< Number of refused connections
-	prometheus::Counter *_totalConnection;			   ///< Number of total received connections
-	prometheus::Counter *_totalUploadBytes;			   ///< Total uploaded bytes
-	prometheus::Counter *_totalDownloadBytes;		   ///< Total downloaded bytes
-	prometheus::Summary *_sessionDuration;			   ///< Value of the duration of sessions
-	prometheus::Gauge *_maxSessionDuration;			   ///< Maximum duration of sessions
-	prometheus::Gauge *_minSessionDuration;			   ///< Minimum duration of sessions
+	prometheus::Family<prometheus::Info> *_infoFamily;		 ///< Information metric family
+	prometheus::Gauge *_activeConnection;					 ///< Number of active connections
+	prometheus::Counter *_refusedConnection;				 ///< Number of refused connections
+	prometheus::Counter *_totalConnection;					 ///< Number of total received connections
+	prometheus::Counter *_totalUploadBytes;					 ///< Total uploaded bytes
+	prometheus::Counter *_totalDownloadBytes;				 ///< Total downloaded bytes
+	std::unique_ptr<LatencyHistogram> _sessionDuration;		 ///< Value of the duration of sessions
+	prometheus::Gauge *_maxSessionDuration;					 ///< Maximum duration of sessions
+	prometheus::Gauge *_minSessionDuration;					 ///< Minimum duration of sessions
+	prometheus::Counter *_tlsHandshake;						 ///< Number of completed TLS handshakes
+	prometheus::Counter *_tlsResumedHandshake;				 ///< Number of TLS handshakes completed with resumption
+	prometheus::Counter *_tlsFailedHandshake;				 ///< Number of failed TLS handshakes
+	std::unique_ptr<LatencyHistogram> _tlsHandshakeDuration; ///< Value of the duration of TLS handshakes
+	prometheus::Counter *_rateLimitedConnection;			 ///< Number of connections rejected by the peer rate limit
+	prometheus::Counter *_rateLimitedCommand;				 ///< Number of commands rejected by the rate limit
+	prometheus::Counter *_throttledRead;					 ///< Number of reads paused by the byte rate limit
 
   public:
 	/**
@@ -1,22 +1,55 @@
 #pragma once
 
+#include "metrics/LatencyHistogram.hpp"
+#include "metrics/ScrapeRegistry.hpp"
+
 #include <prometheus/registry.h>
 
-#define QUANTILE_DEFAULTS                                                                                              \
-	prometheus::Summary::Quantiles { {0.5, 0.1}, {0.9, 0.1}, {0.99, 0.1} }
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+/// Number of statistics shards, threads are spread over them
+constexpr size_t BASE_STATS_SHARDS = 16;
+/// Size of a cache line, each shard is padded to its own lines
+constexpr size_t BASE_STATS_CACHE_LINE_SIZE = 64;
 
 /**
  * @class BaseServerStats
  * Represents the base statistics for a server.
+ *
+ * Commands are accumulated to per-thread shards with relaxed atomics, so threads consuming statistics do not contend
+ * on the prometheus metrics. Shards are aggregated to the metrics when the registry is scraped, or on every command if
+ * the registry is not a ScrapeRegistry.
  */
 class BaseServerStats {
   private:
-	prometheus::Summary *_processingTime{nullptr};	 ///< Value of the command processing performance
-	prometheus::Gauge *_maxProcessingTime{nullptr};	 ///< Maximum value of the command processing performance
-	prometheus::Gauge *_minProcessingTime{nullptr};	 ///< Minimum value of the command processing performance
-	prometheus::Counter *_succeededCommand{nullptr}; ///< Number of succeeded commands
-	prometheus::Counter *_failedCommand{nullptr};	 ///< Number of failed commands
-	prometheus::Counter *_totalCommand{nullptr};	 ///< Number of total received commands
+	/// Statistics accumulated by the threads of a shard since the last flush
+	struct alignas(BASE_STATS_CACHE_LINE_SIZE) StatsShard {
+		/// Number of succeeded commands
+		std::atomic_uint64_t succeeded{0};
+		/// Number of failed commands
+		std::atomic_uint64_t failed{0};
+		/// Minimum processing time, never reset
+		std::atomic<double> minProcessingTime{std::numeric_limits<double>::max()};
+		/// Maximum processing time, never reset
+		std::atomic<double> maxProcessingTime{0};
+	};
+
+	std::unique_ptr<StatsShard[]> _shards;						///< Per-thread statistics
+	std::mutex _flushLock;										///< Serialises the flushes of the shards
+	bool _flushOnConsume{true};									///< Flushes on every command without scrapes
+	std::unique_ptr<LatencyHistogram> _processingTimeHistogram;	///< Command processing performance
+	prometheus::Gauge *_maxProcessingTime{nullptr};				///< Maximum value of the command processing performance
+	prometheus::Gauge *_minProcessingTime{nullptr};				///< Minimum value of the command processing performance
+	prometheus::Counter *_succeededCommand{nullptr};			///< Number of succeeded commands
+	prometheus::Counter *_failedCommand{nullptr};				///< Number of failed commands
+	prometheus::Counter *_totalCommand{nullptr};				///< Number of total received commands
+	std::unique_ptr<ScrapeCallback> _scrapeCallback;			///< Flushes the shards, removed first on destruction
+
+	// Aggregates the shards to the prometheus metrics
+	void flushBaseStats();
 
   protected:
 	void initBaseStats(const std::shared_ptr<prometheus::Registry> &reg, const std::string &name);
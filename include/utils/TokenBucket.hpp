@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+/**
+ * @class TokenBucket
+ * Token bucket rate limiter. Tokens are refilled continuously with the given rate up to the burst size and each
+ * admitted operation consumes tokens. Not thread-safe.
+ */
+class TokenBucket {
+  private:
+	double _rate;									   ///< Refill rate in tokens per second
+	double _burst;									   ///< Maximum number of tokens
+	double _tokens;									   ///< Available tokens
+	std::chrono::steady_clock::time_point _lastRefill; ///< Last refill time
+
+	// Adds the tokens accumulated since the last refill
+	void refill(std::chrono::steady_clock::time_point now)
+	{
+		const std::chrono::duration<double> elapsed = now - _lastRefill;
+		if (elapsed.count() > 0)
+		{
+			_tokens = std::min(_burst, _tokens + elapsed.count() * _rate);
+			_lastRefill = now;
+		}
+	}
+
+  public:
+	/**
+	 * Constructs a new full bucket
+	 * @param[in] rate Refill rate in tokens per second
+	 * @param[in] burst Maximum number of tokens
+	 */
+	TokenBucket(double rate, double burst)
+		: _rate(rate), _burst(burst), _tokens(burst), _lastRefill(std::chrono::steady_clock::now())
+	{
+	}
+
+	/**
+	 * Consumes tokens if available
+	 * @param[in] tokens Number of tokens to consume
+	 * @param[in] now Current time
+	 * @return true If consumed
+	 * @return false If there are not enough tokens
+	 */
+	bool consume(double tokens = 1.0, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+	{
+		refill(now);
+		if (_tokens < tokens)
+		{
+			return false;
+		}
+		_tokens -= tokens;
+		return true;
+	}
+
+	/**
+	 * Gets the number of available tokens
+	 * @param[in] now Current time
+	 * @return double Available tokens
+	 */
+	double available(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+	{
+		refill(now);
+		return _tokens;
+	}
+
+	/**
+	 * Checks if the bucket is full, which is equivalent to a newly created bucket
+	 * @param[in] now Current time
+	 * @return true If full
+	 * @return false otherwise
+	 */
+	bool full(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+	{
+		refill(now);
+		return _tokens >= _burst;
+	}
+};
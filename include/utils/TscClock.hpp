@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/// Period the time stamp counter is calibrated over
+constexpr std::chrono::milliseconds TSC_CLOCK_CALIBRATION_PERIOD{10};
+
+/**
+ * @class TscClock
+ * Steady clock which reads the time stamp counter of the CPU.
+ *
+ * Reading the counter is a single instruction, while std::chrono clocks go through clock_gettime. The counter is
+ * calibrated against std::chrono::steady_clock once on first use, which takes TSC_CLOCK_CALIBRATION_PERIOD. Time
+ * points start at the steady clock time of the calibration, but drift from it by the calibration error, so only the
+ * durations between TscClock time points are meaningful. If the CPU is not x86-64 or has no invariant TSC, which is
+ * synchronised between the cores and ticks with a constant rate, the clock falls back to std::chrono::steady_clock.
+ */
+class TscClock {
+  public:
+	using duration = std::chrono::nanoseconds;						///< Duration type
+	using rep = duration::rep;										///< Arithmetic type of the durations
+	using period = duration::period;								///< Tick period
+	using time_point = std::chrono::time_point<TscClock, duration>;	///< Time point type
+	static constexpr bool is_steady = true;							///< Never adjusted
+
+	/**
+	 * Gets the current time
+	 * @return time_point Current time
+	 */
+	static time_point now() noexcept;
+
+	/**
+	 * Checks whether the time stamp counter is used. Calibrates the clock if it is not calibrated yet
+	 * @return true If the time stamp counter is used
+	 * @return false If the clock falls back to std::chrono::steady_clock
+	 */
+	static bool isTscUsed() noexcept;
+
+	/**
+	 * Gets the calibrated frequency of the time stamp counter
+	 * @return double Ticks per second, zero if the time stamp counter is not used
+	 */
+	static double tscFrequency() noexcept;
+};
+
+/**
+ * @class ScopedTimer
+ * Adds the time elapsed in its scope to a counter.
+ *
+ * The timer is started when constructed and the elapsed time in nanoseconds is added to the counter when destructed,
+ * also on exceptions or early returns.
+ * @tparam Clock Clock of the timer
+ */
+template <typename Clock = TscClock> class ScopedTimer {
+  private:
+	double &_elapsedTime;				   ///< Counter of the elapsed time in nanoseconds
+	typename Clock::time_point _startTime; ///< Start time of the timer
+
+  public:
+	/**
+	 * Constructs a new timer and starts it
+	 * @param[out] elapsedTime Counter to add the elapsed time in nanoseconds to
+	 */
+	explicit ScopedTimer(double &elapsedTime) : _elapsedTime(elapsedTime), _startTime(Clock::now()) {}
+
+	/**
+	 * Gets the time elapsed since the timer is started
+	 * @return std::chrono::nanoseconds Elapsed time
+	 */
+	[[nodiscard]] std::chrono::nanoseconds elapsed() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _startTime);
+	}
+
+	/// Adds the elapsed time to the counter
+	~ScopedTimer() { _elapsedTime += static_cast<double>(elapsed().count()); }
+
+	// Non-copyable and non-movable
+	ScopedTimer(const ScopedTimer & /*unused*/) = delete;
+	ScopedTimer(ScopedTimer && /*unused*/) = delete;
+	ScopedTimer &operator=(const ScopedTimer & /*unused*/) = delete;
+	ScopedTimer &operator=(ScopedTimer && /*unused*/) = delete;
+};
@@ -2,6 +2,24 @@
 
 #include <zmq.hpp>
 
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// ZAP domain of the CURVE server sockets
+constexpr std::string_view ZEROMQ_ZAP_DOMAIN = "global";
+
+/**
+ * @struct ZeroMQCurveKeys
+ * Z85 encoded CURVE keys of a socket. Sockets without a secret key are not encrypted
+ */
+struct ZeroMQCurveKeys {
+	std::string publicKey; ///< Public key of the socket, derived from the secret key if empty
+	std::string secretKey; ///< Secret key of the socket
+	std::string serverKey; ///< Public key of the server for client sockets, empty for server sockets
+};
+
 /**
  * @class ZeroMQ
  * A class that provides a wrapper for ZeroMQ functionality.
@@ -26,16 +44,18 @@ class ZeroMQ {
 
 	// Initializes class
 	void init(const std::shared_ptr<zmq::context_t> &ctx, const zmq::socket_type &type, const std::string_view &addr,
-			  bool isBind);
+			  bool isBind, const ZeroMQCurveKeys &curveKeys);
 
   public:
 	/**
-	 * Construct a new ZeroMQ class
+	 * Construct a new ZeroMQ class in the shared context of the process, see ZeroMQSharedContext
 	 * @param[in] type Type of the socket
 	 * @param[in] addr Full socket address
 	 * @param[in] isBind True if should be binded, false if should be connected
+	 * @param[in] curveKeys CURVE keys to secure the socket. Server sockets authenticate the clients through the ZAP
+	 * handler of the context, see ZeroMQAuthenticator
 	 */
-	ZeroMQ(const zmq::socket_type &type, const std::string &addr, bool isBind);
+	ZeroMQ(const zmq::socket_type &type, const std::string &addr, bool isBind, const ZeroMQCurveKeys &curveKeys = {});
 
 	/**
 	 * Construct a new ZeroMQ class
@@ -43,9 +63,11 @@ class ZeroMQ {
 	 * @param[in] type Type of the socket
 	 * @param[in] addr Full socket address
 	 * @param[in] isBind True if should be binded, false if should be connected
+	 * @param[in] curveKeys CURVE keys to secure the socket. Server sockets authenticate the clients through the ZAP
+	 * handler of the context, see ZeroMQAuthenticator
 	 */
 	ZeroMQ(const std::shared_ptr<zmq::context_t> &ctx, const zmq::socket_type &type, const std::string &addr,
-		   bool isBind);
+		   bool isBind, const ZeroMQCurveKeys &curveKeys = {});
 
 	/// Copy constructor
 	ZeroMQ(const ZeroMQ & /*unused*/) = delete;
@@ -76,6 +98,13 @@ class ZeroMQ {
 	 */
 	std::vector<zmq::message_t> recvMessages();
 
+	/**
+	 * Receives multipart message into a recycled vector
+	 * @param[out] msg Received messages. Previous messages are discarded but the capacity of the vector is kept
+	 * @return size_t Number of received messages
+	 */
+	size_t recvMessages(std::vector<zmq::message_t> &msg);
+
 	/**
 	 * Sends multipart message
 	 * @param[in] msg Messages to send
@@ -106,3 +135,74 @@ class ZeroMQ {
 	 */
 	~ZeroMQ();
 };
+
+/**
+ * Creates a message referencing constant data without copying it
+ * @param[in] data Data to send. Should outlive the message, such as string literals or static strings
+ * @return zmq::message_t Message
+ */
+zmq::message_t makeConstMessage(std::string_view data);
+
+/**
+ * Creates a message from a string. Large strings are handed over to ZeroMQ without copying and released once the
+ * message is sent, small strings are copied into the message itself
+ * @param[in] data Data to send
+ * @return zmq::message_t Message
+ */
+zmq::message_t makeMessage(std::string &&data);
+
+/**
+ * Generates a new CURVE key pair
+ * @return ZeroMQCurveKeys Z85 encoded public and secret keys
+ * @throws zmq::error_t If ZeroMQ is built without CURVE support
+ */
+ZeroMQCurveKeys makeCurveKeyPair();
+
+/**
+ * Runs a ZeroMQ call again while it is interrupted by a signal, such as SIGPROF of the profiler. ZeroMQ does not
+ * restart its blocking calls, which fail with EINTR
+ * @tparam Func Type of the call
+ * @param[in] func Call to run
+ * @return Result of the call
+ * @throws zmq::error_t On errors other than EINTR
+ */
+template <typename Func> auto retryOnInterrupt(Func &&func)
+{
+	while (true)
+	{
+		try
+		{
+			return func();
+		}
+		catch (const zmq::error_t &e)
+		{
+			if (e.num() != EINTR)
+			{
+				throw;
+			}
+		}
+	}
+}
+
+/**
+ * Receives all parts of a message. Interrupted parts are received again, so a message is never split
+ * @param[in] socket Socket to receive from
+ * @param[out] msgs Received parts, appended to the previous ones
+ * @param[in] flags Receive flags
+ * @return size_t Number of received parts, zero if there is no message and the socket times out or does not wait
+ * @throws zmq::error_t On errors other than EINTR
+ */
+size_t recvMultipart(zmq::socket_ref socket, std::vector<zmq::message_t> &msgs,
+					 zmq::recv_flags flags = zmq::recv_flags::none);
+
+/**
+ * Sends all parts of a message. Interrupted parts are sent again, so a message is never split
+ * @param[in] socket Socket to send to
+ * @param[in] msgs Parts to send, moved to the socket
+ * @param[in] flags Send flags. All parts but the last are also sent with zmq::send_flags::sndmore
+ * @return true If all parts are sent
+ * @return false If the socket times out or does not wait
+ * @throws zmq::error_t On errors other than EINTR
+ */
+bool sendMultipart(zmq::socket_ref socket, std::vector<zmq::message_t> &msgs,
+				   zmq::send_flags flags = zmq::send_flags::none);
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "utils/FileHelpers.hpp"
+
+#include <zmq.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+
+/**
+ * @class ZeroMQAuthenticator
+ * ZAP handler which authenticates the CURVE clients of the server sockets in a context.
+ *
+ * Public keys of the authorised clients are cached in a hash set, so a handshake costs a single lookup. The keys are
+ * read from a file with one Z85 encoded key per line, where empty lines and lines starting with '#' are ignored. The
+ * file is monitored and the keys are reloaded when it is written, without restarting the sockets. Only one handler can
+ * be bound to a context.
+ */
+class ZeroMQAuthenticator {
+  private:
+	/// Transparent hash, so the received keys are looked up without copying them
+	struct KeyHash {
+		using is_transparent = void;
+		size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+	};
+
+	// Context of the authenticated sockets
+	std::shared_ptr<zmq::context_t> _contextPtr;
+	// ZAP handler socket
+	std::unique_ptr<zmq::socket_t> _zapSocket;
+	// File of the authorised keys
+	std::filesystem::path _keyFilePath;
+	// Monitors the file of the authorised keys
+	std::unique_ptr<FileMonitor> _keyFileMonitor;
+
+	// Guards the authorised keys
+	mutable std::shared_mutex _guard;
+	// Binary public keys of the authorised clients
+	std::unordered_set<std::string, KeyHash, std::equal_to<>> _authorizedKeys;
+
+	// Number of accepted clients
+	std::atomic_uint64_t _nAccepted{0};
+	// Number of denied clients
+	std::atomic_uint64_t _nDenied{0};
+
+	// Handler thread
+	std::unique_ptr<std::jthread> _handlerThread;
+
+	// Replies a ZAP request
+	void handleRequest(std::vector<zmq::message_t> &recvMsgs);
+
+	/// Main thread function
+	void threadFunc(const std::stop_token &stopToken) noexcept;
+
+  public:
+	/**
+	 * Binds the ZAP handler to the context and starts the handler thread
+	 * @param[in] ctx Context of the sockets to authenticate. Should be the context of the server sockets
+	 * @param[in] keyFilePath File of the authorised keys. If empty, keys are only added by authorizeKey
+	 * @throws zmq::error_t If there is already a ZAP handler in the context
+	 * @throws std::ios_base::failure If the file can't be monitored
+	 */
+	explicit ZeroMQAuthenticator(std::shared_ptr<zmq::context_t> ctx, std::filesystem::path keyFilePath = {});
+
+	/// Copy constructor
+	ZeroMQAuthenticator(const ZeroMQAuthenticator & /*unused*/) = delete;
+
+	/// Move constructor
+	ZeroMQAuthenticator(ZeroMQAuthenticator && /*unused*/) = delete;
+
+	/// Copy assignment operator
+	ZeroMQAuthenticator &operator=(ZeroMQAuthenticator /*unused*/) = delete;
+
+	/// Move assignment operator
+	ZeroMQAuthenticator &operator=(ZeroMQAuthenticator && /*unused*/) = delete;
+
+	/**
+	 * Reads the authorised keys from the file and replaces the cached ones
+	 * @return true If the keys are reloaded
+	 * @return false If the file can't be read, the cached keys are kept
+	 */
+	bool reloadKeys();
+
+	/**
+	 * Adds an authorised key
+	 * @param[in] publicKey Z85 encoded public key of the client
+	 * @return true If added
+	 * @return false If the key is invalid
+	 */
+	bool authorizeKey(std::string_view publicKey);
+
+	/**
+	 * Gets the number of authorised keys
+	 * @return size_t Number of keys
+	 */
+	[[nodiscard]] size_t authorizedKeys() const;
+
+	/**
+	 * Gets the number of accepted clients
+	 * @return uint64_t Number of clients
+	 */
+	[[nodiscard]] uint64_t acceptedClients() const { return _nAccepted; }
+
+	/**
+	 * Gets the number of denied clients
+	 * @return uint64_t Number of clients
+	 */
+	[[nodiscard]] uint64_t deniedClients() const { return _nDenied; }
+
+	/// Destructor
+	~ZeroMQAuthenticator();
+};
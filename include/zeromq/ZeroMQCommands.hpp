@@ -0,0 +1,202 @@
+#pragma once
+
+#include "utils/Hasher.hpp"
+
+#include <zmq.hpp>
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// ZeroMQ command handler. Receives the argument parts following the command identifier and appends the reply parts
+using FPTR_ZeroMQCommand = std::function<bool(std::span<const zmq::message_t>, std::vector<zmq::message_t> &)>;
+
+/**
+ * Generates the identifier of a command from its name at compile time
+ * @param[in] name Name of the command
+ * @return uint32_t Identifier sent in the first message part
+ */
+template <size_t N> constexpr uint32_t ZeroMQCommandId(const char (&name)[N])
+{
+	const uint64_t value = constSeeder(name, constHasher(name));
+	return static_cast<uint32_t>(value ^ (value >> 32));
+}
+
+/// Identifier of the batch command, which carries several commands in one message
+constexpr uint32_t ZEROMQ_BATCH_CMD_ID = ZeroMQCommandId("batch");
+
+/// Marks pipelined requests, sent as the first part before the request identifier. Never a command identifier
+constexpr uint32_t ZEROMQ_PIPELINE_MARKER_ID = ZeroMQCommandId("pipeline");
+
+/// Request identifier pipelined clients send after the marker, the reply is routed back with both
+using ZeroMQRequestId = uint64_t;
+
+/**
+ * @struct ZeroMQCommand
+ * Represents a registered ZeroMQ command
+ */
+struct ZeroMQCommand {
+	std::string name;				   ///< Name of the command, used for logs and metrics
+	uint32_t id{0};					   ///< Identifier sent in the first message part
+	std::vector<size_t> argumentSizes; ///< Sizes of the argument parts, zero accepts any size
+	FPTR_ZeroMQCommand handler;		   ///< Function invoked when the command is received
+	bool isVariadic{false};			   ///< Accepts any number of argument parts, the handler checks them
+};
+
+/**
+ * Gets the size of a flat encoded argument
+ * @tparam T Type of the argument. std::string_view accepts parts of any size, other types are copied as they are
+ * @return size_t Size of the message part, zero if any size is accepted
+ */
+template <typename T> constexpr size_t ZeroMQArgumentSize()
+{
+	static_assert(std::is_same_v<T, std::string_view> || std::is_trivially_copyable_v<T>,
+				  "Arguments should be trivially copyable or std::string_view");
+	if constexpr (std::is_same_v<T, std::string_view>)
+	{
+		return 0;
+	}
+	else
+	{
+		return sizeof(T);
+	}
+}
+
+/**
+ * Decodes a flat encoded argument. The size of the part should be checked before
+ * @param[in] msg Message part
+ * @return T Decoded argument
+ */
+template <typename T> T ZeroMQDecodeArgument(const zmq::message_t &msg)
+{
+	if constexpr (std::is_same_v<T, std::string_view>)
+	{
+		return msg.to_string_view();
+	}
+	else
+	{
+		T value;
+		std::memcpy(&value, msg.data(), sizeof(T));
+		return value;
+	}
+}
+
+/**
+ * Encodes a value as a flat message part
+ * @param[in] value Trivially copyable value
+ * @return zmq::message_t Message part
+ */
+template <typename T> zmq::message_t ZeroMQEncodeReply(const T &value)
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Replies should be trivially copyable");
+	return {&value, sizeof(T)};
+}
+
+/**
+ * Creates a command with flat encoded arguments. The argument parts are checked against the argument types before
+ * the handler is invoked, so handlers receive decoded values
+ * @tparam Args Types of the arguments, one message part per argument
+ * @param[in] name Name of the command
+ * @param[in] id Identifier of the command
+ * @param[in] func Function of form bool(Args..., std::vector<zmq::message_t> &replyMsgs)
+ * @return ZeroMQCommand Command to register
+ */
+template <typename... Args, typename Func> ZeroMQCommand makeZeroMQCommand(std::string name, uint32_t id, Func func)
+{
+	return {.name = std::move(name),
+			.id = id,
+			.argumentSizes = {ZeroMQArgumentSize<Args>()...},
+			.handler = [func = std::move(func)](std::span<const zmq::message_t> args,
+												std::vector<zmq::message_t> &replyMsgs) {
+				return [&]<size_t... Idx>(std::index_sequence<Idx...>) {
+					return func(ZeroMQDecodeArgument<Args>(args[Idx])..., replyMsgs);
+				}(std::index_sequence_for<Args...>{});
+			}};
+}
+
+/**
+ * @class ZeroMQCommandRegistry
+ * Thread-safe registry of ZeroMQ commands.
+ *
+ * Requests are [uint32_t id, arguments...] and replies are [int status, body...], where the status is
+ * ZMQ_EVENT_HANDSHAKE_SUCCEEDED or ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL. Arguments and replies are flat encoded, so
+ * the fixed size parts are copied as they are without parsing. Commands can be registered or removed at any time, also
+ * while a ZeroMQ server is running.
+ *
+ * Several commands can be sent in one message with the batch command, see dispatchBatch.
+ */
+class ZeroMQCommandRegistry {
+  private:
+	// Guards the commands
+	mutable std::shared_mutex _guard;
+	// Registered commands by their identifiers
+	std::unordered_map<uint32_t, std::shared_ptr<const ZeroMQCommand>> _commands;
+
+	// Appends the status and the reply parts of a command
+	bool invoke(std::span<const zmq::message_t> recvMsgs, std::vector<zmq::message_t> &replyMsgs) const;
+
+  public:
+	/**
+	 * Registers a new command
+	 * @param[in] command Command to register
+	 * @return true If registered
+	 * @return false If the handler is empty, the identifier is reserved or a command with the same identifier exists
+	 */
+	bool registerCommand(ZeroMQCommand command);
+
+	/**
+	 * Removes a registered command
+	 * @param[in] id Identifier of the command
+	 * @return true If removed
+	 * @return false If there is no such command
+	 */
+	bool unregisterCommand(uint32_t id);
+
+	/**
+	 * Finds a registered command
+	 * @param[in] id Identifier of the command
+	 * @return std::shared_ptr<const ZeroMQCommand> Command, null if not found
+	 */
+	std::shared_ptr<const ZeroMQCommand> find(uint32_t id) const;
+
+	/**
+	 * Checks the arguments and invokes the handler of the received command
+	 * @param[in] recvMsgs Received messages
+	 * @param[out] replyMsgs Reply messages
+	 * @return true If the command succeeded
+	 * @return false otherwise
+	 */
+	bool dispatch(const std::vector<zmq::message_t> &recvMsgs, std::vector<zmq::message_t> &replyMsgs) const;
+
+	/**
+	 * Dispatches the commands of a batch in order. Batches are [uint32_t nParts, command parts...] repeated for every
+	 * command and replied as [uint32_t nParts, status, reply parts...] in the same order. Commands fail on their own
+	 * without failing the batch, but malformed or nested batches are rejected before any command runs
+	 * @param[in] args Argument parts of the batch command
+	 * @param[out] replyMsgs Reply messages, the replies of the commands are appended
+	 * @return true If the batch is dispatched
+	 * @return false If the batch is malformed
+	 */
+	bool dispatchBatch(std::span<const zmq::message_t> args, std::vector<zmq::message_t> &replyMsgs) const;
+
+	/**
+	 * Gets the registered commands
+	 * @return std::vector<std::pair<uint32_t, std::string>> Identifiers and names ordered by name
+	 */
+	std::vector<std::pair<uint32_t, std::string>> commands() const;
+};
+
+/**
+ * Registry of the commands used by the default ZeroMQ callback. Built-in commands are registered on first access and
+ * modules can register their own commands at runtime.
+ * @return ZeroMQCommandRegistry& Command registry
+ */
+ZeroMQCommandRegistry &ZeroMQCommands();
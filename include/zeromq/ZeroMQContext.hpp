@@ -0,0 +1,39 @@
+#pragma once
+
+#include <zmq.hpp>
+
+#include <memory>
+#include <vector>
+
+/// Default value of the scheduling options, the I/O threads keep the scheduling of the process
+constexpr int ZEROMQ_THREAD_SCHED_DEFAULT = -1;
+
+/**
+ * @struct ZeroMQContextOptions
+ * Options of the shared ZeroMQ context
+ */
+struct ZeroMQContextOptions {
+	int ioThreads{1};								///< Number of I/O threads
+	std::vector<int> cpuAffinity;					///< CPUs the I/O threads run on, empty for all CPUs
+	int schedPolicy{ZEROMQ_THREAD_SCHED_DEFAULT};	///< Scheduling policy of the I/O threads, such as SCHED_FIFO
+	int schedPriority{ZEROMQ_THREAD_SCHED_DEFAULT}; ///< Scheduling priority of the I/O threads
+};
+
+/**
+ * Configures the context shared by the ZeroMQ sockets of the process. The options are applied when the context is
+ * created, so it should be called before any socket is created. Realtime scheduling policies need CAP_SYS_NICE,
+ * ZeroMQ aborts if the scheduling of the I/O threads can't be applied
+ * @param[in] options Options of the context
+ * @return true If configured
+ * @return false If the options are invalid or the context is already created
+ */
+bool configureZeroMQContext(const ZeroMQContextOptions &options);
+
+/**
+ * Context shared by the ZeroMQ sockets of the process. Sockets of a context share its I/O threads and can connect to
+ * each other over inproc. Created on first access with the configured options, and released once all of its sockets
+ * are released
+ * @return const std::shared_ptr<zmq::context_t>& Shared context
+ * @throws zmq::error_t If an option is not supported by ZeroMQ
+ */
+const std::shared_ptr<zmq::context_t> &ZeroMQSharedContext();
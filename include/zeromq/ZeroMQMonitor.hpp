@@ -1,67 +1,124 @@
 #pragma once
 
+#include "zeromq/ZeroMQContext.hpp"
+#include "zeromq/ZeroMQReactor.hpp"
+
+#include <prometheus/registry.h>
 #include <zmq.hpp>
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <string>
-#include <thread>
+#include <unordered_map>
+
+/**
+ * Results of the connection handshakes
+ */
+enum class ZeroMQHandshakeResult : uint8_t {
+	Succeeded,		///< Handshake succeeded
+	FailedNoDetail, ///< Handshake failed without a detail, such as a timeout
+	FailedProtocol, ///< Handshake failed because of a protocol error
+	FailedAuth		///< Handshake failed because the peer is not authorised
+};
+
+/// Callback function for the handshakes, invoked with the result and the time since the connection is established
+using FPTR_HandshakeCallback = std::function<void(ZeroMQHandshakeResult, std::chrono::nanoseconds)>;
 
 /**
  * @class ZeroMQMonitor
  * Class for monitoring ZeroMQ events on a socket.
  *
  * The ZeroMQMonitor class provides functionality to monitor ZeroMQ events on a socket.
- * It starts a separate thread to listen for events and invokes corresponding event handlers.
+ * Events are received from a PAIR socket served by a reactor, so they are handled as soon as they arrive. The reactor
+ * can be shared with the server thread of the monitored socket, otherwise the monitor starts its own.
  * The class supports various event types such as connection, binding, acceptance, closure, etc.
+ *
+ * If metrics are registered, connections, disconnections, handshake and accept failures and the current peers are
+ * counted per endpoint as reported by ZeroMQ, and the handshake times are observed in a histogram.
  */
-class ZeroMQMonitor : private zmq::monitor_t {
+class ZeroMQMonitor {
   private:
-	std::atomic_int _peerCount{0};				  /**< Number of peers connected. */
-	std::unique_ptr<std::jthread> _monitorThread; /**< Thread for monitoring events. */
+	/// Metrics of an endpoint
+	struct EndpointStats {
+		prometheus::Counter *connections{nullptr};		 ///< Number of established connections
+		prometheus::Counter *disconnections{nullptr};	 ///< Number of closed connections
+		prometheus::Counter *handshakeFailures{nullptr}; ///< Number of failed handshakes
+		prometheus::Counter *acceptFailures{nullptr};	 ///< Number of failed accepts
+		prometheus::Gauge *peers{nullptr};				 ///< Number of connected peers
+	};
+
+	std::atomic_int _peerCount{0};			   /**< Number of peers connected. */
+	FPTR_HandshakeCallback _handshakeCallback; /**< Called after every handshake. */
+
+	/** Connection times of the handshakes in progress, in connection order. */
+	std::deque<std::chrono::steady_clock::time_point> _handshakeStartTimes;
+
+	zmq::socket_t *_socket{nullptr};			   /**< Monitored socket. */
+	std::unique_ptr<zmq::socket_t> _monitorSocket; /**< Receives the events of the monitored socket. */
+	std::unique_ptr<ZeroMQReactor> _ownedReactor;  /**< Reactor started by the monitor, if not shared. */
+	ZeroMQReactor *_reactor{nullptr};			   /**< Reactor serving the event socket. */
+
+	prometheus::Family<prometheus::Counter> *_connectionFamily{nullptr};	   /**< Connections by endpoint. */
+	prometheus::Family<prometheus::Counter> *_disconnectionFamily{nullptr};	   /**< Disconnections by endpoint. */
+	prometheus::Family<prometheus::Counter> *_handshakeFailureFamily{nullptr}; /**< Handshake failures by endpoint. */
+	prometheus::Family<prometheus::Counter> *_acceptFailureFamily{nullptr};	   /**< Accept failures by endpoint. */
+	prometheus::Family<prometheus::Gauge> *_peerFamily{nullptr};			   /**< Connected peers by endpoint. */
+	std::array<prometheus::Counter *, 4> _handshakeCounts{};				   /**< Handshakes by result. */
+	std::array<prometheus::Histogram *, 4> _handshakeTimes{};				   /**< Handshake times by result. */
+	std::unordered_map<std::string, EndpointStats> _endpointStats;			   /**< Metrics of the endpoints. */
+
+	void handleEvents();
+
+	EndpointStats *endpointStats(const char *addr);
+
+	void startHandshake();
 
-	void threadFunc(const std::stop_token &stopToken);
+	void finishHandshake(ZeroMQHandshakeResult result, const char *addr);
 
 	static void on_event(const std::string &messageStr, int level, const char *addr = nullptr);
 
-	void on_monitor_started() override;
+	void on_monitor_started();
 
-	void on_event_connected(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_connected(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_connect_delayed(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_connect_delayed(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_connect_retried(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_connect_retried(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_listening(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_listening(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_bind_failed(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_bind_failed(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_accepted(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_accepted(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_accept_failed(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_accept_failed(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_closed(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_closed(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_close_failed(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_close_failed(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_disconnected(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_disconnected(const zmq_event_t & /*unused*/, const char *addr_);
 
 #if ZMQ_VERSION >= ZMQ_MAKE_VERSION(4, 3, 0) ||                                                                        \
 	(defined(ZMQ_BUILD_DRAFT_API) && ZMQ_VERSION >= ZMQ_MAKE_VERSION(4, 2, 3))
-	void on_event_handshake_failed_no_detail(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_handshake_failed_no_detail(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_handshake_failed_protocol(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_handshake_failed_protocol(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_handshake_failed_auth(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_handshake_failed_auth(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_handshake_succeeded(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_handshake_succeeded(const zmq_event_t & /*unused*/, const char *addr_);
 
 #elif defined(ZMQ_BUILD_DRAFT_API) && ZMQ_VERSION >= ZMQ_MAKE_VERSION(4, 2, 1)
-	void on_event_handshake_failed(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_handshake_failed(const zmq_event_t & /*unused*/, const char *addr_);
 
-	void on_event_handshake_succeed(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_handshake_succeed(const zmq_event_t & /*unused*/, const char *addr_);
 #endif
 
-	void on_event_unknown(const zmq_event_t & /*unused*/, const char *addr_) override;
+	void on_event_unknown(const zmq_event_t & /*unused*/, const char *addr_);
 
   public:
 	/// Constructor.
@@ -82,13 +139,33 @@ class ZeroMQMonitor : private zmq::monitor_t {
 	/**
 	 * Start monitoring events on the given socket.
 	 *
-	 * This method starts a separate thread to listen for events on the given socket.
+	 * The events are served by the given reactor, from the same thread as the other sockets of the reactor.
 	 * The method also sets up the event handlers for various event types.
 	 *
 	 * @param[in] socket Zeromq socket
 	 * @param[in] monitorAddress Monitoring address
+	 * @param[in] reactor Reactor to serve the events. Should be created in the context of the socket
 	 */
-	void startMonitoring(zmq::socket_t *socket, const std::string &monitorAddress);
+	void startMonitoring(zmq::socket_t *socket, const std::string &monitorAddress, ZeroMQReactor &reactor);
+
+	/**
+	 * Start monitoring events on the given socket.
+	 *
+	 * This method starts a reactor thread to listen for events on the given socket.
+	 *
+	 * @param[in] socket Zeromq socket
+	 * @param[in] monitorAddress Monitoring address
+	 * @param[in] ctx Context of the socket
+	 */
+	void startMonitoring(zmq::socket_t *socket, const std::string &monitorAddress,
+						 std::shared_ptr<zmq::context_t> ctx = ZeroMQSharedContext());
+
+	/**
+	 * Registers the connection metrics. Should be called before the monitoring starts
+	 * @param[in] reg Prometheus registry
+	 * @param[in] prependName Prefix for Prometheus stats
+	 */
+	void registerMetrics(const std::shared_ptr<prometheus::Registry> &reg, const std::string &prependName = "");
 
 	/**
 	 * Get the number of peers connected.
@@ -97,7 +174,14 @@ class ZeroMQMonitor : private zmq::monitor_t {
 	[[nodiscard]] int getPeerCount() const { return _peerCount; }
 
 	/**
-	 * Stop monitoring events on the socket.
+	 * Sets the handshake callback function. Handshake events do not identify the connections, so the durations are
+	 * matched to the connections in order. Should be set before the monitoring starts
+	 * @param[in] func The handshake callback function to be set
+	 */
+	void handshakeCallback(FPTR_HandshakeCallback func) { _handshakeCallback = std::move(func); }
+
+	/**
+	 * Stop monitoring events on the socket. Should be called while the monitored socket and the reactor are alive.
 	 */
 	void stopMonitoring();
 
@@ -109,5 +193,5 @@ class ZeroMQMonitor : private zmq::monitor_t {
 	/**
 	 * Destructor.
 	 */
-	~ZeroMQMonitor() override { stopMonitoring(); }
+	~ZeroMQMonitor() { stopMonitoring(); }
 };
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "zeromq/ZeroMQ.hpp"
+
+#include <spdlog/details/null_mutex.h>
+#include <spdlog/sinks/base_sink.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// Topic prefix of the log lines, followed by the log level
+constexpr std::string_view ZEROMQ_TOPIC_LOG = "log.";
+/// Topic prefix of the metric deltas, followed by the metric name
+constexpr std::string_view ZEROMQ_TOPIC_METRIC = "metric.";
+/// Topic prefix of the command audit records, followed by the source of the command
+constexpr std::string_view ZEROMQ_TOPIC_AUDIT = "audit.";
+
+/**
+ * @struct ZeroMQPublisherOptions
+ * Tuning options of a ZeroMQ publisher
+ */
+struct ZeroMQPublisherOptions {
+	/// Use an XPUB socket and drop the events without a subscriber before queueing them
+	bool isXPub{false};
+	/// High-water mark of each subscriber in batches, ZeroMQ drops the batches above it
+	int sendHwm{1000};
+	/// Only publish the latest queued event of each topic
+	bool conflate{false};
+	/// Maximum number of events sent in one multipart message
+	size_t maxBatchSize{64};
+	/// Events are dropped while this many events are queued
+	size_t maxQueuedEvents{65536};
+	/// Maximum time an event waits in the queue
+	std::chrono::milliseconds flushInterval{10};
+};
+
+/**
+ * @class ZeroMQPublisher
+ * Streams internal events to subscribers over a PUB or XPUB socket.
+ *
+ * Events can be published from any thread without blocking. They are queued per topic and sent by the publisher thread
+ * as multipart messages of [topic, event, event, ...], so a subscriber receives a batch of events with a single
+ * message. Metric deltas of the same metric are summed until they are sent.
+ */
+class ZeroMQPublisher : private ZeroMQ {
+  private:
+	// Tuning options
+	ZeroMQPublisherOptions _options;
+
+	// Guards the queued events and the subscriptions
+	std::mutex _guard;
+	// Notified when a batch is ready to send
+	std::condition_variable_any _flushCond;
+	// Queued events of the topics
+	std::unordered_map<std::string, std::vector<std::string>> _queuedEvents;
+	// Queued metric deltas of the metric topics
+	std::unordered_map<std::string, double> _queuedMetrics;
+	// Number of queued events
+	size_t _nQueuedEvents{0};
+	// Topic prefixes subscribed by the subscribers, only tracked for XPUB sockets
+	std::unordered_set<std::string> _subscriptions;
+
+	// Events being sent by the publisher thread, swapped with the queued ones to recycle the buffers
+	std::unordered_map<std::string, std::vector<std::string>> _sendingEvents;
+	// Metric deltas being sent by the publisher thread
+	std::unordered_map<std::string, double> _sendingMetrics;
+	// Recycled frames of a batch
+	std::vector<zmq::message_t> _batchMsgs;
+
+	// Number of events sent to the socket
+	std::atomic_uint64_t _nPublishedEvents{0};
+	// Number of multipart messages sent to the socket
+	std::atomic_uint64_t _nPublishedBatches{0};
+	// Number of events dropped because the queue is full
+	std::atomic_uint64_t _nDroppedEvents{0};
+
+	// Publisher thread
+	std::unique_ptr<std::jthread> _publisherThread;
+
+	// Checks if there is a subscriber for the topic. Should be called with the guard locked
+	bool isSubscribed(std::string_view topic) const;
+
+	// Reads the subscription changes of the XPUB socket
+	void updateSubscriptions();
+
+	// Sends the events swapped out of the queue
+	void sendEvents();
+
+	// Sends the events of a topic in batches
+	void sendBatches(const std::string &topic, std::vector<std::string> &events);
+
+	/// Main thread function
+	void threadFunc(const std::stop_token &stopToken) noexcept;
+
+  public:
+	/**
+	 * Constructs a new publisher
+	 * @param[in] hostAddr Address to bind. Can be anything supported by ZeroMQ publish sockets
+	 * @param[in] options Tuning options
+	 */
+	explicit ZeroMQPublisher(const std::string &hostAddr, const ZeroMQPublisherOptions &options = {});
+
+	/// Copy constructor
+	ZeroMQPublisher(const ZeroMQPublisher & /*unused*/) = delete;
+
+	/// Move constructor
+	ZeroMQPublisher(ZeroMQPublisher && /*unused*/) = delete;
+
+	/// Copy assignment operator
+	ZeroMQPublisher &operator=(ZeroMQPublisher /*unused*/) = delete;
+
+	/// Move assignment operator
+	ZeroMQPublisher &operator=(ZeroMQPublisher && /*unused*/) = delete;
+
+	/**
+	 * Binds the socket and starts the publisher thread
+	 * @return true If initialized
+	 * @return false otherwise
+	 */
+	bool initialise();
+
+	/// Sends the queued events and closes the publisher
+	void shutdown();
+
+	/**
+	 * Queues an event
+	 * @param[in] topic Topic of the event. Subscribers filter the events by the prefixes of the topics
+	 * @param[in] event Event data
+	 * @return true If queued
+	 * @return false If there is no subscriber of an XPUB socket or the queue is full
+	 */
+	bool publish(std::string_view topic, std::string_view event);
+
+	/**
+	 * Queues a log line to the log.<level> topic
+	 * @param[in] level Log level name
+	 * @param[in] line Log line
+	 * @return true If queued
+	 * @return false otherwise
+	 */
+	bool publishLog(std::string_view level, std::string_view line);
+
+	/**
+	 * Adds a delta to the metric.<name> topic. Deltas of a metric are summed until they are sent
+	 * @param[in] name Name of the metric
+	 * @param[in] delta Change of the metric
+	 * @return true If queued
+	 * @return false otherwise
+	 */
+	bool publishMetric(std::string_view name, double delta);
+
+	/**
+	 * Queues a command audit record to the audit.<source> topic
+	 * @param[in] source Source of the command, such as telnet or zeromq
+	 * @param[in] record Audit record
+	 * @return true If queued
+	 * @return false otherwise
+	 */
+	bool publishAudit(std::string_view source, std::string_view record);
+
+	/**
+	 * Gets the number of events sent to the socket
+	 * @return uint64_t Number of events
+	 */
+	[[nodiscard]] uint64_t publishedEvents() const { return _nPublishedEvents; }
+
+	/**
+	 * Gets the number of multipart messages sent to the socket
+	 * @return uint64_t Number of messages
+	 */
+	[[nodiscard]] uint64_t publishedBatches() const { return _nPublishedBatches; }
+
+	/**
+	 * Gets the number of events dropped because the queue is full
+	 * @return uint64_t Number of events
+	 */
+	[[nodiscard]] uint64_t droppedEvents() const { return _nDroppedEvents; }
+
+	/// Destructor
+	~ZeroMQPublisher() { shutdown(); }
+};
+
+namespace spdlog::sinks
+{
+	// NOLINTBEGIN
+	/**
+	 * A custom sink for spdlog that publishes the log lines with a ZeroMQ publisher.
+	 *
+	 * @tparam Mutex The type of mutex to use for thread-safety.
+	 */
+	template <typename Mutex> class zeromq_publisher_sink : public base_sink<Mutex> {
+	  public:
+		/**
+		 * Constructs a zeromq_publisher_sink object with the specified publisher.
+		 *
+		 * @param publisher The publisher to send log lines to.
+		 */
+		explicit zeromq_publisher_sink(std::shared_ptr<ZeroMQPublisher> publisher) : _publisher(std::move(publisher))
+		{
+		}
+
+	  protected:
+		void sink_it_(const details::log_msg &msg) override
+		{
+			const auto level = level::to_string_view(msg.level);
+			_publisher->publishLog(std::string_view(level.data(), level.size()),
+								   std::string_view(msg.payload.data(), msg.payload.size()));
+		}
+
+		void flush_() override {}
+
+	  private:
+		std::shared_ptr<ZeroMQPublisher> _publisher;
+	};
+
+	using zeromq_publisher_sink_mt = zeromq_publisher_sink<std::mutex>;
+	using zeromq_publisher_sink_st = zeromq_publisher_sink<details::null_mutex>;
+	// NOLINTEND
+} // namespace spdlog::sinks
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <zmq.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Handler of a socket registered to a reactor. Called from the reactor thread when the socket has messages to read
+using FPTR_SocketHandler = std::function<void(zmq::socket_ref)>;
+
+/**
+ * @class ZeroMQReactor
+ * Serves several ZeroMQ sockets from a single thread.
+ *
+ * The reactor thread polls all registered sockets and invokes the handler of each readable socket. Sockets can be
+ * registered or removed at any time, from any thread. An internal PAIR socket wakes up the poll, so registration
+ * changes and stop requests take effect immediately. Registered sockets should only be used from the handlers.
+ */
+class ZeroMQReactor {
+  private:
+	/// Registered socket
+	struct Entry {
+		zmq::socket_ref socket;		///< Socket to poll
+		FPTR_SocketHandler handler; ///< Function to invoke when the socket is readable
+		bool isPaused{false};		///< True if the socket is not polled temporarily
+	};
+
+	// ZeroMQ context of the wake-up sockets
+	std::shared_ptr<zmq::context_t> _contextPtr;
+	// Address of the wake-up sockets
+	std::string _wakeupAddr;
+	// Wake-up socket polled by the reactor thread
+	zmq::socket_t _wakeupReceiver;
+	// Wake-up socket used by other threads
+	zmq::socket_t _wakeupSender;
+
+	// Guards the registered sockets and the wake-up sender
+	std::mutex _guard;
+	// Notified when the reactor thread applies a registration change
+	std::condition_variable _appliedCond;
+	// Registered sockets
+	std::vector<Entry> _entries;
+	// Incremented on every registration change
+	std::atomic_uint64_t _generation{0};
+	// Generation the reactor thread polls with
+	uint64_t _appliedGeneration{0};
+	// True while the reactor thread applies registration changes
+	bool _isPolling{false};
+	// Identifier of the reactor thread
+	std::thread::id _reactorThreadId;
+
+	// Called after every poll
+	std::function<void()> _tickCallback;
+	// Reactor thread
+	std::unique_ptr<std::jthread> _reactorThread;
+
+	// Marks a registration change and wakes up the reactor. Should be called with the guard locked
+	void markChanged(std::unique_lock<std::mutex> &lock, bool waitApplied);
+
+	/// Main thread function
+	void threadFunc(const std::stop_token &stopToken) noexcept;
+
+  public:
+	/**
+	 * Constructs a new reactor
+	 * @param[in] ctx ZeroMQ context for the internal wake-up sockets
+	 */
+	explicit ZeroMQReactor(std::shared_ptr<zmq::context_t> ctx);
+
+	/// Copy constructor
+	ZeroMQReactor(const ZeroMQReactor & /*unused*/) = delete;
+
+	/// Move constructor
+	ZeroMQReactor(ZeroMQReactor && /*unused*/) = delete;
+
+	/// Copy assignment operator
+	ZeroMQReactor &operator=(ZeroMQReactor /*unused*/) = delete;
+
+	/// Move assignment operator
+	ZeroMQReactor &operator=(ZeroMQReactor && /*unused*/) = delete;
+
+	/**
+	 * Registers a socket
+	 * @param[in] socket Socket to poll
+	 * @param[in] handler Function to invoke when the socket is readable
+	 * @return true If registered
+	 * @return false If the socket is invalid or already registered
+	 */
+	bool addSocket(zmq::socket_ref socket, FPTR_SocketHandler handler);
+
+	/**
+	 * Removes a registered socket. When called from another thread, returns after the reactor thread stops polling the
+	 * socket, so the socket can be closed right after
+	 * @param[in] socket Registered socket
+	 * @return true If removed
+	 * @return false If the socket is not registered
+	 */
+	bool removeSocket(zmq::socket_ref socket);
+
+	/**
+	 * Stops or restarts polling a registered socket without removing it. Useful for applying backpressure, messages
+	 * stay in the queue of the socket while it is paused. When called from another thread, returns after the reactor
+	 * thread applies the change
+	 * @param[in] socket Registered socket
+	 * @param[in] isPaused True to stop polling, false to restart
+	 * @return true If updated
+	 * @return false If the socket is not registered
+	 */
+	bool pauseSocket(zmq::socket_ref socket, bool isPaused);
+
+	/**
+	 * Sets the function called from the reactor thread after every poll. Polls time out periodically, so it is called
+	 * even if there is no message. Should be set before starting the reactor
+	 * @param[in] func Function to call
+	 */
+	void tickCallback(std::function<void()> func) { _tickCallback = std::move(func); }
+
+	/**
+	 * Starts the reactor thread
+	 * @return true If started
+	 * @return false If already running
+	 */
+	bool start();
+
+	/// Stops the reactor thread without waiting for the poll timeout. Should not be called from the handlers
+	void stop();
+
+	/**
+	 * Gets the context of the reactor. Sockets served by the reactor can be created in it
+	 * @return const std::shared_ptr<zmq::context_t>& Context of the reactor
+	 */
+	[[nodiscard]] const std::shared_ptr<zmq::context_t> &context() const { return _contextPtr; }
+
+	/**
+	 * Checks the reactor thread is running
+	 * @return true If running
+	 * @return false otherwise
+	 */
+	[[nodiscard]] bool isRunning() const { return _reactorThread != nullptr; }
+
+	/// Destructor
+	~ZeroMQReactor() { stop(); }
+};
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "zeromq/ZeroMQ.hpp"
+#include "zeromq/ZeroMQAuthenticator.hpp"
+#include "zeromq/ZeroMQCommands.hpp"
 #include "zeromq/ZeroMQMonitor.hpp"
+#include "zeromq/ZeroMQPublisher.hpp"
+#include "zeromq/ZeroMQReactor.hpp"
 #include "zeromq/ZeroMQStats.hpp"
 
+#include <deque>
 #include <functional>
 
 using FPTR_MessageCallback = std::function<bool(const std::vector<zmq::message_t> &, std::vector<zmq::message_t> &)>;
@@ -16,25 +21,86 @@ class ZeroMQServer : private ZeroMQ, private ZeroMQMonitor {
 	std::unique_ptr<ZeroMQStats> _stats;
 	// Called after every message function(std::vector<zmq::message_t>) {}
 	FPTR_MessageCallback _m_messageCallback;
-	// Thread for processing messages
-	std::unique_ptr<std::jthread> _serverThread;
+	// Serves the sockets of the server
+	ZeroMQReactor _reactor;
+	// Publishes the audit records and metric deltas of the commands
+	std::shared_ptr<ZeroMQPublisher> _publisher;
+	// Authenticates the CURVE clients
+	std::unique_ptr<ZeroMQAuthenticator> _authenticator;
+
+	// Number of worker threads, zero if messages are processed by the server thread
+	size_t _nWorkers;
+	// Address of the internal socket which distributes messages to workers
+	std::string _backendAddr;
+	// Internal socket which distributes messages to workers
+	std::unique_ptr<zmq::socket_t> _backendSocket;
+	// Address of the monitor socket of the frontend
+	std::string _monitorAddr;
+	// Routing ids of the workers waiting for a message
+	std::deque<zmq::message_t> _idleWorkers;
+	// Worker threads
+	std::vector<std::jthread> _workerThreads;
+
+	// Received messages of the server thread, recycled between messages
+	std::vector<zmq::message_t> _recvMsgs;
+	// Reply messages of the server thread, recycled between messages
+	std::vector<zmq::message_t> _replyMsgs;
+
+	/// Runs the message callback and prepares the reply
+	bool processMessages(const std::vector<zmq::message_t> &recvMsgs, std::vector<zmq::message_t> &replyMsgs);
+
+	/// Updates the statistics and publishes the telemetry
+	void consumeStats(const std::vector<zmq::message_t> &recvMsgs, const std::vector<zmq::message_t> &replyMsgs,
+					  const ZeroMQServerStats &serverStats);
 
 	/// Processes new messages
 	void update();
 
-	/// Main thread function
-	void threadFunc(const std::stop_token &stopToken) noexcept;
+	/// Forwards a new message to an idle worker
+	void dispatchMessages();
+
+	/// Forwards the replies of the workers to the clients
+	void forwardReplies();
+
+	/// Worker thread function
+	void workerFunc(const std::stop_token &stopToken, size_t workerIdx) noexcept;
 
   public:
 	/**
-	 * Constructor for server
+	 * Constructor for server in the shared context of the process, see ZeroMQSharedContext
 	 * @param[in] hostAddr Host address to connect. Can be anything supported by ZeroMQ reply socket
 	 * @param[in] checkFlag Flag to check if the server is running
 	 * @param[in] reg Prometheus registry for stats
 	 * @param[in] prependName Prefix for Prometheus stats
+	 * @param[in] nWorkers Number of worker threads. If zero, a reply socket is used and messages are processed one by
+	 * one by the server thread. Otherwise a router socket is used and messages are processed concurrently by workers
+	 * @param[in] curveKeys CURVE keys of the server. If set, only the clients with an authorised key are accepted
+	 * @param[in] authorizedKeysPath File of the authorised client keys, reloaded when it is written
 	 */
 	ZeroMQServer(const std::string &hostAddr, std::shared_ptr<std::atomic_flag> checkFlag,
-				 const std::shared_ptr<prometheus::Registry> &reg = nullptr, const std::string &prependName = "");
+				 const std::shared_ptr<prometheus::Registry> &reg = nullptr, const std::string &prependName = "",
+				 size_t nWorkers = 0, const ZeroMQCurveKeys &curveKeys = {},
+				 const std::filesystem::path &authorizedKeysPath = {});
+
+	/**
+	 * Constructor for server
+	 * @param[in] ctx ZeroMQ context. Only one CURVE server can be created in a context, as the context has a single
+	 * ZAP handler. Other servers need their own contexts
+	 * @param[in] hostAddr Host address to connect. Can be anything supported by ZeroMQ reply socket
+	 * @param[in] checkFlag Flag to check if the server is running
+	 * @param[in] reg Prometheus registry for stats
+	 * @param[in] prependName Prefix for Prometheus stats
+	 * @param[in] nWorkers Number of worker threads. If zero, a reply socket is used and messages are processed one by
+	 * one by the server thread. Otherwise a router socket is used and messages are processed concurrently by workers
+	 * @param[in] curveKeys CURVE keys of the server. If set, only the clients with an authorised key are accepted
+	 * @param[in] authorizedKeysPath File of the authorised client keys, reloaded when it is written
+	 * @throws zmq::error_t If CURVE keys are set and there is already a ZAP handler in the context
+	 */
+	ZeroMQServer(const std::shared_ptr<zmq::context_t> &ctx, const std::string &hostAddr,
+				 std::shared_ptr<std::atomic_flag> checkFlag,
+				 const std::shared_ptr<prometheus::Registry> &reg = nullptr, const std::string &prependName = "",
+				 size_t nWorkers = 0, const ZeroMQCurveKeys &curveKeys = {},
+				 const std::filesystem::path &authorizedKeysPath = {});
 
 	/// @brief Copy constructor
 	ZeroMQServer(const ZeroMQServer & /*unused*/) = delete;
@@ -61,19 +127,50 @@ class ZeroMQServer : private ZeroMQ, private ZeroMQMonitor {
 	/**
 	 * Deconstructor for server
 	 */
-	~ZeroMQServer() override { shutdown(); }
+	~ZeroMQServer() { shutdown(); }
 
 	/**
-	 * Sets the message callback function
+	 * Sets the message callback function. Called concurrently from the worker threads if there are workers
 	 * @param[in] func The message callback function to be set
 	 */
 	void messageCallback(FPTR_MessageCallback func) { _m_messageCallback = std::move(func); }
 
+	/**
+	 * Sets the publisher for the audit records and the metric deltas of the processed commands. Should be set before
+	 * initialise
+	 * @param[in] publisher Telemetry publisher
+	 */
+	void publisher(std::shared_ptr<ZeroMQPublisher> publisher) { _publisher = std::move(publisher); }
+
+	/**
+	 * Gets the reactor serving the server sockets. Other sockets can be registered to serve them from the same thread
+	 * @return ZeroMQReactor& Reactor of the server
+	 */
+	ZeroMQReactor &reactor() { return _reactor; }
+
+	/**
+	 * Gets the context of the server. Clients of inproc addresses should be created in the same context
+	 * @return const std::shared_ptr<zmq::context_t>& Context of the server
+	 */
+	[[nodiscard]] const std::shared_ptr<zmq::context_t> &context() const { return getContext(); }
+
+	/**
+	 * Gets the authenticator of the CURVE clients
+	 * @return ZeroMQAuthenticator* Authenticator, null if the server is not secured with CURVE
+	 */
+	[[nodiscard]] ZeroMQAuthenticator *authenticator() const { return _authenticator.get(); }
+
 	/**
 	 * Gets the message callback function
 	 * @return The message callback function
 	 */
 	[[nodiscard]] FPTR_MessageCallback messageCallback() const { return _m_messageCallback; }
+
+	/**
+	 * Gets the number of connected peers, counted while the server is running
+	 * @return int Number of connected peers
+	 */
+	using ZeroMQMonitor::getPeerCount;
 };
 
 /**
@@ -1,26 +1,42 @@
 #pragma once
 
+#include "metrics/LatencyHistogram.hpp"
 #include "utils/BaseServerStats.hpp"
+#include "utils/TscClock.hpp"
 
 #include <prometheus/registry.h>
 #include <zmq.hpp>
 
+#include <shared_mutex>
+#include <unordered_map>
+
 /**
  * @struct ZeroMQServerStats
  * Represents the statistics of a ZeroMQ server connection.
  */
 struct ZeroMQServerStats {
-	std::chrono::high_resolution_clock::time_point processingTimeStart; ///< Processing time start
-	std::chrono::high_resolution_clock::time_point processingTimeEnd;	///< Processing time end
-	bool isSuccessful{false}; ///< Indicates if processing was successful for this connection
+	TscClock::time_point processingTimeStart; ///< Processing time start
+	TscClock::time_point processingTimeEnd;	  ///< Processing time end
+	bool isSuccessful{false};				  ///< Indicates if processing was successful for this connection
 };
 
 /**
  * @class ZeroMQStats
  * Represents the statistics of a ZeroMQ server.
+ *
+ * Statistics can be consumed by several worker threads at the same time. Metrics of the commands are looked up under a
+ * shared lock, and only the first command with a new identifier adds its metrics under an exclusive lock.
  */
 class ZeroMQStats : private BaseServerStats {
   private:
+	/// Metrics of a command
+	struct CommandStats {
+		prometheus::Counter *total{nullptr};			  ///< Number of received commands
+		prometheus::Counter *failed{nullptr};			  ///< Number of failed commands
+		std::unique_ptr<LatencyHistogram> processingTime; ///< Processing time of the command
+	};
+
+	std::shared_ptr<prometheus::Registry> _registry;   ///< Registry of the metrics
 	prometheus::Family<prometheus::Info> *_infoFamily; ///< Information metric family
 	prometheus::Counter *_succeededCommandParts;	   ///< Number of received succeeded message parts
 	prometheus::Counter *_failedCommandParts;		   ///< Number of received failed message parts
@@ -28,6 +44,19 @@ class ZeroMQStats : private BaseServerStats {
 	prometheus::Counter *_totalUploadBytes;			   ///< Total uploaded bytes
 	prometheus::Counter *_totalDownloadBytes;		   ///< Total downloaded bytes
 
+	prometheus::Family<prometheus::Counter> *_commandCountFamily;  ///< Number of received commands by name
+	prometheus::Family<prometheus::Counter> *_commandErrorFamily;  ///< Number of failed commands by name
+	prometheus::Family<prometheus::Histogram> *_commandTimeFamily; ///< Processing time of the commands by name
+	std::shared_mutex _commandStatsGuard;						   ///< Guards the lazily added command metrics
+	std::unordered_map<uint32_t, CommandStats> _commandStats;	   ///< Metrics of the registered commands
+	CommandStats _unknownCommandStats;							   ///< Metrics of the unknown commands
+
+	// Adds the metrics of a command
+	CommandStats makeCommandStats(const std::string &command);
+
+	// Gets the metrics of a command, created on first use for the registered commands, thread-safe
+	CommandStats &commandStats(const std::vector<zmq::message_t> &recvMsgs);
+
   public:
 	/**
 	 * Construct a new ZeroMQStats object.
@@ -1,9 +1,9 @@
 #include "connection/RawSocket.hpp"
 
 #include "utils/ErrorHelpers.hpp"
+#include "utils/TscClock.hpp"
 
 #include <algorithm>
-#include <chrono>
 #include <cstring>
 #include <format>
 #include <ios>
@@ -73,11 +73,13 @@ int RawSocket::writeData(const unsigned char *data, size_t dataLen)
 		return -EPERM;
 	}
 
-	auto startTime = std::chrono::high_resolution_clock::now();
-	const auto retval = static_cast<int>(write(_sockFd, data, dataLen));
+	int retval = 0;
+	{
+		const ScopedTimer timer(_stats.processingTime);
+		retval = static_cast<int>(write(_sockFd, data, dataLen));
+	}
 
 	// Update stats
-	_stats.processingTime += static_cast<double>((std::chrono::high_resolution_clock::now() - startTime).count());
 	if (retval > 0)
 	{
 		_stats.sentBytes += static_cast<size_t>(retval);
@@ -95,12 +97,13 @@ int RawSocket::readData(unsigned char *data, size_t dataLen)
 	// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
 	socklen_t socketLen = sizeof(_addr);
 
-	auto startTime = std::chrono::high_resolution_clock::now();
-	const auto retval =
-		static_cast<int>(recvfrom(_sockFd, data, dataLen, 0, std::bit_cast<sockaddr *>(&_addr), &socketLen));
+	int retval = 0;
+	{
+		const ScopedTimer timer(_stats.processingTime);
+		retval = static_cast<int>(recvfrom(_sockFd, data, dataLen, 0, std::bit_cast<sockaddr *>(&_addr), &socketLen));
+	}
 
 	// Update stats
-	_stats.processingTime += static_cast<double>((std::chrono::high_resolution_clock::now() - startTime).count());
 	if (retval > 0)
 	{
 		_stats.receivedBytes += static_cast<size_t>(retval);
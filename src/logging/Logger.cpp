@@ -31,6 +31,7 @@ MainLogger::MainLogger(const std::string &lokiAddr, const std::string &sentryAdd
 	dupFilter->add_sink(std::make_shared<spdlog::sinks::sentry_api_sink_mt>(sentryAddr));
 
 	// Register main logger
+	_mainSink = dupFilter;
 	_mainLogger = std::make_shared<spdlog::logger>(PROJECT_NAME, dupFilter);
 
 	spdlog::set_default_logger(_mainLogger);
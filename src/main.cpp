@@ -6,12 +6,18 @@
 #include "utils/ErrorHelpers.hpp"
 #include "utils/InputParser.hpp"
 #include "utils/Tracer.hpp"
+#include "utils/TscClock.hpp"
+#include "zeromq/ZeroMQContext.hpp"
+#include "zeromq/ZeroMQPublisher.hpp"
 #include "zeromq/ZeroMQServer.hpp"
 
 #include <curl/curl.h>
+#include <sched.h>
 #include <spdlog/spdlog.h>
 
 #include <csignal>
+#include <format>
+#include <sstream>
 
 // SIGALRM interval in seconds
 constexpr uintmax_t alarmInterval = 30;
@@ -98,6 +104,16 @@ int main(int argc, char **argv)
 		spdlog::debug("{} = {}", entry.first, entry.second);
 	}
 
+	// Calibrate the clock of the performance metrics before the servers start
+	if (TscClock::isTscUsed())
+	{
+		spdlog::info("Performance metrics use TSC clock at {:.0f} MHz", TscClock::tscFrequency() / 1e6);
+	}
+	else
+	{
+		spdlog::warn("Invariant TSC is not available, performance metrics use steady clock");
+	}
+
 	// Register interrupt signal handler
 	if (std::signal(SIGINT, interruptFunc) == SIG_ERR)
 	{
@@ -149,8 +165,82 @@ int main(int argc, char **argv)
 	vCheckFlag.emplace_back("Self Monitor", std::make_shared<std::atomic_flag>(false));
 	if (mainPrometheusServer)
 	{
+		auto updateInterval = PROCESS_METRICS_DEFAULT_INTERVAL;
+		if (const std::string interval = config.get("PROCESS_METRICS_INTERVAL_MS"); !interval.empty())
+		{
+			updateInterval = std::chrono::milliseconds(std::stoul(interval));
+		}
 		selfMonitor = std::make_unique<ProcessMetrics>(vCheckFlag[vCheckFlag.size() - 1].second,
-													   mainPrometheusServer->createNewRegistry());
+													   mainPrometheusServer->createNewRegistry(),
+													   config.get("PROCESS_PERF_COUNTERS") == "1", updateInterval);
+	}
+
+	// Configure the ZeroMQ context shared by the publisher and the server
+	try
+	{
+		ZeroMQContextOptions contextOptions;
+		if (const std::string ioThreads = config.get("ZEROMQ_IO_THREADS"); !ioThreads.empty())
+		{
+			contextOptions.ioThreads = std::stoi(ioThreads);
+		}
+		// Comma separated list of CPUs
+		std::istringstream affinityStream(config.get("ZEROMQ_IO_THREAD_AFFINITY"));
+		for (std::string cpu; std::getline(affinityStream, cpu, ',');)
+		{
+			contextOptions.cpuAffinity.push_back(std::stoi(cpu));
+		}
+		if (const std::string schedPolicy = config.get("ZEROMQ_IO_THREAD_SCHED_POLICY"); schedPolicy == "fifo")
+		{
+			contextOptions.schedPolicy = SCHED_FIFO;
+		}
+		else if (schedPolicy == "rr")
+		{
+			contextOptions.schedPolicy = SCHED_RR;
+		}
+		else if (schedPolicy == "other")
+		{
+			contextOptions.schedPolicy = SCHED_OTHER;
+		}
+		if (const std::string priority = config.get("ZEROMQ_IO_THREAD_PRIORITY"); !priority.empty())
+		{
+			contextOptions.schedPriority = std::stoi(priority);
+		}
+
+		if (!configureZeroMQContext(contextOptions))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception &e)
+	{
+		spdlog::error("Can't configure ZeroMQ context: {}", e.what());
+		return EXIT_FAILURE;
+	}
+
+	// Initialize ZeroMQ telemetry publisher
+	std::shared_ptr<ZeroMQPublisher> zmqPublisher(nullptr);
+	const std::string zeromqPublisherAddr = input.getCmdOption("--enable-zeromq-publisher");
+	if (!zeromqPublisherAddr.empty())
+	{
+		try
+		{
+			ZeroMQPublisherOptions publisherOptions;
+			publisherOptions.isXPub = true;
+			if (const std::string publisherHwm = config.get("ZEROMQ_PUBLISHER_HWM"); !publisherHwm.empty())
+			{
+				publisherOptions.sendHwm = std::stoi(publisherHwm);
+			}
+			publisherOptions.conflate = config.get("ZEROMQ_PUBLISHER_CONFLATE") == "1";
+
+			zmqPublisher = std::make_shared<ZeroMQPublisher>(zeromqPublisherAddr, publisherOptions);
+			zmqPublisher->initialise();
+			logger.addSink(std::make_shared<spdlog::sinks::zeromq_publisher_sink_mt>(zmqPublisher));
+		}
+		catch (const std::exception &e)
+		{
+			spdlog::error("Can't start ZeroMQ Publisher: {}", e.what());
+			return EXIT_FAILURE;
+		}
 	}
 
 	// Initialize ZeroMQ server
@@ -161,10 +251,17 @@ int main(int argc, char **argv)
 	{
 		try
 		{
+			const std::string zeromqWorkers = config.get("ZEROMQ_WORKERS");
+			const ZeroMQCurveKeys curveKeys{.publicKey = config.get("ZEROMQ_CURVE_PUBLIC_KEY"),
+											.secretKey = config.get("ZEROMQ_CURVE_SECRET_KEY"),
+											.serverKey = ""};
 			zmqController = std::make_unique<ZeroMQServer>(
 				zeromqServerAddr, vCheckFlag[vCheckFlag.size() - 1].second,
-				mainPrometheusServer ? mainPrometheusServer->createNewRegistry() : nullptr);
+				mainPrometheusServer ? mainPrometheusServer->createNewRegistry() : nullptr, "",
+				zeromqWorkers.empty() ? 0 : std::stoul(zeromqWorkers), curveKeys,
+				config.get("ZEROMQ_CURVE_AUTHORIZED_KEYS"));
 			zmqController->messageCallback(ZeroMQServerMessageCallback);
+			zmqController->publisher(zmqPublisher);
 			zmqController->initialise();
 		}
 		catch (const std::exception &e)
@@ -200,6 +297,27 @@ int main(int argc, char **argv)
 			telnetController->connectedCallback(TelnetConnectedCallback);
 			telnetController->newLineCallback(TelnetMessageCallback);
 			telnetController->tabCallback(TelnetTabCallback);
+			if (zmqPublisher)
+			{
+				telnetController->auditCallback(
+					[zmqPublisher](const std::string &peerIP, const std::string &line, bool isSucceeded) {
+						zmqPublisher->publishAudit(
+							"telnet", std::format("{} {} {}", peerIP, isSucceeded ? "succeeded" : "failed", line));
+						zmqPublisher->publishMetric(
+							isSucceeded ? "telnet.succeeded_commands" : "telnet.failed_commands", 1);
+					});
+			}
+
+			// Serve over TLS if a certificate is configured
+			if (const std::string tlsCert = config.get("TELNET_TLS_CERT"); !tlsCert.empty())
+			{
+				if (!telnetController->initialiseTLS(tlsCert, config.get("TELNET_TLS_KEY")))
+				{
+					throw std::invalid_argument("Can't initialise TLS");
+				}
+				spdlog::info("Telnet server uses TLS");
+			}
+
 			telnetController->initialise(telnetPort, vCheckFlag[vCheckFlag.size() - 1].second, "> ",
 										 mainPrometheusServer ? mainPrometheusServer->createNewRegistry() : nullptr);
 		}
@@ -0,0 +1,212 @@
+#include "metrics/LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+// Number of linear sub-buckets of every power of two
+constexpr uint64_t LATENCY_HISTOGRAM_SUB_BUCKETS = uint64_t{1} << LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+// Index of the overflow bucket
+constexpr size_t LATENCY_HISTOGRAM_OVERFLOW_IDX = LATENCY_HISTOGRAM_BUCKETS - 1;
+
+namespace
+{
+	std::atomic_size_t nextShardIdx{0};
+
+	// Lowest value of a bucket, in the offset values the buckets are indexed with
+	uint64_t bucketLowerBound(size_t idx)
+	{
+		if (idx < 2 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+		{
+			return idx;
+		}
+		const uint64_t mantissa = (idx % LATENCY_HISTOGRAM_SUB_BUCKETS) + LATENCY_HISTOGRAM_SUB_BUCKETS;
+		return mantissa << (idx / LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+	}
+} // namespace
+
+size_t threadShardIndex()
+{
+	thread_local const size_t shardIdx = nextShardIdx.fetch_add(1, std::memory_order_relaxed);
+	return shardIdx;
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value)
+{
+	// Values are offset by one, so the upper bounds of the buckets are powers of two and their multiples
+	const uint64_t offsetValue = value == 0 ? 0 : value - 1;
+	if (offsetValue < 2 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+	{
+		return offsetValue;
+	}
+
+	const auto exponent = static_cast<size_t>(std::bit_width(offsetValue) - 1);
+	if (exponent >= LATENCY_HISTOGRAM_MAX_EXPONENT)
+	{
+		return LATENCY_HISTOGRAM_OVERFLOW_IDX;
+	}
+	const size_t shift = exponent - LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+	return ((shift + 1) << LATENCY_HISTOGRAM_SUB_BUCKET_BITS) +
+		   static_cast<size_t>((offsetValue >> shift) - LATENCY_HISTOGRAM_SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t idx)
+{
+	return bucketLowerBound(std::min(idx + 1, LATENCY_HISTOGRAM_OVERFLOW_IDX));
+}
+
+prometheus::Histogram::BucketBoundaries LatencyHistogram::bucketBoundaries(uint64_t lowestBoundary,
+																		   uint64_t highestBoundary)
+{
+	const auto lowestExponent =
+		std::min<size_t>(std::bit_width(std::max<uint64_t>(lowestBoundary, 1) - 1), LATENCY_HISTOGRAM_MAX_EXPONENT);
+	const auto highestExponent = std::clamp<size_t>(std::bit_width(std::max<uint64_t>(highestBoundary, 1) - 1),
+													lowestExponent, LATENCY_HISTOGRAM_MAX_EXPONENT);
+
+	prometheus::Histogram::BucketBoundaries boundaries;
+	for (size_t exponent = lowestExponent; exponent < highestExponent; ++exponent)
+	{
+		boundaries.push_back(static_cast<double>(uint64_t{1} << exponent));
+		if (exponent > 0)
+		{
+			boundaries.push_back(static_cast<double>(uint64_t{3} << (exponent - 1)));
+		}
+	}
+	boundaries.push_back(static_cast<double>(uint64_t{1} << highestExponent));
+	return boundaries;
+}
+
+LatencyHistogram::LatencyHistogram() : _shards(std::make_unique<Shard[]>(LATENCY_HISTOGRAM_SHARDS)) {}
+
+LatencyHistogram::LatencyHistogram(const std::shared_ptr<prometheus::Registry> &reg,
+								   prometheus::Family<prometheus::Histogram> &family, const prometheus::Labels &labels,
+								   uint64_t lowestBoundary, uint64_t highestBoundary)
+	: _shards(std::make_unique<Shard[]>(LATENCY_HISTOGRAM_SHARDS)),
+	  _boundaries(bucketBoundaries(lowestBoundary, highestBoundary)), _exportedCounts(LATENCY_HISTOGRAM_BUCKETS, 0)
+{
+	// Callback may run on a concurrent scrape as soon as it is added, so the members are set before
+	_metric = &family.Add(labels, _boundaries);
+	_observeOnRecord = std::dynamic_pointer_cast<ScrapeRegistry>(reg) == nullptr;
+	_scrapeCallback = std::make_unique<ScrapeCallback>(reg, [this] { exportMetric(); });
+}
+
+uint64_t LatencyHistogram::bucketCount(size_t idx) const
+{
+	uint64_t total = 0;
+	for (size_t shardIdx = 0; shardIdx < LATENCY_HISTOGRAM_SHARDS; ++shardIdx)
+	{
+		total += _shards[shardIdx].buckets[idx].load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+	auto &shard = _shards[threadShardIndex() % LATENCY_HISTOGRAM_SHARDS];
+	shard.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+	if (_observeOnRecord)
+	{
+		_metric->Observe(static_cast<double>(value));
+	}
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+	auto &shard = _shards[threadShardIndex() % LATENCY_HISTOGRAM_SHARDS];
+	for (size_t idx = 0; idx < LATENCY_HISTOGRAM_BUCKETS; ++idx)
+	{
+		if (const uint64_t otherCount = other.bucketCount(idx); otherCount > 0)
+		{
+			shard.buckets[idx].fetch_add(otherCount, std::memory_order_relaxed);
+		}
+	}
+	shard.sum.fetch_add(other.sum(), std::memory_order_relaxed);
+}
+
+void LatencyHistogram::exportMetric()
+{
+	if (_metric == nullptr || _observeOnRecord)
+	{
+		return;
+	}
+
+	const std::scoped_lock guard(_exportLock);
+
+	// Values recorded during the export may be split between this export and the next one
+	bool isUpdated = false;
+	std::vector<double> increments(_boundaries.size() + 1, 0);
+	for (size_t idx = 0; idx < LATENCY_HISTOGRAM_BUCKETS; ++idx)
+	{
+		const uint64_t total = bucketCount(idx);
+		if (total == _exportedCounts[idx])
+		{
+			continue;
+		}
+
+		// Boundaries are bucket upper bounds, so every bucket is exported to a single metric bucket
+		const auto boundaryItr = std::ranges::lower_bound(_boundaries, static_cast<double>(bucketUpperBound(idx)));
+		const size_t metricIdx = idx == LATENCY_HISTOGRAM_OVERFLOW_IDX
+									 ? _boundaries.size()
+									 : static_cast<size_t>(boundaryItr - _boundaries.begin());
+		increments[metricIdx] += static_cast<double>(total - _exportedCounts[idx]);
+		_exportedCounts[idx] = total;
+		isUpdated = true;
+	}
+
+	if (isUpdated)
+	{
+		const uint64_t total = sum();
+		_metric->ObserveMultiple(increments, static_cast<double>(total - _exportedSum));
+		_exportedSum = total;
+	}
+}
+
+uint64_t LatencyHistogram::count() const
+{
+	uint64_t total = 0;
+	for (size_t idx = 0; idx < LATENCY_HISTOGRAM_BUCKETS; ++idx)
+	{
+		total += bucketCount(idx);
+	}
+	return total;
+}
+
+uint64_t LatencyHistogram::sum() const
+{
+	uint64_t total = 0;
+	for (size_t shardIdx = 0; shardIdx < LATENCY_HISTOGRAM_SHARDS; ++shardIdx)
+	{
+		total += _shards[shardIdx].sum.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+uint64_t LatencyHistogram::quantile(double quantile) const
+{
+	std::array<uint64_t, LATENCY_HISTOGRAM_BUCKETS> counts{};
+	uint64_t total = 0;
+	for (size_t idx = 0; idx < LATENCY_HISTOGRAM_BUCKETS; ++idx)
+	{
+		counts[idx] = bucketCount(idx);
+		total += counts[idx];
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	const auto rank = std::max<uint64_t>(
+		static_cast<uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * static_cast<double>(total))), 1);
+	uint64_t cumulative = 0;
+	for (size_t idx = 0; idx < LATENCY_HISTOGRAM_BUCKETS; ++idx)
+	{
+		cumulative += counts[idx];
+		if (cumulative >= rank)
+		{
+			return bucketUpperBound(idx);
+		}
+	}
+	return bucketUpperBound(LATENCY_HISTOGRAM_OVERFLOW_IDX);
+}
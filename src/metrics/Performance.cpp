@@ -1,21 +1,33 @@
 #include "metrics/Performance.hpp"
 
+#include <algorithm>
 #include <format>
 
 #include <prometheus/gauge.h>
-#include <prometheus/summary.h>
+#include <prometheus/histogram.h>
 
-#define QUANTILE_DEFAULTS                                                                                              \
-	prometheus::Summary::Quantiles { {0.5, 0.1}, {0.9, 0.1}, {0.99, 0.1} }
+thread_local PerformanceSpan *PerformanceSpan::_currentSpan = nullptr;
 
-PerformanceTracker::PerformanceTracker(const std::shared_ptr<prometheus::Registry> &reg, const std::string &name,
-									   uint64_t metricID)
+PerformanceSpan::PerformanceSpan() : _parent(_currentSpan) { _currentSpan = this; }
+
+void PerformanceSpan::finish(std::chrono::nanoseconds totalTime)
+{
+	if (_parent != nullptr)
+	{
+		_parent->_childTime += totalTime;
+	}
+	_currentSpan = _parent;
+}
+
+template <typename Clock>
+BasicPerformanceTracker<Clock>::BasicPerformanceTracker(const std::shared_ptr<prometheus::Registry> &reg,
+														const std::string &name, uint64_t metricID)
 {
-	_perfTiming = &prometheus::BuildSummary()
-					   .Name(std::format("{}{}{}", name, "_processing_time_", metricID))
-					   .Help(name + " processing performance")
-					   .Register(*reg)
-					   .Add({}, QUANTILE_DEFAULTS);
+	auto &perfFamily = prometheus::BuildHistogram()
+						   .Name(std::format("{}{}{}", name, "_processing_time_", metricID))
+						   .Help(name + " processing performance")
+						   .Register(*reg);
+	_perfTiming = std::make_unique<LatencyHistogram>(reg, perfFamily);
 	_maxTiming = &prometheus::BuildGauge()
 					  .Name(std::format("{}{}{}", name, "_maximum_processing_time_", metricID))
 					  .Help("Maximum value of the " + name + " processing performance")
@@ -27,24 +39,60 @@ PerformanceTracker::PerformanceTracker(const std::shared_ptr<prometheus::Registr
 					  .Register(*reg)
 					  .Add({});
 
+	auto &selfFamily = prometheus::BuildHistogram()
+						   .Name(std::format("{}{}{}", name, "_self_processing_time_", metricID))
+						   .Help(name + " processing performance without the nested spans")
+						   .Register(*reg);
+	_selfTiming = std::make_unique<LatencyHistogram>(reg, selfFamily);
+
 	_minTiming->Set(std::numeric_limits<int>::max());
-}
 
-void PerformanceTracker::startTimer() { _startTime = std::chrono::high_resolution_clock::now(); }
+	// Extremes are only exported when scraped if the registry supports it
+	_scrapeCallback = std::make_unique<ScrapeCallback>(reg, [this] { exportExtremes(); });
+	_exportOnRecord = !_scrapeCallback->isRegistered();
+}
 
-double PerformanceTracker::endTimer()
+template <typename Clock>
+void BasicPerformanceTracker<Clock>::record(std::chrono::nanoseconds totalTime, std::chrono::nanoseconds selfTime)
 {
-	const auto val = static_cast<double>((std::chrono::high_resolution_clock::now() - _startTime).count());
+	const auto value = static_cast<uint64_t>(std::max<int64_t>(totalTime.count(), 0));
+	_perfTiming->record(value);
+	_selfTiming->record(static_cast<uint64_t>(std::max<int64_t>(selfTime.count(), 0)));
+
+	uint64_t current = _minValue.load(std::memory_order_relaxed);
+	while (value < current && !_minValue.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+	current = _maxValue.load(std::memory_order_relaxed);
+	while (value > current && !_maxValue.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
 
-	_perfTiming->Observe(val);
-	if (val < _minTiming->Value())
+	if (_exportOnRecord)
 	{
-		_minTiming->Set(val);
+		exportExtremes();
 	}
-	if (val > _maxTiming->Value())
+}
+
+template <typename Clock> void BasicPerformanceTracker<Clock>::exportExtremes()
+{
+	const uint64_t minValue = _minValue.load(std::memory_order_relaxed);
+	if (minValue <= _maxValue.load(std::memory_order_relaxed))
 	{
-		_maxTiming->Set(val);
+		_minTiming->Set(static_cast<double>(minValue));
+		_maxTiming->Set(static_cast<double>(_maxValue.load(std::memory_order_relaxed)));
 	}
+}
+
+template <typename Clock> void BasicPerformanceTracker<Clock>::startTimer() { _startTime = Clock::now(); }
 
-	return val;
+template <typename Clock> double BasicPerformanceTracker<Clock>::endTimer()
+{
+	const auto elapsedTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _startTime);
+
+	record(elapsedTime, elapsedTime);
+	return static_cast<double>(elapsedTime.count());
 }
+
+template class BasicPerformanceTracker<TscClock>;
+template class BasicPerformanceTracker<std::chrono::steady_clock>;
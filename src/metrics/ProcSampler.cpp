@@ -0,0 +1,318 @@
+#include "metrics/ProcSampler.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+	// Sampled fields of /proc/[pid]/stat in order, numbered as in proc(5)
+	constexpr std::array<std::pair<size_t, uint64_t ProcSample::*>, 5> PROC_STAT_FIELDS = {{
+		{10, &ProcSample::minorFaults},
+		{12, &ProcSample::majorFaults},
+		{14, &ProcSample::userTicks},
+		{15, &ProcSample::systemTicks},
+		{20, &ProcSample::threadCount},
+	}};
+	// Number of the field following the command name
+	constexpr size_t PROC_STAT_FIRST_FIELD_AFTER_COMMAND = 3;
+
+	// Parses the decimal number at the position and moves past it, returns false if there is no digit
+	bool scanNumber(std::string_view content, size_t &pos, uint64_t &value)
+	{
+		const size_t start = pos;
+		value = 0;
+		while (pos < content.size() && content[pos] >= '0' && content[pos] <= '9')
+		{
+			value = value * 10 + static_cast<uint64_t>(content[pos] - '0');
+			++pos;
+		}
+		return pos > start;
+	}
+
+	// Finds the value of a "key: value" line and parses it, spaces and tabs before the value are skipped
+	bool scanKey(std::string_view content, std::string_view key, uint64_t &value)
+	{
+		for (size_t pos = 0; pos < content.size();)
+		{
+			if (content.compare(pos, key.size(), key) == 0)
+			{
+				pos += key.size();
+				while (pos < content.size() && (content[pos] == ' ' || content[pos] == '\t'))
+				{
+					++pos;
+				}
+				return scanNumber(content, pos, value);
+			}
+
+			pos = content.find('\n', pos);
+			if (pos == std::string_view::npos)
+			{
+				break;
+			}
+			++pos;
+		}
+		return false;
+	}
+} // namespace
+
+ProcSampler::ProcSampler()
+	: _statFd(open("/proc/self/stat", O_RDONLY | O_CLOEXEC)), _ioFd(open("/proc/self/io", O_RDONLY | O_CLOEXEC)),
+	  _statusFd(open("/proc/self/status", O_RDONLY | O_CLOEXEC)),
+	  _fdDirFd(open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC)),
+	  _taskDirFd(open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC))
+{
+}
+
+std::string_view ProcSampler::readFile(int fd)
+{
+	if (fd < 0)
+	{
+		return {};
+	}
+
+	// Files are generated on read, so they are read at once from the beginning
+	const ssize_t nRead = pread(fd, _buffer.data(), _buffer.size(), 0);
+	if (nRead <= 0)
+	{
+		return {};
+	}
+	return {_buffer.data(), static_cast<size_t>(nRead)};
+}
+
+uint64_t ProcSampler::countFileDescriptors()
+{
+	if (_fdDirFd < 0 || lseek(_fdDirFd, 0, SEEK_SET) != 0)
+	{
+		return 0;
+	}
+
+	uint64_t count = 0;
+	long nRead = 0;
+	while ((nRead = syscall(SYS_getdents64, _fdDirFd, _buffer.data(), _buffer.size())) > 0)
+	{
+		for (long pos = 0; pos < nRead;)
+		{
+			const auto *entry = reinterpret_cast<const dirent64 *>(&_buffer[static_cast<size_t>(pos)]);
+			if (entry->d_name[0] != '.')
+			{
+				++count;
+			}
+			pos += entry->d_reclen;
+		}
+	}
+
+	// Descriptors of the sampler are not counted
+	uint64_t ownCount = 0;
+	for (const int fd : {_statFd, _ioFd, _statusFd, _fdDirFd, _taskDirFd})
+	{
+		ownCount += fd >= 0 ? 1 : 0;
+	}
+	for (const auto &[threadId, files] : _threadFiles)
+	{
+		for (const int fd : {files.statFd, files.statusFd, files.schedstatFd})
+		{
+			ownCount += fd >= 0 ? 1 : 0;
+		}
+	}
+	return count > ownCount ? count - ownCount : 0;
+}
+
+void ProcSampler::listThreads()
+{
+	_threadIds.clear();
+	if (_taskDirFd < 0 || lseek(_taskDirFd, 0, SEEK_SET) != 0)
+	{
+		return;
+	}
+
+	long nRead = 0;
+	while ((nRead = syscall(SYS_getdents64, _taskDirFd, _buffer.data(), _buffer.size())) > 0)
+	{
+		for (long pos = 0; pos < nRead;)
+		{
+			const auto *entry = reinterpret_cast<const dirent64 *>(&_buffer[static_cast<size_t>(pos)]);
+			const std::string_view name(&entry->d_name[0]);
+			if (pid_t threadId = 0;
+				std::from_chars(name.data(), name.data() + name.size(), threadId).ec == std::errc{} && threadId > 0)
+			{
+				_threadIds.push_back(threadId);
+			}
+			pos += entry->d_reclen;
+		}
+	}
+}
+
+void ProcSampler::closeThreadFiles(const ThreadFiles &files)
+{
+	for (const int fd : {files.statFd, files.statusFd, files.schedstatFd})
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+}
+
+bool ProcSampler::parseStat(std::string_view content, ProcSample &sample)
+{
+	// Command name is in parentheses and may contain spaces or parentheses itself
+	const size_t commandEnd = content.rfind(')');
+	if (commandEnd == std::string_view::npos)
+	{
+		return false;
+	}
+
+	size_t pos = commandEnd + 1;
+	size_t field = PROC_STAT_FIRST_FIELD_AFTER_COMMAND;
+	for (const auto &[sampledField, member] : PROC_STAT_FIELDS)
+	{
+		for (; field < sampledField; ++field)
+		{
+			pos = content.find(' ', pos + 1);
+			if (pos == std::string_view::npos)
+			{
+				return false;
+			}
+		}
+
+		++pos;
+		if (!scanNumber(content, pos, sample.*member))
+		{
+			return false;
+		}
+		++field;
+	}
+	return true;
+}
+
+bool ProcSampler::parseThreadStat(std::string_view content, ThreadSample &sample)
+{
+	const size_t commandBegin = content.find('(');
+	const size_t commandEnd = content.rfind(')');
+	ProcSample values;
+	if (commandBegin == std::string_view::npos || commandEnd == std::string_view::npos || commandEnd < commandBegin ||
+		!parseStat(content, values))
+	{
+		return false;
+	}
+
+	sample.name.assign(content.substr(commandBegin + 1, commandEnd - commandBegin - 1));
+	sample.userTicks = values.userTicks;
+	sample.systemTicks = values.systemTicks;
+	return true;
+}
+
+bool ProcSampler::parseThreadStatus(std::string_view content, ThreadSample &sample)
+{
+	return scanKey(content, "voluntary_ctxt_switches:", sample.voluntarySwitches) &&
+		   scanKey(content, "nonvoluntary_ctxt_switches:", sample.involuntarySwitches);
+}
+
+bool ProcSampler::parseSchedstat(std::string_view content, ThreadSample &sample)
+{
+	// Time on the CPU, time waiting on a run queue and number of time slices
+	size_t pos = content.find(' ');
+	if (pos == std::string_view::npos)
+	{
+		return false;
+	}
+	++pos;
+	return scanNumber(content, pos, sample.runQueueWaitNs);
+}
+
+bool ProcSampler::parseIo(std::string_view content, ProcSample &sample)
+{
+	return scanKey(content, "read_bytes:", sample.readBytes) && scanKey(content, "write_bytes:", sample.writeBytes);
+}
+
+bool ProcSampler::parseStatus(std::string_view content, ProcSample &sample)
+{
+	return scanKey(content, "VmHWM:", sample.peakResidentKb) && scanKey(content, "VmRSS:", sample.residentKb);
+}
+
+bool ProcSampler::sample(ProcSample &values)
+{
+	const bool isSampled = parseStat(readFile(_statFd), values);
+	parseIo(readFile(_ioFd), values);
+	parseStatus(readFile(_statusFd), values);
+	values.fileDescriptorCount = countFileDescriptors();
+	return isSampled;
+}
+
+bool ProcSampler::sampleThreads(std::vector<ThreadSample> &values)
+{
+	values.clear();
+	listThreads();
+	if (_threadIds.empty())
+	{
+		return false;
+	}
+
+	// Files of the exited threads are closed
+	std::erase_if(_threadFiles, [this](const auto &entry) {
+		if (std::ranges::find(_threadIds, entry.first) != _threadIds.end())
+		{
+			return false;
+		}
+		closeThreadFiles(entry.second);
+		return true;
+	});
+
+	for (const pid_t threadId : _threadIds)
+	{
+		auto itr = _threadFiles.find(threadId);
+		if (itr == _threadFiles.end())
+		{
+			const auto openFile = [this, threadId](const char *file) {
+				const std::string path = std::format("{}/{}", threadId, file);
+				return openat(_taskDirFd, path.c_str(), O_RDONLY | O_CLOEXEC);
+			};
+			ThreadFiles files{.statFd = openFile("stat"),
+							  .statusFd = openFile("status"),
+							  .schedstatFd = openFile("schedstat")};
+			if (files.statFd < 0)
+			{
+				// Thread exited after listing
+				closeThreadFiles(files);
+				continue;
+			}
+			itr = _threadFiles.emplace(threadId, files).first;
+		}
+
+		ThreadSample sample;
+		sample.threadId = threadId;
+		if (!parseThreadStat(readFile(itr->second.statFd), sample))
+		{
+			// Descriptors may belong to an exited task whose ID is reused, they are reopened on the next sample
+			closeThreadFiles(itr->second);
+			_threadFiles.erase(itr);
+			continue;
+		}
+		parseThreadStatus(readFile(itr->second.statusFd), sample);
+		parseSchedstat(readFile(itr->second.schedstatFd), sample);
+		values.push_back(std::move(sample));
+	}
+	return true;
+}
+
+ProcSampler::~ProcSampler()
+{
+	for (const auto &[threadId, files] : _threadFiles)
+	{
+		closeThreadFiles(files);
+	}
+	for (const int fd : {_statFd, _ioFd, _statusFd, _fdDirFd, _taskDirFd})
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+}
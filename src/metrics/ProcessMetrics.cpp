@@ -1,113 +1,280 @@
 #include "metrics/ProcessMetrics.hpp"
 
-#include "utils/FileHelpers.hpp"
-
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
 #include <dirent.h>
-#include <sys/resource.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+	/// Definition of a perf event counter
+	struct PerfEventInfo {
+		uint32_t type;	  ///< Type of the event
+		uint64_t config;  ///< Event of the type
+		const char *name; ///< Name of the rate metric
+		const char *help; ///< Description of the rate metric
+	};
+
+	// Indexed by PerfCounterType
+	constexpr std::array<PerfEventInfo, PERF_COUNTER_COUNT> PERF_EVENTS = {{
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "perf_cycles_rate", "CPU cycles per second of application"},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "perf_instructions_rate",
+		 "Retired instructions per second of application"},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "perf_cache_misses_rate",
+		 "Last level cache misses per second of application"},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "perf_branch_misses_rate",
+		 "Mispredicted branches per second of application"},
+		{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "perf_context_switches_rate",
+		 "Context switches per second of application"},
+	}};
 
-constexpr int SLEEP_INTERVAL_SEC = 1;
+	/// Values read from a counter with PERF_FORMAT_TOTAL_TIME_ENABLED and PERF_FORMAT_TOTAL_TIME_RUNNING
+	struct PerfReadFormat {
+		uint64_t value;		  ///< Number of events
+		uint64_t timeEnabled; ///< Time the counter is enabled
+		uint64_t timeRunning; ///< Time the counter is on the PMU
+	};
+
+	// Opens a counting event for a thread and the threads it starts, returns -1 on failure
+	int openPerfEvent(const PerfEventInfo &info, pid_t threadId)
+	{
+		perf_event_attr attr{};
+		attr.size = sizeof(attr);
+		attr.type = info.type;
+		attr.config = info.config;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.inherit = 1;
+		// Software events like context switches only occur in the kernel
+		attr.exclude_kernel = info.type == PERF_TYPE_HARDWARE ? 1 : 0;
+		attr.exclude_hv = 1;
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, threadId, -1, -1, PERF_FLAG_FD_CLOEXEC));
+	}
+
+	// Converts CPU times in clock ticks to a percentage of the elapsed seconds
+	double cpuUsage(uint64_t ticks, double elapsed)
+	{
+		static const auto ticksPerSecond = static_cast<double>(sysconf(_SC_CLK_TCK));
+		return elapsed > 0 ? 100.0 * static_cast<double>(ticks) / (elapsed * ticksPerSecond) : 0.0;
+	}
+} // namespace
 
-size_t ProcessMetrics::countDirectoryEntries(const std::filesystem::path &path)
+void ProcessMetrics::initPerfCounters(const std::shared_ptr<prometheus::Registry> &reg)
 {
-	DIR *dir = nullptr;
-	size_t count = 0;
-	if ((dir = opendir(path.c_str())) != nullptr)
+	std::vector<pid_t> threadIds;
+	if (DIR *dir = opendir("/proc/self/task"); dir != nullptr)
 	{
-		while (readdir(dir) != nullptr) // NOLINT(concurrency-mt-unsafe)
+		while (const dirent *entry = readdir(dir)) // NOLINT(concurrency-mt-unsafe)
 		{
-			++count;
+			if (entry->d_name[0] != '.')
+			{
+				threadIds.push_back(static_cast<pid_t>(std::strtol(&entry->d_name[0], nullptr, 10)));
+			}
 		}
 		closedir(dir);
 	}
 
-	return count;
-}
+	for (size_t idx = 0; idx < PERF_COUNTER_COUNT; ++idx)
+	{
+		const auto &info = PERF_EVENTS[idx];
+		auto &counter = _perfCounters[idx];
+		bool isOpened = true;
+		for (const pid_t threadId : threadIds)
+		{
+			// Threads may exit while the counters are opened
+			if (const int fd = openPerfEvent(info, threadId); fd >= 0)
+			{
+				counter.fds.push_back(fd);
+			}
+			else if (errno != ESRCH)
+			{
+				spdlog::warn("Can't open perf counter for {}: {}", info.name, std::strerror(errno));
+				isOpened = false;
+				break;
+			}
+		}
+		if (!isOpened || counter.fds.empty())
+		{
+			for (const int fd : counter.fds)
+			{
+				close(fd);
+			}
+			counter.fds.clear();
+			continue;
+		}
 
-long int ProcessMetrics::getMemoryUsage()
-{
-	struct rusage r_usage{};
-	getrusage(RUSAGE_SELF, &r_usage);
-	return r_usage.ru_maxrss; // NOLINT(cppcoreguidelines-pro-type-union-access)
-}
+		counter.rate = &prometheus::BuildGauge().Name(info.name).Help(info.help).Register(*reg).Add({});
+		counter.oldValue = readPerfCounter(counter);
+	}
 
-long int ProcessMetrics::getPageFaults()
-{
-	struct rusage r_usage{};
-	getrusage(RUSAGE_SELF, &r_usage);
-	return r_usage.ru_majflt; // NOLINT(cppcoreguidelines-pro-type-union-access)
+	if (hasPerfCounter(PerfCounterType::Cycles) && hasPerfCounter(PerfCounterType::Instructions))
+	{
+		_pInstructionsPerCycle = &prometheus::BuildGauge()
+									  .Name("perf_instructions_per_cycle")
+									  .Help("Retired instructions per CPU cycle of application")
+									  .Register(*reg)
+									  .Add({});
+	}
+	_oldPerfTime = std::chrono::steady_clock::now();
 }
 
-double ProcessMetrics::getCpuUsage()
+double ProcessMetrics::readPerfCounter(const PerfCounter &counter)
 {
-	if (_oldCpuTime == 0)
+	double total = 0;
+	for (const int fd : counter.fds)
 	{
-		_oldCpuTime = times(&_oldCpu);
-		if (_oldCpuTime == static_cast<clock_t>(-1))
+		PerfReadFormat values{};
+		if (read(fd, &values, sizeof(values)) != sizeof(values) || values.timeRunning == 0)
 		{
-			_oldCpuTime = 0;
+			continue;
 		}
-		return 0.0;
+
+		// Counters sharing the PMU with others only run for a part of the time
+		total += static_cast<double>(values.value) * static_cast<double>(values.timeEnabled) /
+				 static_cast<double>(values.timeRunning);
 	}
+	return total;
+}
 
-	struct tms nowCpu{};
-	auto nowCpuTime = times(&nowCpu);
+void ProcessMetrics::updatePerfCounters()
+{
+	const auto nowTime = std::chrono::steady_clock::now();
+	const double elapsed = std::chrono::duration<double>(nowTime - _oldPerfTime).count();
+	_oldPerfTime = nowTime;
+	if (elapsed <= 0)
+	{
+		return;
+	}
 
-	const double usage = 100.0 * static_cast<double>(nowCpu.tms_utime - _oldCpu.tms_utime) /
-						 static_cast<double>(nowCpuTime - _oldCpuTime);
+	for (auto &counter : _perfCounters)
+	{
+		if (counter.fds.empty())
+		{
+			continue;
+		}
 
-	std::swap(_oldCpu, nowCpu);
-	std::swap(_oldCpuTime, nowCpuTime);
+		const double value = readPerfCounter(counter);
+		const double rate = std::max(value - counter.oldValue, 0.0) / elapsed;
+		counter.oldValue = value;
+		counter.lastRate = rate;
+		counter.rate->Set(rate);
+	}
 
-	return usage;
+	if (_pInstructionsPerCycle != nullptr)
+	{
+		const double cycles = perfCounterRate(PerfCounterType::Cycles);
+		_pInstructionsPerCycle->Set(cycles > 0 ? perfCounterRate(PerfCounterType::Instructions) / cycles : 0);
+	}
 }
 
-std::pair<size_t, size_t> ProcessMetrics::getDiskIO()
+void ProcessMetrics::removeThreadMetrics(const ThreadMetrics &metrics)
 {
-	std::string buffer;
-	findFromFile("/proc/self/io", "read_bytes", buffer);
-	size_t readBytes = buffer.empty() ? 0 : std::stoull(buffer);
-	if (buffer.empty())
-	{
-		return {};
-	}
+	_threadUserCpuFamily->Remove(metrics.userCpu);
+	_threadSystemCpuFamily->Remove(metrics.systemCpu);
+	_threadRunQueueWaitFamily->Remove(metrics.runQueueWait);
+	_threadVoluntarySwitchFamily->Remove(metrics.voluntarySwitches);
+	_threadInvoluntarySwitchFamily->Remove(metrics.involuntarySwitches);
+}
 
-	buffer.clear();
-	findFromFile("/proc/self/io", "write_bytes", buffer);
-	size_t writeBytes = buffer.empty() ? 0 : std::stoull(buffer);
-	if (buffer.empty())
+void ProcessMetrics::updateThreads(double elapsed)
+{
+	if (!_sampler.sampleThreads(_threadSamples))
 	{
-		return {};
+		return;
 	}
 
-	std::pair<size_t, size_t> result = {readBytes - _oldReadBytes, writeBytes - _oldWriteBytes};
-
-	std::swap(_oldReadBytes, readBytes);
-	std::swap(_oldWriteBytes, writeBytes);
+	// Metrics of the exited threads are removed
+	std::erase_if(_threadMetrics, [this](const auto &entry) {
+		if (std::ranges::find(_threadSamples, entry.first, &ThreadSample::threadId) != _threadSamples.end())
+		{
+			return false;
+		}
+		removeThreadMetrics(entry.second);
+		return true;
+	});
 
-	return result;
-}
+	for (auto &sample : _threadSamples)
+	{
+		auto itr = _threadMetrics.find(sample.threadId);
 
-size_t ProcessMetrics::getThreadCount() { return countDirectoryEntries("/proc/self/task"); }
+		// Threads may be named after they are started
+		if (itr != _threadMetrics.end() && itr->second.oldSample.name != sample.name)
+		{
+			removeThreadMetrics(itr->second);
+			_threadMetrics.erase(itr);
+			itr = _threadMetrics.end();
+		}
+		if (itr == _threadMetrics.end())
+		{
+			const prometheus::Labels labels = {{"thread", sample.name}, {"tid", std::to_string(sample.threadId)}};
+			_threadMetrics.emplace(sample.threadId,
+								   ThreadMetrics{.userCpu = &_threadUserCpuFamily->Add(labels),
+												 .systemCpu = &_threadSystemCpuFamily->Add(labels),
+												 .runQueueWait = &_threadRunQueueWaitFamily->Add(labels),
+												 .voluntarySwitches = &_threadVoluntarySwitchFamily->Add(labels),
+												 .involuntarySwitches = &_threadInvoluntarySwitchFamily->Add(labels),
+												 .oldSample = std::move(sample)});
+			continue;
+		}
 
-size_t ProcessMetrics::getFileDescriptorCount() { return countDirectoryEntries("/proc/self/fd"); }
+		auto &metrics = itr->second;
+		const auto &oldSample = metrics.oldSample;
+		metrics.userCpu->Set(cpuUsage(sample.userTicks - oldSample.userTicks, elapsed));
+		metrics.systemCpu->Set(cpuUsage(sample.systemTicks - oldSample.systemTicks, elapsed));
+		if (elapsed > 0)
+		{
+			metrics.runQueueWait->Set(100.0 * static_cast<double>(sample.runQueueWaitNs - oldSample.runQueueWaitNs) /
+									  (elapsed * std::nano::den));
+			metrics.voluntarySwitches->Set(
+				static_cast<double>(sample.voluntarySwitches - oldSample.voluntarySwitches) / elapsed);
+			metrics.involuntarySwitches->Set(
+				static_cast<double>(sample.involuntarySwitches - oldSample.involuntarySwitches) / elapsed);
+		}
+		metrics.oldSample = std::move(sample);
+	}
+}
 
 void ProcessMetrics::update()
 {
 	_pCurrentTime->SetToCurrentTime();
-	_pMemory->Set(static_cast<double>(getMemoryUsage()));
-	_pPageFaults->Set(static_cast<double>(getPageFaults()));
-	_pCpuUsage->Set(getCpuUsage());
-	auto [diskRead, diskWrite] = getDiskIO();
-	_pDiskRead->Set(static_cast<double>(diskRead));
-	_pDiskWrite->Set(static_cast<double>(diskWrite));
-	_pThreadCount->Set(static_cast<double>(getThreadCount()));
-	_pFileDescriptorCount->Set(static_cast<double>(getFileDescriptorCount()));
+
+	ProcSample sample;
+	const auto sampleTime = std::chrono::steady_clock::now();
+	if (!_sampler.sample(sample))
+	{
+		throw std::runtime_error("Can't sample /proc/self/stat");
+	}
+
+	const double elapsed = std::chrono::duration<double>(sampleTime - _oldSampleTime).count();
+
+	_pMemory->Set(static_cast<double>(sample.peakResidentKb));
+	_pPageFaults->Set(static_cast<double>(sample.majorFaults));
+	_pCpuUsage->Set(cpuUsage(sample.userTicks - _oldSample.userTicks, elapsed));
+	if (elapsed > 0)
+	{
+		// Rates per second, so the values don't depend on the update interval
+		_pDiskRead->Set(static_cast<double>(sample.readBytes - _oldSample.readBytes) / elapsed);
+		_pDiskWrite->Set(static_cast<double>(sample.writeBytes - _oldSample.writeBytes) / elapsed);
+	}
+	_pThreadCount->Set(static_cast<double>(sample.threadCount));
+	_pFileDescriptorCount->Set(static_cast<double>(sample.fileDescriptorCount));
+
+	_oldSample = sample;
+	_oldSampleTime = sampleTime;
+	updateThreads(elapsed);
+	updatePerfCounters();
 }
 
 void ProcessMetrics::threadRunner(const std::stop_token &stopToken) noexcept
 {
+	pthread_setname_np(pthread_self(), "proc-metrics");
+
 	while (!stopToken.stop_requested())
 	{
 		try
@@ -123,13 +290,14 @@ void ProcessMetrics::threadRunner(const std::stop_token &stopToken) noexcept
 			spdlog::error("Self monitoring failed: {}", e.what());
 		}
 
-		std::this_thread::sleep_for(std::chrono::seconds(SLEEP_INTERVAL_SEC));
+		std::this_thread::sleep_for(_updateInterval);
 	}
 }
 
 ProcessMetrics::ProcessMetrics(std::shared_ptr<std::atomic_flag> checkFlag,
-							   const std::shared_ptr<prometheus::Registry> &reg)
-	: _checkFlag(std::move(checkFlag))
+							   const std::shared_ptr<prometheus::Registry> &reg, bool enablePerfCounters,
+							   std::chrono::milliseconds updateInterval)
+	: _checkFlag(std::move(checkFlag)), _updateInterval(updateInterval)
 {
 	if (reg == nullptr)
 	{
@@ -145,8 +313,16 @@ ProcessMetrics::ProcessMetrics(std::shared_ptr<std::atomic_flag> checkFlag,
 	_pPageFaults =
 		&prometheus::BuildGauge().Name("page_faults").Help("Page faults of application").Register(*reg).Add({});
 	_pCpuUsage = &prometheus::BuildGauge().Name("cpu_usage").Help("CPU usage of application").Register(*reg).Add({});
-	_pDiskRead = &prometheus::BuildGauge().Name("disk_read").Help("Disk read of application").Register(*reg).Add({});
-	_pDiskWrite = &prometheus::BuildGauge().Name("disk_write").Help("Disk write of application").Register(*reg).Add({});
+	_pDiskRead = &prometheus::BuildGauge()
+					  .Name("disk_read")
+					  .Help("Disk read of application in bytes per second")
+					  .Register(*reg)
+					  .Add({});
+	_pDiskWrite = &prometheus::BuildGauge()
+					   .Name("disk_write")
+					   .Help("Disk write of application in bytes per second")
+					   .Register(*reg)
+					   .Add({});
 	_pThreadCount =
 		&prometheus::BuildGauge().Name("thread_count").Help("Thread count of application").Register(*reg).Add({});
 	_pFileDescriptorCount = &prometheus::BuildGauge()
@@ -155,9 +331,48 @@ ProcessMetrics::ProcessMetrics(std::shared_ptr<std::atomic_flag> checkFlag,
 								 .Register(*reg)
 								 .Add({});
 
+	_threadUserCpuFamily =
+		&prometheus::BuildGauge().Name("thread_user_cpu_usage").Help("User mode CPU usage of threads").Register(*reg);
+	_threadSystemCpuFamily = &prometheus::BuildGauge()
+								  .Name("thread_system_cpu_usage")
+								  .Help("Kernel mode CPU usage of threads")
+								  .Register(*reg);
+	_threadRunQueueWaitFamily = &prometheus::BuildGauge()
+									 .Name("thread_run_queue_wait")
+									 .Help("Share of time threads wait on a run queue")
+									 .Register(*reg);
+	_threadVoluntarySwitchFamily = &prometheus::BuildGauge()
+										.Name("thread_voluntary_context_switches_rate")
+										.Help("Voluntary context switches per second of threads")
+										.Register(*reg);
+	_threadInvoluntarySwitchFamily = &prometheus::BuildGauge()
+										  .Name("thread_involuntary_context_switches_rate")
+										  .Help("Involuntary context switches per second of threads")
+										  .Register(*reg);
+
 	_pInitTime->SetToCurrentTime();
 
+	// Rates of the first update are computed from the values at construction
+	_oldSampleTime = std::chrono::steady_clock::now();
+	_sampler.sample(_oldSample);
+
+	if (enablePerfCounters)
+	{
+		initPerfCounters(reg);
+	}
+
 	_thread = std::make_unique<std::jthread>([this](const std::stop_token &sToken) { threadRunner(sToken); });
 }
 
-ProcessMetrics::~ProcessMetrics() = default;
+ProcessMetrics::~ProcessMetrics()
+{
+	// Counters are read by the thread
+	_thread.reset();
+	for (auto &counter : _perfCounters)
+	{
+		for (const int fd : counter.fds)
+		{
+			close(fd);
+		}
+	}
+}
@@ -0,0 +1,349 @@
+#include "metrics/Profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <format>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+// States of the sample slots
+constexpr uint32_t PROFILER_SAMPLE_FREE = 0;
+constexpr uint32_t PROFILER_SAMPLE_WRITING = 1;
+constexpr uint32_t PROFILER_SAMPLE_READY = 2;
+// Maximum distance of the walked frames from the interrupted stack pointer, larger ones are taken as corrupt
+constexpr uintptr_t PROFILER_MAX_STACK_SIZE = 64 * 1024 * 1024;
+
+namespace
+{
+	// Profiler receiving the signals, null while none is running
+	std::atomic<SamplingProfiler *> activeProfiler{nullptr};
+
+	/// Registers of the interrupted thread the stack is walked from
+	struct InterruptedRegisters {
+		uintptr_t instruction{0};  ///< Interrupted instruction
+		uintptr_t framePointer{0}; ///< Frame record of the interrupted function
+		uintptr_t stackPointer{0}; ///< Top of the interrupted stack
+	};
+
+	// Gets the registers of the interrupted thread from the signal context
+	InterruptedRegisters interruptedRegisters(void *context)
+	{
+		[[maybe_unused]] const auto *ucontext = static_cast<const ucontext_t *>(context);
+#if defined(__x86_64__)
+		return {.instruction = static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_RIP]),
+				.framePointer = static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_RBP]),
+				.stackPointer = static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_RSP])};
+#elif defined(__aarch64__)
+		return {.instruction = static_cast<uintptr_t>(ucontext->uc_mcontext.pc),
+				.framePointer = static_cast<uintptr_t>(ucontext->uc_mcontext.regs[29]),
+				.stackPointer = static_cast<uintptr_t>(ucontext->uc_mcontext.sp)};
+#else
+		return {};
+#endif
+	}
+
+	// Reads a frame record of the previous frame pointer and the return address. Unmapped addresses fail the read
+	// instead of faulting, async-signal-safe
+	bool readFrameRecord(uintptr_t framePointer, std::array<uintptr_t, 2> &record)
+	{
+		iovec local{.iov_base = record.data(), .iov_len = sizeof(record)};
+		iovec remote{.iov_base = reinterpret_cast<void *>(framePointer), .iov_len = sizeof(record)};
+		return process_vm_readv(getpid(), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(sizeof(record));
+	}
+
+	// Names a frame as its demangled function, or as its module and offset without symbols
+	std::string symbolise(uintptr_t address)
+	{
+		Dl_info info{};
+		if (dladdr(reinterpret_cast<void *>(address), &info) == 0)
+		{
+			return std::format("{:#x}", address);
+		}
+
+		std::string name;
+		if (info.dli_sname != nullptr)
+		{
+			int status = 0;
+			char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+			name = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+			std::free(demangled); // NOLINT(cppcoreguidelines-no-malloc)
+		}
+		else if (info.dli_fname != nullptr)
+		{
+			name = std::format("{}+{:#x}", std::filesystem::path(info.dli_fname).filename().string(),
+							   address - reinterpret_cast<uintptr_t>(info.dli_fbase));
+		}
+		else
+		{
+			name = std::format("{:#x}", address);
+		}
+
+		// Semicolons separate the frames of the folded stacks
+		std::ranges::replace(name, ';', ':');
+		return name;
+	}
+} // namespace
+
+size_t SamplingProfiler::StackHash::operator()(const std::vector<uintptr_t> &stack) const
+{
+	size_t seed = stack.size();
+	for (const uintptr_t address : stack)
+	{
+		seed ^= std::hash<uintptr_t>{}(address) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+	}
+	return seed;
+}
+
+void SamplingProfiler::capture(void *context)
+{
+	const auto registers = interruptedRegisters(context);
+	if (registers.instruction == 0)
+	{
+		return;
+	}
+
+	auto &sample = _samples[_nextSample.fetch_add(1, std::memory_order_relaxed) % PROFILER_BUFFER_SIZE];
+	uint32_t expected = PROFILER_SAMPLE_FREE;
+	if (!sample.state.compare_exchange_strong(expected, PROFILER_SAMPLE_WRITING, std::memory_order_acquire))
+	{
+		_nDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// Frame records are walked towards the bottom of the stack, every record should be above the previous one and
+	// within the stack size from the interrupted stack pointer. Functions without frame pointers end the walk
+	uint32_t depth = 0;
+	sample.frames[depth++] = reinterpret_cast<void *>(registers.instruction);
+	uintptr_t framePointer = registers.framePointer;
+	uintptr_t lowerBound = registers.stackPointer;
+	std::array<uintptr_t, 2> record{};
+	while (depth < PROFILER_MAX_DEPTH && framePointer % alignof(uintptr_t) == 0 && framePointer >= lowerBound &&
+		   framePointer - registers.stackPointer < PROFILER_MAX_STACK_SIZE && readFrameRecord(framePointer, record) &&
+		   record[1] != 0)
+	{
+		sample.frames[depth++] = reinterpret_cast<void *>(record[1]);
+		lowerBound = framePointer + sizeof(record);
+		framePointer = record[0];
+	}
+	sample.depth = depth;
+	sample.state.store(PROFILER_SAMPLE_READY, std::memory_order_release);
+}
+
+void SamplingProfiler::drain()
+{
+	std::vector<std::vector<uintptr_t>> stacks;
+	for (size_t idx = 0; idx < PROFILER_BUFFER_SIZE; ++idx)
+	{
+		auto &sample = _samples[idx];
+		if (sample.state.load(std::memory_order_acquire) != PROFILER_SAMPLE_READY)
+		{
+			continue;
+		}
+		auto &stack = stacks.emplace_back(sample.depth);
+		std::transform(&sample.frames[0], &sample.frames[sample.depth], stack.begin(),
+					   [](void *frame) { return reinterpret_cast<uintptr_t>(frame); });
+		sample.state.store(PROFILER_SAMPLE_FREE, std::memory_order_release);
+	}
+
+	const std::scoped_lock lock(_stacksGuard);
+	for (auto &stack : stacks)
+	{
+		if (const auto itr = _stacks.find(stack); itr != _stacks.end())
+		{
+			++itr->second;
+		}
+		else if (_stacks.size() < PROFILER_MAX_STACKS)
+		{
+			_stacks.emplace(std::move(stack), 1);
+		}
+		else
+		{
+			_nDropped.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		_nSamples.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void SamplingProfiler::threadFunc(const std::stop_token &stopToken)
+{
+	pthread_setname_np(pthread_self(), "profiler");
+
+	while (!stopToken.stop_requested())
+	{
+		std::this_thread::sleep_for(PROFILER_DRAIN_INTERVAL);
+		drain();
+	}
+}
+
+void SamplingProfiler::signalHandler(int /*unused*/, siginfo_t * /*unused*/, void *context)
+{
+	const int savedErrno = errno;
+	if (auto *profiler = activeProfiler.load(std::memory_order_acquire);
+		profiler != nullptr && profiler->_isRunning.load(std::memory_order_relaxed))
+	{
+		profiler->capture(context);
+	}
+	errno = savedErrno;
+}
+
+SamplingProfiler::SamplingProfiler() : _samples(std::make_unique<Sample[]>(PROFILER_BUFFER_SIZE)) {}
+
+bool SamplingProfiler::start(uint32_t frequency)
+{
+	const std::scoped_lock lock(_guard);
+
+	SamplingProfiler *expected = nullptr;
+	if (!activeProfiler.compare_exchange_strong(expected, this))
+	{
+		spdlog::warn("Profiler is already running");
+		return false;
+	}
+
+	for (size_t idx = 0; idx < PROFILER_BUFFER_SIZE; ++idx)
+	{
+		_samples[idx].state.store(PROFILER_SAMPLE_FREE, std::memory_order_relaxed);
+	}
+	{
+		const std::scoped_lock stacksLock(_stacksGuard);
+		_stacks.clear();
+	}
+	_nSamples = 0;
+	_nDropped = 0;
+
+	// Handler stays installed after the profiler stops, signals still in flight are ignored by it
+	struct sigaction action{};
+	action.sa_sigaction = signalHandler;
+	action.sa_flags = SA_RESTART | SA_SIGINFO;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGPROF, &action, nullptr) != 0)
+	{
+		spdlog::error("Can't install profiler signal handler: {}", std::strerror(errno));
+		activeProfiler = nullptr;
+		return false;
+	}
+
+	_frequency = std::clamp<uint32_t>(frequency, 1, PROFILER_MAX_FREQUENCY);
+	const auto interval = std::chrono::microseconds(std::micro::den / _frequency);
+	itimerval timer{};
+	timer.it_interval.tv_sec = static_cast<time_t>(interval.count() / std::micro::den);
+	timer.it_interval.tv_usec = static_cast<suseconds_t>(interval.count() % std::micro::den);
+	timer.it_value = timer.it_interval;
+
+	_isRunning = true;
+	if (setitimer(ITIMER_PROF, &timer, nullptr) != 0)
+	{
+		spdlog::error("Can't start profiler timer: {}", std::strerror(errno));
+		_isRunning = false;
+		activeProfiler = nullptr;
+		return false;
+	}
+	_startTime = std::chrono::steady_clock::now();
+	_thread = std::make_unique<std::jthread>([this](const std::stop_token &sToken) { threadFunc(sToken); });
+
+	spdlog::info("Profiler started at {} Hz", _frequency);
+	return true;
+}
+
+bool SamplingProfiler::stop()
+{
+	const std::scoped_lock lock(_guard);
+	if (!_isRunning)
+	{
+		return false;
+	}
+
+	itimerval timer{};
+	setitimer(ITIMER_PROF, &timer, nullptr);
+	_isRunning = false;
+	_thread.reset();
+	drain();
+	activeProfiler = nullptr;
+
+	spdlog::info("Profiler stopped with {} samples", _nSamples.load());
+	return true;
+}
+
+std::string SamplingProfiler::summary() const
+{
+	const std::scoped_lock lock(_guard);
+
+	size_t nStacks = 0;
+	{
+		const std::scoped_lock stacksLock(_stacksGuard);
+		nStacks = _stacks.size();
+	}
+	if (!_isRunning)
+	{
+		return std::format("Profiler stopped, {} samples, {} dropped, {} stacks", _nSamples.load(), _nDropped.load(),
+						   nStacks);
+	}
+	const auto runTime =
+		std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - _startTime);
+	return std::format("Profiler running at {} Hz for {}s, {} samples, {} dropped, {} stacks", _frequency,
+					   runTime.count(), _nSamples.load(), _nDropped.load(), nStacks);
+}
+
+std::vector<std::string> SamplingProfiler::foldedStacks() const
+{
+	std::vector<std::pair<std::vector<uintptr_t>, uint64_t>> stacks;
+	{
+		const std::scoped_lock lock(_stacksGuard);
+		stacks.assign(_stacks.begin(), _stacks.end());
+	}
+
+	// Frames are shared by many stacks, every address is symbolised once. Stacks differing only in the addresses
+	// within the same functions are merged
+	std::unordered_map<uintptr_t, std::string> symbols;
+	std::unordered_map<std::string, uint64_t> foldedCounts;
+	for (const auto &[stack, count] : stacks)
+	{
+		std::string line;
+		for (size_t idx = stack.size(); idx-- > 0;)
+		{
+			// Return addresses point after the call, the innermost frame is the interrupted instruction itself
+			const uintptr_t address = idx == 0 ? stack[idx] : stack[idx] - 1;
+			auto itr = symbols.find(address);
+			if (itr == symbols.end())
+			{
+				itr = symbols.emplace(address, symbolise(address)).first;
+			}
+			if (!line.empty())
+			{
+				line.push_back(';');
+			}
+			line.append(itr->second);
+		}
+		foldedCounts[line.empty() ? "[unknown]" : line] += count;
+	}
+
+	std::vector<std::pair<std::string, uint64_t>> folded(foldedCounts.begin(), foldedCounts.end());
+	std::ranges::sort(folded, std::ranges::greater{}, &std::pair<std::string, uint64_t>::second);
+
+	std::vector<std::string> retval;
+	retval.reserve(folded.size());
+	for (auto &[line, count] : folded)
+	{
+		retval.push_back(std::move(line.append(" ").append(std::to_string(count))));
+	}
+	return retval;
+}
+
+SamplingProfiler::~SamplingProfiler() { stop(); }
+
+SamplingProfiler &Profiler()
+{
+	static SamplingProfiler profiler;
+	return profiler;
+}
@@ -1,5 +1,7 @@
 #include "metrics/PrometheusServer.hpp"
 
+#include "metrics/ScrapeRegistry.hpp"
+
 #include "Version.h"
 
 #include <algorithm>
@@ -53,7 +55,7 @@ std::shared_ptr<prometheus::Registry> PrometheusServer::createNewRegistry(uint64
 	const std::scoped_lock guard(_guardLock);
 
 	// Create registry
-	auto reg = std::make_shared<prometheus::Registry>();
+	auto reg = std::make_shared<ScrapeRegistry>();
 	_mainExposer->RegisterCollectable(reg);
 
 	// Push to vector (At least information registry always exist so back is valid)
@@ -0,0 +1,45 @@
+#include "metrics/ScrapeRegistry.hpp"
+
+#include <algorithm>
+
+uint64_t ScrapeRegistry::addScrapeCallback(std::function<void()> func)
+{
+	const std::scoped_lock guard(_guardLock);
+	_vCallbacks.emplace_back(_nextCallbackId, std::move(func));
+	return _nextCallbackId++;
+}
+
+void ScrapeRegistry::removeScrapeCallback(uint64_t callbackId)
+{
+	const std::scoped_lock guard(_guardLock);
+	std::erase_if(_vCallbacks, [callbackId](const std::pair<uint64_t, std::function<void()>> &val) {
+		return callbackId == val.first;
+	});
+}
+
+std::vector<prometheus::MetricFamily> ScrapeRegistry::Collect() const
+{
+	{
+		const std::scoped_lock guard(_guardLock);
+		std::ranges::for_each(_vCallbacks, [](const std::pair<uint64_t, std::function<void()>> &val) { val.second(); });
+	}
+	return prometheus::Registry::Collect();
+}
+
+ScrapeCallback::ScrapeCallback(const std::shared_ptr<prometheus::Registry> &reg, std::function<void()> func)
+{
+	if (auto scrapeReg = std::dynamic_pointer_cast<ScrapeRegistry>(reg))
+	{
+		_callbackId = scrapeReg->addScrapeCallback(std::move(func));
+		_registry = scrapeReg;
+		_isRegistered = true;
+	}
+}
+
+ScrapeCallback::~ScrapeCallback()
+{
+	if (auto scrapeReg = _registry.lock())
+	{
+		scrapeReg->removeScrapeCallback(_callbackId);
+	}
+}
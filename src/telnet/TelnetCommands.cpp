@@ -0,0 +1,203 @@
+#include "telnet/TelnetCommands.hpp"
+
+#include <mutex>
+
+const TelnetCommandRegistry::Node *TelnetCommandRegistry::findNode(std::string_view prefix) const
+{
+	const Node *node = &m_root;
+	for (const char chr : prefix)
+	{
+		const auto itr = node->children.find(chr);
+		if (itr == node->children.end())
+		{
+			return nullptr;
+		}
+		node = itr->second.get();
+	}
+	return node;
+}
+
+void TelnetCommandRegistry::collect(const Node &node, std::vector<const TelnetCommand *> &commands)
+{
+	if (node.command && !node.command->info.empty())
+	{
+		commands.push_back(node.command.get());
+	}
+	for (const auto &[chr, child] : node.children)
+	{
+		if (child->visibleCount > 0)
+		{
+			collect(*child, commands);
+		}
+	}
+}
+
+bool TelnetCommandRegistry::registerCommand(const std::string &name, std::string info, FPTR_TelnetCommand handler,
+											bool hasArguments)
+{
+	if (name.empty())
+	{
+		return false;
+	}
+
+	const std::unique_lock lock(m_guard);
+
+	// Check existence first to keep visible counters consistent
+	if (const Node *node = findNode(name); node != nullptr && node->command)
+	{
+		return false;
+	}
+
+	const bool isVisible = !info.empty();
+	Node *node = &m_root;
+	for (const char chr : name)
+	{
+		node->visibleCount += static_cast<size_t>(isVisible);
+		auto &child = node->children[chr];
+		if (!child)
+		{
+			child = std::make_unique<Node>();
+		}
+		node = child.get();
+	}
+	node->visibleCount += static_cast<size_t>(isVisible);
+	node->command = std::make_unique<TelnetCommand>(TelnetCommand{
+		.name = name, .info = std::move(info), .handler = std::move(handler), .hasArguments = hasArguments});
+
+	return true;
+}
+
+bool TelnetCommandRegistry::unregisterCommand(std::string_view name)
+{
+	const std::unique_lock lock(m_guard);
+
+	const Node *found = findNode(name);
+	if (found == nullptr || !found->command)
+	{
+		return false;
+	}
+
+	const bool isVisible = !found->command->info.empty();
+
+	// Walk again to update counters and prune the nodes left without any command
+	std::vector<std::pair<Node *, char>> path;
+	Node *node = &m_root;
+	for (const char chr : name)
+	{
+		node->visibleCount -= static_cast<size_t>(isVisible);
+		path.emplace_back(node, chr);
+		node = node->children[chr].get();
+	}
+	node->visibleCount -= static_cast<size_t>(isVisible);
+	node->command.reset();
+
+	for (auto itr = path.rbegin(); itr != path.rend(); ++itr)
+	{
+		auto &child = itr->first->children[itr->second];
+		if (child->command || !child->children.empty())
+		{
+			break;
+		}
+		itr->first->children.erase(itr->second);
+	}
+
+	return true;
+}
+
+FPTR_TelnetCommand TelnetCommandRegistry::find(std::string_view line, std::string_view &args) const
+{
+	const std::shared_lock lock(m_guard);
+
+	const TelnetCommand *match = nullptr;
+	const Node *node = &m_root;
+	for (size_t idx = 0; idx < line.size(); ++idx)
+	{
+		// Command accepting arguments terminates at a word boundary
+		if (line[idx] == ' ' && node->command && node->command->hasArguments)
+		{
+			match = node->command.get();
+			args = line.substr(idx + 1);
+		}
+
+		const auto itr = node->children.find(line[idx]);
+		if (itr == node->children.end())
+		{
+			node = nullptr;
+			break;
+		}
+		node = itr->second.get();
+	}
+
+	// Exact match
+	if (node != nullptr && node->command)
+	{
+		match = node->command.get();
+		args = {};
+	}
+
+	return match == nullptr ? FPTR_TelnetCommand{} : match->handler;
+}
+
+std::string TelnetCommandRegistry::complete(std::string_view prefix, std::vector<std::string> &candidates) const
+{
+	const std::shared_lock lock(m_guard);
+
+	candidates.clear();
+	const Node *node = findNode(prefix);
+	if (node == nullptr || node->visibleCount == 0)
+	{
+		return "";
+	}
+
+	std::vector<const TelnetCommand *> commands;
+	collect(*node, commands);
+	for (const auto *command : commands)
+	{
+		candidates.push_back(command->name);
+	}
+
+	// Descend while there is a single way to continue
+	std::string retval(prefix);
+	while (!(node->command && !node->command->info.empty()))
+	{
+		const Node *next = nullptr;
+		char nextChr = '\0';
+		for (const auto &[chr, child] : node->children)
+		{
+			if (child->visibleCount == 0)
+			{
+				continue;
+			}
+			if (next != nullptr)
+			{
+				return retval;
+			}
+			next = child.get();
+			nextChr = chr;
+		}
+		if (next == nullptr)
+		{
+			break;
+		}
+		retval.push_back(nextChr);
+		node = next;
+	}
+
+	return retval;
+}
+
+std::vector<std::pair<std::string, std::string>> TelnetCommandRegistry::commands() const
+{
+	const std::shared_lock lock(m_guard);
+
+	std::vector<const TelnetCommand *> commands;
+	collect(m_root, commands);
+
+	std::vector<std::pair<std::string, std::string>> retval;
+	retval.reserve(commands.size());
+	for (const auto *command : commands)
+	{
+		retval.emplace_back(command->name, command->info);
+	}
+	return retval;
+}
@@ -0,0 +1,101 @@
+#include "telnet/TelnetHistory.hpp"
+
+#include <algorithm>
+
+void TelnetHistoryEntry::assign(std::string_view value)
+{
+	m_size = value.size();
+	if (m_size <= TELNET_HISTORY_INLINE_SIZE)
+	{
+		std::ranges::copy(value, m_inline.begin());
+		return;
+	}
+	m_overflow.assign(value);
+}
+
+bool TelnetHistory::push(std::string_view line)
+{
+	if (line.empty() || (m_size > 0 && (*this)[m_size - 1] == line))
+	{
+		return false;
+	}
+
+	if (m_size < TELNET_HISTORY_LIMIT)
+	{
+		m_entries[(m_head + m_size) % TELNET_HISTORY_LIMIT].assign(line);
+		++m_size;
+	}
+	else
+	{
+		// Overwrite the oldest entry
+		m_entries[m_head].assign(line);
+		m_head = (m_head + 1) % TELNET_HISTORY_LIMIT;
+	}
+	return true;
+}
+
+size_t TelnetHistory::rfind(std::string_view pattern, size_t before) const
+{
+	if (pattern.empty())
+	{
+		return std::string::npos;
+	}
+
+	for (size_t idx = std::min(before, m_size); idx > 0; --idx)
+	{
+		if ((*this)[idx - 1].find(pattern) != std::string_view::npos)
+		{
+			return idx - 1;
+		}
+	}
+	return std::string::npos;
+}
+
+void TelnetHistory::clear()
+{
+	m_head = 0;
+	m_size = 0;
+}
+
+TelnetHistory *TelnetHistoryArena::acquire(std::string_view peer)
+{
+	Slot *selected = nullptr;
+	for (auto &slot : m_slots)
+	{
+		if (slot.peer == peer)
+		{
+			selected = &slot;
+			break;
+		}
+
+		// Prefer unused slots, then the least recently used one without active sessions
+		if (slot.users == 0 && (selected == nullptr || (!selected->peer.empty() && slot.lastUsed < selected->lastUsed)))
+		{
+			selected = &slot;
+		}
+	}
+
+	if (selected == nullptr)
+	{
+		return nullptr;
+	}
+
+	if (selected->peer != peer)
+	{
+		selected->peer = peer;
+		selected->history.clear();
+	}
+	++selected->users;
+	selected->lastUsed = ++m_clock;
+	return &selected->history;
+}
+
+void TelnetHistoryArena::release(const TelnetHistory *history)
+{
+	const auto itr = std::ranges::find_if(m_slots, [history](const Slot &slot) { return &slot.history == history; });
+	if (itr != m_slots.end() && itr->users > 0)
+	{
+		--itr->users;
+		itr->lastUsed = ++m_clock;
+	}
+}
@@ -0,0 +1,168 @@
+#include "telnet/TelnetInputParser.hpp"
+
+#include <utility>
+
+// ASCII constants
+constexpr uint8_t ASCII_NULL = 0x00;
+constexpr uint8_t ASCII_BELL = 0x07;
+constexpr uint8_t ASCII_BACKSPACE = 0x08;
+constexpr uint8_t ASCII_TAB = 0x09;
+constexpr uint8_t ASCII_LF = 0x0A;
+constexpr uint8_t ASCII_CR = 0x0D;
+constexpr uint8_t ASCII_DC2 = 0x12;
+constexpr uint8_t ASCII_ESC = 0x1B;
+constexpr uint8_t ASCII_DEL = 0x7F;
+
+// Telnet NVT constants (RFC 854)
+constexpr uint8_t TELNET_SE = 0xF0;
+constexpr uint8_t TELNET_SB = 0xFA;
+constexpr uint8_t TELNET_WILL = 0xFB;
+constexpr uint8_t TELNET_DONT = 0xFE;
+constexpr uint8_t TELNET_IAC = 0xFF;
+
+// ANSI escape sequence constants
+constexpr uint8_t ANSI_CSI = '[';
+constexpr uint8_t ANSI_SS3 = 'O';
+constexpr uint8_t ANSI_SEQUENCE_MIN = 0x20;
+constexpr uint8_t ANSI_SEQUENCE_FINAL_MIN = 0x40;
+constexpr uint8_t ANSI_SEQUENCE_MAX = 0x7E;
+
+TelnetInputEvent TelnetInputParser::consume(char chr)
+{
+	const auto byte = static_cast<uint8_t>(chr);
+
+	switch (m_state)
+	{
+	case State::Data:
+		break;
+	case State::CarriageReturn:
+		m_state = State::Data;
+		if (byte == ASCII_LF || byte == ASCII_NULL)
+		{
+			return TelnetInputEvent::Line;
+		}
+
+		// Not a line ending, keep CR and process the byte as regular data
+		m_buffer.push_back(static_cast<char>(ASCII_CR));
+		break;
+	case State::Iac:
+		if (byte == TELNET_IAC)
+		{
+			// Escaped data byte 255
+			m_buffer.push_back(chr);
+			m_state = State::Data;
+		}
+		else if (byte == TELNET_SB)
+		{
+			m_state = State::SubNegotiation;
+		}
+		else if (byte >= TELNET_WILL && byte <= TELNET_DONT)
+		{
+			m_state = State::IacOption;
+		}
+		else
+		{
+			// Two byte commands (NOP, GA, AYT etc.) are ignored
+			m_state = State::Data;
+		}
+		return TelnetInputEvent::None;
+	case State::IacOption:
+		m_state = State::Data;
+		return TelnetInputEvent::None;
+	case State::SubNegotiation:
+		if (byte == TELNET_IAC)
+		{
+			m_state = State::SubNegotiationIac;
+		}
+		return TelnetInputEvent::None;
+	case State::SubNegotiationIac:
+		m_state = byte == TELNET_SE ? State::Data : State::SubNegotiation;
+		return TelnetInputEvent::None;
+	case State::Escape:
+		m_state = (byte == ANSI_CSI || byte == ANSI_SS3) ? State::ControlSequence : State::Data;
+		return TelnetInputEvent::None;
+	case State::ControlSequence:
+		if (byte < ANSI_SEQUENCE_MIN || byte > ANSI_SEQUENCE_MAX)
+		{
+			// Malformed sequence, process the byte as regular data
+			m_state = State::Data;
+			break;
+		}
+		if (byte < ANSI_SEQUENCE_FINAL_MIN)
+		{
+			// Parameter or intermediate byte
+			return TelnetInputEvent::None;
+		}
+
+		m_state = State::Data;
+		switch (byte)
+		{
+		case 'A':
+			return TelnetInputEvent::ArrowUp;
+		case 'B':
+			return TelnetInputEvent::ArrowDown;
+		case 'C':
+			return TelnetInputEvent::ArrowRight;
+		case 'D':
+			return TelnetInputEvent::ArrowLeft;
+		default:
+			return TelnetInputEvent::None;
+		}
+	}
+
+	// Regular data
+	switch (byte)
+	{
+	case TELNET_IAC:
+		m_state = State::Iac;
+		return TelnetInputEvent::None;
+	case ASCII_CR:
+		m_state = State::CarriageReturn;
+		return TelnetInputEvent::None;
+	case ASCII_NULL:
+		// Telnet clients might send NUL for new lines mid-data block
+		m_buffer.push_back(static_cast<char>(ASCII_LF));
+		return TelnetInputEvent::None;
+	default:
+		break;
+	}
+
+	if (m_lineEditing)
+	{
+		switch (byte)
+		{
+		case ASCII_BACKSPACE:
+		case ASCII_DEL:
+			if (!m_buffer.empty())
+			{
+				m_buffer.pop_back();
+			}
+			return TelnetInputEvent::Erase;
+		case ASCII_TAB:
+			return TelnetInputEvent::Tab;
+		case ASCII_DC2:
+			return TelnetInputEvent::ReverseSearch;
+		case ASCII_BELL:
+			return TelnetInputEvent::Cancel;
+		case ASCII_ESC:
+			m_state = State::Escape;
+			return TelnetInputEvent::None;
+		default:
+			break;
+		}
+	}
+
+	m_buffer.push_back(chr);
+	return TelnetInputEvent::None;
+}
+
+std::string TelnetInputParser::takeBuffer()
+{
+	return std::exchange(m_buffer, {});
+}
+
+void TelnetInputParser::reset()
+{
+	m_state = State::Data;
+	m_buffer.clear();
+}
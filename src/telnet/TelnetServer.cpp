@@ -1,22 +1,25 @@
 #include "telnet/TelnetServer.hpp"
 
 #include "Version.h"
+#include "metrics/Profiler.hpp"
 #include "utils/ErrorHelpers.hpp"
-#include "utils/Hasher.hpp"
 
+#include <openssl/err.h>
 #include <spdlog/spdlog.h>
 
 #include <algorithm>
 #include <array>
+#include <charconv>
 #include <ctime>
 #include <format>
-#include <iomanip>
 #include <iostream>
-#include <sstream>
+#include <span>
 #include <string>
 #include <utility>
 
-#include <sys/time.h>
+#include <csignal>
+#include <netinet/tcp.h>
+#include <pthread.h>
 
 // Invalid socket identifier for readability
 constexpr int INVALID_SOCKET = -1;
@@ -24,40 +27,31 @@ constexpr int INVALID_SOCKET = -1;
 constexpr int DEFAULT_BUFLEN = 512;
 // Timeout to automatic close session
 constexpr int TELNET_TIMEOUT = 120;
-// Maximum number of concurrent sessions
-constexpr int MAX_AVAILABLE_SESSION = 5;
-// History limit for Telnet session
-constexpr int TELNET_HISTORY_LIMIT = 50;
-// Sleep interval for the server (to control rate limiting)
+// Maximum wait interval of the server loop for socket events
 constexpr int SLEEP_INTERVAL_MS = 50;
+// Streamed output is pulled only while pending data is below this limit
+constexpr size_t TELNET_OUTPUT_HIGH_WATERMARK = 16 * 1024;
+// Session is closed if pending data exceeds this limit
+constexpr size_t TELNET_OUTPUT_BUFFER_LIMIT = 1024 * 1024;
+// Number of lines per page for paged output
+constexpr size_t TELNET_PAGE_SIZE = 20;
+// Timeout to complete the TLS handshake in seconds
+constexpr int TELNET_TLS_HANDSHAKE_TIMEOUT = 10;
+// Number of session tickets issued after a TLS 1.3 handshake
+constexpr size_t TELNET_TLS_TICKET_COUNT = 2;
+// Lifetime of resumable TLS sessions in seconds
+constexpr long TELNET_TLS_SESSION_LIFETIME = 3600;
+// Idle per-peer connection buckets are dropped when the number of tracked peers exceeds this limit
+constexpr size_t TELNET_PEER_BUCKET_LIMIT = 4096;
 
 // Status table widths
 constexpr int KEY_WIDTH = 30;
 constexpr int VAL_WIDTH = 15;
 
 // Telnet ASCII constants
-constexpr int ASCII_LF = 0x0A;
-constexpr int ASCII_NULL = 0x00;
 constexpr int ASCII_NBSP = 0xFF;
 
 // NOLINTBEGIN
-const std::vector<std::pair<std::string, std::string>> telnetCommands = {
-	{"clear", "Clears the terminal screen"},
-	{"disable log", "Resets logger level"},
-	{"enable log", R"(Enable specified logger level. Level can be "v" (info), "vv" (debug) and "vvv" (trace))"},
-	{"help", "Prints available commands"},
-	{"ping", "Pings the server"},
-	{"status", "Checks the internal status"},
-	{"version", "Displays the current version"},
-	/* ################################################################################### */
-	/* ############################# MAKE MODIFICATIONS HERE ############################# */
-	/* ################################################################################### */
-
-	/* ################################################################################### */
-	/* ################################ END MODIFICATIONS ################################ */
-	/* ################################################################################### */
-	{"quit", "Ends the connection"}};
-
 const std::string ANSI_FG_BLACK("\x1b[30m");
 const std::string ANSI_FG_RED("\x1b[31m");
 const std::string ANSI_FG_GREEN("\x1b[32m");
@@ -106,8 +100,24 @@ const std::string ANSI_HORIZONTAL_TAB("\t");
 
 const std::string TELNET_ERASE_LINE("\xff\xf8");
 const std::string TELNET_CLEAR_SCREEN("\033[2J");
+const std::string TELNET_WILL_ECHO("\xff\xfb\x01");
+const std::string TELNET_DONT_ECHO("\xff\xfe\x01");
+const std::string TELNET_WILL_SGA("\xff\xfb\x03");
+
+const std::string TELNET_PAGER_PROMPT("--More-- (SPACE: next page, ENTER: next line, q: quit)");
+const std::string TELNET_TLS_SESSION_ID_CONTEXT("TelnetServer");
+
+const std::string TELNET_TOO_MANY_SESSIONS("Too many active connections. Please try again later. \r\nClosing...\r\n");
+const std::string TELNET_TOO_MANY_COMMANDS("Too many commands. Please slow down.");
 // NOLINTEND
 
+TelnetSession::TelnetSession(Socket ClientSocket, std::shared_ptr<TelnetServer> tServer)
+	: m_socket(ClientSocket), m_telnetServer(std::move(tServer)),
+	  m_byteBucket(m_telnetServer->limits().byteRate, m_telnetServer->limits().byteBurst),
+	  m_commandBucket(m_telnetServer->limits().commandRate, m_telnetServer->limits().commandBurst)
+{
+}
+
 std::string TelnetSession::getPeerIP() const
 {
 	sockaddr_in client_info{};
@@ -121,69 +131,317 @@ std::string TelnetSession::getPeerIP() const
 	return ipAddr.data();
 }
 
-void TelnetSession::sendPromptAndBuffer()
+ssize_t TelnetSession::readSocket(char *buffer, size_t length)
 {
-	// Output the prompt
-	ssize_t sendBytes =
-		send(m_socket, m_telnetServer->promptString().c_str(), m_telnetServer->promptString().length(), 0);
+	if (!m_ssl)
+	{
+		return recv(m_socket, buffer, length, 0);
+	}
+
+	const int readBytes = SSL_read(m_ssl.get(), buffer, static_cast<int>(length));
+	if (readBytes > 0)
+	{
+		return readBytes;
+	}
+
+	switch (SSL_get_error(m_ssl.get(), readBytes))
+	{
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		errno = EAGAIN;
+		return -1;
+	case SSL_ERROR_ZERO_RETURN:
+		return 0;
+	default:
+		ERR_clear_error();
+		errno = ECONNRESET;
+		return -1;
+	}
+}
+
+ssize_t TelnetSession::writeSocket(const char *buffer, size_t length)
+{
+	if (!m_ssl)
+	{
+		return send(m_socket, buffer, length, MSG_NOSIGNAL);
+	}
+
+	const int sendBytes = SSL_write(m_ssl.get(), buffer, static_cast<int>(length));
 	if (sendBytes > 0)
 	{
-		stats.uploadBytes += static_cast<size_t>(sendBytes);
+		return sendBytes;
 	}
 
-	// Resend the buffer
-	if (!m_buffer.empty())
+	switch (SSL_get_error(m_ssl.get(), sendBytes))
+	{
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		errno = EAGAIN;
+		return -1;
+	default:
+		ERR_clear_error();
+		errno = ECONNRESET;
+		return -1;
+	}
+}
+
+void TelnetSession::continueHandshake()
+{
+	const int retval = SSL_do_handshake(m_ssl.get());
+	if (retval == 1)
+	{
+		stats.tlsHandshakeCtr = 1;
+		stats.tlsResumedHandshakeCtr = static_cast<uint64_t>(SSL_session_reused(m_ssl.get()) == 1);
+		stats.tlsHandshakeDuration = std::chrono::high_resolution_clock::now() - m_handshakeStart;
+		m_tlsWantWrite = false;
+
+		spdlog::debug("TLS handshake with {} completed ({})", getPeerIP(), SSL_get_version(m_ssl.get()));
+		establish();
+		return;
+	}
+
+	switch (SSL_get_error(m_ssl.get(), retval))
+	{
+	case SSL_ERROR_WANT_READ:
+		m_tlsWantWrite = false;
+		break;
+	case SSL_ERROR_WANT_WRITE:
+		m_tlsWantWrite = true;
+		break;
+	default: {
+		const unsigned long errCode = ERR_get_error();
+		ERR_clear_error();
+		spdlog::warn("TLS handshake with {} failed: {}", getPeerIP(),
+					 errCode == 0 ? "connection closed" : ERR_reason_error_string(errCode));
+		++stats.tlsFailedHandshakeCtr;
+		markTimeout();
+		break;
+	}
+	}
+}
+
+void TelnetSession::writeData(std::string_view data)
+{
+	// Keep the ordering if there is already data waiting for the socket or the connection is not ready yet
+	if (m_outputBuffer.empty() && m_established)
 	{
-		sendBytes = send(m_socket, m_buffer.c_str(), m_buffer.length(), 0);
+		const ssize_t sendBytes = writeSocket(data.data(), data.size());
 		if (sendBytes > 0)
 		{
 			stats.uploadBytes += static_cast<size_t>(sendBytes);
+			data.remove_prefix(static_cast<size_t>(sendBytes));
 		}
+		else if (sendBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			// Connection is broken, the output can't be delivered
+			m_outputBuffer.clear();
+			m_outputStreams.clear();
+			markTimeout();
+			return;
+		}
+	}
+
+	if (m_outputBuffer.size() + data.size() > TELNET_OUTPUT_BUFFER_LIMIT)
+	{
+		// Client is not reading, there is no point to keep the session
+		spdlog::warn("Telnet output buffer limit exceeded for {}", getPeerIP());
+		m_outputBuffer.clear();
+		m_outputStreams.clear();
+		markTimeout();
+		return;
 	}
+	m_outputBuffer.append(data);
 }
 
-void TelnetSession::eraseLine()
+void TelnetSession::flushOutput()
 {
-	// Send an erase line
-	ssize_t sendBytes = send(m_socket, ANSI_ERASE_LINE.c_str(), ANSI_ERASE_LINE.length(), 0);
-	if (sendBytes > 0)
+	if (!m_established)
 	{
-		stats.uploadBytes += static_cast<size_t>(sendBytes);
+		return;
 	}
 
-	// Move the cursor to the beginning of the line
-	const std::string moveBack = "\x1b[80D";
-	sendBytes = send(m_socket, moveBack.c_str(), moveBack.length(), 0);
+	// Pull lines from the streams only while there is room in the buffer
+	while (!m_pagerWaiting && !m_outputStreams.empty() && m_outputBuffer.size() < TELNET_OUTPUT_HIGH_WATERMARK)
+	{
+		auto &stream = m_outputStreams.front();
+
+		std::string line;
+		if (!stream.producer(line))
+		{
+			m_outputStreams.pop_front();
+			if (m_outputStreams.empty() && m_telnetServer->interactivePrompt())
+			{
+				sendPromptAndBuffer();
+			}
+			continue;
+		}
+
+		line.append("\r\n");
+		writeData(line);
+
+		// Streams are dropped if the buffer limit is exceeded
+		if (m_outputStreams.empty())
+		{
+			break;
+		}
+
+		if (stream.paged && ++stream.pageLines >= TELNET_PAGE_SIZE)
+		{
+			stream.pageLines = 0;
+			writeData(TELNET_PAGER_PROMPT);
+			m_pagerWaiting = !m_outputStreams.empty();
+		}
+	}
+
+	if (m_outputBuffer.empty())
+	{
+		return;
+	}
+
+	const ssize_t sendBytes = writeSocket(m_outputBuffer.data(), m_outputBuffer.size());
 	if (sendBytes > 0)
 	{
 		stats.uploadBytes += static_cast<size_t>(sendBytes);
+		m_outputBuffer.erase(0, static_cast<size_t>(sendBytes));
+	}
+	else if (sendBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	{
+		// Connection is broken, the output can't be delivered
+		m_outputBuffer.clear();
+		m_outputStreams.clear();
+		markTimeout();
 	}
 }
 
-void TelnetSession::sendLine(std::string data)
+void TelnetSession::processPagerInput(std::span<const char> data)
 {
-	// If is something is on the prompt, wipe it off
-	if (m_telnetServer->interactivePrompt() || !m_buffer.empty())
+	if (m_outputStreams.empty())
+	{
+		m_pagerWaiting = false;
+		return;
+	}
+
+	for (const char chr : data)
 	{
+		if (chr == ' ')
+		{
+			// Next page
+			m_outputStreams.front().pageLines = 0;
+		}
+		else if (chr == '\r' || chr == '\n')
+		{
+			// Next line
+			m_outputStreams.front().pageLines = TELNET_PAGE_SIZE - 1;
+		}
+		else if (chr == 'q' || chr == 'Q')
+		{
+			// Drop the rest of the output
+			m_outputStreams.pop_front();
+		}
+		else
+		{
+			continue;
+		}
+
+		// Remove the pager prompt, rest of the data is discarded
+		m_pagerWaiting = false;
 		eraseLine();
+		if (m_outputStreams.empty() && m_telnetServer->interactivePrompt())
+		{
+			sendPromptAndBuffer();
+		}
+		return;
 	}
+}
 
+void TelnetSession::sendPromptAndBuffer()
+{
+	// Search prompt replaces the prompt while searching
+	if (m_searching)
+	{
+		writeData(std::format("(reverse-i-search)'{}': {}", m_inputParser.buffer(),
+							  m_searchMatch < m_history->size() ? (*m_history)[m_searchMatch] : ""));
+		return;
+	}
+
+	// Output the prompt
+	writeData(m_telnetServer->promptString());
+
+	// Resend the buffer
+	if (const auto &buffer = m_inputParser.buffer(); !buffer.empty())
+	{
+		writeData(buffer);
+	}
+}
+
+void TelnetSession::eraseLine()
+{
+	// Send an erase line
+	writeData(ANSI_ERASE_LINE);
+
+	// Move the cursor to the beginning of the line
+	writeData("\x1b[80D");
+}
+
+void TelnetSession::sendLine(std::string data)
+{
 	data.append("\r\n");
-	if (const auto sendBytes = send(m_socket, data.c_str(), data.length(), 0); sendBytes > 0)
+
+	// Prompt is not displayed while streaming, just keep the ordering
+	if (!m_outputStreams.empty())
 	{
-		stats.uploadBytes += static_cast<size_t>(sendBytes);
+		writeData(data);
+		return;
+	}
+
+	// If is something is on the prompt, wipe it off
+	if (m_telnetServer->interactivePrompt() || !m_inputParser.buffer().empty())
+	{
+		eraseLine();
 	}
 
+	writeData(data);
+
 	if (m_telnetServer->interactivePrompt())
 	{
 		sendPromptAndBuffer();
 	}
 }
 
+void TelnetSession::sendStream(FPTR_LineProducer producer, bool paged)
+{
+	if (!producer)
+	{
+		return;
+	}
+
+	// Wipe off the prompt until the output is drained
+	if (m_outputStreams.empty() && (m_telnetServer->interactivePrompt() || !m_inputParser.buffer().empty()))
+	{
+		eraseLine();
+	}
+
+	m_outputStreams.push_back({.producer = std::move(producer), .paged = paged, .pageLines = 0});
+}
+
 void TelnetSession::closeClient()
 {
 	spdlog::info("Telnet connection to {} closed", getPeerIP());
 
+	// History is kept by the server for the next connection of the peer
+	if (m_history != nullptr)
+	{
+		m_telnetServer->historyArena().release(m_history);
+		m_history = nullptr;
+	}
+
+	// Notify the peer for TLS connections, does not wait for the response
+	if (m_ssl && m_established)
+	{
+		SSL_shutdown(m_ssl.get());
+		ERR_clear_error();
+	}
+
 	// Attempt to cleanly shutdown the connection since we're done
 	shutdown(m_socket, SHUT_WR);
 
@@ -213,11 +471,7 @@ void TelnetSession::echoBack(const char *buffer, unsigned long length)
 		return;
 	}
 
-	const ssize_t sendBytes = send(m_socket, buffer, length, 0);
-	if (sendBytes > 0)
-	{
-		stats.uploadBytes += static_cast<size_t>(sendBytes);
-	}
+	writeData({buffer, length});
 }
 
 void TelnetSession::initialise()
@@ -231,29 +485,37 @@ void TelnetSession::initialise()
 	unsigned long iMode = 1;
 	ioctl(m_socket, FIONBIO, &iMode);
 
-	// Set NVT mode to say that I will echo back characters.
-	const std::array<uint8_t, 3> willEcho{0xff, 0xfb, 0x01};
-	ssize_t sendBytes = send(m_socket, willEcho.data(), 3, 0);
-	if (sendBytes > 0)
+	// Responses are written in several small pieces (echo, line, prompt), don't let Nagle hold them for the ACKs
+	int noDelay = 1;
+	setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+	// Set last seen
+	lastSeenTime = std::chrono::system_clock::now();
+
+	// Telnet negotiation starts after the TLS handshake which is advanced by the server loop
+	if (m_ssl)
 	{
-		stats.uploadBytes += static_cast<size_t>(sendBytes);
+		SSL_set_fd(m_ssl.get(), m_socket);
+		SSL_set_accept_state(m_ssl.get());
+		m_handshakeStart = std::chrono::high_resolution_clock::now();
+		return;
 	}
 
+	establish();
+}
+
+void TelnetSession::establish()
+{
+	m_established = true;
+
+	// Set NVT mode to say that I will echo back characters.
+	writeData(TELNET_WILL_ECHO);
+
 	// Set NVT requesting that the remote system not/dont echo back characters
-	const std::array<uint8_t, 3> dontEcho{0xff, 0xfe, 0x01};
-	sendBytes = send(m_socket, dontEcho.data(), 3, 0);
-	if (sendBytes > 0)
-	{
-		stats.uploadBytes += static_cast<size_t>(sendBytes);
-	}
+	writeData(TELNET_DONT_ECHO);
 
 	// Set NVT mode to say that I will suppress go-ahead. Stops remote clients from doing local linemode.
-	const std::array<uint8_t, 3> willSGA{0xff, 0xfb, 0x03};
-	sendBytes = send(m_socket, willSGA.data(), 3, 0);
-	if (sendBytes > 0)
-	{
-		stats.uploadBytes += static_cast<size_t>(sendBytes);
-	}
+	writeData(TELNET_WILL_SGA);
 
 	if (m_telnetServer->connectedCallback())
 	{
@@ -264,186 +526,135 @@ void TelnetSession::initialise()
 	lastSeenTime = std::chrono::system_clock::now();
 }
 
-void TelnetSession::stripNVT(std::string &buffer)
+void TelnetSession::processTab()
 {
-	size_t found = 0;
-	do
+	if (!m_telnetServer->tabCallback())
 	{
-		found = buffer.find_first_of(static_cast<char>(ASCII_NBSP));
-		if (found != std::string::npos && (found + 2) <= buffer.length() - 1)
-		{
-			buffer.erase(found, 3);
-		}
-		else if ((found + 2) >= buffer.length())
-		{
-			break;
-		}
-	} while (found != std::string::npos);
-}
-
-void TelnetSession::stripEscapeCharacters(std::string &buffer)
-{
-	size_t found = 0;
-	const std::array<std::string, 4> cursors = {ANSI_ARROW_UP, ANSI_ARROW_DOWN, ANSI_ARROW_RIGHT, ANSI_ARROW_LEFT};
+		return;
+	}
 
-	for (const auto &cursor : cursors)
+	auto &buffer = m_inputParser.buffer();
+	if (std::string retCommand = m_telnetServer->tabCallback()(shared_from_this(), buffer); !retCommand.empty())
 	{
-		do
-		{
-			found = buffer.find(cursor);
-			if (found != std::string::npos)
-			{
-				buffer.erase(found, cursor.length());
-			}
-		} while (found != std::string::npos);
+		buffer = std::move(retCommand);
 	}
 }
 
-bool TelnetSession::processBackspace(std::string &buffer)
+void TelnetSession::addToHistory(const std::string &line)
 {
-	bool foundBackspaces = false;
-
-	size_t found = 0;
-	do
+	if (m_history == nullptr)
 	{
-		// Need to handle both \x7f and \b backspaces
-		found = buffer.find_first_of('\x7f');
-		if (found == std::string::npos)
-		{
-			found = buffer.find_first_of('\b');
-		}
+		return;
+	}
 
-		if (found != std::string::npos)
-		{
-			if (buffer.length() > 1 && (found > 0))
-			{
-				buffer.erase(found - 1, 2);
-			}
-			else
-			{
-				buffer = "";
-			}
-			foundBackspaces = true;
-		}
-	} while (found != std::string::npos);
-	return foundBackspaces;
+	// Add it to the history
+	m_history->push(line);
+	m_historyCursor = m_history->size();
 }
 
-bool TelnetSession::processTab(std::string &buffer)
+bool TelnetSession::processCommandHistory(TelnetInputEvent event)
 {
-	bool foundTabs = false;
-
-	size_t found = 0;
-	do
+	// Handle up and down arrow actions
+	if ((event == TelnetInputEvent::ArrowUp || event == TelnetInputEvent::ArrowDown) && m_history != nullptr &&
+		m_history->size() > 0)
 	{
-		found = buffer.find_first_of('\t');
-		if (found == std::string::npos)
-		{
-			continue;
-		}
+		// History might be shortened or extended by the other sessions of the peer
+		m_historyCursor = std::min(m_historyCursor, m_history->size());
 
-		// Remove single tab
-		if (!buffer.empty())
+		const std::string *counterCursor = nullptr;
+		if (event == TelnetInputEvent::ArrowUp)
 		{
-			buffer.erase(found, 1);
+			if (m_historyCursor > 0)
+			{
+				--m_historyCursor;
+			}
+			counterCursor = &ANSI_ARROW_DOWN;
 		}
-		foundTabs = true;
-
-		// Process
-		if (m_telnetServer->tabCallback())
+		else
 		{
-			const std::string retCommand = m_telnetServer->tabCallback()(shared_from_this(), buffer.substr(0, found));
-			if (!retCommand.empty())
+			if (m_historyCursor + 1 < m_history->size())
 			{
-				buffer.erase(0, found);
-				buffer.insert(0, retCommand);
+				++m_historyCursor;
 			}
+			counterCursor = &ANSI_ARROW_UP;
 		}
-	} while (found != std::string::npos);
-	return foundTabs;
-}
-
-void TelnetSession::addToHistory(const std::string &line)
-{
-	// Add it to the history
-	if (line != (!m_history.empty() ? m_history.back() : "") && !line.empty())
-	{
-		m_history.push_back(line);
-		if (m_history.size() > TELNET_HISTORY_LIMIT)
+		if (m_historyCursor < m_history->size())
 		{
-			m_history.pop_front();
+			m_inputParser.buffer() = (*m_history)[m_historyCursor];
 		}
+
+		// Issue a cursor command to counter it
+		writeData(*counterCursor);
+		return true;
 	}
-	m_historyCursor = m_history.end();
+
+	// Ignore left and right and just reprint buffer
+	return event == TelnetInputEvent::ArrowLeft || event == TelnetInputEvent::ArrowRight;
 }
 
-bool TelnetSession::processCommandHistory(std::string &buffer)
+bool TelnetSession::processReverseSearch(TelnetInputEvent event)
 {
-	// Handle up and down arrow actions
-	if (m_telnetServer->interactivePrompt())
+	if (m_history == nullptr)
 	{
-		if (buffer.find(ANSI_ARROW_UP) != std::string::npos && !m_history.empty())
-		{
-			if (m_historyCursor != m_history.begin())
-			{
-				--m_historyCursor;
-			}
-			buffer = *m_historyCursor;
+		return event == TelnetInputEvent::ReverseSearch;
+	}
 
-			// Issue a cursor command to counter it
-			ssize_t sendBytes = 0;
-			if ((sendBytes = send(m_socket, ANSI_ARROW_DOWN.c_str(), ANSI_ARROW_DOWN.length(), 0)) < 0)
-			{
-				return false;
-			}
-			stats.uploadBytes += static_cast<size_t>(sendBytes);
-			return true;
-		}
-		if (buffer.find(ANSI_ARROW_DOWN) != std::string::npos && !m_history.empty())
+	const auto acceptMatch = [this]() {
+		m_searching = false;
+		if (m_searchMatch < m_history->size())
 		{
-			if (next(m_historyCursor) != m_history.end())
-			{
-				++m_historyCursor;
-			}
-			buffer = *m_historyCursor;
-
-			// Issue a cursor command to counter it
-			ssize_t sendBytes = 0;
-			if ((sendBytes = send(m_socket, ANSI_ARROW_UP.c_str(), ANSI_ARROW_UP.length(), 0)) < 0)
-			{
-				return false;
-			}
-
-			stats.uploadBytes += static_cast<size_t>(sendBytes);
-			return true;
+			m_inputParser.buffer() = (*m_history)[m_searchMatch];
+			m_historyCursor = m_searchMatch;
 		}
-
-		// Ignore left and right and just reprint buffer
-		if (buffer.find(ANSI_ARROW_LEFT) != std::string::npos || buffer.find(ANSI_ARROW_RIGHT) != std::string::npos)
+		else
 		{
-			return true;
+			m_inputParser.buffer() = std::move(m_searchSavedLine);
 		}
-	}
-	return false;
-}
-
-std::vector<std::string> TelnetSession::getCompleteLines(std::string &buffer)
-{
-	// Now find all new lines (<CR><LF>) and place in a vector and delete from buffer
-	std::vector<std::string> lines;
+		m_searchSavedLine.clear();
+	};
 
-	size_t found = 0;
-	do
+	// Parser buffer holds the search pattern while searching
+	switch (event)
 	{
-		found = buffer.find("\r\n");
-		if (found != std::string::npos)
+	case TelnetInputEvent::ReverseSearch:
+		if (!m_searching)
 		{
-			lines.push_back(buffer.substr(0, found));
-			buffer.erase(0, found + 2);
+			m_searching = true;
+			m_searchSavedLine = m_inputParser.takeBuffer();
+			m_searchMatch = std::string::npos;
 		}
-	} while (found != std::string::npos);
-
-	return lines;
+		else if (m_searchMatch != std::string::npos)
+		{
+			// Continue with the older commands
+			if (const size_t older = m_history->rfind(m_inputParser.buffer(), m_searchMatch);
+				older != std::string::npos)
+			{
+				m_searchMatch = older;
+			}
+		}
+		return true;
+	case TelnetInputEvent::None:
+		// Pattern extended, current match is kept if it still matches
+		m_searchMatch = m_history->rfind(
+			m_inputParser.buffer(), m_searchMatch == std::string::npos ? m_history->size() : m_searchMatch + 1);
+		return true;
+	case TelnetInputEvent::Erase:
+		m_searchMatch = m_history->rfind(m_inputParser.buffer(), m_history->size());
+		return true;
+	case TelnetInputEvent::Cancel:
+		m_searching = false;
+		m_inputParser.buffer() = std::move(m_searchSavedLine);
+		m_searchSavedLine.clear();
+		return true;
+	case TelnetInputEvent::Line:
+		// Execute the match
+		acceptMatch();
+		return false;
+	default:
+		// Any other editing key accepts the match for editing
+		acceptMatch();
+		return true;
+	}
 }
 
 void TelnetSession::update()
@@ -456,14 +667,61 @@ void TelnetSession::update()
 	stats.downloadBytes = 0;
 	stats.successCmdCtr = 0;
 	stats.failCmdCtr = 0;
+	stats.tlsHandshakeCtr = 0;
+	stats.tlsResumedHandshakeCtr = 0;
+	stats.tlsFailedHandshakeCtr = 0;
+	stats.rateLimitedCmdCtr = 0;
+	stats.throttledReadCtr = 0;
+
+	// Advance the TLS handshake until the connection is ready
+	if (!m_established)
+	{
+		if (std::chrono::high_resolution_clock::now() - m_handshakeStart >
+			std::chrono::seconds(TELNET_TLS_HANDSHAKE_TIMEOUT))
+		{
+			spdlog::warn("TLS handshake with {} timed out", getPeerIP());
+			++stats.tlsFailedHandshakeCtr;
+			markTimeout();
+			return;
+		}
+
+		continueHandshake();
+		if (!m_established)
+		{
+			return;
+		}
+	}
+
+	// Read only as much as the byte rate allows, the rest waits in the socket buffer
+	const auto allowance =
+		static_cast<size_t>(std::min(m_byteBucket.available(), static_cast<double>(DEFAULT_BUFLEN)));
+	if (allowance == 0)
+	{
+		++stats.throttledReadCtr;
+		flushOutput();
+		return;
+	}
 
 	// Receive
-	readBytes = recv(m_socket, recvbuf.data(), DEFAULT_BUFLEN, 0);
+	readBytes = readSocket(recvbuf.data(), allowance);
 
-	// Check for errors from the read
-	if (readBytes < 0 && errno != EAGAIN)
+	// Check for errors from the read, socket is closed by the server after the timeout mark
+	if (readBytes == 0 || (readBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+	{
+		markTimeout();
+		return;
+	}
+	if (readBytes > 0)
 	{
-		close(m_socket);
+		m_byteBucket.consume(static_cast<double>(readBytes));
+	}
+	if (readBytes > 0 && m_pagerWaiting)
+	{
+		stats.downloadBytes += static_cast<size_t>(readBytes);
+		lastSeenTime = std::chrono::system_clock::now();
+
+		// Keys are consumed by the pager while it is waiting
+		processPagerInput(std::span(recvbuf.data(), static_cast<size_t>(readBytes)));
 	}
 	else if (readBytes > 0)
 	{
@@ -475,57 +733,69 @@ void TelnetSession::update()
 		// Echo it back to the sender
 		echoBack(recvbuf.data(), static_cast<size_t>(readBytes));
 
-		// we've got to be careful here. Telnet client might send null characters for New Lines mid-data block. We need
-		// to swap these out. recv is not null terminated, so its cool
-		std::replace_if(
-			recvbuf.begin(), recvbuf.begin() + readBytes, [](char chr) { return chr == ASCII_NULL; }, ASCII_LF);
-
-		// Add it to the received buffer
-		m_buffer.append(recvbuf.data(), static_cast<unsigned int>(readBytes));
-		// Remove telnet negotiation sequences
-		stripNVT(m_buffer);
+		// Line editing keys are only meaningful with an interactive prompt
+		m_inputParser.lineEditing(m_telnetServer->interactivePrompt());
 
+		// Parse received data in a single pass and act on the produced events
 		bool requirePromptReprint = false;
-		if (m_telnetServer->interactivePrompt())
+		for (const char chr : std::span(recvbuf.data(), static_cast<size_t>(readBytes)))
 		{
-			// Read up and down arrow keys and scroll through history
-			if (processCommandHistory(m_buffer))
+			const auto event = m_inputParser.consume(chr);
+			if ((m_searching || event == TelnetInputEvent::ReverseSearch) && processReverseSearch(event))
 			{
 				requirePromptReprint = true;
+				continue;
 			}
-			stripEscapeCharacters(m_buffer);
 
-			// Remove characters
-			if (processBackspace(m_buffer))
+			switch (event)
 			{
-				requirePromptReprint = true;
+			case TelnetInputEvent::None:
+				break;
+			case TelnetInputEvent::Line: {
+				const std::string line = m_inputParser.takeBuffer();
+				if (!m_commandBucket.consume())
+				{
+					++stats.rateLimitedCmdCtr;
+					sendLine(TELNET_TOO_MANY_COMMANDS);
+				}
+				else if (m_telnetServer->newLineCallBack())
+				{
+					const bool isSucceeded = m_telnetServer->newLineCallBack()(shared_from_this(), line);
+					isSucceeded ? ++stats.successCmdCtr : ++stats.failCmdCtr;
+					if (m_telnetServer->auditCallback())
+					{
+						m_telnetServer->auditCallback()(getPeerIP(), line, isSucceeded);
+					}
+					addToHistory(line);
+				}
+				break;
 			}
-			// Complete commands
-			if (processTab(m_buffer))
-			{
+			case TelnetInputEvent::Tab:
+				processTab();
 				requirePromptReprint = true;
-			}
-		}
-
-		// Process commands
-		auto lines = getCompleteLines(m_buffer);
-		for (const auto &line : lines)
-		{
-			if (!m_telnetServer->newLineCallBack())
-			{
+				break;
+			case TelnetInputEvent::Erase:
+				requirePromptReprint = true;
+				break;
+			default:
+				// Read up and down arrow keys and scroll through history
+				if (processCommandHistory(event))
+				{
+					requirePromptReprint = true;
+				}
 				break;
 			}
-
-			m_telnetServer->newLineCallBack()(shared_from_this(), line) ? ++stats.successCmdCtr : ++stats.failCmdCtr;
-			addToHistory(line);
 		}
 
-		if (requirePromptReprint && m_telnetServer->interactivePrompt())
+		if (requirePromptReprint && m_telnetServer->interactivePrompt() && m_outputStreams.empty())
 		{
 			eraseLine();
 			sendPromptAndBuffer();
 		}
 	}
+
+	// Continue with the pending output
+	flushOutput();
 }
 
 /* ------------------ Telnet Server -------------------*/
@@ -602,12 +872,17 @@ bool TelnetServer::initialise(unsigned long listenPort, const std::shared_ptr<st
 	}
 	freeaddrinfo(result);
 
-	if (listen(m_listenSocket, SOMAXCONN) < 0)
+	// Keep the backlog small, so a flood is pushed back by the kernel (SYN cookies) instead of the server loop
+	if (listen(m_listenSocket, m_limits.listenBacklog) < 0)
 	{
 		close(m_listenSocket);
 		return false;
 	}
 
+	// Pending connections are accepted until the queue is empty
+	unsigned long iMode = 1;
+	ioctl(m_listenSocket, FIONBIO, &iMode);
+
 	// If prometheus registry is provided prepare statistics
 	if (reg)
 	{
@@ -620,32 +895,124 @@ bool TelnetServer::initialise(unsigned long listenPort, const std::shared_ptr<st
 	return true;
 }
 
-bool TelnetServer::acceptConnection()
+bool TelnetServer::initialiseTLS(const std::string &certPath, const std::string &keyPath)
 {
-	const Socket ClientSocket = accept(m_listenSocket, nullptr, nullptr);
-	if (ClientSocket == INVALID_SOCKET)
+	if (m_initialised)
 	{
 		return false;
 	}
-	if (m_sessions.size() >= MAX_AVAILABLE_SESSION)
+
+	std::unique_ptr<SSL_CTX, TelnetSSLDeleter> sslContext(SSL_CTX_new(TLS_server_method()));
+	if (!sslContext)
 	{
-		// Create for only sending error
-		const auto session = std::make_shared<TelnetSession>(ClientSocket, shared_from_this());
-		session->initialise();
+		return false;
+	}
+	SSL_CTX_set_min_proto_version(sslContext.get(), TLS1_2_VERSION);
 
-		session->sendLine("Too many active connections. Please try again later. \r\nClosing...");
-		session->closeClient();
+	// Output buffer of the session is retried as it grows, so writes can be partial and buffer can move
+	SSL_CTX_set_mode(sslContext.get(), SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+	if (SSL_CTX_use_certificate_chain_file(sslContext.get(), certPath.c_str()) != 1 ||
+		SSL_CTX_use_PrivateKey_file(sslContext.get(), keyPath.c_str(), SSL_FILETYPE_PEM) != 1 ||
+		SSL_CTX_check_private_key(sslContext.get()) != 1)
+	{
+		spdlog::error("Can't load TLS certificate {} and key {}: {}", certPath, keyPath,
+					  ERR_reason_error_string(ERR_get_error()));
+		ERR_clear_error();
 		return false;
 	}
 
-	const auto session = std::make_shared<TelnetSession>(ClientSocket, shared_from_this());
-	m_sessions.push_back(session);
-	session->initialise();
+	// Session resumption. Ticket keys live with the context, so reconnects skip the full handshake until restart
+	SSL_CTX_set_session_cache_mode(sslContext.get(), SSL_SESS_CACHE_SERVER);
+	SSL_CTX_set_session_id_context(sslContext.get(),
+								   std::bit_cast<const unsigned char *>(TELNET_TLS_SESSION_ID_CONTEXT.data()),
+								   static_cast<unsigned int>(TELNET_TLS_SESSION_ID_CONTEXT.size()));
+	SSL_CTX_set_num_tickets(sslContext.get(), TELNET_TLS_TICKET_COUNT);
+	SSL_CTX_set_timeout(sslContext.get(), TELNET_TLS_SESSION_LIFETIME);
+
+	m_sslContext = std::move(sslContext);
 	return true;
 }
 
+bool TelnetServer::admitPeer(in_addr_t peerAddr)
+{
+	if (m_peerBuckets.size() >= TELNET_PEER_BUCKET_LIMIT)
+	{
+		// Full buckets are equivalent to new ones
+		for (auto itr = m_peerBuckets.begin(); itr != m_peerBuckets.end();)
+		{
+			itr = itr->second.full() ? m_peerBuckets.erase(itr) : std::next(itr);
+		}
+	}
+
+	auto [itr, inserted] = m_peerBuckets.try_emplace(peerAddr, m_limits.connectionRate, m_limits.connectionBurst);
+	return itr->second.consume();
+}
+
+void TelnetServer::acceptConnections(TelnetServerStats &serverStats)
+{
+	for (size_t idx = 0; idx < m_limits.acceptBatch; ++idx)
+	{
+		sockaddr_in peerAddr{};
+		socklen_t addrSize = sizeof(peerAddr);
+		const Socket ClientSocket = accept(m_listenSocket, std::bit_cast<sockaddr *>(&peerAddr), &addrSize);
+		if (ClientSocket == INVALID_SOCKET)
+		{
+			return;
+		}
+
+		// Admission is checked before any session state is created
+		if (!admitPeer(peerAddr.sin_addr.s_addr))
+		{
+			close(ClientSocket);
+			++serverStats.rateLimitedConnectionCtr;
+			continue;
+		}
+
+		if (m_sessions.size() >= m_limits.maxSessions)
+		{
+			// Best effort notification, not delivered over TLS as there is no handshake
+			if (!m_sslContext)
+			{
+				send(ClientSocket, TELNET_TOO_MANY_SESSIONS.c_str(), TELNET_TOO_MANY_SESSIONS.size(),
+					 MSG_NOSIGNAL | MSG_DONTWAIT);
+			}
+			close(ClientSocket);
+			++serverStats.refusedConnectionCtr;
+			continue;
+		}
+
+		const auto session = std::make_shared<TelnetSession>(ClientSocket, shared_from_this());
+		if (m_sslContext)
+		{
+			session->m_ssl.reset(SSL_new(m_sslContext.get()));
+			if (!session->m_ssl)
+			{
+				close(ClientSocket);
+				++serverStats.refusedConnectionCtr;
+				continue;
+			}
+		}
+		session->m_history = m_historyArena.acquire(session->getPeerIP());
+		m_sessions.push_back(session);
+		session->initialise();
+		++serverStats.acceptedConnectionCtr;
+	}
+}
+
 void TelnetServer::threadFunc(const std::stop_token &stopToken) noexcept
 {
+	pthread_setname_np(pthread_self(), "telnet");
+
+	// OpenSSL writes can't use MSG_NOSIGNAL, broken connections are reported by the write errors instead
+	if (m_sslContext)
+	{
+		sigset_t sigSet;
+		sigemptyset(&sigSet);
+		sigaddset(&sigSet, SIGPIPE);
+		pthread_sigmask(SIG_BLOCK, &sigSet, nullptr);
+	}
+
 	spdlog::info("Telnet server started");
 	while (!stopToken.stop_requested())
 	{
@@ -660,39 +1027,49 @@ void TelnetServer::threadFunc(const std::stop_token &stopToken) noexcept
 		catch (const std::exception &e)
 		{
 			spdlog::error("Telnet server failed: {}", e.what());
+			std::this_thread::sleep_for(std::chrono::milliseconds(SLEEP_INTERVAL_MS));
 		}
-		std::this_thread::sleep_for(std::chrono::milliseconds(SLEEP_INTERVAL_MS));
 	}
+
+	// Sessions are closed here rather than by the stopping thread, since closing a TLS session writes to the socket
+	// and SIGPIPE is only blocked in this thread
+	for (const SP_TelnetSession &tSession : m_sessions)
+	{
+		tSession->closeClient();
+	}
+	m_sessions.clear();
 	spdlog::info("Telnet server stopped");
 }
 
 void TelnetServer::update()
 {
-	// See if connection pending on the listening socket
-	fd_set readSet;
-	FD_ZERO(&readSet);
-	FD_SET(m_listenSocket, &readSet);
-	timeval timeout{};
-	timeout.tv_sec = 0; // Zero timeout (poll)
-	timeout.tv_usec = 0;
+	// Wait for a pending connection, received data or a session which can write its pending output. Unlike select,
+	// poll has no limit on the descriptor values
+	m_pollFds.clear();
+	m_pollFds.push_back({.fd = m_listenSocket, .events = POLLIN, .revents = 0});
+	bool hasBufferedInput = false;
+	for (const auto &session : m_sessions)
+	{
+		// Throttled sessions are not polled until they are allowed to read again
+		short events = session->isThrottled() ? 0 : POLLIN;
+		if (session->hasPendingOutput())
+		{
+			events |= POLLOUT;
+		}
+		m_pollFds.push_back({.fd = session->m_socket, .events = events, .revents = 0});
+		hasBufferedInput = hasBufferedInput || session->hasBufferedInput();
+	}
 
-	bool newConnectionAccept = false;
-	bool newConnectionRefused = false;
+	// Don't wait if TLS connections already hold decrypted data
+	const int nReady = poll(m_pollFds.data(), m_pollFds.size(), hasBufferedInput ? 0 : SLEEP_INTERVAL_MS);
 
 	TelnetServerStats serverStats;
-	serverStats.processingTimeStart = std::chrono::high_resolution_clock::now();
+	serverStats.processingTimeStart = TscClock::now();
 
-	// If there is a connection pending, accept it.
-	if (select(m_listenSocket + 1, &readSet, nullptr, nullptr, &timeout) > 0)
+	// If there are connections pending, accept them.
+	if (nReady > 0 && (m_pollFds.front().revents & POLLIN) != 0)
 	{
-		if (acceptConnection())
-		{
-			newConnectionAccept = true;
-		}
-		else
-		{
-			newConnectionRefused = true;
-		}
+		acceptConnections(serverStats);
 	}
 
 	// Update all the telnet Sessions that are currently in flight.
@@ -722,9 +1099,7 @@ void TelnetServer::update()
 	}
 
 	serverStats.activeConnectionCtr = m_sessions.size();
-	serverStats.acceptedConnectionCtr = static_cast<uint64_t>(newConnectionAccept);
-	serverStats.refusedConnectionCtr = static_cast<uint64_t>(newConnectionRefused);
-	serverStats.processingTimeEnd = std::chrono::high_resolution_clock::now();
+	serverStats.processingTimeEnd = TscClock::now();
 	if (m_stats)
 	{
 		m_stats->consumeStats(serverStats);
@@ -733,22 +1108,212 @@ void TelnetServer::update()
 
 void TelnetServer::shutdown()
 {
-	// Attempt to cleanly close every telnet session in flight.
-	for (const SP_TelnetSession &tSession : m_sessions)
+	// Sessions are owned and closed by the server thread when it stops
+	if (m_serverThread)
 	{
-		tSession->closeClient();
+		m_serverThread.reset();
 	}
-	m_sessions.clear();
 
 	// No longer need server socket so close it.
 	close(m_listenSocket);
 	m_listenSocket = INVALID_SOCKET;
 	m_initialised = false;
+}
 
-	if (m_serverThread)
+namespace
+{
+	bool clearCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
 	{
-		m_serverThread.reset();
+		session->sendLine(TELNET_CLEAR_SCREEN);
+		return true;
+	}
+
+	bool disableLogCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		session->sendLine("Default log mode enabled");
+#ifdef NDEBUG
+		spdlog::set_level(spdlog::level::warn);
+#else
+		spdlog::set_level(spdlog::level::info);
+#endif
+		return true;
+	}
+
+	bool disableAllLogCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		session->sendLine("Disabling all logs");
+		spdlog::set_level(spdlog::level::off);
+		return true;
+	}
+
+	bool enableLogCommand(const SP_TelnetSession &session, std::string_view args)
+	{
+		if (args == "v")
+		{
+			session->sendLine("Info log mode enabled");
+			spdlog::set_level(spdlog::level::info);
+			return true;
+		}
+		if (args == "vv")
+		{
+			session->sendLine("Debug log mode enabled");
+			spdlog::set_level(spdlog::level::debug);
+			return true;
+		}
+		if (args == "vvv")
+		{
+			session->sendLine("Trace log mode enabled");
+			spdlog::set_level(spdlog::level::trace);
+			return true;
+		}
+
+		session->sendLine("Unknown command received");
+		return false;
+	}
+
+	bool helpCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		TelnetPrintAvailableCommands(session);
+		return true;
+	}
+
+	bool pingCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		session->sendLine("pong");
+		return true;
+	}
+
+	bool profilerStartCommand(const SP_TelnetSession &session, std::string_view args)
+	{
+		uint32_t frequency = PROFILER_DEFAULT_FREQUENCY;
+		if (!args.empty() && std::from_chars(args.data(), args.data() + args.size(), frequency).ec != std::errc{})
+		{
+			session->sendLine("Invalid sampling frequency");
+			return false;
+		}
+
+		if (!Profiler().start(frequency))
+		{
+			session->sendLine("Profiler can't be started");
+			return false;
+		}
+		session->sendLine(Profiler().summary());
+		return true;
+	}
+
+	bool profilerStopCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		if (!Profiler().stop())
+		{
+			session->sendLine("Profiler is not running");
+			return false;
+		}
+		session->sendLine(Profiler().summary());
+		return true;
+	}
+
+	bool profilerStatusCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		session->sendLine(Profiler().summary());
+		return true;
+	}
+
+	bool profilerDumpCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		// Stacks are symbolised once and streamed as the client drains them
+		session->sendStream([stacks = Profiler().foldedStacks(), idx = size_t{0}](std::string &line) mutable {
+			if (idx >= stacks.size())
+			{
+				return false;
+			}
+			line = std::move(stacks[idx++]);
+			return true;
+		});
+		return true;
+	}
+
+	bool statusCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		// Flags are checked while the output is drained
+		session->sendStream([idx = size_t{0}](std::string &line) mutable {
+			if (idx >= vCheckFlag.size())
+			{
+				return false;
+			}
+			const auto &[service, statusFlag] = vCheckFlag[idx++];
+			line = std::format("{:.<{}}{:.>{}} ", service + " ", KEY_WIDTH,
+							   (statusFlag->test() ? " OK" : " Not Active"), VAL_WIDTH);
+			return true;
+		});
+		return true;
+	}
+
+	bool testMessageCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		session->sendLine("OK");
+		return true;
+	}
+
+	bool versionCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		session->sendLine(PROJECT_FULL_VERSION_STRING);
+		return true;
+	}
+
+	bool quitCommand(const SP_TelnetSession &session, std::string_view /*unused*/)
+	{
+		session->sendLine("Closing connection");
+		session->sendLine("Goodbye!");
+		session->markTimeout();
+		return true;
 	}
+
+	// Built-in commands, registered to the registry on first access. Commands without description are hidden.
+	// NOLINTBEGIN
+	const std::vector<TelnetCommand> telnetCommands = {
+		{"clear", "Clears the terminal screen", clearCommand, false},
+		{"disable log", "Resets logger level", disableLogCommand, false},
+		{"disable log all", "", disableAllLogCommand, false}, // Internal use only
+		{"enable log", R"(Enable specified logger level. Level can be "v" (info), "vv" (debug) and "vvv" (trace))",
+		 enableLogCommand, true},
+		{"help", "Prints available commands", helpCommand, false},
+		{"ping", "Pings the server", pingCommand, false},
+		{"profiler dump", "Prints the sampled stacks in folded format for flame graphs", profilerDumpCommand, false},
+		{"profiler start", "Starts the sampling profiler. Sampling frequency in Hz can be given, defaults to 99",
+		 profilerStartCommand, true},
+		{"profiler status", "Prints the state of the sampling profiler", profilerStatusCommand, false},
+		{"profiler stop", "Stops the sampling profiler, samples are kept until the next start", profilerStopCommand,
+		 false},
+		{"status", "Checks the internal status", statusCommand, false},
+		{"Test Message", "", testMessageCommand, false}, // Internal use only
+		{"version", "Displays the current version", versionCommand, false},
+		/* ################################################################################### */
+		/* ############################# MAKE MODIFICATIONS HERE ############################# */
+		/* ################################################################################### */
+
+		/* ################################################################################### */
+		/* ################################ END MODIFICATIONS ################################ */
+		/* ################################################################################### */
+		{"quit", "Ends the connection", quitCommand, false}};
+	// NOLINTEND
+} // namespace
+
+TelnetCommandRegistry &TelnetCommands()
+{
+	static TelnetCommandRegistry registry;
+	static const bool isRegistered = [] {
+		for (const auto &command : telnetCommands)
+		{
+			if (!registry.registerCommand(command.name, command.info, command.handler, command.hasArguments))
+			{
+				spdlog::warn("Telnet command {} is already registered", command.name);
+			}
+		}
+		return true;
+	}();
+	(void)isRegistered;
+
+	return registry;
 }
 
 void TelnetPrintAvailableCommands(const SP_TelnetSession &session)
@@ -757,14 +1322,17 @@ void TelnetPrintAvailableCommands(const SP_TelnetSession &session)
 	session->sendLine("");
 	session->sendLine("Available commands:");
 	session->sendLine("");
-	for (const auto &[command, info] : telnetCommands)
-	{
-		std::array<char, BUFSIZ> buffer{'\0'};
-		if (std::format_to_n(buffer.data(), BUFSIZ, "{:<25} : {}", command, info).size > 0)
-		{
-			session->sendLine(buffer.data());
-		}
-	}
+	session->sendStream(
+		[commands = TelnetCommands().commands(), idx = size_t{0}](std::string &line) mutable {
+			if (idx >= commands.size())
+			{
+				return false;
+			}
+			const auto &[command, info] = commands[idx++];
+			line = std::format("{:<25} : {}", command, info);
+			return true;
+		},
+		true);
 }
 
 void TelnetConnectedCallback(const SP_TelnetSession &session)
@@ -789,91 +1357,30 @@ bool TelnetMessageCallback(const SP_TelnetSession &session, const std::string &l
 	}
 
 	// Process received message
-	switch (constHasher(line.c_str()))
+	std::string_view args;
+	if (const auto handler = TelnetCommands().find(line, args); handler)
 	{
-	case constHasher("Test Message"):
-		session->sendLine("OK");
-		return true;
-	case constHasher("help"):
-		TelnetPrintAvailableCommands(session);
-		return true;
-	case constHasher("disable log"):
-		session->sendLine("Default log mode enabled");
-#ifdef NDEBUG
-		spdlog::set_level(spdlog::level::warn);
-#else
-		spdlog::set_level(spdlog::level::info);
-#endif
-		return true;
-	case constHasher("disable log all"): // Internal use only
-		session->sendLine("Disabling all logs");
-		spdlog::set_level(spdlog::level::off);
-		return true;
-	case constHasher("enable log v"):
-		session->sendLine("Info log mode enabled");
-		spdlog::set_level(spdlog::level::info);
-		return true;
-	case constHasher("enable log vv"):
-		session->sendLine("Debug log mode enabled");
-		spdlog::set_level(spdlog::level::debug);
-		return true;
-	case constHasher("enable log vvv"):
-		session->sendLine("Trace log mode enabled");
-		spdlog::set_level(spdlog::level::trace);
-		return true;
-	case constHasher("ping"):
-		session->sendLine("pong");
-		return true;
-	case constHasher("version"):
-		session->sendLine(PROJECT_FULL_VERSION_STRING);
-		return true;
-	case constHasher("clear"):
-		session->sendLine(TELNET_CLEAR_SCREEN);
-		return true;
-	case constHasher("status"):
-		for (const auto &[service, statusFlag] : vCheckFlag)
-		{
-			session->sendLine(std::format("{:.<{}}{:.>{}} ", service + " ", KEY_WIDTH,
-										  (statusFlag->test() ? " OK" : " Not Active"), VAL_WIDTH));
-		}
-		return true;
-	/* ################################################################################### */
-	/* ############################# MAKE MODIFICATIONS HERE ############################# */
-	/* ################################################################################### */
-
-	/* ################################################################################### */
-	/* ################################ END MODIFICATIONS ################################ */
-	/* ################################################################################### */
-	case constHasher("quit"):
-		session->sendLine("Closing connection");
-		session->sendLine("Goodbye!");
-		session->markTimeout();
-		return true;
-	default:
-		session->sendLine("Unknown command received");
-		return false;
+		return handler(session, args);
 	}
+
+	session->sendLine("Unknown command received");
+	return false;
 }
 
 std::string TelnetTabCallback(const SP_TelnetSession &session, std::string_view line)
 {
-	std::string retval;
+	std::vector<std::string> candidates;
+	std::string retval = TelnetCommands().complete(line, candidates);
 
-	size_t ctr = 0;
-	std::ostringstream sStream;
-	for (const auto &[command, info] : telnetCommands)
+	// Complete the longest common prefix if it extends the line. Otherwise send suggestions if found any
+	if (candidates.size() > 1 && retval.size() <= line.size())
 	{
-		if (command.starts_with(line))
+		std::string suggestions;
+		for (const auto &candidate : candidates)
 		{
-			++ctr;
-			retval = command;
-			sStream << command << std::setw(KEY_WIDTH);
+			suggestions += std::format("{:<{}}", candidate, KEY_WIDTH);
 		}
-	}
-	// Send suggestions if found any. If there is only one command retval will invoke completion
-	if (ctr != 1 && (!sStream.str().empty()))
-	{
-		session->sendLine(sStream.str());
+		session->sendLine(suggestions);
 		retval = "";
 	}
 
@@ -3,11 +3,14 @@
 #include <date/date.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
+#include <prometheus/histogram.h>
 #include <prometheus/info.h>
-#include <prometheus/summary.h>
 
 #include <limits>
 
+// Highest exported bucket of the session durations in seconds, ~36 hours
+constexpr uint64_t TELNET_SESSION_DURATION_HIGHEST_BOUNDARY = uint64_t{1} << 17;
+
 TelnetStats::TelnetStats(const std::shared_ptr<prometheus::Registry> &reg, uint16_t portNumber,
 						 const std::string &prependName)
 	: BaseServerStats()
@@ -58,11 +61,10 @@ TelnetStats::TelnetStats(const std::shared_ptr<prometheus::Registry> &reg, uint1
 							   .Add({});
 
 	// Session durations
-	_sessionDuration = &prometheus::BuildSummary()
-							.Name(name + "session_duration")
-							.Help("Duration of sessions")
-							.Register(*reg)
-							.Add({}, QUANTILE_DEFAULTS);
+	auto &sessionDurationFamily =
+		prometheus::BuildHistogram().Name(name + "session_duration").Help("Duration of sessions").Register(*reg);
+	_sessionDuration = std::make_unique<LatencyHistogram>(reg, sessionDurationFamily, prometheus::Labels{}, 1,
+														  TELNET_SESSION_DURATION_HIGHEST_BOUNDARY);
 	_maxSessionDuration = &prometheus::BuildGauge()
 							   .Name(name + "maximum_session_duration")
 							   .Help("Maximum duration of sessions")
@@ -74,6 +76,45 @@ TelnetStats::TelnetStats(const std::shared_ptr<prometheus::Registry> &reg, uint1
 							   .Register(*reg)
 							   .Add({});
 
+	// TLS handshake stats
+	_tlsHandshake = &prometheus::BuildCounter()
+						 .Name(name + "tls_handshakes")
+						 .Help("Number of completed TLS handshakes")
+						 .Register(*reg)
+						 .Add({});
+	_tlsResumedHandshake = &prometheus::BuildCounter()
+								.Name(name + "tls_resumed_handshakes")
+								.Help("Number of TLS handshakes completed with session resumption")
+								.Register(*reg)
+								.Add({});
+	_tlsFailedHandshake = &prometheus::BuildCounter()
+							   .Name(name + "tls_failed_handshakes")
+							   .Help("Number of failed TLS handshakes")
+							   .Register(*reg)
+							   .Add({});
+	auto &tlsHandshakeDurationFamily = prometheus::BuildHistogram()
+										   .Name(name + "tls_handshake_duration")
+										   .Help("Duration of TLS handshakes")
+										   .Register(*reg);
+	_tlsHandshakeDuration = std::make_unique<LatencyHistogram>(reg, tlsHandshakeDurationFamily);
+
+	// Admission control stats
+	_rateLimitedConnection = &prometheus::BuildCounter()
+								  .Name(name + "rate_limited_connections")
+								  .Help("Number of connections rejected by the peer rate limit")
+								  .Register(*reg)
+								  .Add({});
+	_rateLimitedCommand = &prometheus::BuildCounter()
+							   .Name(name + "rate_limited_commands")
+							   .Help("Number of commands rejected by the rate limit")
+							   .Register(*reg)
+							   .Add({});
+	_throttledRead = &prometheus::BuildCounter()
+						  .Name(name + "throttled_reads")
+						  .Help("Number of reads paused by the byte rate limit")
+						  .Register(*reg)
+						  .Add({});
+
 	// Set defaults
 	_minSessionDuration->Set(std::numeric_limits<int>::max());
 }
@@ -85,12 +126,25 @@ void TelnetStats::consumeStats(const TelnetSessionStats &stat, bool sessionClose
 	_totalUploadBytes->Increment(static_cast<double>(stat.uploadBytes));
 	_totalDownloadBytes->Increment(static_cast<double>(stat.downloadBytes));
 
+	// TLS handshake stats
+	if (stat.tlsHandshakeCtr > 0)
+	{
+		_tlsHandshake->Increment(static_cast<double>(stat.tlsHandshakeCtr));
+		_tlsResumedHandshake->Increment(static_cast<double>(stat.tlsResumedHandshakeCtr));
+		_tlsHandshakeDuration->record(static_cast<uint64_t>(stat.tlsHandshakeDuration.count()));
+	}
+	_tlsFailedHandshake->Increment(static_cast<double>(stat.tlsFailedHandshakeCtr));
+
+	// Rate limits
+	_rateLimitedCommand->Increment(static_cast<double>(stat.rateLimitedCmdCtr));
+	_throttledRead->Increment(static_cast<double>(stat.throttledReadCtr));
+
 	if (sessionClosed)
 	{
 		// Session durations
 		const auto sessionTime = static_cast<double>(
 			std::chrono::duration_cast<std::chrono::seconds>(stat.disconnectTime - stat.connectTime).count());
-		_sessionDuration->Observe(sessionTime);
+		_sessionDuration->record(static_cast<uint64_t>(sessionTime));
 		if (sessionTime < _minSessionDuration->Value())
 		{
 			_minSessionDuration->Set(sessionTime);
@@ -108,6 +162,7 @@ void TelnetStats::consumeStats(const TelnetServerStats &stat)
 	_activeConnection->Set(static_cast<double>(stat.activeConnectionCtr));
 	_refusedConnection->Increment(static_cast<double>(stat.refusedConnectionCtr));
 	_totalConnection->Increment(static_cast<double>(stat.acceptedConnectionCtr));
+	_rateLimitedConnection->Increment(static_cast<double>(stat.rateLimitedConnectionCtr));
 
 	// Performance stats if there is an active connection
 	if (stat.activeConnectionCtr > 0)
@@ -1,10 +1,32 @@
 #include "utils/BaseServerStats.hpp"
 
 #include <prometheus/counter.h>
-#include <prometheus/summary.h>
+#include <prometheus/gauge.h>
+#include <prometheus/histogram.h>
+
+namespace
+{
+	void atomicMin(std::atomic<double> &target, double value)
+	{
+		double current = target.load(std::memory_order_relaxed);
+		while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void atomicMax(std::atomic<double> &target, double value)
+	{
+		double current = target.load(std::memory_order_relaxed);
+		while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+} // namespace
 
 void BaseServerStats::initBaseStats(const std::shared_ptr<prometheus::Registry> &reg, const std::string &name)
 {
+	_shards = std::make_unique<StatsShard[]>(BASE_STATS_SHARDS);
+
 	// Command stats
 	_succeededCommand = &prometheus::BuildCounter()
 							 .Name(name + "succeeded_commands")
@@ -23,11 +45,11 @@ void BaseServerStats::initBaseStats(const std::shared_ptr<prometheus::Registry>
 						 .Add({});
 
 	// Performance stats
-	_processingTime = &prometheus::BuildSummary()
-						   .Name(name + "processing_time")
-						   .Help("Command processing performance")
-						   .Register(*reg)
-						   .Add({}, QUANTILE_DEFAULTS);
+	auto &processingTimeFamily = prometheus::BuildHistogram()
+									 .Name(name + "processing_time")
+									 .Help("Command processing performance")
+									 .Register(*reg);
+	_processingTimeHistogram = std::make_unique<LatencyHistogram>(reg, processingTimeFamily);
 	_maxProcessingTime = &prometheus::BuildGauge()
 							  .Name(name + "maximum_processing_time")
 							  .Help("Maximum value of the command processing performance")
@@ -41,20 +63,64 @@ void BaseServerStats::initBaseStats(const std::shared_ptr<prometheus::Registry>
 
 	// Set defaults
 	_minProcessingTime->Set(std::numeric_limits<int>::max());
+
+	// Shards are only aggregated when scraped if the registry supports it
+	_scrapeCallback = std::make_unique<ScrapeCallback>(reg, [this] { flushBaseStats(); });
+	_flushOnConsume = !_scrapeCallback->isRegistered();
+}
+
+void BaseServerStats::flushBaseStats()
+{
+	const std::scoped_lock guard(_flushLock);
+
+	// Commands consumed during the flush may be split between this flush and the next one
+	uint64_t succeeded = 0;
+	uint64_t failed = 0;
+	double minProcessingTime = std::numeric_limits<double>::max();
+	double maxProcessingTime = 0;
+	for (size_t shardIdx = 0; shardIdx < BASE_STATS_SHARDS; ++shardIdx)
+	{
+		auto &shard = _shards[shardIdx];
+		succeeded += shard.succeeded.exchange(0, std::memory_order_relaxed);
+		failed += shard.failed.exchange(0, std::memory_order_relaxed);
+		minProcessingTime = std::min(minProcessingTime, shard.minProcessingTime.load(std::memory_order_relaxed));
+		maxProcessingTime = std::max(maxProcessingTime, shard.maxProcessingTime.load(std::memory_order_relaxed));
+	}
+
+	// Command stats
+	if (succeeded + failed > 0)
+	{
+		_succeededCommand->Increment(static_cast<double>(succeeded));
+		_failedCommand->Increment(static_cast<double>(failed));
+		_totalCommand->Increment(static_cast<double>(succeeded + failed));
+	}
+
+	// Performance stats
+	if (maxProcessingTime > 0)
+	{
+		_maxProcessingTime->Set(maxProcessingTime);
+		_minProcessingTime->Set(minProcessingTime);
+	}
 }
 
 void BaseServerStats::consumeBaseStats(uint64_t succeeded, uint64_t failed, double processingTime)
 {
+	auto &shard = _shards[threadShardIndex() % BASE_STATS_SHARDS];
+
 	// Command stats
-	_succeededCommand->Increment(static_cast<double>(succeeded));
-	_failedCommand->Increment(static_cast<double>(failed));
-	_totalCommand->Increment(static_cast<double>(succeeded + failed));
+	shard.succeeded.fetch_add(succeeded, std::memory_order_relaxed);
+	shard.failed.fetch_add(failed, std::memory_order_relaxed);
 
 	// Performance stats
 	if (processingTime > 0)
 	{
-		_processingTime->Observe(processingTime);
-		_maxProcessingTime->Set(std::max(_maxProcessingTime->Value(), processingTime));
-		_minProcessingTime->Set(std::min(_minProcessingTime->Value(), processingTime));
+		_processingTimeHistogram->record(static_cast<uint64_t>(processingTime));
+		atomicMin(shard.minProcessingTime, processingTime);
+		atomicMax(shard.maxProcessingTime, processingTime);
+	}
+
+	if (_flushOnConsume)
+	{
+		flushBaseStats();
 	}
 }
@@ -6,6 +6,7 @@
 #include <iostream>
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/file.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -17,6 +18,8 @@ constexpr int SLEEP_INTERVAL_MS = 50;
 
 void FileMonitor::threadFunc(const std::stop_token &stopToken) const noexcept
 {
+	pthread_setname_np(pthread_self(), "file-monitor");
+
 	while (!stopToken.stop_requested())
 	{
 		// Buffer for reading events
@@ -12,6 +12,7 @@
 #include <fstream>
 #include <sstream>
 
+#include <pthread.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -56,6 +57,8 @@ void Tracer::startHandler()
 
 void Tracer::threadFunc(const std::stop_token &stopToken) const noexcept
 {
+	pthread_setname_np(pthread_self(), "crashpad-watch");
+
 	int stopCounter = 0;
 	while (!stopToken.stop_requested())
 	{
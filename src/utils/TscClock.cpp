@@ -0,0 +1,118 @@
+#include "utils/TscClock.hpp"
+
+#include <cmath>
+#include <thread>
+
+#ifdef __x86_64__
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+// Fractional bits of the nanoseconds per tick
+constexpr int TSC_CLOCK_SCALE_BITS = 32;
+
+namespace
+{
+	/// Conversion from the time stamp counter to the steady clock
+	struct TscCalibration {
+		bool isUsed{false};			  ///< Whether the time stamp counter is used
+		uint64_t baseTicks{0};		  ///< Counter at the base time
+		int64_t baseTime{0};		  ///< Steady clock time in nanoseconds at the base ticks
+		uint64_t scaledTickPeriod{0}; ///< Nanoseconds per tick scaled by 2^TSC_CLOCK_SCALE_BITS
+		double frequency{0};		  ///< Ticks per second
+	};
+
+	// Checks for an invariant time stamp counter and the RDTSCP instruction
+	bool hasInvariantTsc()
+	{
+#ifdef __x86_64__
+		unsigned int eax = 0;
+		unsigned int ebx = 0;
+		unsigned int ecx = 0;
+		unsigned int edx = 0;
+		if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+		{
+			return false;
+		}
+		__cpuid(0x80000001, eax, ebx, ecx, edx);
+		const bool hasRdtscp = (edx & (1U << 27)) != 0;
+		__cpuid(0x80000007, eax, ebx, ecx, edx);
+		return hasRdtscp && (edx & (1U << 8)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	// Reads the time stamp counter after the previous instructions complete
+	uint64_t readTsc()
+	{
+#ifdef __x86_64__
+		unsigned int aux = 0;
+		return __rdtscp(&aux);
+#else
+		return 0;
+#endif
+	}
+
+	int64_t steadyTime()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				   std::chrono::steady_clock::now().time_since_epoch())
+			.count();
+	}
+
+	TscCalibration calibrate()
+	{
+		TscCalibration calibration;
+		if (!hasInvariantTsc())
+		{
+			return calibration;
+		}
+
+		const int64_t startTime = steadyTime();
+		const uint64_t startTicks = readTsc();
+		std::this_thread::sleep_for(TSC_CLOCK_CALIBRATION_PERIOD);
+		const uint64_t endTicks = readTsc();
+		const int64_t endTime = steadyTime();
+		if (endTicks <= startTicks || endTime <= startTime)
+		{
+			return calibration;
+		}
+
+		const auto elapsedTime = static_cast<double>(endTime - startTime);
+		const auto elapsedTicks = static_cast<double>(endTicks - startTicks);
+		calibration.isUsed = true;
+		calibration.baseTicks = endTicks;
+		calibration.baseTime = endTime;
+		calibration.scaledTickPeriod =
+			static_cast<uint64_t>(std::ldexp(elapsedTime / elapsedTicks, TSC_CLOCK_SCALE_BITS));
+		calibration.frequency = elapsedTicks / elapsedTime * 1e9;
+		return calibration;
+	}
+
+	const TscCalibration &tscCalibration()
+	{
+		static const TscCalibration calibration = calibrate();
+		return calibration;
+	}
+} // namespace
+
+TscClock::time_point TscClock::now() noexcept
+{
+#ifdef __x86_64__
+	if (const auto &calibration = tscCalibration(); calibration.isUsed)
+	{
+		// Invariant counters are synchronised between the cores, reads before the base are only clamped against skew
+		const uint64_t ticks = readTsc();
+		const unsigned __int128 elapsedTicks = ticks > calibration.baseTicks ? ticks - calibration.baseTicks : 0;
+		const auto elapsedTime =
+			static_cast<int64_t>((elapsedTicks * calibration.scaledTickPeriod) >> TSC_CLOCK_SCALE_BITS);
+		return time_point(duration(calibration.baseTime + elapsedTime));
+	}
+#endif
+	return time_point(duration(steadyTime()));
+}
+
+bool TscClock::isTscUsed() noexcept { return tscCalibration().isUsed; }
+
+double TscClock::tscFrequency() noexcept { return tscCalibration().frequency; }
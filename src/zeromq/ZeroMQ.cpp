@@ -1,6 +1,8 @@
 #include "zeromq/ZeroMQ.hpp"
+#include "zeromq/ZeroMQContext.hpp"
 
 #include <iostream>
+#include <memory>
 #include <optional>
 
 #include <spdlog/spdlog.h>
@@ -10,9 +12,20 @@
 constexpr int ZEROMQ_MSG_TIMEOUT_MS = 1000;
 // ZeroMQ heartbeat timeout in milliseconds
 constexpr int ZEROMQ_HEARTBEAT_TIMEOUT_MS = 1000;
+// Strings larger than this are not copied to messages. Small ones are cheaper to copy than to allocate a reference
+// counted owner
+constexpr size_t ZEROMQ_ZERO_COPY_THRESHOLD = 1024;
+// Length of the Z85 encoded CURVE keys
+constexpr size_t ZEROMQ_CURVE_KEY_LENGTH = 40;
+
+namespace
+{
+	// Releases the string owned by a zero-copy message
+	void freeString(void * /*unused*/, void *hint) { delete static_cast<std::string *>(hint); }
+} // namespace
 
 void ZeroMQ::init(const std::shared_ptr<zmq::context_t> &ctx, const zmq::socket_type &type,
-				  const std::string_view &addr, bool isBind)
+				  const std::string_view &addr, bool isBind, const ZeroMQCurveKeys &curveKeys)
 {
 	_contextPtr = ctx;
 	_socketAddr = addr;
@@ -27,17 +40,44 @@ void ZeroMQ::init(const std::shared_ptr<zmq::context_t> &ctx, const zmq::socket_
 	_socketPtr->set(zmq::sockopt::heartbeat_ivl, ZEROMQ_HEARTBEAT_TIMEOUT_MS);
 	_socketPtr->set(zmq::sockopt::heartbeat_ttl, ZEROMQ_HEARTBEAT_TIMEOUT_MS * 3);
 	_socketPtr->set(zmq::sockopt::heartbeat_timeout, ZEROMQ_HEARTBEAT_TIMEOUT_MS);
+
+	// Keys should be set before bind/connect, they are only used by the new connections
+	if (!curveKeys.secretKey.empty())
+	{
+		std::string publicKey = curveKeys.publicKey;
+		if (publicKey.empty())
+		{
+			publicKey.resize(ZEROMQ_CURVE_KEY_LENGTH + 1);
+			if (zmq_curve_public(publicKey.data(), curveKeys.secretKey.c_str()) != 0)
+			{
+				throw zmq::error_t();
+			}
+			publicKey.resize(ZEROMQ_CURVE_KEY_LENGTH);
+		}
+
+		if (curveKeys.serverKey.empty())
+		{
+			_socketPtr->set(zmq::sockopt::curve_server, true);
+			_socketPtr->set(zmq::sockopt::zap_domain, std::string(ZEROMQ_ZAP_DOMAIN));
+		}
+		else
+		{
+			_socketPtr->set(zmq::sockopt::curve_serverkey, curveKeys.serverKey);
+		}
+		_socketPtr->set(zmq::sockopt::curve_publickey, publicKey);
+		_socketPtr->set(zmq::sockopt::curve_secretkey, curveKeys.secretKey);
+	}
 }
 
-ZeroMQ::ZeroMQ(const zmq::socket_type &type, const std::string &addr, bool isBind)
+ZeroMQ::ZeroMQ(const zmq::socket_type &type, const std::string &addr, bool isBind, const ZeroMQCurveKeys &curveKeys)
 {
-	init(std::make_shared<zmq::context_t>(1), type, addr, isBind);
+	init(ZeroMQSharedContext(), type, addr, isBind, curveKeys);
 }
 
 ZeroMQ::ZeroMQ(const std::shared_ptr<zmq::context_t> &ctx, const zmq::socket_type &type, const std::string &addr,
-			   bool isBind)
+			   bool isBind, const ZeroMQCurveKeys &curveKeys)
 {
-	init(ctx, type, addr, isBind);
+	init(ctx, type, addr, isBind, curveKeys);
 }
 
 bool ZeroMQ::start()
@@ -81,31 +121,33 @@ void ZeroMQ::stop()
 std::vector<zmq::message_t> ZeroMQ::recvMessages()
 {
 	std::vector<zmq::message_t> recvMsgs;
+	recvMessages(recvMsgs);
+	return recvMsgs;
+}
+
+size_t ZeroMQ::recvMessages(std::vector<zmq::message_t> &msg)
+{
+	msg.clear();
 	if (!_isActive)
 	{
 		spdlog::warn("Connection needs to starting");
+		return 0;
 	}
-	else
-	{
-		auto nMsgs = zmq::recv_multipart(*_socketPtr, std::back_inserter(recvMsgs));
-		spdlog::trace("Received {} messages", nMsgs.value_or(0));
-	}
-	return recvMsgs;
+
+	const size_t nMsgs = recvMultipart(*_socketPtr, msg);
+	spdlog::trace("Received {} messages", nMsgs);
+	return nMsgs;
 }
 
 size_t ZeroMQ::sendMessages(std::vector<zmq::message_t> &msg)
 {
-	zmq::send_result_t res;
 	if (!_isActive)
 	{
 		spdlog::warn("Connection needs to starting");
-	}
-	else
-	{
-		res = zmq::send_multipart(*_socketPtr, msg);
+		return 0;
 	}
 
-	return res.value_or(0);
+	return sendMultipart(*_socketPtr, msg) ? msg.size() : 0;
 }
 
 ZeroMQ::~ZeroMQ()
@@ -128,3 +170,67 @@ ZeroMQ::~ZeroMQ()
 		}
 	}
 }
+
+zmq::message_t makeConstMessage(std::string_view data)
+{
+	// Messages without a free function only reference the data
+	return {const_cast<char *>(data.data()), data.size(), nullptr, nullptr};
+}
+
+zmq::message_t makeMessage(std::string &&data)
+{
+	if (data.size() < ZEROMQ_ZERO_COPY_THRESHOLD)
+	{
+		return zmq::message_t(data.data(), data.size());
+	}
+
+	auto owner = std::make_unique<std::string>(std::move(data));
+	zmq::message_t msg(owner->data(), owner->size(), freeString, owner.get());
+	static_cast<void>(owner.release());
+	return msg;
+}
+
+ZeroMQCurveKeys makeCurveKeyPair()
+{
+	ZeroMQCurveKeys keys;
+	keys.publicKey.resize(ZEROMQ_CURVE_KEY_LENGTH + 1);
+	keys.secretKey.resize(ZEROMQ_CURVE_KEY_LENGTH + 1);
+	if (zmq_curve_keypair(keys.publicKey.data(), keys.secretKey.data()) != 0)
+	{
+		throw zmq::error_t();
+	}
+
+	// Remove the null terminators
+	keys.publicKey.resize(ZEROMQ_CURVE_KEY_LENGTH);
+	keys.secretKey.resize(ZEROMQ_CURVE_KEY_LENGTH);
+	return keys;
+}
+
+size_t recvMultipart(zmq::socket_ref socket, std::vector<zmq::message_t> &msgs, zmq::recv_flags flags)
+{
+	const size_t nPrevious = msgs.size();
+	zmq::message_t msg;
+	do
+	{
+		// Only the first part may be missing, the other parts arrive with it
+		if (!retryOnInterrupt([&socket, &msg, flags] { return socket.recv(msg, flags); }))
+		{
+			return 0;
+		}
+		msgs.push_back(std::move(msg));
+	} while (msgs.back().more());
+	return msgs.size() - nPrevious;
+}
+
+bool sendMultipart(zmq::socket_ref socket, std::vector<zmq::message_t> &msgs, zmq::send_flags flags)
+{
+	for (size_t idx = 0; idx < msgs.size(); ++idx)
+	{
+		const auto partFlags = idx + 1 < msgs.size() ? flags | zmq::send_flags::sndmore : flags;
+		if (!retryOnInterrupt([&socket, &msg = msgs[idx], partFlags] { return socket.send(msg, partFlags); }))
+		{
+			return false;
+		}
+	}
+	return true;
+}
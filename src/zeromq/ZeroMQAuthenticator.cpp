@@ -0,0 +1,189 @@
+#include "zeromq/ZeroMQAuthenticator.hpp"
+#include "zeromq/ZeroMQ.hpp"
+
+#include <fstream>
+#include <mutex>
+
+#include <pthread.h>
+
+#include <spdlog/spdlog.h>
+
+// Address of the ZAP handler defined by the ZeroMQ Authentication Protocol
+constexpr const char *ZEROMQ_ZAP_ADDRESS = "inproc://zeromq.zap.01";
+// Version of the ZeroMQ Authentication Protocol
+constexpr std::string_view ZEROMQ_ZAP_VERSION = "1.0";
+// Receive timeout of the handler socket in milliseconds
+constexpr int ZEROMQ_ZAP_TIMEOUT_MS = 100;
+// Length of the binary CURVE keys
+constexpr size_t ZEROMQ_CURVE_BINARY_KEY_LENGTH = 32;
+// Length of the Z85 encoded CURVE keys
+constexpr size_t ZEROMQ_CURVE_Z85_KEY_LENGTH = 40;
+
+namespace
+{
+	// Decodes a Z85 encoded key, returns an empty string for invalid keys
+	std::string decodeKey(std::string_view publicKey)
+	{
+		if (publicKey.size() != ZEROMQ_CURVE_Z85_KEY_LENGTH)
+		{
+			return {};
+		}
+
+		const std::string encodedKey(publicKey);
+		std::string binaryKey(ZEROMQ_CURVE_BINARY_KEY_LENGTH, '\0');
+		if (zmq_z85_decode(reinterpret_cast<uint8_t *>(binaryKey.data()), encodedKey.c_str()) == nullptr)
+		{
+			return {};
+		}
+		return binaryKey;
+	}
+} // namespace
+
+void ZeroMQAuthenticator::handleRequest(std::vector<zmq::message_t> &recvMsgs)
+{
+	// Requests are [version, request id, domain, address, identity, mechanism, credentials...]
+	std::vector<zmq::message_t> replyMsgs;
+	replyMsgs.push_back(zmq::message_t(ZEROMQ_ZAP_VERSION));
+	replyMsgs.push_back(recvMsgs.size() > 1 ? std::move(recvMsgs[1]) : zmq::message_t());
+
+	bool isAuthorized = false;
+	if (recvMsgs.size() < 7 || recvMsgs[0].to_string_view() != ZEROMQ_ZAP_VERSION)
+	{
+		spdlog::error("Received invalid ZAP request");
+	}
+	else if (recvMsgs[5].to_string_view() != "CURVE" || recvMsgs[6].size() != ZEROMQ_CURVE_BINARY_KEY_LENGTH)
+	{
+		spdlog::warn("Received {} ZAP request from {}, only CURVE is supported", recvMsgs[5].to_string_view(),
+					 recvMsgs[3].to_string_view());
+	}
+	else
+	{
+		const std::shared_lock lock(_guard);
+		isAuthorized = _authorizedKeys.contains(recvMsgs[6].to_string_view());
+	}
+
+	if (isAuthorized)
+	{
+		++_nAccepted;
+		replyMsgs.push_back(zmq::message_t(std::string_view("200")));
+		replyMsgs.push_back(zmq::message_t(std::string_view("OK")));
+	}
+	else
+	{
+		++_nDenied;
+		if (recvMsgs.size() > 3)
+		{
+			spdlog::warn("ZeroMQ client {} is not authorised", recvMsgs[3].to_string_view());
+		}
+		replyMsgs.push_back(zmq::message_t(std::string_view("400")));
+		replyMsgs.push_back(zmq::message_t(std::string_view("Not authorised")));
+	}
+	replyMsgs.emplace_back(); // User id
+	replyMsgs.emplace_back(); // Metadata
+
+	sendMultipart(*_zapSocket, replyMsgs);
+}
+
+void ZeroMQAuthenticator::threadFunc(const std::stop_token &stopToken) noexcept
+{
+	pthread_setname_np(pthread_self(), "zmq-auth");
+
+	spdlog::debug("ZeroMQ authenticator started");
+	std::vector<zmq::message_t> recvMsgs;
+	while (!stopToken.stop_requested())
+	{
+		try
+		{
+			recvMsgs.clear();
+			if (recvMultipart(*_zapSocket, recvMsgs) > 0)
+			{
+				handleRequest(recvMsgs);
+			}
+		}
+		catch (const std::exception &e)
+		{
+			spdlog::error("ZeroMQ authenticator failed: {}", e.what());
+		}
+	}
+	spdlog::debug("ZeroMQ authenticator stopped");
+}
+
+ZeroMQAuthenticator::ZeroMQAuthenticator(std::shared_ptr<zmq::context_t> ctx, std::filesystem::path keyFilePath)
+	: _contextPtr(std::move(ctx)), _keyFilePath(std::move(keyFilePath))
+{
+	_zapSocket = std::make_unique<zmq::socket_t>(*_contextPtr, zmq::socket_type::rep);
+	_zapSocket->set(zmq::sockopt::linger, 0);
+	_zapSocket->set(zmq::sockopt::rcvtimeo, ZEROMQ_ZAP_TIMEOUT_MS);
+	_zapSocket->bind(ZEROMQ_ZAP_ADDRESS);
+
+	if (!_keyFilePath.empty())
+	{
+		reloadKeys();
+		_keyFileMonitor = std::make_unique<FileMonitor>(_keyFilePath, IN_CLOSE_WRITE);
+		_keyFileMonitor->notifyCallback([this](const void * /*unused*/) { reloadKeys(); });
+	}
+
+	_handlerThread = std::make_unique<std::jthread>([this](const std::stop_token &sToken) { threadFunc(sToken); });
+}
+
+bool ZeroMQAuthenticator::reloadKeys()
+{
+	std::ifstream keyFile(_keyFilePath);
+	if (!keyFile.is_open())
+	{
+		spdlog::error("Can't read ZeroMQ authorised keys from {}", _keyFilePath.string());
+		return false;
+	}
+
+	std::unordered_set<std::string, KeyHash, std::equal_to<>> authorizedKeys;
+	std::string readLine;
+	while (std::getline(keyFile, readLine))
+	{
+		readLine.erase(readLine.find_last_not_of(" \t\r") + 1);
+		if (readLine.empty() || readLine.front() == '#')
+		{
+			continue;
+		}
+
+		if (std::string binaryKey = decodeKey(readLine); !binaryKey.empty())
+		{
+			authorizedKeys.insert(std::move(binaryKey));
+		}
+		else
+		{
+			spdlog::warn("Invalid ZeroMQ authorised key {}", readLine);
+		}
+	}
+
+	spdlog::info("Loaded {} ZeroMQ authorised keys", authorizedKeys.size());
+	const std::unique_lock lock(_guard);
+	std::swap(_authorizedKeys, authorizedKeys);
+	return true;
+}
+
+bool ZeroMQAuthenticator::authorizeKey(std::string_view publicKey)
+{
+	std::string binaryKey = decodeKey(publicKey);
+	if (binaryKey.empty())
+	{
+		return false;
+	}
+
+	const std::unique_lock lock(_guard);
+	_authorizedKeys.insert(std::move(binaryKey));
+	return true;
+}
+
+size_t ZeroMQAuthenticator::authorizedKeys() const
+{
+	const std::shared_lock lock(_guard);
+	return _authorizedKeys.size();
+}
+
+ZeroMQAuthenticator::~ZeroMQAuthenticator()
+{
+	// Stop the threads before the keys and the socket are released
+	_handlerThread.reset();
+	_keyFileMonitor.reset();
+	_zapSocket.reset();
+}
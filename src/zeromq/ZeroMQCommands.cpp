@@ -0,0 +1,151 @@
+#include "zeromq/ZeroMQCommands.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+#include <spdlog/spdlog.h>
+
+bool ZeroMQCommandRegistry::registerCommand(ZeroMQCommand command)
+{
+	if (!command.handler || command.id == ZEROMQ_PIPELINE_MARKER_ID)
+	{
+		return false;
+	}
+
+	const std::unique_lock lock(_guard);
+	const uint32_t commandId = command.id;
+	return _commands.try_emplace(commandId, std::make_shared<const ZeroMQCommand>(std::move(command))).second;
+}
+
+bool ZeroMQCommandRegistry::unregisterCommand(uint32_t id)
+{
+	const std::unique_lock lock(_guard);
+	return _commands.erase(id) > 0;
+}
+
+std::shared_ptr<const ZeroMQCommand> ZeroMQCommandRegistry::find(uint32_t id) const
+{
+	const std::shared_lock lock(_guard);
+	const auto itr = _commands.find(id);
+	return itr == _commands.end() ? nullptr : itr->second;
+}
+
+bool ZeroMQCommandRegistry::invoke(std::span<const zmq::message_t> recvMsgs,
+								   std::vector<zmq::message_t> &replyMsgs) const
+{
+	// Status is written once the handler returns
+	int reply = ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL;
+	const size_t statusIdx = replyMsgs.size();
+	replyMsgs.emplace_back(&reply, sizeof(reply));
+
+	if (recvMsgs.empty() || recvMsgs[0].size() != sizeof(uint32_t))
+	{
+		spdlog::error("Received invalid command identifier from control");
+	}
+	else if (const auto command = find(*recvMsgs[0].data<uint32_t>()); !command)
+	{
+		spdlog::error("Unknown command received from control");
+	}
+	else if (const auto args = recvMsgs.subspan(1);
+			 !command->isVariadic &&
+			 (args.size() != command->argumentSizes.size() ||
+			  !std::ranges::equal(args, command->argumentSizes, [](const zmq::message_t &msg, size_t size) {
+				  return size == 0 || msg.size() == size;
+			  })))
+	{
+		spdlog::error("Received invalid arguments for {}", command->name);
+	}
+	else
+	{
+		try
+		{
+			if (command->handler(args, replyMsgs))
+			{
+				reply = ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
+			}
+		}
+		catch (const std::exception &e)
+		{
+			spdlog::error("ZeroMQ command {} failed: {}", command->name, e.what());
+		}
+	}
+
+	// Failed commands only reply the status
+	if (reply != ZMQ_EVENT_HANDSHAKE_SUCCEEDED)
+	{
+		replyMsgs.erase(replyMsgs.begin() + static_cast<std::ptrdiff_t>(statusIdx) + 1, replyMsgs.end());
+	}
+	std::memcpy(replyMsgs[statusIdx].data(), &reply, sizeof(reply));
+	if (replyMsgs.size() == statusIdx + 1)
+	{
+		replyMsgs.emplace_back();
+	}
+
+	return reply == ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
+}
+
+bool ZeroMQCommandRegistry::dispatch(const std::vector<zmq::message_t> &recvMsgs,
+									 std::vector<zmq::message_t> &replyMsgs) const
+{
+	spdlog::trace("Received {} messages", recvMsgs.size());
+
+	replyMsgs.clear();
+	return invoke(recvMsgs, replyMsgs);
+}
+
+bool ZeroMQCommandRegistry::dispatchBatch(std::span<const zmq::message_t> args,
+										  std::vector<zmq::message_t> &replyMsgs) const
+{
+	// Whole batch is checked first, so a malformed batch does not run any command
+	if (args.empty())
+	{
+		spdlog::error("Received empty batch from control");
+		return false;
+	}
+	for (size_t idx = 0; idx < args.size();)
+	{
+		if (args[idx].size() != sizeof(uint32_t) || *args[idx].data<uint32_t>() == 0 ||
+			*args[idx].data<uint32_t>() > args.size() - idx - 1)
+		{
+			spdlog::error("Received invalid batch from control");
+			return false;
+		}
+
+		const auto &commandMsg = args[idx + 1];
+		if (commandMsg.size() == sizeof(uint32_t) && *commandMsg.data<uint32_t>() == ZEROMQ_BATCH_CMD_ID)
+		{
+			spdlog::error("Received nested batch from control");
+			return false;
+		}
+		idx += *args[idx].data<uint32_t>() + 1;
+	}
+
+	for (size_t idx = 0; idx < args.size();)
+	{
+		const uint32_t nParts = *args[idx].data<uint32_t>();
+		const size_t countIdx = replyMsgs.size();
+		replyMsgs.emplace_back(sizeof(uint32_t));
+
+		invoke(args.subspan(idx + 1, nParts), replyMsgs);
+
+		const auto nReplyParts = static_cast<uint32_t>(replyMsgs.size() - countIdx - 1);
+		std::memcpy(replyMsgs[countIdx].data(), &nReplyParts, sizeof(nReplyParts));
+		idx += nParts + 1;
+	}
+	return true;
+}
+
+std::vector<std::pair<uint32_t, std::string>> ZeroMQCommandRegistry::commands() const
+{
+	std::vector<std::pair<uint32_t, std::string>> retval;
+	{
+		const std::shared_lock lock(_guard);
+		retval.reserve(_commands.size());
+		for (const auto &[id, command] : _commands)
+		{
+			retval.emplace_back(id, command->name);
+		}
+	}
+	std::ranges::sort(retval, {}, &std::pair<uint32_t, std::string>::second);
+	return retval;
+}
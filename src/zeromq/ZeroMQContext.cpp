@@ -0,0 +1,80 @@
+#include "zeromq/ZeroMQContext.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+#include <sched.h>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+	// Guards the options of the shared context
+	std::mutex contextGuard;
+	// Options of the shared context
+	ZeroMQContextOptions contextOptions;
+	// True once the shared context is created, the options are not applied after
+	bool isContextCreated = false;
+
+	// Sets an option of a context, options of the I/O threads should be set before the first socket is created
+	void setContextOption(zmq::context_t &ctx, int option, int value)
+	{
+		if (zmq_ctx_set(ctx.handle(), option, value) != 0)
+		{
+			throw zmq::error_t();
+		}
+	}
+} // namespace
+
+bool configureZeroMQContext(const ZeroMQContextOptions &options)
+{
+	if (options.ioThreads < 0 || std::ranges::any_of(options.cpuAffinity, [](int cpu) { return cpu < 0; }))
+	{
+		spdlog::error("Invalid ZeroMQ context options");
+		return false;
+	}
+
+	// ZeroMQ aborts if the scheduling of the I/O threads can't be applied, so the priority is checked before
+	if ((options.schedPolicy == SCHED_FIFO || options.schedPolicy == SCHED_RR) &&
+		(options.schedPriority < sched_get_priority_min(options.schedPolicy) ||
+		 options.schedPriority > sched_get_priority_max(options.schedPolicy)))
+	{
+		spdlog::error("Invalid ZeroMQ I/O thread priority {} for the scheduling policy", options.schedPriority);
+		return false;
+	}
+
+	const std::scoped_lock lock(contextGuard);
+	if (isContextCreated)
+	{
+		spdlog::warn("ZeroMQ context is already created, options are not applied");
+		return false;
+	}
+	contextOptions = options;
+	return true;
+}
+
+const std::shared_ptr<zmq::context_t> &ZeroMQSharedContext()
+{
+	static const std::shared_ptr<zmq::context_t> sharedContext = [] {
+		const std::scoped_lock lock(contextGuard);
+		isContextCreated = true;
+
+		auto ctx = std::make_shared<zmq::context_t>();
+		setContextOption(*ctx, ZMQ_IO_THREADS, contextOptions.ioThreads);
+		for (const int cpu : contextOptions.cpuAffinity)
+		{
+			setContextOption(*ctx, ZMQ_THREAD_AFFINITY_CPU_ADD, cpu);
+		}
+		if (contextOptions.schedPolicy != ZEROMQ_THREAD_SCHED_DEFAULT)
+		{
+			setContextOption(*ctx, ZMQ_THREAD_SCHED_POLICY, contextOptions.schedPolicy);
+		}
+		if (contextOptions.schedPriority != ZEROMQ_THREAD_SCHED_DEFAULT)
+		{
+			setContextOption(*ctx, ZMQ_THREAD_PRIORITY, contextOptions.schedPriority);
+		}
+
+		spdlog::debug("ZeroMQ context created with {} I/O threads", contextOptions.ioThreads);
+		return ctx;
+	}();
+	return sharedContext;
+}
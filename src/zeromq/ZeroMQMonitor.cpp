@@ -1,17 +1,140 @@
 #include "zeromq/ZeroMQMonitor.hpp"
+#include "zeromq/ZeroMQ.hpp"
 
+#include <cstring>
+
+#include <prometheus/counter.h>
+#include <prometheus/gauge.h>
+#include <prometheus/histogram.h>
 #include <spdlog/spdlog.h>
 
-constexpr int EVENT_CHECK_TIMEOUT_MS = 100;
+// Maximum number of handshakes tracked at the same time, the oldest ones are dropped
+constexpr size_t MAX_PENDING_HANDSHAKES = 1024;
+// Maximum number of endpoint labels, metrics of the other endpoints are merged to keep the cardinality bounded
+constexpr size_t MAX_ENDPOINT_LABELS = 64;
+// Size of the first part of the events, which is the event type followed by its value
+constexpr size_t EVENT_MESSAGE_SIZE = sizeof(uint16_t) + sizeof(int32_t);
 
-void ZeroMQMonitor::threadFunc(const std::stop_token &stopToken)
+void ZeroMQMonitor::handleEvents()
 {
-	while (!stopToken.stop_requested())
+	// Events are [uint16_t event, int32_t value] followed by the endpoint, all pending ones are handled together
+	zmq::message_t eventMsg;
+	zmq::message_t addrMsg;
+	const auto recvPart = [this](zmq::message_t &msg) {
+		return retryOnInterrupt([this, &msg] { return _monitorSocket->recv(msg, zmq::recv_flags::dontwait); });
+	};
+	while (recvPart(eventMsg))
 	{
-		check_event(EVENT_CHECK_TIMEOUT_MS);
+		if (!eventMsg.more() || !recvPart(addrMsg))
+		{
+			spdlog::warn("Received incomplete ZeroMQ monitor event");
+			continue;
+		}
+		if (eventMsg.size() != EVENT_MESSAGE_SIZE)
+		{
+			spdlog::warn("Received invalid ZeroMQ monitor event");
+			continue;
+		}
+
+		zmq_event_t event{};
+		std::memcpy(&event.event, eventMsg.data(), sizeof(event.event));
+		std::memcpy(&event.value, eventMsg.data<uint8_t>() + sizeof(event.event), sizeof(event.value));
+		const std::string addr = addrMsg.to_string();
+
+		switch (event.event)
+		{
+		case ZMQ_EVENT_CONNECTED:
+			on_event_connected(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_CONNECT_DELAYED:
+			on_event_connect_delayed(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_CONNECT_RETRIED:
+			on_event_connect_retried(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_LISTENING:
+			on_event_listening(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_BIND_FAILED:
+			on_event_bind_failed(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_ACCEPTED:
+			on_event_accepted(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_ACCEPT_FAILED:
+			on_event_accept_failed(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_CLOSED:
+			on_event_closed(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_CLOSE_FAILED:
+			on_event_close_failed(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_DISCONNECTED:
+			on_event_disconnected(event, addr.c_str());
+			break;
+#if ZMQ_VERSION >= ZMQ_MAKE_VERSION(4, 3, 0) ||                                                                        \
+	(defined(ZMQ_BUILD_DRAFT_API) && ZMQ_VERSION >= ZMQ_MAKE_VERSION(4, 2, 3))
+		case ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL:
+			on_event_handshake_failed_no_detail(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_HANDSHAKE_FAILED_PROTOCOL:
+			on_event_handshake_failed_protocol(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_HANDSHAKE_FAILED_AUTH:
+			on_event_handshake_failed_auth(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_HANDSHAKE_SUCCEEDED:
+			on_event_handshake_succeeded(event, addr.c_str());
+			break;
+#elif defined(ZMQ_BUILD_DRAFT_API) && ZMQ_VERSION >= ZMQ_MAKE_VERSION(4, 2, 1)
+		case ZMQ_EVENT_HANDSHAKE_FAILED:
+			on_event_handshake_failed(event, addr.c_str());
+			break;
+		case ZMQ_EVENT_HANDSHAKE_SUCCEED:
+			on_event_handshake_succeed(event, addr.c_str());
+			break;
+#endif
+		case ZMQ_EVENT_MONITOR_STOPPED:
+			break;
+		default:
+			on_event_unknown(event, addr.c_str());
+			break;
+		}
 	}
 }
 
+ZeroMQMonitor::EndpointStats *ZeroMQMonitor::endpointStats(const char *addr)
+{
+	if (_connectionFamily == nullptr)
+	{
+		return nullptr;
+	}
+
+	std::string endpoint = addr == nullptr ? "" : addr;
+	if (const auto itr = _endpointStats.find(endpoint); itr != _endpointStats.end())
+	{
+		return &itr->second;
+	}
+	if (_endpointStats.size() >= MAX_ENDPOINT_LABELS)
+	{
+		endpoint = "other";
+		if (const auto itr = _endpointStats.find(endpoint); itr != _endpointStats.end())
+		{
+			return &itr->second;
+		}
+	}
+
+	const prometheus::Labels labels{{"endpoint", endpoint}};
+	return &_endpointStats
+				.emplace(std::move(endpoint), EndpointStats{.connections = &_connectionFamily->Add(labels),
+															.disconnections = &_disconnectionFamily->Add(labels),
+															.handshakeFailures = &_handshakeFailureFamily->Add(labels),
+															.acceptFailures = &_acceptFailureFamily->Add(labels),
+															.peers = &_peerFamily->Add(labels)})
+				.first->second;
+}
+
 void ZeroMQMonitor::on_event(const std::string &messageStr, int level, const char *addr)
 {
 	switch (level)
@@ -30,11 +153,52 @@ void ZeroMQMonitor::on_event(const std::string &messageStr, int level, const cha
 	}
 }
 
+void ZeroMQMonitor::startHandshake()
+{
+	if (_handshakeStartTimes.size() >= MAX_PENDING_HANDSHAKES)
+	{
+		_handshakeStartTimes.pop_front();
+	}
+	_handshakeStartTimes.push_back(std::chrono::steady_clock::now());
+}
+
+void ZeroMQMonitor::finishHandshake(ZeroMQHandshakeResult result, const char *addr)
+{
+	std::chrono::nanoseconds duration{0};
+	if (!_handshakeStartTimes.empty())
+	{
+		duration = std::chrono::steady_clock::now() - _handshakeStartTimes.front();
+		_handshakeStartTimes.pop_front();
+	}
+
+	if (auto *stats = endpointStats(addr); stats != nullptr)
+	{
+		const auto idx = static_cast<size_t>(result);
+		_handshakeCounts.at(idx)->Increment();
+		_handshakeTimes.at(idx)->Observe(static_cast<double>(duration.count()));
+		if (result != ZeroMQHandshakeResult::Succeeded)
+		{
+			stats->handshakeFailures->Increment();
+		}
+	}
+
+	if (_handshakeCallback)
+	{
+		_handshakeCallback(result, duration);
+	}
+}
+
 void ZeroMQMonitor::on_monitor_started() { on_event("Monitor started", spdlog::level::info); }
 
 void ZeroMQMonitor::on_event_connected(const zmq_event_t & /*unused*/, const char *addr_)
 {
 	_peerCount.fetch_add(1);
+	if (auto *stats = endpointStats(addr_); stats != nullptr)
+	{
+		stats->connections->Increment();
+		stats->peers->Increment();
+	}
+	startHandshake();
 	on_event("Connected", spdlog::level::info, addr_);
 }
 
@@ -60,11 +224,22 @@ void ZeroMQMonitor::on_event_bind_failed(const zmq_event_t & /*unused*/, const c
 
 void ZeroMQMonitor::on_event_accepted(const zmq_event_t & /*unused*/, const char *addr_)
 {
+	_peerCount.fetch_add(1);
+	if (auto *stats = endpointStats(addr_); stats != nullptr)
+	{
+		stats->connections->Increment();
+		stats->peers->Increment();
+	}
+	startHandshake();
 	on_event("Accepted", spdlog::level::info, addr_);
 }
 
 void ZeroMQMonitor::on_event_accept_failed(const zmq_event_t & /*unused*/, const char *addr_)
 {
+	if (auto *stats = endpointStats(addr_); stats != nullptr)
+	{
+		stats->acceptFailures->Increment();
+	}
 	on_event("Accept failed", spdlog::level::warn, addr_);
 }
 
@@ -81,6 +256,15 @@ void ZeroMQMonitor::on_event_close_failed(const zmq_event_t & /*unused*/, const
 void ZeroMQMonitor::on_event_disconnected(const zmq_event_t & /*unused*/, const char *addr_)
 {
 	_peerCount.fetch_sub(1);
+	if (auto *stats = endpointStats(addr_); stats != nullptr)
+	{
+		stats->disconnections->Increment();
+		// Peers of a wildcard endpoint might disconnect from the address they connected to
+		if (stats->peers->Value() > 0)
+		{
+			stats->peers->Decrement();
+		}
+	}
 	on_event("Disconnected", spdlog::level::info, addr_);
 }
 
@@ -88,32 +272,38 @@ void ZeroMQMonitor::on_event_disconnected(const zmq_event_t & /*unused*/, const
 	(defined(ZMQ_BUILD_DRAFT_API) && ZMQ_VERSION >= ZMQ_MAKE_VERSION(4, 2, 3))
 void ZeroMQMonitor::on_event_handshake_failed_no_detail(const zmq_event_t & /*unused*/, const char *addr_)
 {
+	finishHandshake(ZeroMQHandshakeResult::FailedNoDetail, addr_);
 	on_event("Handshake failed (no detail)", spdlog::level::warn, addr_);
 }
 
 void ZeroMQMonitor::on_event_handshake_failed_protocol(const zmq_event_t & /*unused*/, const char *addr_)
 {
+	finishHandshake(ZeroMQHandshakeResult::FailedProtocol, addr_);
 	on_event("Handshake failed (protocol)", spdlog::level::warn, addr_);
 }
 
 void ZeroMQMonitor::on_event_handshake_failed_auth(const zmq_event_t & /*unused*/, const char *addr_)
 {
+	finishHandshake(ZeroMQHandshakeResult::FailedAuth, addr_);
 	on_event("Handshake failed (auth)", spdlog::level::warn, addr_);
 }
 
 void ZeroMQMonitor::on_event_handshake_succeeded(const zmq_event_t & /*unused*/, const char *addr_)
 {
+	finishHandshake(ZeroMQHandshakeResult::Succeeded, addr_);
 	on_event("Handshake succeeded", spdlog::level::info, addr_);
 }
 
 #elif defined(ZMQ_BUILD_DRAFT_API) && ZMQ_VERSION >= ZMQ_MAKE_VERSION(4, 2, 1)
 void ZeroMQMonitor::on_event_handshake_failed(const zmq_event_t & /*unused*/, const char *addr_)
 {
+	finishHandshake(ZeroMQHandshakeResult::FailedNoDetail, addr_);
 	on_event("Handshake failed", spdlog::level::warn, addr_);
 }
 
 void ZeroMQMonitor::on_event_handshake_succeed(const zmq_event_t & /*unused*/, const char *addr_)
 {
+	finishHandshake(ZeroMQHandshakeResult::Succeeded, addr_);
 	on_event("Handshake succeed", spdlog::level::info, addr_);
 }
 #endif
@@ -123,15 +313,90 @@ void ZeroMQMonitor::on_event_unknown(const zmq_event_t & /*unused*/, const char
 	on_event("Unknown event", spdlog::level::warn, addr_);
 }
 
-void ZeroMQMonitor::startMonitoring(zmq::socket_t *socket, const std::string &monitorAddress)
+void ZeroMQMonitor::startMonitoring(zmq::socket_t *socket, const std::string &monitorAddress, ZeroMQReactor &reactor)
 {
 	if (socket == nullptr)
 	{
 		throw std::invalid_argument("ZeroMQ socket to monitor is nullptr");
 	}
 
-	init(*socket, monitorAddress);
-	_monitorThread = std::make_unique<std::jthread>([this](const std::stop_token &sToken) { threadFunc(sToken); });
+	if (zmq_socket_monitor(socket->handle(), monitorAddress.c_str(), ZMQ_EVENT_ALL) != 0)
+	{
+		throw zmq::error_t();
+	}
+	_monitorSocket = std::make_unique<zmq::socket_t>(*reactor.context(), zmq::socket_type::pair);
+	_monitorSocket->set(zmq::sockopt::linger, 0);
+	_monitorSocket->connect(monitorAddress);
+
+	// Connections of a previous monitoring were closed with the socket endpoint
+	_peerCount = 0;
+	_socket = socket;
+	_reactor = &reactor;
+	_reactor->addSocket(*_monitorSocket, [this](zmq::socket_ref /*unused*/) { handleEvents(); });
+	on_monitor_started();
+}
+
+void ZeroMQMonitor::startMonitoring(zmq::socket_t *socket, const std::string &monitorAddress,
+									std::shared_ptr<zmq::context_t> ctx)
+{
+	if (socket == nullptr)
+	{
+		throw std::invalid_argument("ZeroMQ socket to monitor is nullptr");
+	}
+
+	_ownedReactor = std::make_unique<ZeroMQReactor>(std::move(ctx));
+	startMonitoring(socket, monitorAddress, *_ownedReactor);
+	_ownedReactor->start();
+}
+
+void ZeroMQMonitor::registerMetrics(const std::shared_ptr<prometheus::Registry> &reg, const std::string &prependName)
+{
+	if (!reg)
+	{
+		throw std::invalid_argument("Can't init ZeroMQ monitor statistics. Registry is null");
+	}
+
+	const auto name = prependName.empty() ? "zeromq_" : prependName + "_zeromq_";
+
+	// Connection stats by endpoint
+	_connectionFamily = &prometheus::BuildCounter()
+							 .Name(name + "connections")
+							 .Help("Number of established connections by endpoint")
+							 .Register(*reg);
+	_disconnectionFamily = &prometheus::BuildCounter()
+								.Name(name + "disconnections")
+								.Help("Number of closed connections by endpoint")
+								.Register(*reg);
+	_handshakeFailureFamily = &prometheus::BuildCounter()
+								   .Name(name + "handshake_failures")
+								   .Help("Number of failed connection handshakes by endpoint")
+								   .Register(*reg);
+	_acceptFailureFamily = &prometheus::BuildCounter()
+								.Name(name + "accept_failures")
+								.Help("Number of failed connection accepts by endpoint")
+								.Register(*reg);
+	_peerFamily =
+		&prometheus::BuildGauge().Name(name + "peers").Help("Number of connected peers by endpoint").Register(*reg);
+
+	// Handshake stats, indexed by ZeroMQHandshakeResult
+	auto &handshakeCountFamily = prometheus::BuildCounter()
+									 .Name(name + "handshakes")
+									 .Help("Number of connection handshakes by result")
+									 .Register(*reg);
+	auto &handshakeTimeFamily = prometheus::BuildHistogram()
+									.Name(name + "handshake_time")
+									.Help("Connection handshake time by result in nanoseconds")
+									.Register(*reg);
+	const std::array<std::string, 4> handshakeResults = {"succeeded", "failed_no_detail", "failed_protocol",
+														 "failed_auth"};
+	// From 100us to 10s, ZeroMQ times out the handshakes after 30s by default
+	const prometheus::Histogram::BucketBoundaries handshakeBuckets = {1e5, 2.5e5, 5e5, 1e6, 2.5e6, 5e6, 1e7,
+																	  2.5e7, 5e7, 1e8, 2.5e8, 5e8, 1e9, 1e10};
+	for (size_t idx = 0; idx < handshakeResults.size(); ++idx)
+	{
+		_handshakeCounts[idx] = &handshakeCountFamily.Add({{"result", handshakeResults[idx]}});
+		_handshakeTimes[idx] = &handshakeTimeFamily.Add({{"result", handshakeResults[idx]}}, handshakeBuckets);
+	}
 }
 
 void ZeroMQMonitor::testInternals()
@@ -167,9 +432,27 @@ void ZeroMQMonitor::testInternals()
 
 void ZeroMQMonitor::stopMonitoring()
 {
-#ifdef ZMQ_EVENT_MONITOR_STOPPED
-	abort();
-#endif
+	if (!_monitorSocket)
+	{
+		return;
+	}
+
+	// Reactor should not serve the event socket while it is closed
+	if (_ownedReactor)
+	{
+		_ownedReactor.reset();
+	}
+	else
+	{
+		_reactor->removeSocket(*_monitorSocket);
+	}
+	if (*_socket)
+	{
+		zmq_socket_monitor(_socket->handle(), nullptr, 0);
+	}
+	_monitorSocket.reset();
+	_reactor = nullptr;
+	_socket = nullptr;
 
 	spdlog::info("Monitor stopped");
 }
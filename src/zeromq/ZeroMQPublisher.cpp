@@ -0,0 +1,213 @@
+#include "zeromq/ZeroMQPublisher.hpp"
+
+#include <algorithm>
+#include <format>
+
+#include <pthread.h>
+
+#include <spdlog/spdlog.h>
+
+ZeroMQPublisher::ZeroMQPublisher(const std::string &hostAddr, const ZeroMQPublisherOptions &options)
+	: ZeroMQ(options.isXPub ? zmq::socket_type::xpub : zmq::socket_type::pub, hostAddr, true), _options(options)
+{
+	_options.maxBatchSize = std::max<size_t>(_options.maxBatchSize, 1);
+	getSocket()->set(zmq::sockopt::sndhwm, _options.sendHwm);
+}
+
+bool ZeroMQPublisher::isSubscribed(std::string_view topic) const
+{
+	// Plain publish sockets do not report the subscriptions
+	if (!_options.isXPub)
+	{
+		return true;
+	}
+	return std::ranges::any_of(_subscriptions,
+							   [topic](const std::string &prefix) { return topic.starts_with(prefix); });
+}
+
+void ZeroMQPublisher::updateSubscriptions()
+{
+	// Subscription messages are the subscribe flag followed by the topic prefix
+	zmq::message_t msg;
+	while (retryOnInterrupt([this, &msg] { return getSocket()->recv(msg, zmq::recv_flags::dontwait); }))
+	{
+		if (msg.empty())
+		{
+			continue;
+		}
+
+		const bool isSubscribe = *msg.data<uint8_t>() != 0;
+		std::string prefix(msg.data<char>() + 1, msg.size() - 1);
+		spdlog::debug("ZeroMQ publisher {} {}", isSubscribe ? "subscribed" : "unsubscribed", prefix);
+
+		const std::scoped_lock lock(_guard);
+		if (isSubscribe)
+		{
+			_subscriptions.insert(std::move(prefix));
+		}
+		else
+		{
+			_subscriptions.erase(prefix);
+		}
+	}
+}
+
+void ZeroMQPublisher::sendBatches(const std::string &topic, std::vector<std::string> &events)
+{
+	for (size_t idx = 0; idx < events.size();)
+	{
+		_batchMsgs.clear();
+		_batchMsgs.emplace_back(topic.data(), topic.size());
+		for (const size_t endIdx = std::min(events.size(), idx + _options.maxBatchSize); idx < endIdx; ++idx)
+		{
+			_batchMsgs.push_back(makeMessage(std::move(events[idx])));
+		}
+
+		// Publish sockets never block, ZeroMQ drops the batch if the subscriber is too slow
+		if (sendMultipart(*getSocket(), _batchMsgs, zmq::send_flags::dontwait))
+		{
+			_nPublishedEvents += _batchMsgs.size() - 1;
+			++_nPublishedBatches;
+		}
+	}
+	events.clear();
+}
+
+void ZeroMQPublisher::sendEvents()
+{
+	for (auto &[topic, events] : _sendingEvents)
+	{
+		if (!events.empty())
+		{
+			sendBatches(topic, events);
+		}
+	}
+
+	std::vector<std::string> metricEvents(1);
+	for (const auto &[topic, delta] : _sendingMetrics)
+	{
+		metricEvents.front() = std::format("{}", delta);
+		sendBatches(topic, metricEvents);
+		metricEvents.resize(1);
+	}
+	_sendingMetrics.clear();
+}
+
+void ZeroMQPublisher::threadFunc(const std::stop_token &stopToken) noexcept
+{
+	pthread_setname_np(pthread_self(), "zmq-publisher");
+
+	spdlog::info("ZeroMQ publisher started");
+	try
+	{
+		// Queued events are sent once more after the stop request
+		while (!stopToken.stop_requested())
+		{
+			if (_options.isXPub)
+			{
+				updateSubscriptions();
+			}
+
+			{
+				std::unique_lock lock(_guard);
+				_flushCond.wait_for(lock, stopToken, _options.flushInterval,
+									[this] { return _nQueuedEvents >= _options.maxBatchSize; });
+				std::swap(_queuedEvents, _sendingEvents);
+				std::swap(_queuedMetrics, _sendingMetrics);
+				_nQueuedEvents = 0;
+			}
+			sendEvents();
+		}
+	}
+	catch (const std::exception &e)
+	{
+		spdlog::error("ZeroMQ publisher failed: {}", e.what());
+	}
+	spdlog::info("ZeroMQ publisher stopped");
+}
+
+bool ZeroMQPublisher::initialise()
+{
+	if (!start())
+	{
+		return false;
+	}
+
+	_publisherThread = std::make_unique<std::jthread>([this](const std::stop_token &sToken) { threadFunc(sToken); });
+	return true;
+}
+
+void ZeroMQPublisher::shutdown()
+{
+	if (_publisherThread)
+	{
+		_publisherThread.reset();
+	}
+	stop();
+}
+
+bool ZeroMQPublisher::publish(std::string_view topic, std::string_view event)
+{
+	{
+		const std::scoped_lock lock(_guard);
+		if (!isSubscribed(topic))
+		{
+			return false;
+		}
+
+		auto &events = _queuedEvents[std::string(topic)];
+		if (_options.conflate && !events.empty())
+		{
+			events.back().assign(event);
+			return true;
+		}
+
+		if (_nQueuedEvents >= _options.maxQueuedEvents)
+		{
+			++_nDroppedEvents;
+			return false;
+		}
+		events.emplace_back(event);
+		if (++_nQueuedEvents < _options.maxBatchSize)
+		{
+			return true;
+		}
+	}
+	_flushCond.notify_one();
+	return true;
+}
+
+bool ZeroMQPublisher::publishLog(std::string_view level, std::string_view line)
+{
+	return publish(std::format("{}{}", ZEROMQ_TOPIC_LOG, level), line);
+}
+
+bool ZeroMQPublisher::publishMetric(std::string_view name, double delta)
+{
+	std::string topic = std::format("{}{}", ZEROMQ_TOPIC_METRIC, name);
+
+	const std::scoped_lock lock(_guard);
+	if (!isSubscribed(topic))
+	{
+		return false;
+	}
+
+	auto iter = _queuedMetrics.find(topic);
+	if (iter == _queuedMetrics.end())
+	{
+		if (_nQueuedEvents >= _options.maxQueuedEvents)
+		{
+			++_nDroppedEvents;
+			return false;
+		}
+		iter = _queuedMetrics.emplace(std::move(topic), 0.0).first;
+		++_nQueuedEvents;
+	}
+	iter->second += delta;
+	return true;
+}
+
+bool ZeroMQPublisher::publishAudit(std::string_view source, std::string_view record)
+{
+	return publish(std::format("{}{}", ZEROMQ_TOPIC_AUDIT, source), record);
+}
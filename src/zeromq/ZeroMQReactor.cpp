@@ -0,0 +1,191 @@
+#include "zeromq/ZeroMQReactor.hpp"
+#include "zeromq/ZeroMQ.hpp"
+
+#include <algorithm>
+#include <format>
+
+#include <pthread.h>
+
+#include <spdlog/spdlog.h>
+
+// Poll timeout of the reactor in milliseconds, tick callback is called at least this often
+constexpr int ZEROMQ_REACTOR_TICK_MS = 100;
+
+ZeroMQReactor::ZeroMQReactor(std::shared_ptr<zmq::context_t> ctx)
+	: _contextPtr(std::move(ctx)), _wakeupAddr(std::format("inproc://reactor.{}", static_cast<const void *>(this))),
+	  _wakeupReceiver(*_contextPtr, zmq::socket_type::pair), _wakeupSender(*_contextPtr, zmq::socket_type::pair)
+{
+	_wakeupReceiver.set(zmq::sockopt::linger, 0);
+	_wakeupSender.set(zmq::sockopt::linger, 0);
+	_wakeupReceiver.bind(_wakeupAddr);
+	_wakeupSender.connect(_wakeupAddr);
+}
+
+void ZeroMQReactor::markChanged(std::unique_lock<std::mutex> &lock, bool waitApplied)
+{
+	const uint64_t generation = ++_generation;
+
+	// Queue already has a pending wake-up if the send would block
+	static_cast<void>(_wakeupSender.send(zmq::const_buffer(), zmq::send_flags::dontwait));
+
+	if (waitApplied && std::this_thread::get_id() != _reactorThreadId)
+	{
+		_appliedCond.wait(lock, [this, generation]() { return !_isPolling || _appliedGeneration >= generation; });
+	}
+}
+
+void ZeroMQReactor::threadFunc(const std::stop_token &stopToken) noexcept
+{
+	pthread_setname_np(pthread_self(), "zmq-reactor");
+
+	{
+		const std::scoped_lock lock(_guard);
+		_reactorThreadId = std::this_thread::get_id();
+	}
+
+	spdlog::debug("ZeroMQ reactor started");
+	std::vector<Entry> entries;
+	std::vector<zmq::pollitem_t> items;
+	bool isInitialised = false;
+	while (!stopToken.stop_requested())
+	{
+		try
+		{
+			// Take a snapshot of the registered sockets, so handlers can change the registrations
+			if (!isInitialised || _appliedGeneration != _generation)
+			{
+				const std::scoped_lock lock(_guard);
+				entries = _entries;
+				items.clear();
+				items.push_back({_wakeupReceiver.handle(), 0, ZMQ_POLLIN, 0});
+				for (auto &entry : entries)
+				{
+					const short events = entry.isPaused ? 0 : ZMQ_POLLIN;
+					items.push_back({entry.socket.handle(), 0, events, 0});
+				}
+				_appliedGeneration = _generation;
+				isInitialised = true;
+				_appliedCond.notify_all();
+			}
+
+			retryOnInterrupt([&items] { return zmq::poll(items, std::chrono::milliseconds(ZEROMQ_REACTOR_TICK_MS)); });
+
+			if ((items[0].revents & ZMQ_POLLIN) != 0)
+			{
+				zmq::message_t wakeupMsg;
+				while (retryOnInterrupt(
+					[this, &wakeupMsg] { return _wakeupReceiver.recv(wakeupMsg, zmq::recv_flags::dontwait); }))
+				{
+				}
+			}
+
+			for (size_t idx = 1; idx < items.size(); ++idx)
+			{
+				if ((items[idx].revents & ZMQ_POLLIN) == 0)
+				{
+					continue;
+				}
+				entries[idx - 1].handler(entries[idx - 1].socket);
+
+				// Remaining sockets might be removed by the handler, they are polled again with the new registrations
+				if (_appliedGeneration != _generation)
+				{
+					break;
+				}
+			}
+
+			if (_tickCallback)
+			{
+				_tickCallback();
+			}
+		}
+		catch (const std::exception &e)
+		{
+			spdlog::error("ZeroMQ reactor failed: {}", e.what());
+		}
+	}
+
+	{
+		const std::scoped_lock lock(_guard);
+		_isPolling = false;
+		_reactorThreadId = {};
+		_appliedCond.notify_all();
+	}
+	spdlog::debug("ZeroMQ reactor stopped");
+}
+
+bool ZeroMQReactor::addSocket(zmq::socket_ref socket, FPTR_SocketHandler handler)
+{
+	if (!socket || !handler)
+	{
+		return false;
+	}
+
+	std::unique_lock lock(_guard);
+	if (std::ranges::any_of(_entries, [socket](const Entry &entry) { return entry.socket == socket; }))
+	{
+		return false;
+	}
+	_entries.push_back({.socket = socket, .handler = std::move(handler)});
+	markChanged(lock, false);
+	return true;
+}
+
+bool ZeroMQReactor::removeSocket(zmq::socket_ref socket)
+{
+	std::unique_lock lock(_guard);
+	const auto itr = std::ranges::find_if(_entries, [socket](const Entry &entry) { return entry.socket == socket; });
+	if (itr == _entries.end())
+	{
+		return false;
+	}
+	_entries.erase(itr);
+	markChanged(lock, true);
+	return true;
+}
+
+bool ZeroMQReactor::pauseSocket(zmq::socket_ref socket, bool isPaused)
+{
+	std::unique_lock lock(_guard);
+	const auto itr = std::ranges::find_if(_entries, [socket](const Entry &entry) { return entry.socket == socket; });
+	if (itr == _entries.end())
+	{
+		return false;
+	}
+	if (itr->isPaused != isPaused)
+	{
+		itr->isPaused = isPaused;
+		markChanged(lock, true);
+	}
+	return true;
+}
+
+bool ZeroMQReactor::start()
+{
+	if (_reactorThread)
+	{
+		return false;
+	}
+
+	{
+		const std::scoped_lock lock(_guard);
+		_isPolling = true;
+	}
+	_reactorThread = std::make_unique<std::jthread>([this](const std::stop_token &sToken) { threadFunc(sToken); });
+	return true;
+}
+
+void ZeroMQReactor::stop()
+{
+	if (!_reactorThread)
+	{
+		return;
+	}
+
+	_reactorThread->request_stop();
+	{
+		const std::scoped_lock lock(_guard);
+		static_cast<void>(_wakeupSender.send(zmq::const_buffer(), zmq::send_flags::dontwait));
+	}
+	_reactorThread.reset();
+}
@@ -1,13 +1,19 @@
 #include "zeromq/ZeroMQServer.hpp"
 
+#include <array>
+#include <cstring>
 #include <format>
 
+#include <pthread.h>
+
 #include "Version.h"
+#include "metrics/Profiler.hpp"
 #include "utils/ErrorHelpers.hpp"
 #include "utils/Hasher.hpp"
 
 #include <spdlog/spdlog.h>
 
+// Identifiers of the text commands, kept for the clients of the first protocol version
 constexpr uint32_t LOG_LEVEL_ID = (static_cast<uint32_t>('L') | (static_cast<uint32_t>('O') << 8) |
 								   (static_cast<uint32_t>('G') << 16) | (static_cast<uint32_t>('L') << 24));
 constexpr uint32_t VERSION_INFO_ID = (static_cast<uint32_t>('V') | (static_cast<uint32_t>('E') << 8) |
@@ -16,134 +22,365 @@ constexpr uint32_t PING_PONG_ID = (static_cast<uint32_t>('P') | (static_cast<uin
 								   (static_cast<uint32_t>('N') << 16) | (static_cast<uint32_t>('G') << 24));
 constexpr uint32_t STATUS_CHECK_ID = (static_cast<uint32_t>('S') | (static_cast<uint32_t>('C') << 8) |
 									  (static_cast<uint32_t>('H') << 16) | (static_cast<uint32_t>('K') << 24));
-/* ################################################################################### */
-/* ############################# MAKE MODIFICATIONS HERE ############################# */
-/* ################################################################################### */
 
-/* ################################################################################### */
-/* ################################ END MODIFICATIONS ################################ */
-/* ################################################################################### */
+// Identifiers of the binary commands
+constexpr uint32_t LOG_LEVEL_CMD_ID = ZeroMQCommandId("log_level");
+constexpr uint32_t VERSION_CMD_ID = ZeroMQCommandId("version");
+constexpr uint32_t PING_CMD_ID = ZeroMQCommandId("ping");
+constexpr uint32_t STATUS_CMD_ID = ZeroMQCommandId("status");
+constexpr uint32_t COMMANDS_CMD_ID = ZeroMQCommandId("commands");
+constexpr uint32_t PROFILER_START_CMD_ID = ZeroMQCommandId("profiler_start");
+constexpr uint32_t PROFILER_STOP_CMD_ID = ZeroMQCommandId("profiler_stop");
+constexpr uint32_t PROFILER_DUMP_CMD_ID = ZeroMQCommandId("profiler_dump");
 
-void ZeroMQServer::update()
-{
-	auto recvMsgs = recvMessages();
+static_assert(
+	[] {
+		constexpr std::array commandIds = {LOG_LEVEL_ID,		  VERSION_INFO_ID,		 PING_PONG_ID,
+										   STATUS_CHECK_ID,		  LOG_LEVEL_CMD_ID,		 VERSION_CMD_ID,
+										   PING_CMD_ID,			  STATUS_CMD_ID,		 COMMANDS_CMD_ID,
+										   PROFILER_START_CMD_ID, PROFILER_STOP_CMD_ID, PROFILER_DUMP_CMD_ID,
+										   ZEROMQ_BATCH_CMD_ID};
+		for (size_t idx = 0; idx < commandIds.size(); ++idx)
+		{
+			for (size_t other = idx + 1; other < commandIds.size(); ++other)
+			{
+				if (commandIds[idx] == commandIds[other])
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}(),
+	"Command identifiers should be unique");
 
-	if (!recvMsgs.empty())
-	{
-		std::vector<zmq::message_t> replyMsgs;
+// Receive timeout of the worker sockets in milliseconds
+constexpr int ZEROMQ_POLL_TIMEOUT_MS = 100;
 
-		ZeroMQServerStats serverStats;
-		serverStats.processingTimeStart = std::chrono::high_resolution_clock::now();
+namespace
+{
+	// Name of the registered command, unknown identifiers are written as hex
+	std::string commandName(const std::vector<zmq::message_t> &recvMsgs)
+	{
+		if (recvMsgs.empty() || recvMsgs[0].size() != sizeof(uint32_t))
+		{
+			return "-";
+		}
 
-		if (recvMsgs[0].size() != sizeof(uint32_t))
+		const uint32_t commandId = *recvMsgs[0].data<uint32_t>();
+		if (const auto command = ZeroMQCommands().find(commandId); command)
 		{
-			int errorCode = ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL;
-			replyMsgs.emplace_back(&errorCode, sizeof(errorCode));
-			replyMsgs.emplace_back("", 0);
+			return command->name;
 		}
-		else
+		return std::format("{:#010x}", commandId);
+	}
+} // namespace
+
+bool ZeroMQServer::processMessages(const std::vector<zmq::message_t> &recvMsgs, std::vector<zmq::message_t> &replyMsgs)
+{
+	replyMsgs.clear();
+	if (recvMsgs.empty() || recvMsgs[0].size() != sizeof(uint32_t))
+	{
+		int errorCode = ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL;
+		replyMsgs.emplace_back(&errorCode, sizeof(errorCode));
+		replyMsgs.emplace_back("", 0);
+		return false;
+	}
+	return messageCallback() && messageCallback()(recvMsgs, replyMsgs);
+}
+
+void ZeroMQServer::consumeStats(const std::vector<zmq::message_t> &recvMsgs,
+								const std::vector<zmq::message_t> &replyMsgs, const ZeroMQServerStats &serverStats)
+{
+	if (_stats)
+	{
+		_stats->consumeStats(recvMsgs, replyMsgs, serverStats);
+	}
+
+	if (_publisher)
+	{
+		size_t recvBytes = 0;
+		for (const auto &msg : recvMsgs)
 		{
-			serverStats.isSuccessful = messageCallback() && messageCallback()(recvMsgs, replyMsgs);
+			recvBytes += msg.size();
 		}
+		const auto processingTime = std::chrono::duration_cast<std::chrono::microseconds>(
+			serverStats.processingTimeEnd - serverStats.processingTimeStart);
+
+		_publisher->publishAudit("zeromq", std::format("{} {} {}us", commandName(recvMsgs),
+													   serverStats.isSuccessful ? "succeeded" : "failed",
+													   processingTime.count()));
+		_publisher->publishMetric("zeromq.commands", 1);
+		_publisher->publishMetric(serverStats.isSuccessful ? "zeromq.succeeded_commands" : "zeromq.failed_commands", 1);
+		_publisher->publishMetric("zeromq.received_bytes", static_cast<double>(recvBytes));
+	}
+}
+
+void ZeroMQServer::update()
+{
+	if (recvMessages(_recvMsgs) > 0)
+	{
+		ZeroMQServerStats serverStats;
+		serverStats.processingTimeStart = TscClock::now();
+		serverStats.isSuccessful = processMessages(_recvMsgs, _replyMsgs);
 
-		if (size_t nSentMsg = sendMessages(replyMsgs); nSentMsg != replyMsgs.size())
+		if (size_t nSentMsg = sendMessages(_replyMsgs); nSentMsg != _replyMsgs.size())
 		{
-			spdlog::warn("Can't send whole reply: Sent messages {} / {}", nSentMsg, replyMsgs.size());
+			spdlog::warn("Can't send whole reply: Sent messages {} / {}", nSentMsg, _replyMsgs.size());
 		}
-		serverStats.processingTimeEnd = std::chrono::high_resolution_clock::now();
+		serverStats.processingTimeEnd = TscClock::now();
+
+		consumeStats(_recvMsgs, _replyMsgs, serverStats);
+	}
+}
+
+void ZeroMQServer::dispatchMessages()
+{
+	if (_idleWorkers.empty() || recvMessages(_recvMsgs) == 0)
+	{
+		return;
+	}
+
+	retryOnInterrupt([this] { return _backendSocket->send(_idleWorkers.front(), zmq::send_flags::sndmore); });
+	_idleWorkers.pop_front();
+	sendMultipart(*_backendSocket, _recvMsgs);
 
-		if (_stats)
+	// Other messages wait in the frontend queue until a worker is ready
+	if (_idleWorkers.empty())
+	{
+		_reactor.pauseSocket(*getSocket(), true);
+	}
+}
+
+void ZeroMQServer::forwardReplies()
+{
+	// Replies are [worker, client envelope..., reply...], a single empty frame announces a worker is ready
+	_recvMsgs.clear();
+	if (recvMultipart(*_backendSocket, _recvMsgs) == 0)
+	{
+		return;
+	}
+
+	if (_idleWorkers.empty())
+	{
+		_reactor.pauseSocket(*getSocket(), false);
+	}
+	_idleWorkers.push_back(std::move(_recvMsgs.front()));
+	_recvMsgs.erase(_recvMsgs.begin());
+
+	if (_recvMsgs.size() > 1 || (_recvMsgs.size() == 1 && !_recvMsgs.front().empty()))
+	{
+		if (size_t nSentMsg = sendMessages(_recvMsgs); nSentMsg != _recvMsgs.size())
 		{
-			_stats->consumeStats(recvMsgs, replyMsgs, serverStats);
+			spdlog::warn("Can't send whole reply: Sent messages {} / {}", nSentMsg, _recvMsgs.size());
 		}
 	}
 }
 
-void ZeroMQServer::threadFunc(const std::stop_token &stopToken) noexcept
+void ZeroMQServer::workerFunc(const std::stop_token &stopToken, size_t workerIdx) noexcept
 {
-	spdlog::info("ZeroMQ server started");
-	while (!stopToken.stop_requested())
+	pthread_setname_np(pthread_self(), std::format("zmq-worker-{}", workerIdx).c_str());
+
+	try
 	{
-		try
+		zmq::socket_t socket(*getContext(), zmq::socket_type::dealer);
+		socket.set(zmq::sockopt::linger, 0);
+		socket.set(zmq::sockopt::rcvtimeo, ZEROMQ_POLL_TIMEOUT_MS);
+		socket.connect(_backendAddr);
+
+		// Recycled between messages
+		std::vector<zmq::message_t> recvMsgs;
+		std::vector<zmq::message_t> replyMsgs;
+		std::vector<zmq::message_t> envelope;
+
+		spdlog::debug("ZeroMQ worker {} started", workerIdx);
+		retryOnInterrupt([&socket] { return socket.send(zmq::message_t(), zmq::send_flags::none); });
+		while (!stopToken.stop_requested())
 		{
-			update();
-			if (_checkFlag)
+			recvMsgs.clear();
+			if (recvMultipart(socket, recvMsgs) == 0)
 			{
-				_checkFlag->test_and_set();
+				continue;
 			}
-		}
-		catch (const std::exception &e)
-		{
-			spdlog::error("ZeroMQ server failed: {}", e.what());
+
+			// Routing envelope of the frontend. REQ clients also add an empty delimiter and pipelined clients add their
+			// marker and request identifier before it, the parts of other clients are kept as they are
+			size_t envelopeSize = 1;
+			if (recvMsgs.size() > 1 && recvMsgs[1].empty())
+			{
+				envelopeSize = 2;
+			}
+			else if (recvMsgs.size() > 3 && recvMsgs[1].size() == sizeof(ZEROMQ_PIPELINE_MARKER_ID) &&
+					 *recvMsgs[1].data<uint32_t>() == ZEROMQ_PIPELINE_MARKER_ID &&
+					 recvMsgs[2].size() == sizeof(ZeroMQRequestId) && recvMsgs[3].empty())
+			{
+				envelopeSize = 4;
+			}
+			envelope.assign(std::make_move_iterator(recvMsgs.begin()),
+							std::make_move_iterator(recvMsgs.begin() + envelopeSize));
+			recvMsgs.erase(recvMsgs.begin(), recvMsgs.begin() + envelopeSize);
+
+			ZeroMQServerStats serverStats;
+			serverStats.processingTimeStart = TscClock::now();
+			try
+			{
+				serverStats.isSuccessful = processMessages(recvMsgs, replyMsgs);
+			}
+			catch (const std::exception &e)
+			{
+				spdlog::error("ZeroMQ worker {} failed: {}", workerIdx, e.what());
+				replyMsgs.clear();
+			}
+
+			// Reply is required to return the worker to the idle list
+			if (replyMsgs.empty())
+			{
+				replyMsgs.emplace_back();
+			}
+			sendMultipart(socket, envelope, zmq::send_flags::sndmore);
+			sendMultipart(socket, replyMsgs);
+			serverStats.processingTimeEnd = TscClock::now();
+
+			consumeStats(recvMsgs, replyMsgs, serverStats);
 		}
 	}
-	spdlog::info("ZeroMQ server stopped");
+	catch (const std::exception &e)
+	{
+		spdlog::error("ZeroMQ worker {} stopped unexpectedly: {}", workerIdx, e.what());
+	}
+	spdlog::debug("ZeroMQ worker {} stopped", workerIdx);
 }
 
 ZeroMQServer::ZeroMQServer(const std::string &hostAddr, std::shared_ptr<std::atomic_flag> checkFlag,
-						   const std::shared_ptr<prometheus::Registry> &reg, const std::string &prependName)
-	: ZeroMQ(zmq::socket_type::rep, hostAddr, true), _checkFlag(std::move(checkFlag))
+						   const std::shared_ptr<prometheus::Registry> &reg, const std::string &prependName,
+						   size_t nWorkers, const ZeroMQCurveKeys &curveKeys,
+						   const std::filesystem::path &authorizedKeysPath)
+	: ZeroMQServer(ZeroMQSharedContext(), hostAddr, std::move(checkFlag), reg, prependName, nWorkers, curveKeys,
+				   authorizedKeysPath)
+{
+}
+
+ZeroMQServer::ZeroMQServer(const std::shared_ptr<zmq::context_t> &ctx, const std::string &hostAddr,
+						   std::shared_ptr<std::atomic_flag> checkFlag,
+						   const std::shared_ptr<prometheus::Registry> &reg, const std::string &prependName,
+						   size_t nWorkers, const ZeroMQCurveKeys &curveKeys,
+						   const std::filesystem::path &authorizedKeysPath)
+	: ZeroMQ(ctx, nWorkers > 0 ? zmq::socket_type::router : zmq::socket_type::rep, hostAddr, true, curveKeys),
+	  _checkFlag(std::move(checkFlag)), _reactor(getContext()), _nWorkers(nWorkers),
+	  // Internal endpoints are unique per instance, servers of the same address may share the context
+	  _backendAddr(std::format("inproc://{}.{}.workers", constHasher(hostAddr.c_str()), static_cast<void *>(this))),
+	  _monitorAddr(std::format("inproc://{}.{}.{}", constHasher(hostAddr.c_str()), static_cast<void *>(this),
+							   nWorkers > 0 ? "router" : "rep"))
 {
 	if (reg)
 	{
 		_stats = std::make_unique<ZeroMQStats>(reg, prependName);
+		registerMetrics(reg, prependName);
 	}
 
-	startMonitoring(getSocket().get(), std::format("{}{}{}", "inproc://", constHasher(hostAddr.c_str()), ".rep"));
+	// Handler should be bound before the socket, otherwise all clients are accepted
+	if (!curveKeys.secretKey.empty())
+	{
+		_authenticator = std::make_unique<ZeroMQAuthenticator>(getContext(), authorizedKeysPath);
+	}
 }
 
 bool ZeroMQServer::initialise()
 {
-	if (start())
+	if (_reactor.isRunning())
 	{
-		_serverThread = std::make_unique<std::jthread>([this](const std::stop_token &sToken) { threadFunc(sToken); });
-		return true;
+		return false;
+	}
+
+	// Events are served from the server thread. Monitor is attached before the bind to report it, shutdown stops it
+	startMonitoring(getSocket().get(), _monitorAddr, _reactor);
+	try
+	{
+		start();
 	}
-	return false;
+	catch (const zmq::error_t &)
+	{
+		stopMonitoring();
+		throw;
+	}
+
+	if (_nWorkers > 0)
+	{
+		_backendSocket = std::make_unique<zmq::socket_t>(*getContext(), zmq::socket_type::router);
+		_backendSocket->set(zmq::sockopt::linger, 0);
+		_backendSocket->bind(_backendAddr);
+		_reactor.addSocket(*_backendSocket, [this](zmq::socket_ref /*unused*/) { forwardReplies(); });
+
+		// Frontend is polled once a worker is ready
+		_reactor.addSocket(*getSocket(), [this](zmq::socket_ref /*unused*/) { dispatchMessages(); });
+		_reactor.pauseSocket(*getSocket(), true);
+
+		for (size_t idx = 0; idx < _nWorkers; ++idx)
+		{
+			_workerThreads.emplace_back([this, idx](const std::stop_token &sToken) { workerFunc(sToken, idx); });
+		}
+	}
+	else
+	{
+		_reactor.addSocket(*getSocket(), [this](zmq::socket_ref /*unused*/) { update(); });
+	}
+
+	_reactor.tickCallback([this]() {
+		if (_checkFlag)
+		{
+			_checkFlag->test_and_set();
+		}
+	});
+	_reactor.start();
+	spdlog::info("ZeroMQ server started");
+	return true;
 }
 
 void ZeroMQServer::shutdown()
 {
-	if (_serverThread)
+	if (_reactor.isRunning())
+	{
+		_reactor.stop();
+		spdlog::info("ZeroMQ server stopped");
+	}
+	_reactor.removeSocket(*getSocket());
+	if (_backendSocket)
 	{
-		_serverThread.reset();
+		_reactor.removeSocket(*_backendSocket);
 	}
 
+	// Request all first, so the workers stop in parallel
+	for (auto &worker : _workerThreads)
+	{
+		worker.request_stop();
+	}
+	_workerThreads.clear();
+	_idleWorkers.clear();
+	_backendSocket.reset();
+
+	// Monitor is stopped while the reactor and the socket are alive
+	stopMonitoring();
 	stop();
 }
 
-bool ZeroMQServerMessageCallback(const std::vector<zmq::message_t> &recvMsgs, std::vector<zmq::message_t> &replyMsgs)
+namespace
 {
-	spdlog::trace("Received {} messages", recvMsgs.size());
-	replyMsgs.clear();
-
-	std::string replyBody;
-	int reply = ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL;
-	switch (*(static_cast<const uint32_t *>(recvMsgs[0].data())))
+	bool textLogLevelCommand(std::string_view level, std::vector<zmq::message_t> & /*unused*/)
 	{
-	case LOG_LEVEL_ID: {
-		if (recvMsgs.size() != 2)
-		{
-			spdlog::error("Received unknown number of messages for log level change");
-			break;
-		}
-
 		spdlog::warn("Log level change request received");
-		const auto receivedMsg = std::string(static_cast<const char *>(recvMsgs[1].data()), recvMsgs[1].size());
-
-		if (receivedMsg == "v")
+		if (level == "v")
 		{
 			spdlog::set_level(spdlog::level::info);
 		}
-		if (receivedMsg == "vv")
+		if (level == "vv")
 		{
 			spdlog::set_level(spdlog::level::debug);
 		}
-		if (receivedMsg == "vvv")
+		if (level == "vvv")
 		{
 			spdlog::set_level(spdlog::level::trace);
 		}
-		if (receivedMsg == "r")
+		if (level == "r")
 		{
 #ifdef NDEBUG
 			spdlog::set_level(spdlog::level::warn);
@@ -151,65 +388,172 @@ bool ZeroMQServerMessageCallback(const std::vector<zmq::message_t> &recvMsgs, st
 			spdlog::set_level(spdlog::level::info);
 #endif
 		}
-		reply = ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
-		break;
+		return true;
+	}
+
+	bool textPingCommand(std::vector<zmq::message_t> &replyMsgs)
+	{
+		replyMsgs.push_back(makeConstMessage("PONG"));
+		return true;
+	}
+
+	bool textStatusCommand(std::vector<zmq::message_t> &replyMsgs)
+	{
+		std::string statusStr = "{";
+		for (const auto &[process, statusFlag] : vCheckFlag)
+		{
+			statusStr.append("\"").append(process).append("\":").append(statusFlag->test() ? "1," : "0,");
+		}
+		if (statusStr.back() == ',')
+		{
+			statusStr.pop_back();
+		}
+		statusStr.push_back('}');
+		replyMsgs.push_back(makeMessage(std::move(statusStr)));
+		return true;
 	}
-	case VERSION_INFO_ID: {
-		if (recvMsgs.size() != 1)
+
+	// Receives a spdlog::level::level_enum value
+	bool logLevelCommand(uint8_t level, std::vector<zmq::message_t> & /*unused*/)
+	{
+		if (level >= spdlog::level::n_levels)
 		{
-			spdlog::error("Received unknown number of messages for version information");
-			break;
+			spdlog::error("Received invalid log level {}", level);
+			return false;
 		}
 
-		reply = ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
-		replyBody = PROJECT_FULL_VERSION_STRING;
-		break;
+		spdlog::warn("Log level change request received");
+		spdlog::set_level(static_cast<spdlog::level::level_enum>(level));
+		return true;
+	}
+
+	bool versionCommand(std::vector<zmq::message_t> &replyMsgs)
+	{
+		static const std::string versionStr = PROJECT_FULL_VERSION_STRING;
+		replyMsgs.push_back(makeConstMessage(versionStr));
+		return true;
 	}
-	case PING_PONG_ID: {
-		if (recvMsgs.size() != 1)
+
+	// Replies the server time in nanoseconds since epoch
+	bool pingCommand(std::vector<zmq::message_t> &replyMsgs)
+	{
+		const int64_t serverTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+									   std::chrono::system_clock::now().time_since_epoch())
+									   .count();
+		replyMsgs.push_back(ZeroMQEncodeReply(serverTime));
+		return true;
+	}
+
+	// Replies a part for every check, which is the state byte followed by the name of the check
+	bool statusCommand(std::vector<zmq::message_t> &replyMsgs)
+	{
+		for (const auto &[process, statusFlag] : vCheckFlag)
 		{
-			spdlog::error("Received unknown number of messages for ping");
-			break;
+			std::string statusPart(1, static_cast<char>(statusFlag->test()));
+			statusPart.append(process);
+			replyMsgs.push_back(makeMessage(std::move(statusPart)));
 		}
+		return true;
+	}
 
-		reply = ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
-		replyBody = "PONG";
-		break;
+	// Replies a part for every command, which is the identifier followed by the name of the command
+	bool commandsCommand(std::vector<zmq::message_t> &replyMsgs)
+	{
+		for (const auto &[commandId, name] : ZeroMQCommands().commands())
+		{
+			std::string commandPart(sizeof(commandId), '\0');
+			std::memcpy(commandPart.data(), &commandId, sizeof(commandId));
+			commandPart.append(name);
+			replyMsgs.push_back(makeMessage(std::move(commandPart)));
+		}
+		return true;
 	}
-	case STATUS_CHECK_ID: {
-		if (recvMsgs.size() != 1)
+
+	// Starts the sampling profiler at the received frequency in Hz, zero selects the default frequency
+	bool profilerStartCommand(uint32_t frequency, std::vector<zmq::message_t> &replyMsgs)
+	{
+		if (!Profiler().start(frequency == 0 ? PROFILER_DEFAULT_FREQUENCY : frequency))
 		{
-			spdlog::error("Received unknown number of messages for status check");
-			break;
+			return false;
 		}
+		replyMsgs.push_back(makeMessage(Profiler().summary()));
+		return true;
+	}
 
-		reply = ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
+	bool profilerStopCommand(std::vector<zmq::message_t> &replyMsgs)
+	{
+		if (!Profiler().stop())
+		{
+			return false;
+		}
+		replyMsgs.push_back(makeMessage(Profiler().summary()));
+		return true;
+	}
 
-		std::ostringstream oss;
-		oss << "{";
-		for (const auto &[process, statusFlag] : vCheckFlag)
+	// Replies the sampled stacks in folded format, one line per stack
+	bool profilerDumpCommand(std::vector<zmq::message_t> &replyMsgs)
+	{
+		std::string folded;
+		for (const auto &stack : Profiler().foldedStacks())
 		{
-			oss << "\"" << process << "\":" << (statusFlag->test() ? "1," : "0,");
+			folded.append(stack).push_back('\n');
 		}
-		replyBody = oss.str();
-		replyBody.replace(replyBody.size() - 1, 1, "}");
-		break;
+		replyMsgs.push_back(makeMessage(std::move(folded)));
+		return true;
 	}
-	/* ################################################################################### */
-	/* ############################# MAKE MODIFICATIONS HERE ############################# */
-	/* ################################################################################### */
 
-	/* ################################################################################### */
-	/* ################################ END MODIFICATIONS ################################ */
-	/* ################################################################################### */
-	default:
-		spdlog::error("Unknown command received from control");
-		break;
+	// Runs the commands of a batch message, see ZeroMQCommandRegistry::dispatchBatch
+	bool batchCommand(std::span<const zmq::message_t> args, std::vector<zmq::message_t> &replyMsgs)
+	{
+		return ZeroMQCommands().dispatchBatch(args, replyMsgs);
 	}
 
-	// Prepare reply
-	replyMsgs.emplace_back(&reply, sizeof(reply));
-	replyMsgs.emplace_back(replyBody.c_str(), replyBody.size());
+	// Built-in commands, registered to the registry on first access
+	// NOLINTBEGIN
+	const std::vector<ZeroMQCommand> zeromqCommands = {
+		makeZeroMQCommand<std::string_view>("LOGL", LOG_LEVEL_ID, textLogLevelCommand),
+		makeZeroMQCommand<>("VERI", VERSION_INFO_ID, versionCommand),
+		makeZeroMQCommand<>("PING", PING_PONG_ID, textPingCommand),
+		makeZeroMQCommand<>("SCHK", STATUS_CHECK_ID, textStatusCommand),
+		makeZeroMQCommand<uint8_t>("log_level", LOG_LEVEL_CMD_ID, logLevelCommand),
+		makeZeroMQCommand<>("version", VERSION_CMD_ID, versionCommand),
+		makeZeroMQCommand<>("ping", PING_CMD_ID, pingCommand),
+		makeZeroMQCommand<>("status", STATUS_CMD_ID, statusCommand),
+		makeZeroMQCommand<>("commands", COMMANDS_CMD_ID, commandsCommand),
+		makeZeroMQCommand<uint32_t>("profiler_start", PROFILER_START_CMD_ID, profilerStartCommand),
+		makeZeroMQCommand<>("profiler_stop", PROFILER_STOP_CMD_ID, profilerStopCommand),
+		makeZeroMQCommand<>("profiler_dump", PROFILER_DUMP_CMD_ID, profilerDumpCommand),
+		{.name = "batch", .id = ZEROMQ_BATCH_CMD_ID, .argumentSizes = {}, .handler = batchCommand, .isVariadic = true},
+		/* ################################################################################### */
+		/* ############################# MAKE MODIFICATIONS HERE ############################# */
+		/* ################################################################################### */
 
-	return reply == ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
+		/* ################################################################################### */
+		/* ################################ END MODIFICATIONS ################################ */
+		/* ################################################################################### */
+	};
+	// NOLINTEND
+} // namespace
+
+ZeroMQCommandRegistry &ZeroMQCommands()
+{
+	static ZeroMQCommandRegistry registry;
+	static const bool isRegistered = [] {
+		for (const auto &command : zeromqCommands)
+		{
+			if (!registry.registerCommand(command))
+			{
+				spdlog::warn("ZeroMQ command {} is already registered", command.name);
+			}
+		}
+		return true;
+	}();
+	(void)isRegistered;
+
+	return registry;
+}
+
+bool ZeroMQServerMessageCallback(const std::vector<zmq::message_t> &recvMsgs, std::vector<zmq::message_t> &replyMsgs)
+{
+	return ZeroMQCommands().dispatch(recvMsgs, replyMsgs);
 }
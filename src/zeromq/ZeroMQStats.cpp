@@ -1,13 +1,15 @@
 #include "zeromq/ZeroMQStats.hpp"
 
+#include "zeromq/ZeroMQCommands.hpp"
+
 #include <date/date.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
+#include <prometheus/histogram.h>
 #include <prometheus/info.h>
-#include <prometheus/summary.h>
 
 ZeroMQStats::ZeroMQStats(const std::shared_ptr<prometheus::Registry> &reg, const std::string &prependName)
-	: BaseServerStats()
+	: BaseServerStats(), _registry(reg)
 {
 	if (!reg)
 	{
@@ -52,13 +54,80 @@ ZeroMQStats::ZeroMQStats(const std::shared_ptr<prometheus::Registry> &reg, const
 							   .Help("Total downloaded bytes")
 							   .Register(*reg)
 							   .Add({});
+
+	// Per command stats
+	_commandCountFamily = &prometheus::BuildCounter()
+							   .Name(name + "commands")
+							   .Help("Number of received commands by command name")
+							   .Register(*reg);
+	_commandErrorFamily = &prometheus::BuildCounter()
+							   .Name(name + "command_errors")
+							   .Help("Number of failed commands by command name")
+							   .Register(*reg);
+	_commandTimeFamily = &prometheus::BuildHistogram()
+							   .Name(name + "command_processing_time")
+							   .Help("Command processing time by command name")
+							   .Register(*reg);
+	_unknownCommandStats = makeCommandStats("unknown");
+}
+
+ZeroMQStats::CommandStats ZeroMQStats::makeCommandStats(const std::string &command)
+{
+	return {.total = &_commandCountFamily->Add({{"command", command}}),
+			.failed = &_commandErrorFamily->Add({{"command", command}}),
+			.processingTime = std::make_unique<LatencyHistogram>(_registry, *_commandTimeFamily,
+																 prometheus::Labels{{"command", command}})};
+}
+
+ZeroMQStats::CommandStats &ZeroMQStats::commandStats(const std::vector<zmq::message_t> &recvMsgs)
+{
+	if (recvMsgs.empty() || recvMsgs[0].size() != sizeof(uint32_t))
+	{
+		return _unknownCommandStats;
+	}
+
+	const uint32_t commandId = *recvMsgs[0].data<uint32_t>();
+	{
+		const std::shared_lock lock(_commandStatsGuard);
+		if (const auto itr = _commandStats.find(commandId); itr != _commandStats.end())
+		{
+			return itr->second;
+		}
+	}
+
+	// Labels are only created for the registered commands to keep the cardinality bounded
+	const auto command = ZeroMQCommands().find(commandId);
+	if (!command)
+	{
+		return _unknownCommandStats;
+	}
+
+	// Other workers may have added the metrics after the shared lock is released, references to the elements of the
+	// map stay valid on insertion
+	const std::unique_lock lock(_commandStatsGuard);
+	auto itr = _commandStats.find(commandId);
+	if (itr == _commandStats.end())
+	{
+		itr = _commandStats.emplace(commandId, makeCommandStats(command->name)).first;
+	}
+	return itr->second;
 }
 
 void ZeroMQStats::consumeStats(const std::vector<zmq::message_t> &recvMsgs, const std::vector<zmq::message_t> &sendMsgs,
 							   const ZeroMQServerStats &serverStats)
 {
+	const auto processingTime =
+		static_cast<double>((serverStats.processingTimeEnd - serverStats.processingTimeStart).count());
 	consumeBaseStats(static_cast<uint64_t>(serverStats.isSuccessful), static_cast<uint64_t>(!serverStats.isSuccessful),
-					 static_cast<double>((serverStats.processingTimeEnd - serverStats.processingTimeStart).count()));
+					 processingTime);
+
+	auto &command = commandStats(recvMsgs);
+	command.total->Increment();
+	if (!serverStats.isSuccessful)
+	{
+		command.failed->Increment();
+	}
+	command.processingTime->record(static_cast<uint64_t>(processingTime));
 
 	for (const auto &entry : recvMsgs)
 	{
@@ -1,4 +1,5 @@
 #include "TelnetClient.hpp"
+#include "telnet/TelnetInputParser.hpp"
 #include "telnet/TelnetServer.hpp"
 
 #include <spdlog/spdlog.h>
@@ -39,6 +40,21 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
 	static TelnetWrapper server(TELNET_SERVER_PORT);
 	static TelnetClient client("127.0.0.1", TELNET_SERVER_PORT);
 
+	// Drive the input parser directly with and without line editing
+	TelnetInputParser editingParser(true);
+	TelnetInputParser rawParser(false);
+	for (size_t idx = 0; idx < size; ++idx)
+	{
+		if (editingParser.consume(static_cast<char>(data[idx])) == TelnetInputEvent::Line)
+		{
+			editingParser.takeBuffer();
+		}
+		if (rawParser.consume(static_cast<char>(data[idx])) == TelnetInputEvent::Line)
+		{
+			rawParser.takeBuffer();
+		}
+	}
+
 	const auto command = std::string(reinterpret_cast<const char *>(data), size);
 	return client.sendCommand(command);
 }
@@ -5,10 +5,14 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
 #include <chrono>
 #include <cstring>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -157,6 +161,46 @@ class TelnetClient {
 		return sent > 0;
 	}
 
+	/**
+	 * Sends raw data and waits until the expected response is received
+	 * @param[in] data Data to send as is
+	 * @param[in] expected Response to wait for
+	 * @param[in] count Number of responses to wait for
+	 * @param[in] maxIdleReads Number of consecutive receive timeouts before giving up
+	 * @return true if all responses are received, false otherwise
+	 */
+	bool sendAndWait(const std::string &data, const std::string &expected, size_t count = 1, int maxIdleReads = 100)
+	{
+		if (_sockfd < 0 || expected.empty() || send(_sockfd, data.c_str(), data.length(), MSG_NOSIGNAL) < 0)
+		{
+			return false;
+		}
+
+		// Keep the tail of the received data to match responses split between reads
+		std::string received;
+		char buffer[4096];
+		for (int idleReads = 0; count > 0 && idleReads < maxIdleReads;)
+		{
+			ssize_t readBytes = recv(_sockfd, buffer, sizeof(buffer), 0);
+			if (readBytes <= 0)
+			{
+				++idleReads;
+				continue;
+			}
+			idleReads = 0;
+
+			received.append(buffer, static_cast<size_t>(readBytes));
+			size_t consumed = 0;
+			for (size_t pos = 0; count > 0 && (pos = received.find(expected, consumed)) != std::string::npos;)
+			{
+				consumed = pos + expected.size();
+				--count;
+			}
+			received.erase(0, std::max(consumed, received.size() - std::min(received.size(), expected.size() - 1)));
+		}
+		return count == 0;
+	}
+
 	/**
 	 * Wait for the client thread to finish (if running)
 	 */
@@ -168,3 +212,116 @@ class TelnetClient {
 		}
 	}
 };
+
+/**
+ * @class TelnetRawConnection
+ * A raw connection to a telnet server for the tests checking the exact bytes exchanged
+ * Nothing is read or sent implicitly, so the greeting and the prompts are left to the test
+ */
+class TelnetRawConnection {
+  private:
+	int _sockfd{-1};
+
+  public:
+	/**
+	 * Connects to the server
+	 * @param[in] host The host address to connect to (e.g., "127.0.0.1")
+	 * @param[in] port The port to connect to
+	 * @param[in] recvTimeout Timeout of a single receive
+	 * @throws std::runtime_error if connection fails
+	 */
+	TelnetRawConnection(const std::string &host, int port,
+						std::chrono::microseconds recvTimeout = std::chrono::milliseconds(100))
+	{
+		_sockfd = socket(AF_INET, SOCK_STREAM, 0);
+		if (_sockfd < 0)
+		{
+			throw std::runtime_error("Failed to create socket");
+		}
+
+		timeval timeout{.tv_sec = static_cast<time_t>(recvTimeout.count() / 1000000),
+						.tv_usec = static_cast<suseconds_t>(recvTimeout.count() % 1000000)};
+		sockaddr_in serverAddr{};
+		serverAddr.sin_family = AF_INET;
+		serverAddr.sin_port = htons(port);
+		if (setsockopt(_sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0 ||
+			inet_pton(AF_INET, host.c_str(), &serverAddr.sin_addr) <= 0 ||
+			connect(_sockfd, reinterpret_cast<sockaddr *>(&serverAddr), sizeof(serverAddr)) < 0)
+		{
+			close(_sockfd);
+			throw std::runtime_error("Connection failed");
+		}
+	}
+
+	/**
+	 * Destructor - closes the connection
+	 */
+	~TelnetRawConnection() { close(_sockfd); }
+
+	// Delete copy constructor and assignment operator
+	TelnetRawConnection(const TelnetRawConnection &) = delete;
+	TelnetRawConnection &operator=(const TelnetRawConnection &) = delete;
+
+	/**
+	 * Gets the socket of the connection, e.g. to run TLS over it
+	 * @return int Socket descriptor
+	 */
+	[[nodiscard]] int fd() const { return _sockfd; }
+
+	/**
+	 * Sends raw data as is
+	 * @param[in] data Data to send
+	 * @return true if all data is sent, false otherwise
+	 */
+	bool send(std::string_view data)
+	{
+		return ::send(_sockfd, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+	}
+
+	/**
+	 * Reads until the marker is received, the connection is closed or nothing is received for a while
+	 * @param[in] marker Data to wait for
+	 * @param[in] maxIdleReads Number of consecutive receive timeouts before giving up
+	 * @return std::string Received data, including the marker if it is received
+	 */
+	std::string readUntil(const std::string &marker, int maxIdleReads = 20)
+	{
+		std::string received;
+		std::array<char, 4096> buffer{};
+		for (int idleReads = 0; idleReads < maxIdleReads && received.find(marker) == std::string::npos;)
+		{
+			const ssize_t readBytes = recv(_sockfd, buffer.data(), buffer.size(), 0);
+			if (readBytes == 0 || (readBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+			{
+				break;
+			}
+			if (readBytes < 0)
+			{
+				++idleReads;
+				continue;
+			}
+			received.append(buffer.data(), static_cast<size_t>(readBytes));
+		}
+		return received;
+	}
+
+	/**
+	 * Discards the received data until the server closes the connection
+	 * @param[in] maxIdleReads Number of consecutive receive timeouts before giving up
+	 * @return true if the connection is closed, false otherwise
+	 */
+	bool waitClosed(int maxIdleReads = 100)
+	{
+		std::array<char, 65536> buffer{};
+		for (int idleReads = 0; idleReads < maxIdleReads;)
+		{
+			const ssize_t readBytes = recv(_sockfd, buffer.data(), buffer.size(), 0);
+			if (readBytes == 0 || (readBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+			{
+				return true;
+			}
+			idleReads = readBytes < 0 ? idleReads + 1 : 0;
+		}
+		return false;
+	}
+};
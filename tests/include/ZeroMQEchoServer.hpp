@@ -1,5 +1,7 @@
 #pragma once
 
+#include "zeromq/ZeroMQContext.hpp"
+
 #include <zmq.hpp>
 #include <zmq_addon.hpp>
 
@@ -26,18 +28,21 @@ class ZeroMQEchoServer {
 	 */
 	void serverLoop(std::stop_token stopToken)
 	{
-		for (int i = 0; i < _messageCount && !stopToken.stop_requested(); ++i)
+		// Messages are recycled, so the loop itself does not allocate
+		std::vector<zmq::message_t> recvMsgs;
+		for (int i = 0; i < _messageCount && !stopToken.stop_requested();)
 		{
 			try
 			{
-				// Receive multipart message
-				std::vector<zmq::message_t> recvMsgs;
+				// Receive multipart message, times out periodically to check the stop request
+				recvMsgs.clear();
 				auto result = zmq::recv_multipart(*_socket, std::back_inserter(recvMsgs));
 
 				if (result && !recvMsgs.empty())
 				{
 					// Echo back the received messages
 					zmq::send_multipart(*_socket, recvMsgs);
+					++i;
 				}
 			}
 			catch (const zmq::error_t &)
@@ -53,12 +58,16 @@ class ZeroMQEchoServer {
 	 * Constructs a new ZeroMQEchoServer object and starts listening
 	 * @param[in] address The address to bind to (e.g., "tcp://127.0.0.1:8001")
 	 * @param[in] messageCount Number of messages to echo before stopping (default: 1)
+	 * @param[in] context Context of the socket, required to serve inproc clients. The shared context is used if null
 	 * @throws std::runtime_error if server fails to start
 	 */
-	explicit ZeroMQEchoServer(const std::string &address, int messageCount = 1) : _messageCount(messageCount)
+	explicit ZeroMQEchoServer(const std::string &address, int messageCount = 1,
+							  std::shared_ptr<zmq::context_t> context = nullptr)
+		: _context(context ? std::move(context) : ZeroMQSharedContext()), _messageCount(messageCount)
 	{
-		_context = std::make_shared<zmq::context_t>(1);
 		_socket = std::make_shared<zmq::socket_t>(*_context, zmq::socket_type::rep);
+		_socket->set(zmq::sockopt::linger, 0);
+		_socket->set(zmq::sockopt::rcvtimeo, 100);
 
 		try
 		{
@@ -81,9 +90,9 @@ class ZeroMQEchoServer {
 		if (_serverThread.joinable())
 		{
 			_serverThread.request_stop();
-			_socket->close();
 			_serverThread.join();
 		}
+		_socket->close();
 	}
 
 	// Delete copy constructor and assignment operator
@@ -0,0 +1,260 @@
+#pragma once
+
+#include "zeromq/ZeroMQ.hpp"
+#include "zeromq/ZeroMQCommands.hpp"
+
+#include <zmq.hpp>
+#include <zmq_addon.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class ZeroMQPipelinedClient
+ * A pipelined ZeroMQ client for the command servers
+ *
+ * Requests are sent from a DEALER socket as [pipeline marker, request id, empty delimiter, command parts...] without
+ * waiting for the previous replies, so many commands share the round trip. The marker tells the server the next part is
+ * a request id, not a command. The server routes every reply back with its marker and request id,
+ * which completes the requests in any order when the server has workers. Not thread-safe, like the socket itself.
+ */
+class ZeroMQPipelinedClient : private ZeroMQ {
+  public:
+	/// Called with the reply parts when a request completes
+	using FPTR_ReplyCallback = std::function<void(ZeroMQRequestId, std::vector<zmq::message_t> &)>;
+
+  private:
+	// Maximum number of requests waiting for a reply
+	size_t _maxInFlight;
+	// Identifier of the next request
+	ZeroMQRequestId _nextRequestId{1};
+	// Requests waiting for a reply, with their callbacks
+	std::unordered_map<ZeroMQRequestId, FPTR_ReplyCallback> _pendingRequests;
+	// Replies of the completed requests without a callback
+	std::unordered_map<ZeroMQRequestId, std::vector<zmq::message_t>> _completedReplies;
+	// Received messages, recycled between replies
+	std::vector<zmq::message_t> _recvMsgs;
+
+	// Receives a reply and completes its request
+	bool recvReply(zmq::recv_flags flags)
+	{
+		_recvMsgs.clear();
+		if (!zmq::recv_multipart(*getSocket(), std::back_inserter(_recvMsgs), flags))
+		{
+			return false;
+		}
+
+		// Replies of unknown requests are dropped
+		if (_recvMsgs.size() < 3 || _recvMsgs[0].size() != sizeof(ZEROMQ_PIPELINE_MARKER_ID) ||
+			*_recvMsgs[0].data<uint32_t>() != ZEROMQ_PIPELINE_MARKER_ID ||
+			_recvMsgs[1].size() != sizeof(ZeroMQRequestId) || !_recvMsgs[2].empty())
+		{
+			return true;
+		}
+		ZeroMQRequestId requestId = 0;
+		std::memcpy(&requestId, _recvMsgs[1].data(), sizeof(requestId));
+		const auto iter = _pendingRequests.find(requestId);
+		if (iter == _pendingRequests.end())
+		{
+			return true;
+		}
+
+		const auto callback = std::move(iter->second);
+		_pendingRequests.erase(iter);
+		std::vector<zmq::message_t> replyMsgs(std::make_move_iterator(_recvMsgs.begin() + 3),
+											  std::make_move_iterator(_recvMsgs.end()));
+		if (callback)
+		{
+			callback(requestId, replyMsgs);
+		}
+		else
+		{
+			_completedReplies.emplace(requestId, std::move(replyMsgs));
+		}
+		return true;
+	}
+
+  public:
+	/**
+	 * Constructs a new client and connects to the server
+	 * @param[in] address The address to connect to (e.g., "tcp://127.0.0.1:8300")
+	 * @param[in] maxInFlight Maximum number of requests waiting for a reply. Sending more waits for a reply first
+	 * @throws std::runtime_error if connection fails
+	 */
+	explicit ZeroMQPipelinedClient(const std::string &address, size_t maxInFlight = 1000)
+		: ZeroMQ(zmq::socket_type::dealer, address, false), _maxInFlight(std::max<size_t>(maxInFlight, 1))
+	{
+		try
+		{
+			start();
+		}
+		catch (const zmq::error_t &e)
+		{
+			throw std::runtime_error(std::string("Failed to connect ZeroMQ socket: ") + e.what());
+		}
+	}
+
+	/**
+	 * Sends a command without waiting for the reply
+	 * @param[in] msgs Command parts, moved to the socket
+	 * @param[in] callback Called with the reply parts. If empty, the reply is kept until it is taken by wait
+	 * @return ZeroMQRequestId Identifier of the request
+	 * @throws std::runtime_error if there is no reply while the window is full or the command can't be sent
+	 */
+	ZeroMQRequestId send(std::vector<zmq::message_t> &msgs, FPTR_ReplyCallback callback = {})
+	{
+		while (_pendingRequests.size() >= _maxInFlight)
+		{
+			if (!recvReply(zmq::recv_flags::none))
+			{
+				throw std::runtime_error("No reply received from ZeroMQ server");
+			}
+		}
+
+		const ZeroMQRequestId requestId = _nextRequestId++;
+		if (!getSocket()->send(zmq::message_t(&ZEROMQ_PIPELINE_MARKER_ID, sizeof(ZEROMQ_PIPELINE_MARKER_ID)),
+							   zmq::send_flags::sndmore) ||
+			!getSocket()->send(zmq::message_t(&requestId, sizeof(requestId)), zmq::send_flags::sndmore) ||
+			!getSocket()->send(zmq::message_t(), zmq::send_flags::sndmore) ||
+			sendMessages(msgs) != msgs.size())
+		{
+			throw std::runtime_error("Failed to send ZeroMQ request");
+		}
+		_pendingRequests.emplace(requestId, std::move(callback));
+		return requestId;
+	}
+
+	/**
+	 * Sends several commands in one batch message. The reply can be split with splitBatchReply
+	 * @param[in] commands Parts of the commands, moved to the socket
+	 * @param[in] callback Called with the reply parts of the batch
+	 * @return ZeroMQRequestId Identifier of the request
+	 */
+	ZeroMQRequestId sendBatch(std::vector<std::vector<zmq::message_t>> &commands, FPTR_ReplyCallback callback = {})
+	{
+		std::vector<zmq::message_t> msgs;
+		msgs.emplace_back(&ZEROMQ_BATCH_CMD_ID, sizeof(ZEROMQ_BATCH_CMD_ID));
+		for (auto &command : commands)
+		{
+			const auto nParts = static_cast<uint32_t>(command.size());
+			msgs.emplace_back(&nParts, sizeof(nParts));
+			for (auto &msg : command)
+			{
+				msgs.push_back(std::move(msg));
+			}
+		}
+		return send(msgs, std::move(callback));
+	}
+
+	/**
+	 * Completes the requests whose replies arrive within the timeout
+	 * @param[in] timeout Time to wait for the first reply
+	 * @return size_t Number of received replies
+	 */
+	size_t poll(std::chrono::milliseconds timeout)
+	{
+		zmq::pollitem_t items[] = {{getSocket()->handle(), 0, ZMQ_POLLIN, 0}};
+		if (zmq::poll(&items[0], 1, timeout) <= 0)
+		{
+			return 0;
+		}
+
+		size_t nReplies = 0;
+		while (recvReply(zmq::recv_flags::dontwait))
+		{
+			++nReplies;
+		}
+		return nReplies;
+	}
+
+	/**
+	 * Waits for the reply of a request sent without a callback
+	 * @param[in] requestId Identifier of the request
+	 * @param[out] replyMsgs Reply parts
+	 * @return true If the reply is received
+	 * @return false If the request is unknown or the server does not reply in time
+	 */
+	bool wait(ZeroMQRequestId requestId, std::vector<zmq::message_t> &replyMsgs)
+	{
+		auto iter = _completedReplies.find(requestId);
+		while (iter == _completedReplies.end())
+		{
+			if (!_pendingRequests.contains(requestId) || !recvReply(zmq::recv_flags::none))
+			{
+				return false;
+			}
+			iter = _completedReplies.find(requestId);
+		}
+
+		replyMsgs = std::move(iter->second);
+		_completedReplies.erase(iter);
+		return true;
+	}
+
+	/**
+	 * Waits for the replies of all requests
+	 * @return true If all replies are received
+	 * @return false If the server does not reply in time
+	 */
+	bool drain()
+	{
+		while (!_pendingRequests.empty())
+		{
+			if (!recvReply(zmq::recv_flags::none))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Gets the number of requests waiting for a reply
+	 * @return size_t Number of requests
+	 */
+	[[nodiscard]] size_t pendingRequests() const { return _pendingRequests.size(); }
+
+	/**
+	 * Splits the reply of a batch to the replies of its commands
+	 * @param[in] replyMsgs Reply parts of the batch, moved to the command replies
+	 * @return std::vector<std::vector<zmq::message_t>> Status and reply parts of the commands, empty if the batch
+	 * failed
+	 */
+	static std::vector<std::vector<zmq::message_t>> splitBatchReply(std::vector<zmq::message_t> &replyMsgs)
+	{
+		std::vector<std::vector<zmq::message_t>> commandReplies;
+		if (replyMsgs.empty() || replyMsgs[0].size() != sizeof(int) ||
+			*replyMsgs[0].data<int>() != ZMQ_EVENT_HANDSHAKE_SUCCEEDED)
+		{
+			return commandReplies;
+		}
+
+		for (size_t idx = 1; idx < replyMsgs.size();)
+		{
+			uint32_t nParts = 0;
+			if (replyMsgs[idx].size() != sizeof(nParts))
+			{
+				return {};
+			}
+			std::memcpy(&nParts, replyMsgs[idx].data(), sizeof(nParts));
+			if (nParts > replyMsgs.size() - idx - 1)
+			{
+				return {};
+			}
+
+			auto &commandReply = commandReplies.emplace_back();
+			for (size_t partIdx = idx + 1; partIdx <= idx + nParts; ++partIdx)
+			{
+				commandReply.push_back(std::move(replyMsgs[partIdx]));
+			}
+			idx += nParts + 1;
+		}
+		return commandReplies;
+	}
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "zeromq/ZeroMQContext.hpp"
+
 #include <zmq.hpp>
 #include <zmq_addon.hpp>
 
@@ -44,12 +46,15 @@ class ZeroMQTestClient {
 	/**
 	 * Constructs a new ZeroMQTestClient and connects to the server
 	 * @param[in] address The address to connect to (e.g., "tcp://127.0.0.1:8300")
+	 * @param[in] context Context of the socket, required to connect inproc servers. The shared context is used if null
 	 * @throws std::runtime_error if connection fails
 	 */
-	explicit ZeroMQTestClient(const std::string &address)
+	explicit ZeroMQTestClient(const std::string &address, std::shared_ptr<zmq::context_t> context = nullptr)
+		: _context(context ? std::move(context) : ZeroMQSharedContext())
 	{
-		_context = std::make_shared<zmq::context_t>(1);
 		_socket = std::make_shared<zmq::socket_t>(*_context, zmq::socket_type::req);
+		_socket->set(zmq::sockopt::linger, 0);
+		_socket->set(zmq::sockopt::rcvtimeo, 1000);
 
 		try
 		{
@@ -88,4 +93,18 @@ class ZeroMQTestClient {
 			(void)zmq::recv_multipart(*_socket, std::back_inserter(recvMsgs)).value_or(0);
 		}
 	}
+
+	/**
+	 * Sends a request and waits for the reply
+	 * @param[in] sendMsgs Messages to send, moved to the socket
+	 * @param[out] recvMsgs Received messages, previous ones are discarded
+	 * @return true If the reply is received
+	 * @return false otherwise
+	 */
+	bool request(std::vector<zmq::message_t> &sendMsgs, std::vector<zmq::message_t> &recvMsgs)
+	{
+		recvMsgs.clear();
+		return zmq::send_multipart(*_socket, sendMsgs) &&
+			   zmq::recv_multipart(*_socket, std::back_inserter(recvMsgs)).value_or(0) > 0;
+	}
 };
@@ -1,14 +1,26 @@
 #include "test-static-definitions.h"
 
+#include "metrics/LatencyHistogram.hpp"
 #include "metrics/Performance.hpp"
+#include "metrics/ProcSampler.hpp"
 #include "metrics/ProcessMetrics.hpp"
+#include "metrics/Profiler.hpp"
 #include "metrics/PrometheusServer.hpp"
+#include "metrics/ScrapeRegistry.hpp"
 #include "metrics/Status.hpp"
 
+#include <algorithm>
 #include <fstream>
+#include <functional>
+#include <numeric>
+#include <set>
 #include <thread>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <gtest/gtest.h>
+#include <prometheus/metric_family.h>
 
 bool isAllValuesExist(std::ifstream &promFile, const std::vector<std::string> &testVals,
 					  std::vector<std::string> &readVals)
@@ -56,6 +68,85 @@ TEST(Metrics_Tests, PrometheusServerUnitTests)
 	ASSERT_TRUE(reporter.deleteRegistry(regId));
 }
 
+TEST(Metrics_Tests, ScrapeRegistryUnitTests)
+{
+	PrometheusServer reporter("localhost:8104");
+	auto reg = std::dynamic_pointer_cast<ScrapeRegistry>(reporter.createNewRegistry());
+	ASSERT_NE(reg, nullptr);
+
+	int nFirstCalls = 0;
+	int nSecondCalls = 0;
+	const auto firstId = reg->addScrapeCallback([&nFirstCalls] { ++nFirstCalls; });
+	const auto secondId = reg->addScrapeCallback([&nSecondCalls] { ++nSecondCalls; });
+	ASSERT_NE(firstId, secondId);
+
+	reg->Collect();
+	ASSERT_EQ(nFirstCalls, 1);
+	ASSERT_EQ(nSecondCalls, 1);
+
+	reg->removeScrapeCallback(firstId);
+	reg->Collect();
+	ASSERT_EQ(nFirstCalls, 1);
+	ASSERT_EQ(nSecondCalls, 2);
+
+	// Unknown callbacks are ignored
+	reg->removeScrapeCallback(firstId);
+	reg->removeScrapeCallback(secondId);
+	reg->Collect();
+	ASSERT_EQ(nSecondCalls, 2);
+}
+
+TEST(Metrics_Tests, LatencyHistogramUnitTests)
+{
+	// Every value is in a bucket whose bounds are within the precision of the value
+	for (uint64_t value : {0ULL, 1ULL, 2ULL, 31ULL, 32ULL, 33ULL, 1000ULL, 1024ULL, 1025ULL, 123456789ULL, 1ULL << 49})
+	{
+		const size_t idx = LatencyHistogram::bucketIndex(value);
+		ASSERT_LE(value, LatencyHistogram::bucketUpperBound(idx));
+		if (idx > 0)
+		{
+			ASSERT_GT(value, LatencyHistogram::bucketUpperBound(idx - 1));
+		}
+		ASSERT_LE(LatencyHistogram::bucketUpperBound(idx) - value, value / 16 + 1);
+	}
+	ASSERT_EQ(LatencyHistogram::bucketIndex(std::numeric_limits<uint64_t>::max()), LATENCY_HISTOGRAM_BUCKETS - 1);
+
+	// Exported boundaries are powers of two and their midpoints
+	const auto boundaries = LatencyHistogram::bucketBoundaries(1000, 4096);
+	ASSERT_EQ(boundaries, prometheus::Histogram::BucketBoundaries({1024, 1536, 2048, 3072, 4096}));
+
+	LatencyHistogram histogram;
+	ASSERT_EQ(histogram.quantile(0.5), 0);
+	for (uint64_t value = 1; value <= 1000; ++value)
+	{
+		histogram.record(value * 1000);
+	}
+	ASSERT_EQ(histogram.count(), 1000);
+	ASSERT_EQ(histogram.sum(), 500500000);
+	ASSERT_NEAR(histogram.quantile(0.5), 500000, 500000 / 16);
+	ASSERT_NEAR(histogram.quantile(0.99), 990000, 990000 / 16);
+	ASSERT_GE(histogram.quantile(1), 1000000);
+
+	// Values of all threads are merged
+	LatencyHistogram concurrentHistogram;
+	std::vector<std::jthread> threads;
+	for (size_t idx = 0; idx < 4; ++idx)
+	{
+		threads.emplace_back([&concurrentHistogram] {
+			for (uint64_t value = 0; value < 10000; ++value)
+			{
+				concurrentHistogram.record(value);
+			}
+		});
+	}
+	threads.clear();
+	ASSERT_EQ(concurrentHistogram.count(), 40000);
+
+	concurrentHistogram.merge(histogram);
+	ASSERT_EQ(concurrentHistogram.count(), 41000);
+	ASSERT_EQ(concurrentHistogram.sum(), 4 * 49995000 + 500500000);
+}
+
 TEST(Metrics_Tests, PerformanceTrackerUnitTests)
 {
 	std::string promServerAddr = "localhost:8101";
@@ -93,6 +184,100 @@ TEST(Metrics_Tests, PerformanceTrackerUnitTests)
 	ASSERT_LE(std::stoi(readValues[2]), 55 * 1e6);	// test_performance_minimum_processing_time_0
 }
 
+TEST(Metrics_Tests, PerformanceSpanUnitTests)
+{
+	const auto reg = std::make_shared<ScrapeRegistry>();
+	PerformanceTracker outerTracker(reg, "test_outer_span", 0);
+	PerformanceTracker innerTracker(reg, "test_inner_span", 0);
+
+	// Time of the children is attributed to the parent
+	{
+		const auto outer = outerTracker.scope();
+		ASSERT_EQ(outer.parent(), nullptr);
+		{
+			const auto inner = innerTracker.scope();
+			ASSERT_EQ(inner.parent(), &outer);
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		ASSERT_GE(outer.childTime(), std::chrono::milliseconds(20));
+		ASSERT_GE(static_cast<uint64_t>(outer.childTime().count()), innerTracker.timings().sum());
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	ASSERT_EQ(outerTracker.timings().count(), 1);
+	ASSERT_EQ(innerTracker.timings().count(), 1);
+	ASSERT_GE(outerTracker.timings().sum(), 30 * 1e6);
+	// Only lower bounds hold for the sleeps on a loaded host, the children are excluded from the self time
+	ASSERT_GE(outerTracker.selfTimings().sum(), 10 * 1e6);
+	ASSERT_EQ(outerTracker.selfTimings().sum(), outerTracker.timings().sum() - innerTracker.timings().sum());
+	ASSERT_EQ(innerTracker.selfTimings().sum(), innerTracker.timings().sum());
+
+	// Overlapping spans of a shared tracker
+	constexpr size_t nThreads = 4;
+	constexpr size_t nSpans = 1000;
+	std::vector<std::thread> threads;
+	for (size_t idx = 0; idx < nThreads; ++idx)
+	{
+		threads.emplace_back([&innerTracker] {
+			for (size_t spanIdx = 0; spanIdx < nSpans; ++spanIdx)
+			{
+				const TrackPerformance guard(innerTracker);
+			}
+		});
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+	ASSERT_EQ(innerTracker.timings().count(), nThreads * nSpans + 1);
+	ASSERT_EQ(outerTracker.timings().count(), 1);
+}
+
+TEST(Metrics_Tests, ProfilerUnitTests)
+{
+	SamplingProfiler profiler;
+	ASSERT_FALSE(profiler.stop());
+	ASSERT_TRUE(profiler.start(PROFILER_MAX_FREQUENCY));
+	ASSERT_TRUE(profiler.isRunning());
+
+	// Only one profiler receives the signals
+	SamplingProfiler otherProfiler;
+	ASSERT_FALSE(otherProfiler.start());
+
+	// Samples are taken while the process consumes CPU
+	volatile uint64_t value = 0;
+	const auto endTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+	while (std::chrono::steady_clock::now() < endTime)
+	{
+		for (size_t idx = 0; idx < 10000; ++idx)
+		{
+			value = value * 31 + idx;
+		}
+	}
+	ASSERT_TRUE(profiler.stop());
+	ASSERT_FALSE(profiler.isRunning());
+	ASSERT_GT(profiler.sampleCount(), 0);
+
+	// Folded stacks are "frame;frame;... count" and the counts sum up to the samples
+	const auto stacks = profiler.foldedStacks();
+	ASSERT_FALSE(stacks.empty());
+	const uint64_t nSamples = std::accumulate(stacks.begin(), stacks.end(), uint64_t{0},
+											  [](uint64_t sum, const std::string &stack) {
+												  const size_t pos = stack.rfind(' ');
+												  EXPECT_NE(pos, std::string::npos);
+												  return sum + std::stoull(stack.substr(pos + 1));
+											  });
+	ASSERT_EQ(nSamples, profiler.sampleCount());
+
+	// Frame pointers are kept, so the walk unwinds past the interrupted frame
+	ASSERT_TRUE(std::ranges::any_of(
+		stacks, [](const std::string &stack) { return stack.find(';') != std::string::npos; }));
+	ASSERT_NE(profiler.summary().find("stopped"), std::string::npos);
+
+	// Other profiler can run once this one stops
+	ASSERT_TRUE(otherProfiler.start());
+	ASSERT_TRUE(otherProfiler.stop());
+}
+
 TEST(Metrics_Tests, StatusTrackerUnitTests)
 {
 	std::string promServerAddr = "localhost:8102";
@@ -163,3 +348,225 @@ TEST(Metrics_Tests, ProcessMetricsUnitTests)
 	ASSERT_GT(std::stod(readValues[5]), 0); // thread_count
 	ASSERT_GT(std::stod(readValues[6]), 0); // file_descriptor_count
 }
+
+TEST(Metrics_Tests, ProcessPerfCountersUnitTests)
+{
+	const auto reg = std::make_shared<ScrapeRegistry>();
+	ProcessMetrics procMetrics(nullptr, reg, true);
+
+	// Counters depend on the kernel settings and the PMU access of the host
+	const std::array types = {PerfCounterType::Cycles, PerfCounterType::Instructions, PerfCounterType::CacheMisses,
+							  PerfCounterType::BranchMisses, PerfCounterType::ContextSwitches};
+	if (std::ranges::none_of(types, [&procMetrics](PerfCounterType type) { return procMetrics.hasPerfCounter(type); }))
+	{
+		GTEST_SKIP() << "perf_event_open is not permitted";
+	}
+
+	// Events of the other threads are counted as well
+	std::jthread worker([](const std::stop_token &stopToken) {
+		volatile uint64_t value = 0;
+		while (!stopToken.stop_requested())
+		{
+			value = value + 1;
+			std::this_thread::yield();
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+	worker.request_stop();
+
+	if (procMetrics.hasPerfCounter(PerfCounterType::Cycles))
+	{
+		ASSERT_GT(procMetrics.perfCounterRate(PerfCounterType::Cycles), 0);
+	}
+	if (procMetrics.hasPerfCounter(PerfCounterType::Instructions))
+	{
+		ASSERT_GT(procMetrics.perfCounterRate(PerfCounterType::Instructions), 0);
+	}
+	for (const auto type : types)
+	{
+		ASSERT_GE(procMetrics.perfCounterRate(type), 0);
+	}
+}
+
+TEST(Metrics_Tests, ProcessThreadMetricsUnitTests)
+{
+	const auto reg = std::make_shared<ScrapeRegistry>();
+	ProcessMetrics procMetrics(nullptr, reg, false, std::chrono::milliseconds(10));
+
+	// Waits until the threads labelled in every thread metric satisfy the condition
+	const auto waitThreads = [&reg](const std::function<bool(const std::set<prometheus::Labels> &)> &condition) {
+		const std::array names = {"thread_user_cpu_usage", "thread_system_cpu_usage", "thread_run_queue_wait",
+								  "thread_voluntary_context_switches_rate", "thread_involuntary_context_switches_rate"};
+		const auto endTime = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (std::chrono::steady_clock::now() < endTime)
+		{
+			const auto families = reg->Collect();
+			const bool isSatisfied = std::ranges::all_of(names, [&families, &condition](const std::string &name) {
+				const auto family = std::ranges::find(families, name, &prometheus::MetricFamily::name);
+				if (family == families.end())
+				{
+					return false;
+				}
+				std::set<prometheus::Labels> threads;
+				for (const auto &metric : family->metric)
+				{
+					prometheus::Labels labels;
+					for (const auto &label : metric.label)
+					{
+						labels.emplace(label.name, label.value);
+					}
+					threads.insert(std::move(labels));
+				}
+				return condition(threads);
+			});
+			if (isSatisfied)
+			{
+				return true;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return false;
+	};
+
+	std::atomic_bool isRenamed{false};
+	std::atomic<pid_t> threadId{0};
+	std::jthread worker([&isRenamed, &threadId](const std::stop_token &stopToken) {
+		pthread_setname_np(pthread_self(), "metrics-test");
+		threadId = gettid();
+		while (!stopToken.stop_requested())
+		{
+			if (isRenamed.exchange(false))
+			{
+				pthread_setname_np(pthread_self(), "metrics-renamed");
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	while (threadId == 0)
+	{
+		std::this_thread::yield();
+	}
+	const std::string tid = std::to_string(threadId);
+	const prometheus::Labels named = {{"thread", "metrics-test"}, {"tid", tid}};
+	const prometheus::Labels renamed = {{"thread", "metrics-renamed"}, {"tid", tid}};
+
+	// Threads appear labelled by their name and ID
+	ASSERT_TRUE(waitThreads([&named](const auto &threads) { return threads.contains(named); }));
+
+	// Renamed threads are labelled by the new name only
+	isRenamed = true;
+	ASSERT_TRUE(waitThreads([&named, &renamed](const auto &threads) {
+		return threads.contains(renamed) && !threads.contains(named);
+	}));
+
+	// Exited threads are removed
+	worker.request_stop();
+	worker.join();
+	ASSERT_TRUE(waitThreads([&tid](const auto &threads) {
+		return std::ranges::none_of(threads, [&tid](const auto &labels) { return labels.at("tid") == tid; });
+	}));
+}
+
+TEST(Metrics_Tests, ProcSamplerUnitTests)
+{
+	// Command names may contain spaces and parentheses
+	ProcSample sample;
+	ASSERT_TRUE(ProcSampler::parseStat("1234 (a) (b c) S 1 1234 1234 0 -1 4194560 150 0 3 0 42 17 0 0 20 0 7 0 100 "
+									   "1000000 500 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 0 0 0 0 0 0",
+									   sample));
+	ASSERT_EQ(150, sample.minorFaults);
+	ASSERT_EQ(3, sample.majorFaults);
+	ASSERT_EQ(42, sample.userTicks);
+	ASSERT_EQ(17, sample.systemTicks);
+	ASSERT_EQ(7, sample.threadCount);
+	ASSERT_FALSE(ProcSampler::parseStat("1234 (a) S 1 1234", sample));
+	ASSERT_FALSE(ProcSampler::parseStat("", sample));
+
+	// Keys are matched at the beginning of the lines only
+	ASSERT_TRUE(ProcSampler::parseIo("rchar: 10\nwchar: 20\nsyscr: 1\nsyscw: 2\nread_bytes: 4096\n"
+									 "write_bytes: 8192\ncancelled_write_bytes: 512\n",
+									 sample));
+	ASSERT_EQ(4096, sample.readBytes);
+	ASSERT_EQ(8192, sample.writeBytes);
+	ASSERT_FALSE(ProcSampler::parseIo("rchar: 10\n", sample));
+
+	ASSERT_TRUE(ProcSampler::parseStatus("Name:\ttest\nVmPeak:\t  20000 kB\nVmHWM:\t    1200 kB\nVmRSS:\t    1100 kB\n",
+										 sample));
+	ASSERT_EQ(1200, sample.peakResidentKb);
+	ASSERT_EQ(1100, sample.residentKb);
+
+	// Values of the running process
+	ProcSampler sampler;
+	ProcSample current;
+	ASSERT_TRUE(sampler.sample(current));
+	ASSERT_GE(current.threadCount, 1);
+	ASSERT_GT(current.peakResidentKb, 0);
+	ASSERT_GE(current.peakResidentKb, current.residentKb);
+	ASSERT_GE(current.fileDescriptorCount, 3);
+
+	// Descriptors opened after the sampler are counted
+	const int fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	ASSERT_GE(fd, 0);
+	ProcSample withFile;
+	ASSERT_TRUE(sampler.sample(withFile));
+	close(fd);
+	ASSERT_EQ(current.fileDescriptorCount + 1, withFile.fileDescriptorCount);
+}
+
+TEST(Metrics_Tests, ProcSamplerThreadsUnitTests)
+{
+	ThreadSample sample;
+	ASSERT_TRUE(ProcSampler::parseThreadStat("4321 (zmq-worker-1) S 1 1234 1234 0 -1 4194624 20 0 0 0 11 5 0 0 20 0 "
+											 "7 0 100 1000000 500 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 -1 0",
+											 sample));
+	ASSERT_EQ("zmq-worker-1", sample.name);
+	ASSERT_EQ(11, sample.userTicks);
+	ASSERT_EQ(5, sample.systemTicks);
+	ASSERT_FALSE(ProcSampler::parseThreadStat("4321 zmq-worker-1", sample));
+
+	// Key of the voluntary switches is the suffix of the involuntary ones
+	ASSERT_TRUE(ProcSampler::parseThreadStatus(
+		"Name:\tzmq-worker-1\nnonvoluntary_ctxt_switches:\t9\nvoluntary_ctxt_switches:\t120\n", sample));
+	ASSERT_EQ(120, sample.voluntarySwitches);
+	ASSERT_EQ(9, sample.involuntarySwitches);
+
+	ASSERT_TRUE(ProcSampler::parseSchedstat("90000000 2500000 40\n", sample));
+	ASSERT_EQ(2500000, sample.runQueueWaitNs);
+	ASSERT_FALSE(ProcSampler::parseSchedstat("90000000", sample));
+
+	// Named threads are sampled until they exit
+	std::atomic_bool isNamed{false};
+	std::jthread worker([&isNamed](const std::stop_token &stopToken) {
+		pthread_setname_np(pthread_self(), "sampler-test");
+		isNamed = true;
+		while (!stopToken.stop_requested())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	while (!isNamed)
+	{
+		std::this_thread::yield();
+	}
+
+	ProcSampler sampler;
+	ProcSample withoutThreads;
+	ASSERT_TRUE(sampler.sample(withoutThreads));
+	std::vector<ThreadSample> threads;
+	const auto isWorker = [](const ThreadSample &thread) { return thread.name == "sampler-test"; };
+	ASSERT_TRUE(sampler.sampleThreads(threads));
+	ASSERT_GE(threads.size(), 2);
+
+	// Descriptors opened for the threads are not counted
+	ProcSample withThreads;
+	ASSERT_TRUE(sampler.sample(withThreads));
+	ASSERT_EQ(withoutThreads.fileDescriptorCount, withThreads.fileDescriptorCount);
+	const auto itr = std::ranges::find_if(threads, isWorker);
+	ASSERT_NE(threads.end(), itr);
+	ASSERT_GT(itr->voluntarySwitches, 0);
+
+	worker.request_stop();
+	worker.join();
+	ASSERT_TRUE(sampler.sampleThreads(threads));
+	ASSERT_TRUE(std::ranges::none_of(threads, isWorker));
+}
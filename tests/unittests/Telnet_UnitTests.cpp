@@ -1,13 +1,18 @@
 #include "TelnetClient.hpp"
 #include "metrics/PrometheusServer.hpp"
+#include "telnet/TelnetInputParser.hpp"
 #include "telnet/TelnetServer.hpp"
 #include "test-static-definitions.h"
 
+#include <array>
 #include <chrono>
 #include <memory>
 #include <thread>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/resource.h>
+
 #include <gtest/gtest.h>
 
 constexpr int TELNET_PORT = 23000;
@@ -66,3 +71,377 @@ TEST(Telnet_Tests, TelnetServerUnitTests)
 	ASSERT_NO_THROW(telnetServerPtr->shutdown());
 	ASSERT_NO_THROW(telnetServerPtr->shutdown());
 }
+
+TEST(Telnet_Tests, TelnetInputParserUnitTests)
+{
+	const auto feed = [](TelnetInputParser &parser, const std::string &data) {
+		std::vector<TelnetInputEvent> events;
+		for (const char chr : data)
+		{
+			if (const auto event = parser.consume(chr); event != TelnetInputEvent::None)
+			{
+				events.push_back(event);
+			}
+		}
+		return events;
+	};
+
+	TelnetInputParser parser;
+
+	// Negotiation sequences are removed, escaped IAC is kept
+	ASSERT_TRUE(feed(parser, "\xff\xfb\x01pi\xff\xf1ng\xff\xfa\x18\x01\xff\xff\xff\xf0").empty());
+	ASSERT_EQ(parser.buffer(), "ping");
+	ASSERT_EQ(feed(parser, "\xff\xff"), std::vector<TelnetInputEvent>{});
+	ASSERT_EQ(parser.buffer(), "ping\xff");
+	parser.reset();
+	ASSERT_TRUE(parser.buffer().empty());
+
+	// Line endings
+	ASSERT_EQ(feed(parser, "help\r\n"), std::vector<TelnetInputEvent>{TelnetInputEvent::Line});
+	ASSERT_EQ(parser.takeBuffer(), "help");
+	ASSERT_EQ(feed(parser, "quit\r"), std::vector<TelnetInputEvent>{});
+	ASSERT_EQ(feed(parser, std::string(1, '\0')), std::vector<TelnetInputEvent>{TelnetInputEvent::Line});
+	ASSERT_EQ(parser.takeBuffer(), "quit");
+	ASSERT_EQ(feed(parser, "a\rb"), std::vector<TelnetInputEvent>{});
+	ASSERT_EQ(parser.takeBuffer(), "a\rb");
+
+	// Line editing
+	std::vector<TelnetInputEvent> expected = {TelnetInputEvent::ArrowUp,   TelnetInputEvent::ArrowDown,
+											  TelnetInputEvent::ArrowRight, TelnetInputEvent::ArrowLeft,
+											  TelnetInputEvent::Erase,	   TelnetInputEvent::Erase,
+											  TelnetInputEvent::Tab};
+	ASSERT_EQ(feed(parser, "\x1b[A\x1b[B\x1bOC\x1b[1;5Dstatuss\x7fx\b\t"), expected);
+	ASSERT_EQ(parser.takeBuffer(), "status");
+	expected = {TelnetInputEvent::ReverseSearch, TelnetInputEvent::Cancel};
+	ASSERT_EQ(feed(parser, "\x12" "ab\x07"), expected);
+	ASSERT_EQ(parser.takeBuffer(), "ab");
+
+	// Line editing disabled keeps the keys as data
+	parser.lineEditing(false);
+	ASSERT_EQ(feed(parser, "ab\b\t\r\n"), std::vector<TelnetInputEvent>{TelnetInputEvent::Line});
+	ASSERT_EQ(parser.takeBuffer(), "ab\b\t");
+}
+
+TEST(Telnet_Tests, TelnetHistoryUnitTests)
+{
+	TelnetHistory history;
+
+	// Empty and repeated commands are skipped
+	ASSERT_FALSE(history.push(""));
+	ASSERT_TRUE(history.push("ping"));
+	ASSERT_FALSE(history.push("ping"));
+	ASSERT_EQ(history.size(), 1);
+
+	// Long commands are stored out of line
+	const std::string longCommand(TELNET_HISTORY_INLINE_SIZE * 2, 'x');
+	ASSERT_TRUE(history.push(longCommand));
+	ASSERT_EQ(history[1], longCommand);
+
+	// Oldest commands are overwritten once the ring is full
+	for (size_t idx = 0; idx < TELNET_HISTORY_LIMIT; ++idx)
+	{
+		ASSERT_TRUE(history.push("command " + std::to_string(idx)));
+	}
+	ASSERT_EQ(history.size(), TELNET_HISTORY_LIMIT);
+	ASSERT_EQ(history[0], "command 0");
+	ASSERT_EQ(history[TELNET_HISTORY_LIMIT - 1], "command " + std::to_string(TELNET_HISTORY_LIMIT - 1));
+
+	// Reverse search
+	ASSERT_EQ(history.rfind("command 1", history.size()), 19);
+	ASSERT_EQ(history.rfind("command 1", 19), 18);
+	ASSERT_EQ(history.rfind("command 1", 1), std::string::npos);
+	ASSERT_EQ(history.rfind("", history.size()), std::string::npos);
+	ASSERT_EQ(history.rfind("unknown", history.size()), std::string::npos);
+
+	// Histories are kept per peer and recycled in least recently used order
+	TelnetHistoryArena arena(2);
+	TelnetHistory *first = arena.acquire("10.0.0.1");
+	ASSERT_NE(first, nullptr);
+	first->push("status");
+	TelnetHistory *second = arena.acquire("10.0.0.2");
+	ASSERT_NE(second, nullptr);
+	ASSERT_EQ(arena.acquire("10.0.0.3"), nullptr);
+	arena.release(first);
+	ASSERT_EQ(arena.acquire("10.0.0.1"), first);
+	ASSERT_EQ(first->size(), 1);
+	arena.release(first);
+	arena.release(second);
+	ASSERT_EQ(arena.acquire("10.0.0.3"), first);
+	ASSERT_EQ(first->size(), 0);
+
+	// History is kept across reconnects and searched with Ctrl-R
+	auto telnetServerPtr = std::make_shared<TelnetServer>();
+	ASSERT_TRUE(telnetServerPtr->initialise(TELNET_PORT, nullptr, "> "));
+	telnetServerPtr->newLineCallback(TelnetMessageCallback);
+	std::make_unique<TelnetClient>("127.0.0.1", TELNET_PORT, std::vector<std::string>{"ping", "version"})->wait();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	{
+		TelnetRawConnection connection("127.0.0.1", TELNET_PORT);
+		ASSERT_TRUE(connection.send("\x12pi"));
+		ASSERT_NE(connection.readUntil("': ping").find("(reverse-i-search)'pi': ping"), std::string::npos);
+		ASSERT_TRUE(connection.send("\r\n"));
+		ASSERT_NE(connection.readUntil("pong").find("pong"), std::string::npos);
+	}
+	ASSERT_NO_THROW(telnetServerPtr->shutdown());
+}
+
+TEST(Telnet_Tests, TelnetAdmissionUnitTests)
+{
+	auto telnetServerPtr = std::make_shared<TelnetServer>();
+	TelnetLimits limits;
+	limits.maxSessions = 2;
+	limits.connectionRate = 0.001;
+	limits.connectionBurst = 3;
+	limits.commandRate = 0.001;
+	limits.commandBurst = 2;
+	telnetServerPtr->limits(limits);
+	ASSERT_TRUE(telnetServerPtr->initialise(TELNET_PORT, nullptr, "> "));
+	telnetServerPtr->newLineCallback(TelnetMessageCallback);
+
+	// Sessions up to the limit are accepted, next one is refused and the peer is rate limited afterwards
+	std::vector<std::unique_ptr<TelnetRawConnection>> clients;
+	for (int idx = 0; idx < 4; ++idx)
+	{
+		clients.push_back(std::make_unique<TelnetRawConnection>("127.0.0.1", TELNET_PORT));
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	ASSERT_TRUE(clients[0]->send("ping\r\n"));
+	ASSERT_NE(clients[0]->readUntil("pong", 10).find("pong"), std::string::npos);
+	ASSERT_TRUE(clients[1]->send("ping\r\n"));
+	ASSERT_NE(clients[1]->readUntil("pong", 10).find("pong"), std::string::npos);
+	ASSERT_NE(clients[2]->readUntil("Too many", 10).find("Too many active connections"), std::string::npos);
+	ASSERT_TRUE(clients[3]->readUntil("pong", 10).empty());
+
+	// Commands over the limit are rejected
+	ASSERT_TRUE(clients[0]->send("ping\r\nping\r\n"));
+	ASSERT_NE(clients[0]->readUntil("Too many", 10).find("Too many commands"), std::string::npos);
+
+	clients.clear();
+	ASSERT_NO_THROW(telnetServerPtr->shutdown());
+}
+
+TEST(Telnet_Tests, TelnetCommandRegistryUnitTests)
+{
+	TelnetCommandRegistry registry;
+	std::string lastArgs;
+	const auto handler = [&lastArgs](const SP_TelnetSession & /*unused*/, std::string_view args) {
+		lastArgs = args;
+		return true;
+	};
+
+	ASSERT_TRUE(registry.registerCommand("enable log", "Enable logs", handler, true));
+	ASSERT_TRUE(registry.registerCommand("enable metrics", "Enable metrics", handler));
+	ASSERT_TRUE(registry.registerCommand("enable metrics all", "", handler));
+	ASSERT_TRUE(registry.registerCommand("status", "Status", handler));
+	ASSERT_FALSE(registry.registerCommand("status", "Status", handler));
+	ASSERT_FALSE(registry.registerCommand("", "Empty", handler));
+
+	// Dispatch
+	std::string_view args;
+	ASSERT_TRUE(registry.find("status", args));
+	ASSERT_TRUE(args.empty());
+	ASSERT_FALSE(registry.find("status now", args));
+	ASSERT_FALSE(registry.find("stat", args));
+	ASSERT_TRUE(registry.find("enable log vv", args));
+	ASSERT_EQ(args, "vv");
+	ASSERT_TRUE(registry.find("enable metrics all", args)(nullptr, args));
+	ASSERT_TRUE(lastArgs.empty());
+	ASSERT_FALSE(registry.find("enable metrics some", args));
+
+	// Completion
+	std::vector<std::string> candidates;
+	ASSERT_EQ(registry.complete("st", candidates), "status");
+	ASSERT_EQ(candidates, std::vector<std::string>{"status"});
+	ASSERT_EQ(registry.complete("e", candidates), "enable ");
+	ASSERT_EQ(candidates, (std::vector<std::string>{"enable log", "enable metrics"}));
+	ASSERT_EQ(registry.complete("enable m", candidates), "enable metrics");
+	ASSERT_EQ(registry.complete("x", candidates), "");
+	ASSERT_TRUE(candidates.empty());
+	ASSERT_EQ(registry.commands().size(), 3);
+
+	// Runtime removal
+	ASSERT_TRUE(registry.unregisterCommand("enable log"));
+	ASSERT_FALSE(registry.unregisterCommand("enable log"));
+	ASSERT_FALSE(registry.find("enable log v", args));
+	ASSERT_EQ(registry.complete("e", candidates), "enable metrics");
+	ASSERT_TRUE(registry.unregisterCommand("enable metrics all"));
+	ASSERT_TRUE(registry.find("enable metrics", args));
+	ASSERT_EQ(registry.commands().size(), 2);
+
+	// Default registry contains built-in commands
+	ASSERT_TRUE(TelnetCommands().find("ping", args));
+	ASSERT_TRUE(TelnetCommands().find("enable log vvv", args));
+	ASSERT_EQ(TelnetCommands().complete("he", candidates), "help");
+}
+
+TEST(Telnet_Tests, TelnetStreamUnitTests)
+{
+	constexpr int lineCount = 45;
+
+	auto telnetServerPtr = std::make_shared<TelnetServer>();
+	ASSERT_TRUE(telnetServerPtr->initialise(TELNET_PORT, nullptr, "> "));
+	telnetServerPtr->connectedCallback([](const SP_TelnetSession &session) {
+		session->sendStream(
+			[idx = 0](std::string &line) mutable {
+				if (idx >= lineCount)
+				{
+					return false;
+				}
+				line = "line " + std::to_string(idx++);
+				return true;
+			},
+			true);
+	});
+
+	auto connection = std::make_unique<TelnetRawConnection>("127.0.0.1", TELNET_PORT);
+
+	// First page
+	auto received = connection->readUntil("--More--");
+	ASSERT_NE(received.find("line 19\r\n"), std::string::npos);
+	ASSERT_EQ(received.find("line 20\r\n"), std::string::npos);
+	ASSERT_NE(received.find("--More--"), std::string::npos);
+
+	// Next page
+	ASSERT_TRUE(connection->send(" "));
+	received = connection->readUntil("--More--");
+	ASSERT_NE(received.find("line 20\r\n"), std::string::npos);
+	ASSERT_NE(received.find("line 39\r\n"), std::string::npos);
+	ASSERT_EQ(received.find("line 40\r\n"), std::string::npos);
+
+	// Next line
+	ASSERT_TRUE(connection->send("\r"));
+	received = connection->readUntil("--More--");
+	ASSERT_NE(received.find("line 40\r\n"), std::string::npos);
+	ASSERT_EQ(received.find("line 41\r\n"), std::string::npos);
+
+	// Quit, prompt should be back
+	ASSERT_TRUE(connection->send("q"));
+	received = connection->readUntil("> ");
+	ASSERT_EQ(received.find("line 41\r\n"), std::string::npos);
+	ASSERT_NE(received.find("> "), std::string::npos);
+
+	connection.reset();
+	ASSERT_NO_THROW(telnetServerPtr->shutdown());
+}
+
+TEST(Telnet_Tests, TelnetStreamLimitUnitTests)
+{
+	auto telnetServerPtr = std::make_shared<TelnetServer>();
+	ASSERT_TRUE(telnetServerPtr->initialise(TELNET_PORT, nullptr, "> "));
+
+	// A single line larger than the output buffer limit, at the end of the first page
+	telnetServerPtr->connectedCallback([](const SP_TelnetSession &session) {
+		session->sendStream(
+			[idx = 0](std::string &line) mutable {
+				if (idx >= 30)
+				{
+					return false;
+				}
+				line = idx++ == 19 ? std::string(64 * 1024 * 1024, 'x') : "line";
+				return true;
+			},
+			true);
+	});
+
+	auto connection = std::make_unique<TelnetRawConnection>("127.0.0.1", TELNET_PORT);
+
+	// Session is dropped without reading, pager input afterwards is ignored
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	connection->send(" q");
+	ASSERT_TRUE(connection->waitClosed());
+
+	connection.reset();
+	ASSERT_NO_THROW(telnetServerPtr->shutdown());
+}
+
+TEST(Telnet_Tests, TelnetTLSUnitTests)
+{
+	auto telnetServerPtr = std::make_shared<TelnetServer>();
+	ASSERT_FALSE(telnetServerPtr->initialiseTLS("/nonexistent.crt", "/nonexistent.key"));
+	ASSERT_FALSE(telnetServerPtr->isTLS());
+	ASSERT_TRUE(telnetServerPtr->initialiseTLS(TEST_TELNET_TLS_CERT_PATH, TEST_TELNET_TLS_KEY_PATH));
+	ASSERT_TRUE(telnetServerPtr->isTLS());
+	ASSERT_TRUE(telnetServerPtr->initialise(TELNET_PORT, nullptr, "> "));
+	ASSERT_FALSE(telnetServerPtr->initialiseTLS(TEST_TELNET_TLS_CERT_PATH, TEST_TELNET_TLS_KEY_PATH));
+	telnetServerPtr->newLineCallback(TelnetMessageCallback);
+
+	const std::unique_ptr<SSL_CTX, TelnetSSLDeleter> clientContext(SSL_CTX_new(TLS_client_method()));
+	ASSERT_TRUE(clientContext);
+
+	// Second connection should be resumed with the ticket received from the first one
+	SSL_SESSION *savedSession = nullptr;
+	for (int idx = 0; idx < 2; ++idx)
+	{
+		const TelnetRawConnection connection("127.0.0.1", TELNET_PORT);
+		const std::unique_ptr<SSL, TelnetSSLDeleter> ssl(SSL_new(clientContext.get()));
+		SSL_set_fd(ssl.get(), connection.fd());
+		if (savedSession != nullptr)
+		{
+			SSL_set_session(ssl.get(), savedSession);
+			SSL_SESSION_free(savedSession);
+			savedSession = nullptr;
+		}
+		ASSERT_EQ(SSL_connect(ssl.get()), 1);
+		ASSERT_EQ(SSL_session_reused(ssl.get()), idx);
+
+		const std::string command = "ping\r\n";
+		ASSERT_EQ(SSL_write(ssl.get(), command.data(), static_cast<int>(command.size())),
+				  static_cast<int>(command.size()));
+
+		std::string received;
+		std::array<char, 4096> buffer{};
+		for (int retry = 0; retry < 20 && received.find("pong") == std::string::npos; ++retry)
+		{
+			if (const int readBytes = SSL_read(ssl.get(), buffer.data(), static_cast<int>(buffer.size()));
+				readBytes > 0)
+			{
+				received.append(buffer.data(), static_cast<size_t>(readBytes));
+			}
+		}
+		ASSERT_NE(received.find("pong"), std::string::npos);
+
+		savedSession = SSL_get1_session(ssl.get());
+		SSL_shutdown(ssl.get());
+	}
+	SSL_SESSION_free(savedSession);
+
+	ASSERT_NO_THROW(telnetServerPtr->shutdown());
+}
+
+TEST(Telnet_Tests, TelnetDescriptorLimitUnitTests)
+{
+	// Descriptors up to FD_SETSIZE are taken, so the sockets of the server and the client are above it
+	rlimit limit{};
+	ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &limit), 0);
+	if (limit.rlim_cur < FD_SETSIZE + 64)
+	{
+		GTEST_SKIP() << "Descriptor limit is lower than FD_SETSIZE";
+	}
+	const int nullFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	ASSERT_GE(nullFd, 0);
+	std::vector<int> fillers;
+	for (int fd = dup(nullFd); fd >= 0; fd = dup(nullFd))
+	{
+		fillers.push_back(fd);
+		if (fd >= FD_SETSIZE)
+		{
+			break;
+		}
+	}
+
+	auto telnetServerPtr = std::make_shared<TelnetServer>();
+	ASSERT_TRUE(telnetServerPtr->initialise(TELNET_PORT, nullptr, "> "));
+	telnetServerPtr->newLineCallback(TelnetMessageCallback);
+	{
+		TelnetClient client("127.0.0.1", TELNET_PORT);
+		ASSERT_TRUE(client.sendAndWait("ping\r\n", "pong"));
+	}
+	ASSERT_NO_THROW(telnetServerPtr->shutdown());
+
+	for (const int fd : fillers)
+	{
+		close(fd);
+	}
+	close(nullFd);
+}
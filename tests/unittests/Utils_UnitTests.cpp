@@ -1,12 +1,45 @@
+#include "metrics/ScrapeRegistry.hpp"
+#include "utils/BaseServerStats.hpp"
 #include "utils/ConfigParser.hpp"
 #include "utils/ErrorHelpers.hpp"
 #include "utils/FileHelpers.hpp"
 #include "utils/InputParser.hpp"
+#include "utils/TokenBucket.hpp"
 #include "utils/Tracer.hpp"
+#include "utils/TscClock.hpp"
 
 #include "test-static-definitions.h"
 
 #include <gtest/gtest.h>
+#include <prometheus/metric_family.h>
+
+#include <limits>
+#include <thread>
+
+// Exposes the protected interface of the base statistics
+class TestServerStats : public BaseServerStats {
+  public:
+	explicit TestServerStats(const std::shared_ptr<prometheus::Registry> &reg) { initBaseStats(reg, "test_"); }
+
+	void consume(uint64_t succeeded, uint64_t failed, double processingTime)
+	{
+		consumeBaseStats(succeeded, failed, processingTime);
+	}
+};
+
+// Finds the value of an unlabelled counter or gauge in the collected metrics
+double getMetricValue(const std::vector<prometheus::MetricFamily> &families, const std::string &name)
+{
+	for (const auto &family : families)
+	{
+		if (family.name == name && !family.metric.empty())
+		{
+			return family.type == prometheus::MetricType::Counter ? family.metric[0].counter.value
+																  : family.metric[0].gauge.value;
+		}
+	}
+	return -1;
+}
 
 TEST(Utils_Tests, ConfigParserUnitTests)
 {
@@ -132,6 +165,121 @@ TEST(Utils_Tests, InputParserUnitTests)
 	ASSERT_EQ(options[0].second, "");
 }
 
+TEST(Utils_Tests, TscClockUnitTests)
+{
+	// Works with or without an invariant TSC
+	ASSERT_EQ(TscClock::isTscUsed(), TscClock::tscFrequency() > 0);
+
+	// Readings of the clocks are bracketed, so a preemption between them widens the bounds instead of failing
+	const auto steadyStartBefore = std::chrono::steady_clock::now();
+	const auto tscStart = TscClock::now();
+	const auto steadyStartAfter = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	const auto steadyEndBefore = std::chrono::steady_clock::now();
+	const auto tscEnd = TscClock::now();
+	const auto steadyEndAfter = std::chrono::steady_clock::now();
+
+	// Calibrated frequency is accurate to 1%
+	const auto tscElapsed = static_cast<double>((tscEnd - tscStart).count());
+	ASSERT_GE(tscElapsed, 0.99 * static_cast<double>((steadyEndBefore - steadyStartAfter).count()));
+	ASSERT_LE(tscElapsed, 1.01 * static_cast<double>((steadyEndAfter - steadyStartBefore).count()));
+
+	// Monotonic
+	auto lastTime = TscClock::now();
+	for (int idx = 0; idx < 1000; ++idx)
+	{
+		const auto currentTime = TscClock::now();
+		ASSERT_GE(currentTime, lastTime);
+		lastTime = currentTime;
+	}
+
+	// Scoped timers accumulate
+	double elapsedTime = 0;
+	for (int idx = 0; idx < 2; ++idx)
+	{
+		const ScopedTimer timer(elapsedTime);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	ASSERT_GE(elapsedTime, 40e6);
+	ASSERT_LT(elapsedTime, 1e9);
+}
+
+TEST(Utils_Tests, TokenBucketUnitTests)
+{
+	const auto start = std::chrono::steady_clock::now();
+	TokenBucket bucket(10, 5);
+
+	// Starts full
+	ASSERT_TRUE(bucket.full(start));
+	ASSERT_TRUE(bucket.consume(5, start));
+	ASSERT_FALSE(bucket.consume(1, start));
+	ASSERT_FALSE(bucket.full(start));
+
+	// Refilled with the rate up to the burst size
+	ASSERT_NEAR(bucket.available(start + std::chrono::milliseconds(200)), 2, 1e-2);
+	ASSERT_TRUE(bucket.consume(1.5, start + std::chrono::milliseconds(200)));
+	ASSERT_FALSE(bucket.consume(1, start + std::chrono::milliseconds(210)));
+	ASSERT_NEAR(bucket.available(start + std::chrono::seconds(10)), 5, 1e-6);
+	ASSERT_TRUE(bucket.full(start + std::chrono::seconds(10)));
+}
+
+TEST(Utils_Tests, BaseServerStatsUnitTests)
+{
+	constexpr int nThreads = 2 * static_cast<int>(BASE_STATS_SHARDS);
+	constexpr int nCommands = 1000;
+	const auto consumeConcurrently = [](TestServerStats &stats) {
+		std::vector<std::thread> threads;
+		for (int threadIdx = 0; threadIdx < nThreads; ++threadIdx)
+		{
+			threads.emplace_back([&stats, threadIdx] {
+				for (int idx = 0; idx < nCommands; ++idx)
+				{
+					stats.consume(idx % 4 != 0 ? 1 : 0, idx % 4 == 0 ? 1 : 0, threadIdx * nCommands + idx + 1);
+				}
+			});
+		}
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+	};
+
+	// Shards are only flushed when the registry is scraped, the base registry collects without flushing
+	const auto scrapeReg = std::make_shared<ScrapeRegistry>();
+	TestServerStats scrapeStats(scrapeReg);
+	ASSERT_EQ(getMetricValue(scrapeReg->prometheus::Registry::Collect(), "test_minimum_processing_time"),
+			  std::numeric_limits<int>::max());
+	consumeConcurrently(scrapeStats);
+	ASSERT_EQ(getMetricValue(scrapeReg->prometheus::Registry::Collect(), "test_received_commands"), 0);
+
+	// Counts of all shards are summed, extremes are kept across the threads
+	auto families = scrapeReg->Collect();
+	ASSERT_EQ(getMetricValue(families, "test_received_commands"), nThreads * nCommands);
+	ASSERT_EQ(getMetricValue(families, "test_succeeded_commands"), nThreads * nCommands * 3 / 4);
+	ASSERT_EQ(getMetricValue(families, "test_failed_commands"), nThreads * nCommands / 4);
+	ASSERT_EQ(getMetricValue(families, "test_minimum_processing_time"), 1);
+	ASSERT_EQ(getMetricValue(families, "test_maximum_processing_time"), nThreads * nCommands);
+
+	// Shards are reset by the flush, so the next scrape does not count the commands again
+	scrapeStats.consume(1, 0, 0.5);
+	families = scrapeReg->Collect();
+	ASSERT_EQ(getMetricValue(families, "test_received_commands"), nThreads * nCommands + 1);
+	ASSERT_EQ(getMetricValue(families, "test_minimum_processing_time"), 0.5);
+
+	// Every command is flushed without a scrape registry
+	const auto reg = std::make_shared<prometheus::Registry>();
+	TestServerStats stats(reg);
+	stats.consume(0, 1, 10);
+	ASSERT_EQ(getMetricValue(reg->Collect(), "test_failed_commands"), 1);
+	ASSERT_EQ(getMetricValue(reg->Collect(), "test_minimum_processing_time"), 10);
+	consumeConcurrently(stats);
+	families = reg->Collect();
+	ASSERT_EQ(getMetricValue(families, "test_received_commands"), nThreads * nCommands + 1);
+	ASSERT_EQ(getMetricValue(families, "test_failed_commands"), nThreads * nCommands / 4 + 1);
+	ASSERT_EQ(getMetricValue(families, "test_minimum_processing_time"), 1);
+	ASSERT_EQ(getMetricValue(families, "test_maximum_processing_time"), nThreads * nCommands);
+}
+
 #ifndef XXX_ENABLE_MEMLEAK_CHECK
 // Google tracer client does not support destroying tracer completely
 // This is a workaround to avoid memory leak detection issues with the Google tracer client.
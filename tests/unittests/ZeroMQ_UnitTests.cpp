@@ -1,14 +1,29 @@
 #include "ZeroMQEchoServer.hpp"
+#include "ZeroMQPipelinedClient.hpp"
 #include "ZeroMQTestClient.hpp"
+#include "metrics/Profiler.hpp"
 #include "metrics/PrometheusServer.hpp"
 #include "test-static-definitions.h"
+#include "zeromq/ZeroMQContext.hpp"
+#include "zeromq/ZeroMQPublisher.hpp"
 #include "zeromq/ZeroMQServer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
 #include <memory>
 #include <thread>
 
+#include <csignal>
+#include <pthread.h>
+
 #include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
+#include <zmq_addon.hpp>
 
 TEST(ZeroMQ_Tests, ZeroMQUnitTests)
 {
@@ -85,6 +100,21 @@ TEST(ZeroMQ_Tests, ZeroMQServerUnitTests)
 	ASSERT_FALSE(zeromqServerPtr->initialise());
 	ASSERT_NO_THROW(zeromqServerPtr->shutdown());
 
+	// Monitoring is restarted with the server
+	ASSERT_TRUE(zeromqServerPtr->initialise());
+	{
+		zmq::context_t ctx(1);
+		zmq::socket_t client(ctx, zmq::socket_type::dealer);
+		client.set(zmq::sockopt::linger, 0);
+		client.connect(zeromqServerAddr);
+		for (int idx = 0; idx < 20 && zeromqServerPtr->getPeerCount() != 1; ++idx)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+		ASSERT_EQ(zeromqServerPtr->getPeerCount(), 1);
+	}
+	ASSERT_NO_THROW(zeromqServerPtr->shutdown());
+
 	zeromqServerPtr = std::make_shared<ZeroMQServer>(zeromqServerAddr, checkFlag, reporter.createNewRegistry());
 	zeromqServerPtr->messageCallback(ZeroMQServerMessageCallback);
 	ASSERT_TRUE(zeromqServerPtr->initialise());
@@ -130,6 +160,794 @@ TEST(ZeroMQ_Tests, ZeroMQServerUnitTests)
 TEST(ZeroMQ_Tests, ZeroMQMonitorUnitTests)
 {
 	ZeroMQMonitor monitor;
-	ASSERT_THROW(monitor.startMonitoring(nullptr, ""), std::invalid_argument);
+	ASSERT_THROW(monitor.startMonitoring(nullptr, "", std::make_shared<zmq::context_t>()), std::invalid_argument);
+	ASSERT_THROW(monitor.registerMetrics(nullptr), std::invalid_argument);
 	ASSERT_NO_THROW(monitor.testInternals());
+
+	ZeroMQMonitor metricsMonitor;
+	ASSERT_NO_THROW(metricsMonitor.registerMetrics(std::make_shared<prometheus::Registry>(), "test"));
+	ASSERT_NO_THROW(metricsMonitor.testInternals());
+
+	// Peers are counted from the events of a shared reactor
+	ZeroMQ server(zmq::socket_type::rep, "tcp://127.0.0.1:8310", true);
+	ZeroMQReactor reactor(server.getContext());
+	ZeroMQMonitor serverMonitor;
+	std::atomic_int nHandshakes{0};
+	serverMonitor.registerMetrics(std::make_shared<prometheus::Registry>());
+	serverMonitor.handshakeCallback(
+		[&nHandshakes](ZeroMQHandshakeResult /*unused*/, std::chrono::nanoseconds /*unused*/) { ++nHandshakes; });
+	serverMonitor.startMonitoring(server.getSocket().get(), "inproc://monitor-test.monitor", reactor);
+	ASSERT_TRUE(reactor.start());
+	ASSERT_TRUE(server.start());
+
+	const auto waitPeers = [&serverMonitor](int nPeers) {
+		for (int idx = 0; idx < 20 && serverMonitor.getPeerCount() != nPeers; ++idx)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+		return serverMonitor.getPeerCount() == nPeers;
+	};
+	{
+		ZeroMQ client(zmq::socket_type::req, "tcp://127.0.0.1:8310", false);
+		ASSERT_TRUE(client.start());
+		ASSERT_TRUE(waitPeers(1));
+	}
+	ASSERT_TRUE(waitPeers(0));
+	ASSERT_EQ(nHandshakes, 1);
+
+	serverMonitor.stopMonitoring();
+	ASSERT_NO_THROW(serverMonitor.stopMonitoring());
+}
+
+TEST(ZeroMQ_Tests, ZeroMQServerWorkerUnitTests)
+{
+	const std::string zeromqServerAddr = "tcp://127.0.0.1:8302";
+	const uint32_t CMD_PING = 1196312912; // "ping" hash
+	const uint32_t CMD_SLOW = 1464814675; // "slow" hash
+
+	// Echo callback, slow command blocks its worker
+	std::shared_ptr<std::atomic_flag> checkFlag;
+	ZeroMQServer server(zeromqServerAddr, checkFlag, nullptr, "", 4);
+	server.messageCallback([CMD_SLOW](const std::vector<zmq::message_t> &recvMsgs,
+									  std::vector<zmq::message_t> &replyMsgs) {
+		if (*recvMsgs[0].data<uint32_t>() == CMD_SLOW)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		}
+		for (const auto &msg : recvMsgs)
+		{
+			replyMsgs.emplace_back(msg.data(), msg.size());
+		}
+		return true;
+	});
+	ASSERT_TRUE(server.initialise());
+	ASSERT_FALSE(server.initialise());
+
+	zmq::context_t ctx(1);
+	zmq::socket_t slowClient(ctx, zmq::socket_type::dealer);
+	zmq::socket_t reqClient(ctx, zmq::socket_type::req);
+	for (auto *socket : {&slowClient, &reqClient})
+	{
+		socket->set(zmq::sockopt::linger, 0);
+		socket->set(zmq::sockopt::rcvtimeo, 2000);
+		socket->connect(zeromqServerAddr);
+	}
+
+	// Dealer client without delimiter, empty frames of the message should be kept
+	auto slowMsgs = makeMessageVector(CMD_SLOW, std::string("payload"), std::string());
+	const auto slowStart = std::chrono::steady_clock::now();
+	ASSERT_EQ(zmq::send_multipart(slowClient, slowMsgs), 3);
+
+	// Request client is served by another worker while the slow command is processed
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	for (int idx = 0; idx < 10; ++idx)
+	{
+		auto pingMsgs = makeMessageVector(CMD_PING, std::to_string(idx));
+		ASSERT_EQ(zmq::send_multipart(reqClient, pingMsgs), 2);
+
+		std::vector<zmq::message_t> recvMsgs;
+		ASSERT_EQ(zmq::recv_multipart(reqClient, std::back_inserter(recvMsgs)), 2);
+		ASSERT_EQ(*recvMsgs[0].data<uint32_t>(), CMD_PING);
+		ASSERT_EQ(recvMsgs[1].to_string(), std::to_string(idx));
+	}
+	ASSERT_LT(std::chrono::steady_clock::now() - slowStart, std::chrono::milliseconds(400));
+
+	std::vector<zmq::message_t> slowReply;
+	ASSERT_EQ(zmq::recv_multipart(slowClient, std::back_inserter(slowReply)), 3);
+	ASSERT_EQ(*slowReply[0].data<uint32_t>(), CMD_SLOW);
+	ASSERT_EQ(slowReply[1].to_string(), "payload");
+	ASSERT_TRUE(slowReply[2].empty());
+
+	ASSERT_NO_THROW(server.shutdown());
+	ASSERT_NO_THROW(server.shutdown());
+}
+
+TEST(ZeroMQ_Tests, ZeroMQMessageUnitTests)
+{
+	// Constant data is referenced
+	static constexpr std::string_view constData = "constant data";
+	auto constMsg = makeConstMessage(constData);
+	ASSERT_EQ(constMsg.data(), constData.data());
+	ASSERT_EQ(constMsg.to_string_view(), constData);
+
+	// Small strings are copied
+	std::string smallData = "small data";
+	auto smallMsg = makeMessage(std::string(smallData));
+	ASSERT_EQ(smallMsg.to_string_view(), smallData);
+
+	// Large strings are handed over
+	std::string largeData(64 * 1024, 'x');
+	const char *largeDataPtr = largeData.data();
+	auto largeMsg = makeMessage(std::move(largeData));
+	ASSERT_EQ(largeMsg.data(), largeDataPtr);
+	ASSERT_EQ(largeMsg.size(), 64 * 1024);
+
+	// Moved and copied messages keep the data alive after the original one is released
+	zmq::message_t copyMsg;
+	copyMsg.copy(largeMsg);
+	zmq::message_t movedMsg(std::move(largeMsg));
+	movedMsg.rebuild();
+	ASSERT_EQ(copyMsg.data(), largeDataPtr);
+	ASSERT_EQ(copyMsg.to_string_view(), std::string(64 * 1024, 'x'));
+
+	// Replies of the default callback
+	std::vector<zmq::message_t> replyMsgs;
+	ASSERT_TRUE(ZeroMQServerMessageCallback(makeMessageVector(uint32_t{1196312912}), replyMsgs));
+	ASSERT_EQ(replyMsgs.size(), 2);
+	ASSERT_EQ(replyMsgs[1].to_string_view(), "PONG");
+	ASSERT_TRUE(ZeroMQServerMessageCallback(makeMessageVector(uint32_t{1263027027}), replyMsgs));
+	ASSERT_EQ(replyMsgs.size(), 2);
+	ASSERT_EQ(replyMsgs[1].to_string_view().front(), '{');
+	ASSERT_EQ(replyMsgs[1].to_string_view().back(), '}');
+}
+
+TEST(ZeroMQ_Tests, ZeroMQReactorUnitTests)
+{
+	auto ctx = std::make_shared<zmq::context_t>(1);
+	constexpr size_t nSockets = 3;
+	std::vector<std::unique_ptr<zmq::socket_t>> pullSockets;
+	std::vector<std::unique_ptr<zmq::socket_t>> pushSockets;
+	zmq::socket_t lateSocket(*ctx, zmq::socket_type::pull);
+	zmq::socket_t latePush(*ctx, zmq::socket_type::push);
+	std::array<std::atomic_size_t, nSockets> counters{};
+	std::atomic_size_t lateCounter{0};
+	std::atomic_size_t nTicks{0};
+
+	// Several sockets are served from the same thread
+	ZeroMQReactor reactor(ctx);
+	for (size_t idx = 0; idx < nSockets; ++idx)
+	{
+		const std::string addr = "inproc://reactor-test-" + std::to_string(idx);
+		pullSockets.push_back(std::make_unique<zmq::socket_t>(*ctx, zmq::socket_type::pull));
+		pullSockets.back()->set(zmq::sockopt::linger, 0);
+		pullSockets.back()->bind(addr);
+		pushSockets.push_back(std::make_unique<zmq::socket_t>(*ctx, zmq::socket_type::push));
+		pushSockets.back()->set(zmq::sockopt::linger, 0);
+		pushSockets.back()->connect(addr);
+
+		ASSERT_TRUE(reactor.addSocket(*pullSockets.back(), [&counters, idx](zmq::socket_ref socket) {
+			zmq::message_t msg;
+			while (socket.recv(msg, zmq::recv_flags::dontwait))
+			{
+				++counters[idx];
+			}
+		}));
+	}
+	ASSERT_FALSE(reactor.addSocket(*pullSockets.front(), [](zmq::socket_ref /*unused*/) {}));
+	ASSERT_FALSE(reactor.addSocket(zmq::socket_ref(), [](zmq::socket_ref /*unused*/) {}));
+
+	reactor.tickCallback([&nTicks]() { ++nTicks; });
+	ASSERT_TRUE(reactor.start());
+	ASSERT_FALSE(reactor.start());
+	ASSERT_TRUE(reactor.isRunning());
+
+	const auto waitCounter = [&counters](size_t idx, size_t expected) {
+		for (size_t retry = 0; retry < 100 && counters[idx] != expected; ++retry)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		return counters[idx].load();
+	};
+
+	for (size_t idx = 0; idx < nSockets; ++idx)
+	{
+		for (size_t msgIdx = 0; msgIdx <= idx; ++msgIdx)
+		{
+			ASSERT_TRUE(pushSockets[idx]->send(zmq::str_buffer("data"), zmq::send_flags::none));
+		}
+	}
+	for (size_t idx = 0; idx < nSockets; ++idx)
+	{
+		ASSERT_EQ(waitCounter(idx, idx + 1), idx + 1);
+	}
+
+	// Paused sockets keep their messages until resumed
+	ASSERT_TRUE(reactor.pauseSocket(*pullSockets[0], true));
+	ASSERT_TRUE(pushSockets[0]->send(zmq::str_buffer("data"), zmq::send_flags::none));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ASSERT_EQ(counters[0], 1);
+	ASSERT_TRUE(reactor.pauseSocket(*pullSockets[0], false));
+	ASSERT_EQ(waitCounter(0, 2), 2);
+
+	// Removed sockets can be closed right after
+	ASSERT_TRUE(reactor.removeSocket(*pullSockets[1]));
+	ASSERT_FALSE(reactor.removeSocket(*pullSockets[1]));
+	ASSERT_FALSE(reactor.pauseSocket(*pullSockets[1], true));
+	pullSockets[1].reset();
+
+	// Sockets can be added while running
+	lateSocket.set(zmq::sockopt::linger, 0);
+	lateSocket.bind("inproc://reactor-test-late");
+	latePush.set(zmq::sockopt::linger, 0);
+	latePush.connect("inproc://reactor-test-late");
+	ASSERT_TRUE(reactor.addSocket(lateSocket, [&lateCounter](zmq::socket_ref socket) {
+		zmq::message_t msg;
+		if (socket.recv(msg, zmq::recv_flags::dontwait))
+		{
+			++lateCounter;
+		}
+	}));
+	ASSERT_TRUE(latePush.send(zmq::str_buffer("data"), zmq::send_flags::none));
+	for (size_t retry = 0; retry < 100 && lateCounter == 0; ++retry)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	ASSERT_EQ(lateCounter, 1);
+
+	// Tick callback is called even without messages
+	std::this_thread::sleep_for(std::chrono::milliseconds(250));
+	ASSERT_GT(nTicks, 0);
+
+	// Stop does not wait for the poll timeout
+	const auto stopStart = std::chrono::steady_clock::now();
+	reactor.stop();
+	ASSERT_LT(std::chrono::steady_clock::now() - stopStart, std::chrono::milliseconds(50));
+	ASSERT_FALSE(reactor.isRunning());
+	ASSERT_NO_THROW(reactor.stop());
+
+	// Server sockets are served by the reactor of the server
+	ZeroMQServer server("tcp://127.0.0.1:8303", nullptr);
+	ASSERT_TRUE(server.initialise());
+	ASSERT_TRUE(server.reactor().isRunning());
+	const auto shutdownStart = std::chrono::steady_clock::now();
+	server.shutdown();
+	ASSERT_LT(std::chrono::steady_clock::now() - shutdownStart, std::chrono::milliseconds(50));
+	ASSERT_FALSE(server.reactor().isRunning());
+}
+
+TEST(ZeroMQ_Tests, ZeroMQPublisherUnitTests)
+{
+	zmq::context_t ctx(1);
+	std::vector<zmq::message_t> recvMsgs;
+	const auto recvBatch = [&recvMsgs](zmq::socket_t &socket) {
+		recvMsgs.clear();
+		return zmq::recv_multipart(socket, std::back_inserter(recvMsgs)).value_or(0);
+	};
+
+	// Events are batched per topic and filtered by the subscribers
+	ZeroMQPublisherOptions options;
+	options.maxBatchSize = 4;
+	options.flushInterval = std::chrono::milliseconds(50);
+	auto publisher = std::make_shared<ZeroMQPublisher>("tcp://127.0.0.1:8304", options);
+	ASSERT_TRUE(publisher->initialise());
+	ASSERT_FALSE(publisher->initialise());
+
+	zmq::socket_t subscriber(ctx, zmq::socket_type::sub);
+	subscriber.set(zmq::sockopt::linger, 0);
+	subscriber.set(zmq::sockopt::rcvtimeo, 1000);
+	subscriber.set(zmq::sockopt::subscribe, "audit.");
+	subscriber.set(zmq::sockopt::subscribe, "log.");
+	subscriber.connect("tcp://127.0.0.1:8304");
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	for (size_t idx = 0; idx < 10; ++idx)
+	{
+		ASSERT_TRUE(publisher->publishAudit("test", std::to_string(idx)));
+	}
+	ASSERT_TRUE(publisher->publishMetric("test", 1));
+
+	size_t nEvents = 0;
+	while (nEvents < 10)
+	{
+		ASSERT_GT(recvBatch(subscriber), 1);
+		ASSERT_LE(recvMsgs.size(), options.maxBatchSize + 1);
+		ASSERT_EQ(recvMsgs[0].to_string_view(), "audit.test");
+		for (size_t idx = 1; idx < recvMsgs.size(); ++idx)
+		{
+			ASSERT_EQ(recvMsgs[idx].to_string_view(), std::to_string(nEvents++));
+		}
+	}
+
+	// Log lines are published by the sink
+	spdlog::logger logger("publisher", std::make_shared<spdlog::sinks::zeromq_publisher_sink_mt>(publisher));
+	logger.warn("test log line");
+	ASSERT_EQ(recvBatch(subscriber), 2);
+	ASSERT_EQ(recvMsgs[0].to_string_view(), "log.warning");
+	ASSERT_EQ(recvMsgs[1].to_string_view(), "test log line");
+	publisher->shutdown();
+	ASSERT_EQ(publisher->publishedEvents(), 12);
+	ASSERT_GE(publisher->publishedBatches(), 5);
+
+	// XPUB sockets drop the events without a subscriber and deltas of a metric are summed
+	options.isXPub = true;
+	options.flushInterval = std::chrono::milliseconds(100);
+	ZeroMQPublisher xpublisher("tcp://127.0.0.1:8305", options);
+	ASSERT_TRUE(xpublisher.initialise());
+	ASSERT_FALSE(xpublisher.publishMetric("test", 1));
+
+	zmq::socket_t xsubscriber(ctx, zmq::socket_type::sub);
+	xsubscriber.set(zmq::sockopt::linger, 0);
+	xsubscriber.set(zmq::sockopt::rcvtimeo, 1000);
+	xsubscriber.set(zmq::sockopt::subscribe, "metric.");
+	xsubscriber.connect("tcp://127.0.0.1:8305");
+	for (size_t retry = 0; retry < 100 && !xpublisher.publishMetric("test", 1); ++retry)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	ASSERT_TRUE(xpublisher.publishMetric("test", 2));
+	ASSERT_TRUE(xpublisher.publishMetric("test", 3));
+	ASSERT_FALSE(xpublisher.publishAudit("test", "not subscribed"));
+	ASSERT_EQ(recvBatch(xsubscriber), 2);
+	ASSERT_EQ(recvMsgs[0].to_string_view(), "metric.test");
+	ASSERT_EQ(recvMsgs[1].to_string_view(), "6");
+
+	// Conflated topics only keep the latest event and full queues drop the events
+	options.isXPub = false;
+	options.conflate = true;
+	options.maxQueuedEvents = 2;
+	options.flushInterval = std::chrono::milliseconds(500);
+	ZeroMQPublisher cpublisher("tcp://127.0.0.1:8306", options);
+	ASSERT_TRUE(cpublisher.initialise());
+
+	zmq::socket_t csubscriber(ctx, zmq::socket_type::sub);
+	csubscriber.set(zmq::sockopt::linger, 0);
+	csubscriber.set(zmq::sockopt::rcvtimeo, 1000);
+	csubscriber.set(zmq::sockopt::subscribe, "");
+	csubscriber.connect("tcp://127.0.0.1:8306");
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	for (size_t idx = 0; idx < 5; ++idx)
+	{
+		ASSERT_TRUE(cpublisher.publish("first", std::to_string(idx)));
+	}
+	ASSERT_TRUE(cpublisher.publish("second", "0"));
+	ASSERT_FALSE(cpublisher.publish("third", "0"));
+	ASSERT_EQ(cpublisher.droppedEvents(), 1);
+
+	std::map<std::string, std::string> latestEvents;
+	for (size_t idx = 0; idx < 2; ++idx)
+	{
+		ASSERT_EQ(recvBatch(csubscriber), 2);
+		latestEvents[recvMsgs[0].to_string()] = recvMsgs[1].to_string();
+	}
+	ASSERT_EQ(latestEvents["first"], "4");
+	ASSERT_EQ(latestEvents["second"], "0");
+
+	ASSERT_NO_THROW(cpublisher.shutdown());
+	ASSERT_NO_THROW(cpublisher.shutdown());
+}
+
+TEST(ZeroMQ_Tests, ZeroMQCommandUnitTests)
+{
+	static_assert(ZeroMQCommandId("ping") != ZeroMQCommandId("pong"));
+
+	const auto replyStatus = [](const std::vector<zmq::message_t> &replyMsgs) {
+		return replyMsgs.empty() || replyMsgs[0].size() != sizeof(int) ? 0 : *replyMsgs[0].data<int>();
+	};
+
+	// Arguments are checked against the schema before the handler is invoked
+	ZeroMQCommandRegistry registry;
+	constexpr uint32_t testId = ZeroMQCommandId("test");
+	ASSERT_TRUE(registry.registerCommand(makeZeroMQCommand<uint32_t, std::string_view>(
+		"test", testId, [](uint32_t value, std::string_view text, std::vector<zmq::message_t> &replyMsgs) {
+			replyMsgs.push_back(ZeroMQEncodeReply(value + static_cast<uint32_t>(text.size())));
+			return value != 0;
+		})));
+	ASSERT_FALSE(registry.registerCommand(makeZeroMQCommand<>(
+		"duplicate", testId, [](std::vector<zmq::message_t> & /*unused*/) { return true; })));
+	ASSERT_FALSE(registry.registerCommand(ZeroMQCommand{.name = "empty", .id = 1, .argumentSizes = {}, .handler = {}}));
+	ASSERT_FALSE(registry.registerCommand(makeZeroMQCommand<>(
+		"pipeline", ZEROMQ_PIPELINE_MARKER_ID, [](std::vector<zmq::message_t> & /*unused*/) { return true; })));
+
+	std::vector<zmq::message_t> replyMsgs;
+	ASSERT_TRUE(registry.dispatch(makeMessageVector(testId, uint32_t{40}, std::string("ab")), replyMsgs));
+	ASSERT_EQ(replyStatus(replyMsgs), ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+	ASSERT_EQ(replyMsgs.size(), 2);
+	ASSERT_EQ(*replyMsgs[1].data<uint32_t>(), 42);
+
+	// Failed commands only reply the status and an empty part
+	ASSERT_FALSE(registry.dispatch(makeMessageVector(testId, uint32_t{0}, std::string("ab")), replyMsgs));
+	ASSERT_EQ(replyStatus(replyMsgs), ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL);
+	ASSERT_EQ(replyMsgs.size(), 2);
+	ASSERT_TRUE(replyMsgs[1].empty());
+	ASSERT_FALSE(registry.dispatch(makeMessageVector(testId, uint16_t{40}, std::string("ab")), replyMsgs));
+	ASSERT_FALSE(registry.dispatch(makeMessageVector(testId, uint32_t{40}), replyMsgs));
+	ASSERT_FALSE(registry.dispatch(makeMessageVector(ZeroMQCommandId("unknown")), replyMsgs));
+	ASSERT_FALSE(registry.dispatch(makeMessageVector(uint16_t{1}), replyMsgs));
+	ASSERT_EQ(replyMsgs.size(), 2);
+
+	// Exceptions of the handlers fail the command
+	ASSERT_TRUE(registry.registerCommand(makeZeroMQCommand<>(
+		"throw", ZeroMQCommandId("throw"),
+		[](std::vector<zmq::message_t> & /*unused*/) -> bool { throw std::runtime_error("test"); })));
+	ASSERT_FALSE(registry.dispatch(makeMessageVector(ZeroMQCommandId("throw")), replyMsgs));
+	ASSERT_EQ(registry.commands().size(), 2);
+	ASSERT_EQ(registry.commands().front().second, "test");
+	ASSERT_TRUE(registry.unregisterCommand(testId));
+	ASSERT_FALSE(registry.unregisterCommand(testId));
+	ASSERT_EQ(registry.find(testId), nullptr);
+
+	// Built-in binary commands
+	ASSERT_TRUE(ZeroMQServerMessageCallback(makeMessageVector(ZeroMQCommandId("ping")), replyMsgs));
+	ASSERT_EQ(replyMsgs.size(), 2);
+	ASSERT_EQ(replyMsgs[1].size(), sizeof(int64_t));
+	ASSERT_GT(*replyMsgs[1].data<int64_t>(), 0);
+
+	ASSERT_TRUE(ZeroMQServerMessageCallback(makeMessageVector(ZeroMQCommandId("version")), replyMsgs));
+	ASSERT_FALSE(replyMsgs[1].empty());
+
+	ASSERT_TRUE(ZeroMQServerMessageCallback(makeMessageVector(ZeroMQCommandId("commands")), replyMsgs));
+	ASSERT_GE(replyMsgs.size(), 10);
+	ASSERT_TRUE(std::ranges::any_of(replyMsgs, [](const zmq::message_t &msg) {
+		constexpr uint32_t pingId = ZeroMQCommandId("ping");
+		return msg.size() == sizeof(pingId) + 4 && std::memcmp(msg.data(), &pingId, sizeof(pingId)) == 0 &&
+			   msg.to_string_view().substr(sizeof(pingId)) == "ping";
+	}));
+
+	const auto prevLevel = spdlog::get_level();
+	ASSERT_TRUE(ZeroMQServerMessageCallback(
+		makeMessageVector(ZeroMQCommandId("log_level"), uint8_t{spdlog::level::err}), replyMsgs));
+	ASSERT_EQ(spdlog::get_level(), spdlog::level::err);
+	ASSERT_FALSE(ZeroMQServerMessageCallback(makeMessageVector(ZeroMQCommandId("log_level"), uint8_t{99}), replyMsgs));
+	ASSERT_FALSE(ZeroMQServerMessageCallback(makeMessageVector(ZeroMQCommandId("log_level"), uint32_t{1}), replyMsgs));
+	spdlog::set_level(prevLevel);
+}
+
+TEST(ZeroMQ_Tests, ZeroMQPipelinedClientUnitTests)
+{
+	const auto replyStatus = [](const std::vector<zmq::message_t> &replyMsgs) {
+		return replyMsgs.empty() || replyMsgs[0].size() != sizeof(int) ? 0 : *replyMsgs[0].data<int>();
+	};
+
+	// Batches run their commands in order, failed commands do not fail the batch
+	std::vector<zmq::message_t> replyMsgs;
+	auto batchMsgs =
+		makeMessageVector(ZEROMQ_BATCH_CMD_ID, uint32_t{1}, ZeroMQCommandId("ping"), uint32_t{2},
+						  ZeroMQCommandId("log_level"), uint8_t{99}, uint32_t{1}, ZeroMQCommandId("version"));
+	ASSERT_TRUE(ZeroMQServerMessageCallback(batchMsgs, replyMsgs));
+	auto commandReplies = ZeroMQPipelinedClient::splitBatchReply(replyMsgs);
+	ASSERT_EQ(commandReplies.size(), 3);
+	ASSERT_EQ(replyStatus(commandReplies[0]), ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+	ASSERT_EQ(commandReplies[0][1].size(), sizeof(int64_t));
+	ASSERT_EQ(replyStatus(commandReplies[1]), ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL);
+	ASSERT_EQ(commandReplies[1].size(), 2);
+	ASSERT_EQ(replyStatus(commandReplies[2]), ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+	ASSERT_FALSE(commandReplies[2][1].empty());
+
+	// Malformed and nested batches are rejected as a whole
+	ASSERT_FALSE(ZeroMQServerMessageCallback(makeMessageVector(ZEROMQ_BATCH_CMD_ID), replyMsgs));
+	ASSERT_FALSE(ZeroMQServerMessageCallback(
+		makeMessageVector(ZEROMQ_BATCH_CMD_ID, uint32_t{2}, ZeroMQCommandId("ping")), replyMsgs));
+	ASSERT_FALSE(ZeroMQServerMessageCallback(
+		makeMessageVector(ZEROMQ_BATCH_CMD_ID, uint32_t{0}, ZeroMQCommandId("ping")), replyMsgs));
+	ASSERT_FALSE(ZeroMQServerMessageCallback(makeMessageVector(ZEROMQ_BATCH_CMD_ID, uint32_t{3}, ZEROMQ_BATCH_CMD_ID,
+															   uint32_t{1}, ZeroMQCommandId("ping")),
+											 replyMsgs));
+	ASSERT_TRUE(ZeroMQPipelinedClient::splitBatchReply(replyMsgs).empty());
+
+	// Reply server completes the pipelined requests in order
+	std::shared_ptr<std::atomic_flag> checkFlag;
+	ZeroMQServer repServer("tcp://127.0.0.1:8307", checkFlag);
+	repServer.messageCallback(ZeroMQServerMessageCallback);
+	ASSERT_TRUE(repServer.initialise());
+	{
+		ZeroMQPipelinedClient client("tcp://127.0.0.1:8307", 16);
+		std::vector<ZeroMQRequestId> completedIds;
+		for (int idx = 0; idx < 100; ++idx)
+		{
+			auto pingMsgs = makeMessageVector(ZeroMQCommandId("ping"));
+			client.send(pingMsgs, [&completedIds, &replyStatus](ZeroMQRequestId requestId,
+																std::vector<zmq::message_t> &pingReply) {
+				ASSERT_EQ(replyStatus(pingReply), ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+				completedIds.push_back(requestId);
+			});
+			ASSERT_LE(client.pendingRequests(), 16);
+		}
+		ASSERT_TRUE(client.drain());
+		ASSERT_EQ(completedIds.size(), 100);
+		ASSERT_TRUE(std::ranges::is_sorted(completedIds));
+
+		std::vector<std::vector<zmq::message_t>> commands;
+		commands.push_back(makeMessageVector(ZeroMQCommandId("version")));
+		commands.push_back(makeMessageVector(ZeroMQCommandId("unknown")));
+		const auto batchId = client.sendBatch(commands);
+		ASSERT_TRUE(client.wait(batchId, replyMsgs));
+		commandReplies = ZeroMQPipelinedClient::splitBatchReply(replyMsgs);
+		ASSERT_EQ(commandReplies.size(), 2);
+		ASSERT_EQ(replyStatus(commandReplies[0]), ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+		ASSERT_EQ(replyStatus(commandReplies[1]), ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL);
+		ASSERT_FALSE(client.wait(batchId, replyMsgs));
+	}
+	repServer.shutdown();
+
+	// Workers complete a fast request before a slow one sent earlier
+	const uint32_t CMD_SLOW = ZeroMQCommandId("slow");
+	ZeroMQServer workerServer("tcp://127.0.0.1:8308", checkFlag, nullptr, "", 2);
+	workerServer.messageCallback(
+		[CMD_SLOW](const std::vector<zmq::message_t> &recvMsgs, std::vector<zmq::message_t> &replyMsgs) {
+			if (*recvMsgs[0].data<uint32_t>() == CMD_SLOW)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			}
+			replyMsgs.emplace_back(recvMsgs[0].data(), recvMsgs[0].size());
+			return true;
+		});
+	ASSERT_TRUE(workerServer.initialise());
+	{
+		ZeroMQPipelinedClient client("tcp://127.0.0.1:8308");
+		auto slowMsgs = makeMessageVector(CMD_SLOW);
+		auto pingMsgs = makeMessageVector(ZeroMQCommandId("ping"));
+		const auto slowId = client.send(slowMsgs);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		const auto pingId = client.send(pingMsgs);
+
+		ASSERT_EQ(client.poll(std::chrono::milliseconds(150)), 1);
+		ASSERT_EQ(client.pendingRequests(), 1);
+		ASSERT_TRUE(client.wait(pingId, replyMsgs));
+		ASSERT_EQ(*replyMsgs[0].data<uint32_t>(), ZeroMQCommandId("ping"));
+		ASSERT_TRUE(client.wait(slowId, replyMsgs));
+		ASSERT_EQ(*replyMsgs[0].data<uint32_t>(), CMD_SLOW);
+	}
+	{
+		// Parts that only look like a request id are not an envelope without the marker, so the command is invalid
+		zmq::context_t ctx(1);
+		zmq::socket_t dealerClient(ctx, zmq::socket_type::dealer);
+		dealerClient.set(zmq::sockopt::linger, 0);
+		dealerClient.set(zmq::sockopt::rcvtimeo, 2000);
+		dealerClient.connect("tcp://127.0.0.1:8308");
+
+		auto dealerMsgs = makeMessageVector(uint64_t{42}, std::string(), ZeroMQCommandId("ping"));
+		ASSERT_EQ(zmq::send_multipart(dealerClient, dealerMsgs), 3);
+		std::vector<zmq::message_t> dealerReply;
+		ASSERT_EQ(zmq::recv_multipart(dealerClient, std::back_inserter(dealerReply)), 2);
+		ASSERT_EQ(replyStatus(dealerReply), ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL);
+	}
+	workerServer.shutdown();
+}
+
+TEST(ZeroMQ_Tests, ZeroMQCurveUnitTests)
+{
+	const std::string zeromqServerAddr = "tcp://127.0.0.1:8309";
+	const auto serverKeys = makeCurveKeyPair();
+	const auto clientKeys = makeCurveKeyPair();
+	const auto otherKeys = makeCurveKeyPair();
+	ASSERT_EQ(serverKeys.publicKey.size(), 40);
+	ASSERT_EQ(serverKeys.secretKey.size(), 40);
+	{
+		std::ofstream keyFile(TEST_ZEROMQ_AUTHORIZED_KEYS_PATH);
+		keyFile << "# Authorised clients\n" << clientKeys.publicKey << "\n\ninvalid key\n";
+	}
+
+	std::shared_ptr<std::atomic_flag> checkFlag;
+	const ZeroMQCurveKeys serverCurveKeys{.publicKey = "", .secretKey = serverKeys.secretKey, .serverKey = ""};
+	ZeroMQServer server(zeromqServerAddr, checkFlag, nullptr, "", 0, serverCurveKeys, TEST_ZEROMQ_AUTHORIZED_KEYS_PATH);
+	server.messageCallback(ZeroMQServerMessageCallback);
+	ASSERT_NE(server.authenticator(), nullptr);
+	ASSERT_EQ(server.authenticator()->authorizedKeys(), 1);
+	ASSERT_TRUE(server.initialise());
+
+	// Handshakes are reported with their durations
+	std::atomic_int nSucceeded{0};
+	std::atomic_int nFailedAuth{0};
+	const auto countHandshakes = [&nSucceeded, &nFailedAuth](ZeroMQHandshakeResult result,
+															 std::chrono::nanoseconds duration) {
+		if (result == ZeroMQHandshakeResult::Succeeded && duration.count() > 0)
+		{
+			++nSucceeded;
+		}
+		if (result == ZeroMQHandshakeResult::FailedAuth)
+		{
+			++nFailedAuth;
+		}
+	};
+
+	// Authorised client, public key is derived from the secret key if not set
+	std::vector<zmq::message_t> replyMsgs;
+	{
+		ZeroMQ client(zmq::socket_type::req, zeromqServerAddr, false,
+					  {.publicKey = "", .secretKey = clientKeys.secretKey, .serverKey = serverKeys.publicKey});
+		ZeroMQMonitor clientMonitor;
+		clientMonitor.handshakeCallback(countHandshakes);
+		clientMonitor.startMonitoring(client.getSocket().get(), "inproc://curve-client.monitor", client.getContext());
+		ASSERT_TRUE(client.start());
+
+		auto pingMsgs = makeMessageVector(ZeroMQCommandId("ping"));
+		ASSERT_EQ(client.sendMessages(pingMsgs), 1);
+		ASSERT_EQ(client.recvMessages(replyMsgs), 2);
+		ASSERT_EQ(*replyMsgs[0].data<int>(), ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		ASSERT_EQ(nSucceeded, 1);
+	}
+
+	// Unknown keys are denied until they are added to the file
+	{
+		ZeroMQ client(zmq::socket_type::req, zeromqServerAddr, false,
+					  {.publicKey = otherKeys.publicKey,
+					   .secretKey = otherKeys.secretKey,
+					   .serverKey = serverKeys.publicKey});
+		ZeroMQMonitor clientMonitor;
+		clientMonitor.handshakeCallback(countHandshakes);
+		clientMonitor.startMonitoring(client.getSocket().get(), "inproc://curve-denied.monitor", client.getContext());
+		client.getSocket()->set(zmq::sockopt::rcvtimeo, 300);
+		ASSERT_TRUE(client.start());
+
+		auto pingMsgs = makeMessageVector(ZeroMQCommandId("ping"));
+		ASSERT_EQ(client.sendMessages(pingMsgs), 1);
+		ASSERT_EQ(client.recvMessages(replyMsgs), 0);
+		ASSERT_GE(server.authenticator()->deniedClients(), 1);
+		ASSERT_GE(nFailedAuth, 1);
+	}
+
+	{
+		std::ofstream keyFile(TEST_ZEROMQ_AUTHORIZED_KEYS_PATH, std::ios::app);
+		keyFile << otherKeys.publicKey << "\n";
+	}
+	for (int idx = 0; idx < 20 && server.authenticator()->authorizedKeys() != 2; ++idx)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	ASSERT_EQ(server.authenticator()->authorizedKeys(), 2);
+	{
+		ZeroMQ client(zmq::socket_type::req, zeromqServerAddr, false,
+					  {.publicKey = otherKeys.publicKey,
+					   .secretKey = otherKeys.secretKey,
+					   .serverKey = serverKeys.publicKey});
+		ASSERT_TRUE(client.start());
+
+		auto pingMsgs = makeMessageVector(ZeroMQCommandId("ping"));
+		ASSERT_EQ(client.sendMessages(pingMsgs), 1);
+		ASSERT_EQ(client.recvMessages(replyMsgs), 2);
+		ASSERT_EQ(*replyMsgs[0].data<int>(), ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+	}
+	ASSERT_EQ(server.authenticator()->acceptedClients(), 2);
+	ASSERT_FALSE(server.authenticator()->authorizeKey("invalid"));
+	ASSERT_TRUE(server.authenticator()->authorizeKey(makeCurveKeyPair().publicKey));
+
+	ASSERT_NO_THROW(server.shutdown());
+
+	// Only one handler can be bound to a context
+	const auto ctx = std::make_shared<zmq::context_t>(1);
+	const ZeroMQAuthenticator authenticator(ctx);
+	ASSERT_EQ(authenticator.authorizedKeys(), 0);
+	ASSERT_THROW(ZeroMQAuthenticator{ctx}, zmq::error_t);
+}
+
+TEST(ZeroMQ_Tests, ZeroMQContextUnitTests)
+{
+	ASSERT_FALSE(configureZeroMQContext({.ioThreads = -1, .cpuAffinity = {}, .schedPolicy = -1, .schedPriority = -1}));
+	ASSERT_FALSE(configureZeroMQContext({.ioThreads = 1, .cpuAffinity = {-1}, .schedPolicy = -1, .schedPriority = -1}));
+	ASSERT_FALSE(configureZeroMQContext(
+		{.ioThreads = 1, .cpuAffinity = {}, .schedPolicy = SCHED_FIFO, .schedPriority = 1000}));
+
+	// Sockets share the context of the process unless a context is given
+	const auto &ctx = ZeroMQSharedContext();
+	ASSERT_NE(ctx, nullptr);
+	ASSERT_EQ(ctx, ZeroMQSharedContext());
+	ASSERT_EQ(ctx->get(zmq::ctxopt::io_threads), 1);
+
+	ZeroMQ first(zmq::socket_type::pair, "inproc://shared-context-test", true);
+	ZeroMQ second(zmq::socket_type::pair, "inproc://shared-context-test", false);
+	ASSERT_EQ(first.getContext(), ctx);
+	ASSERT_EQ(second.getContext(), ctx);
+	ASSERT_TRUE(first.start());
+	ASSERT_TRUE(second.start());
+
+	// Inproc sockets of the same context can connect to each other
+	auto sendMsgs = makeMessageVector(ZeroMQCommandId("ping"));
+	std::vector<zmq::message_t> recvMsgs;
+	ASSERT_EQ(second.sendMessages(sendMsgs), 1);
+	ASSERT_EQ(first.recvMessages(recvMsgs), 1);
+
+	// Options are not applied once the context is created
+	ASSERT_FALSE(configureZeroMQContext({}));
+}
+
+TEST(ZeroMQ_Tests, ZeroMQMultiServerUnitTests)
+{
+	const auto pingServer = [](const std::string &serverAddr, const ZeroMQCurveKeys &curveKeys) {
+		ZeroMQ client(zmq::socket_type::req, serverAddr, false, curveKeys);
+		client.getSocket()->set(zmq::sockopt::rcvtimeo, 2000);
+		if (!client.start())
+		{
+			return false;
+		}
+
+		auto pingMsgs = makeMessageVector(ZeroMQCommandId("ping"));
+		std::vector<zmq::message_t> replyMsgs;
+		return client.sendMessages(pingMsgs) == 1 && client.recvMessages(replyMsgs) == 2 &&
+			   *replyMsgs[0].data<int>() == ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
+	};
+
+	// Servers with workers share the context, internal endpoints are unique per server
+	std::shared_ptr<std::atomic_flag> checkFlag;
+	ZeroMQServer firstServer("tcp://127.0.0.1:8311", checkFlag, nullptr, "", 2);
+	ZeroMQServer secondServer("tcp://127.0.0.1:8312", checkFlag, nullptr, "", 2);
+	ASSERT_EQ(firstServer.context(), secondServer.context());
+	firstServer.messageCallback(ZeroMQServerMessageCallback);
+	secondServer.messageCallback(ZeroMQServerMessageCallback);
+	ASSERT_TRUE(firstServer.initialise());
+	ASSERT_TRUE(secondServer.initialise());
+	ASSERT_TRUE(pingServer("tcp://127.0.0.1:8311", {}));
+	ASSERT_TRUE(pingServer("tcp://127.0.0.1:8312", {}));
+	firstServer.shutdown();
+	ASSERT_TRUE(pingServer("tcp://127.0.0.1:8312", {}));
+	secondServer.shutdown();
+
+	// A context has a single ZAP handler, so CURVE servers are created in their own contexts
+	const auto serverKeys = makeCurveKeyPair();
+	const auto clientKeys = makeCurveKeyPair();
+	const ZeroMQCurveKeys serverCurveKeys{.publicKey = "", .secretKey = serverKeys.secretKey, .serverKey = ""};
+	const ZeroMQCurveKeys clientCurveKeys{
+		.publicKey = clientKeys.publicKey, .secretKey = clientKeys.secretKey, .serverKey = serverKeys.publicKey};
+	const auto firstCtx = std::make_shared<zmq::context_t>();
+	const auto secondCtx = std::make_shared<zmq::context_t>();
+
+	ZeroMQServer firstCurveServer(firstCtx, "tcp://127.0.0.1:8311", checkFlag, nullptr, "", 0, serverCurveKeys);
+	ASSERT_THROW(ZeroMQServer(firstCtx, "tcp://127.0.0.1:8312", checkFlag, nullptr, "", 0, serverCurveKeys),
+				 zmq::error_t);
+	ZeroMQServer secondCurveServer(secondCtx, "tcp://127.0.0.1:8312", checkFlag, nullptr, "", 2, serverCurveKeys);
+	ASSERT_EQ(firstCurveServer.context(), firstCtx);
+	ASSERT_EQ(secondCurveServer.context(), secondCtx);
+	for (auto *server : {&firstCurveServer, &secondCurveServer})
+	{
+		server->messageCallback(ZeroMQServerMessageCallback);
+		ASSERT_TRUE(server->authenticator()->authorizeKey(clientKeys.publicKey));
+		ASSERT_TRUE(server->initialise());
+	}
+	ASSERT_TRUE(pingServer("tcp://127.0.0.1:8311", clientCurveKeys));
+	ASSERT_TRUE(pingServer("tcp://127.0.0.1:8312", clientCurveKeys));
+	ASSERT_EQ(firstCurveServer.authenticator()->acceptedClients(), 1);
+	ASSERT_EQ(secondCurveServer.authenticator()->acceptedClients(), 1);
+}
+
+TEST(ZeroMQ_Tests, ZeroMQInterruptUnitTests)
+{
+	const std::string zeromqServerAddr = "tcp://127.0.0.1:8313";
+	std::shared_ptr<std::atomic_flag> checkFlag;
+	ZeroMQServer server(zeromqServerAddr, checkFlag, nullptr, "", 2);
+	server.messageCallback(ZeroMQServerMessageCallback);
+	ASSERT_TRUE(server.initialise());
+
+	// Profiler signals are delivered to the waiting threads, as the busy thread blocks them
+	std::jthread busyThread([](const std::stop_token &stopToken) {
+		sigset_t signals;
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGPROF);
+		pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+		while (!stopToken.stop_requested())
+		{
+		}
+	});
+	ASSERT_TRUE(Profiler().start(PROFILER_MAX_FREQUENCY));
+
+	// Interrupted receives of the client, the reactor and the workers are retried
+	{
+		ZeroMQ client(zmq::socket_type::req, zeromqServerAddr, false);
+		client.getSocket()->set(zmq::sockopt::rcvtimeo, 2000);
+		ASSERT_TRUE(client.start());
+
+		std::vector<zmq::message_t> replyMsgs;
+		const auto endTime = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+		while (std::chrono::steady_clock::now() < endTime)
+		{
+			auto pingMsgs = makeMessageVector(ZeroMQCommandId("ping"));
+			ASSERT_EQ(client.sendMessages(pingMsgs), 1);
+			ASSERT_EQ(client.recvMessages(replyMsgs), 2);
+			ASSERT_EQ(*replyMsgs[0].data<int>(), ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+	}
+	ASSERT_TRUE(Profiler().stop());
+	ASSERT_GT(Profiler().sampleCount(), 0);
+	server.shutdown();
 }